@@ -43,6 +43,7 @@ struct _EAddressbookModelPrivate {
 
 	/* Query Results */
 	GPtrArray *contacts;
+	GHashTable *contacts_index; /* const gchar *uid ~> index in contacts */
 
 	/* Signal Handler IDs */
 	gulong create_contact_id;
@@ -89,10 +90,43 @@ free_data (EAddressbookModel *model)
 	GPtrArray *array;
 
 	array = model->priv->contacts;
+	g_hash_table_remove_all (model->priv->contacts_index);
 	g_ptr_array_foreach (array, (GFunc) g_object_unref, NULL);
 	g_ptr_array_set_size (array, 0);
 }
 
+/* The index is keyed by the UID string owned by the contact,
+ * thus it should be updated whenever the contact is replaced. */
+static void
+index_contact (EAddressbookModel *model,
+               EContact *contact,
+               guint index)
+{
+	const gchar *uid;
+
+	uid = e_contact_get_const (contact, E_CONTACT_UID);
+
+	if (uid != NULL)
+		g_hash_table_replace (
+			model->priv->contacts_index,
+			(gpointer) uid, GUINT_TO_POINTER (index));
+}
+
+static gboolean
+lookup_contact_index (EAddressbookModel *model,
+                      const gchar *uid,
+                      guint *out_index)
+{
+	gpointer value;
+
+	if (!g_hash_table_lookup_extended (model->priv->contacts_index, uid, NULL, &value))
+		return FALSE;
+
+	*out_index = GPOINTER_TO_UINT (value);
+
+	return TRUE;
+}
+
 static void
 remove_book_view (EAddressbookModel *model)
 {
@@ -181,16 +215,39 @@ view_create_contact_cb (EBookClientView *client_view,
 
 	array = model->priv->contacts;
 	index = array->len;
-	count = g_list_length ((GList *) contact_list);
 
 	while (contact_list != NULL) {
 		EContact *contact = contact_list->data;
+		const gchar *uid;
+		guint existing;
+
+		uid = e_contact_get_const (contact, E_CONTACT_UID);
+
+		/* A contact already in the model replaces its row, the index
+		 * would not point to the other row of the same UID otherwise. */
+		if (uid && lookup_contact_index (model, uid, &existing)) {
+			EContact *old_contact = array->pdata[existing];
+
+			array->pdata[existing] = g_object_ref (contact);
+			index_contact (model, contact, existing);
+			g_object_unref (old_contact);
+
+			/* Rows added by this call are announced below */
+			if (existing < index)
+				g_signal_emit (model, signals[CONTACT_CHANGED], 0, existing);
+		} else {
+			g_ptr_array_add (array, g_object_ref (contact));
+			index_contact (model, contact, array->len - 1);
+		}
 
-		g_ptr_array_add (array, g_object_ref (contact));
 		contact_list = contact_list->next;
 	}
 
-	g_signal_emit (model, signals[CONTACT_ADDED], 0, index, count);
+	count = array->len - index;
+
+	if (count > 0)
+		g_signal_emit (model, signals[CONTACT_ADDED], 0, index, count);
+
 	update_folder_bar_message (model);
 }
 
@@ -209,51 +266,55 @@ view_remove_contact_cb (EBookClientView *client_view,
                         const GSList *ids,
                         EAddressbookModel *model)
 {
-	/* XXX we should keep a hash around instead of this O(n*m) loop */
 	const GSList *iter;
 	GArray *indices;
 	GPtrArray *array;
-	gint ii;
+	guint first_removed;
+	guint ii, jj;
 
 	array = model->priv->contacts;
 	indices = g_array_new (FALSE, FALSE, sizeof (gint));
+	first_removed = array->len;
 
 	for (iter = ids; iter != NULL; iter = iter->next) {
 		const gchar *target_uid = iter->data;
+		EContact *contact;
+		guint index;
 
-		for (ii = 0; ii < array->len; ii++) {
-			EContact *contact;
-			const gchar *uid;
+		if (!target_uid || !lookup_contact_index (model, target_uid, &index))
+			continue;
 
-			contact = array->pdata[ii];
-			/* check if already removed */
-			if (!contact)
-				continue;
+		contact = array->pdata[index];
+		g_hash_table_remove (model->priv->contacts_index, target_uid);
+		g_object_unref (contact);
 
-			uid = e_contact_get_const (contact, E_CONTACT_UID);
-			g_return_if_fail (uid != NULL);
+		array->pdata[index] = NULL;
+		g_array_append_val (indices, index);
 
-			if (strcmp (uid, target_uid) == 0) {
-				g_object_unref (contact);
-				g_array_append_val (indices, ii);
-				array->pdata[ii] = NULL;
-				break;
-			}
-		}
+		if (index < first_removed)
+			first_removed = index;
 	}
 
-	/* Sort the 'indices' array in descending order, since
-	 * g_ptr_array_remove_index() shifts subsequent elements
-	 * down one position to fill the gap. */
-	g_array_sort (indices, sort_descending);
+	/* Compact the array in one pass, re-indexing moved contacts. */
+	for (ii = first_removed, jj = first_removed; ii < array->len; ii++) {
+		EContact *contact = array->pdata[ii];
 
-	for (ii = 0; ii < indices->len; ii++) {
-		gint index;
+		if (!contact)
+			continue;
+
+		if (ii != jj) {
+			array->pdata[jj] = contact;
+			index_contact (model, contact, jj);
+		}
 
-		index = g_array_index (indices, gint, ii);
-		g_ptr_array_remove_index (array, index);
+		jj++;
 	}
 
+	g_ptr_array_set_size (array, jj);
+
+	/* Listeners expect the removed indices in descending order. */
+	g_array_sort (indices, sort_descending);
+
 	g_signal_emit (model, signals[CONTACTS_REMOVED], 0, indices);
 	g_array_free (indices, TRUE);
 
@@ -272,36 +333,21 @@ view_modify_contact_cb (EBookClientView *client_view,
 	while (contact_list != NULL) {
 		EContact *new_contact = contact_list->data;
 		const gchar *target_uid;
-		gint ii;
+		guint index;
 
 		target_uid = e_contact_get_const (new_contact, E_CONTACT_UID);
 		g_warn_if_fail (target_uid != NULL);
 
 		/* skip contacts without UID */
-		if (!target_uid) {
-			contact_list = contact_list->next;
-			continue;
-		}
-
-		for (ii = 0; ii < array->len; ii++) {
-			EContact *old_contact;
-			const gchar *uid;
-
-			old_contact = array->pdata[ii];
-			g_return_if_fail (old_contact != NULL);
-
-			uid = e_contact_get_const (old_contact, E_CONTACT_UID);
-			g_return_if_fail (uid != NULL);
-
-			if (strcmp (uid, target_uid) != 0)
-				continue;
+		if (target_uid && lookup_contact_index (model, target_uid, &index)) {
+			EContact *old_contact = array->pdata[index];
 
+			array->pdata[index] = e_contact_duplicate (new_contact);
+			index_contact (model, array->pdata[index], index);
 			g_object_unref (old_contact);
-			array->pdata[ii] = e_contact_duplicate (new_contact);
 
 			g_signal_emit (
-				model, signals[CONTACT_CHANGED], 0, ii);
-			break;
+				model, signals[CONTACT_CHANGED], 0, index);
 		}
 
 		contact_list = contact_list->next;
@@ -577,6 +623,7 @@ addressbook_model_finalize (GObject *object)
 	priv = E_ADDRESSBOOK_MODEL_GET_PRIVATE (object);
 
 	g_ptr_array_free (priv->contacts, TRUE);
+	g_hash_table_destroy (priv->contacts_index);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_addressbook_model_parent_class)->finalize (object);
@@ -768,6 +815,7 @@ e_addressbook_model_init (EAddressbookModel *model)
 {
 	model->priv = E_ADDRESSBOOK_MODEL_GET_PRIVATE (model);
 	model->priv->contacts = g_ptr_array_new ();
+	model->priv->contacts_index = g_hash_table_new (g_str_hash, g_str_equal);
 	model->priv->first_get_view = TRUE;
 }
 
@@ -863,6 +911,8 @@ e_addressbook_model_find (EAddressbookModel *model,
                           EContact *contact)
 {
 	GPtrArray *array;
+	const gchar *uid;
+	guint index;
 	gint ii;
 
 	/* XXX This searches for a particular EContact instance,
@@ -874,6 +924,12 @@ e_addressbook_model_find (EAddressbookModel *model,
 	g_return_val_if_fail (E_IS_CONTACT (contact), -1);
 
 	array = model->priv->contacts;
+
+	uid = e_contact_get_const (contact, E_CONTACT_UID);
+	if (uid && lookup_contact_index (model, uid, &index) &&
+	    array->pdata[index] == contact)
+		return index;
+
 	for (ii = 0; ii < array->len; ii++) {
 		EContact *candidate = array->pdata[ii];
 
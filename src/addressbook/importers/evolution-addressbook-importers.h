@@ -25,5 +25,13 @@ struct _EImportImporter *evolution_csv_outlook_importer_peek (void);
 struct _EImportImporter *evolution_csv_mozilla_importer_peek (void);
 struct _EImportImporter *evolution_csv_evolution_importer_peek (void);
 
-/* private utility function for importers only */
+/* private utility functions for importers only */
 GtkWidget *evolution_contact_importer_get_preview_widget (const GSList *contacts);
+
+/* How many contacts are sent to the book at once */
+#define EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE 500
+
+gboolean evolution_contact_importer_add_contacts_sync (struct _EBookClient *book_client,
+						       GSList *contacts,
+						       GCancellable *cancellable,
+						       GError **error);
@@ -53,9 +53,11 @@ typedef struct {
 	EImport *import;
 	EImportTarget *target;
 
-	guint idle_id;
+	guint status_id;
+	gint percent;		/* set by the import thread, read with atomic functions */
+
+	GCancellable *cancellable;
 
-	gint state;
 	FILE *file;
 	gulong size;
 	gint count;
@@ -65,13 +67,12 @@ typedef struct {
 	GHashTable *fields_map;
 
 	EBookClient *book_client;
-	GSList *contacts;
 } CSVImporter;
 
 static gint importer;
 static gchar delimiter;
 
-static void csv_import_done (CSVImporter *gci);
+static void csv_import_done (CSVImporter *gci, const GError *error);
 
 typedef struct {
 	const gchar *csv_attribute;
@@ -767,36 +768,77 @@ getNextCSVEntry (CSVImporter *gci,
 	return contact;
 }
 
-static gboolean
-csv_import_contacts (gpointer d)
+static void
+csv_import_thread (GTask *task,
+                   gpointer source_object,
+                   gpointer task_data,
+                   GCancellable *cancellable)
 {
-	CSVImporter *gci = d;
-	EContact *contact = NULL;
-
-	while ((contact = getNextCSVEntry (gci, gci->file))) {
-		gchar *uid = NULL;
-
-		e_book_client_add_contact_sync (
-			gci->book_client, contact, E_BOOK_OPERATION_FLAG_NONE, &uid, NULL, NULL);
-		if (uid != NULL) {
-			e_contact_set (contact, E_CONTACT_UID, uid);
-			g_free (uid);
+	CSVImporter *gci = task_data;
+	EContact *contact;
+	GSList *batch = NULL;
+	guint batch_len = 0;
+	gboolean success = TRUE;
+	GError *local_error = NULL;
+
+	/* The file is parsed one entry at a time and the contacts are sent
+	 * to the book in batches, thus the memory use stays flat. */
+	while (success && (contact = getNextCSVEntry (gci, gci->file)) != NULL) {
+		batch = g_slist_prepend (batch, contact);
+		batch_len++;
+
+		if (batch_len >= EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE) {
+			batch = g_slist_reverse (batch);
+			success = evolution_contact_importer_add_contacts_sync (gci->book_client, batch, cancellable, &local_error);
+			g_slist_free_full (batch, g_object_unref);
+			batch = NULL;
+			batch_len = 0;
 		}
-		gci->contacts = g_slist_prepend (gci->contacts, contact);
-	}
-	if (contact == NULL) {
-		gci->state = 1;
-	}
-	if (gci->state == 1) {
-		csv_import_done (gci);
-		return FALSE;
+
+		if (gci->size > 0)
+			g_atomic_int_set (&gci->percent, (gint) (ftell (gci->file) * 100 / gci->size));
 	}
-	else {
-		e_import_status (
-			gci->import, gci->target, _("Importing…"),
-			ftell (gci->file) * 100 / gci->size);
-		return TRUE;
+
+	if (success && batch) {
+		batch = g_slist_reverse (batch);
+		success = evolution_contact_importer_add_contacts_sync (gci->book_client, batch, cancellable, &local_error);
 	}
+
+	g_slist_free_full (batch, g_object_unref);
+
+	if (success)
+		g_task_return_boolean (task, TRUE);
+	else
+		g_task_return_error (task, local_error);
+}
+
+static void
+csv_import_thread_done_cb (GObject *source_object,
+                           GAsyncResult *result,
+                           gpointer user_data)
+{
+	CSVImporter *gci = user_data;
+	GError *local_error = NULL;
+
+	if (!g_task_propagate_boolean (G_TASK (result), &local_error) &&
+	    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		g_clear_error (&local_error);
+
+	csv_import_done (gci, local_error);
+
+	g_clear_error (&local_error);
+}
+
+static gboolean
+csv_import_status_cb (gpointer user_data)
+{
+	CSVImporter *gci = user_data;
+
+	e_import_status (
+		gci->import, gci->target, _("Importing…"),
+		g_atomic_int_get (&gci->percent));
+
+	return G_SOURCE_CONTINUE;
 }
 
 static void
@@ -911,20 +953,22 @@ csv_supported (EImport *ei,
 }
 
 static void
-csv_import_done (CSVImporter *gci)
+csv_import_done (CSVImporter *gci,
+                 const GError *error)
 {
-	if (gci->idle_id)
-		g_source_remove (gci->idle_id);
+	if (gci->status_id)
+		g_source_remove (gci->status_id);
+
+	g_datalist_set_data (&gci->target->data, "csv-data", NULL);
 
 	fclose (gci->file);
-	g_object_unref (gci->book_client);
-	g_slist_foreach (gci->contacts, (GFunc) g_object_unref, NULL);
-	g_slist_free (gci->contacts);
+	g_clear_object (&gci->book_client);
+	g_clear_object (&gci->cancellable);
 
 	if (gci->fields_map)
 		g_hash_table_destroy (gci->fields_map);
 
-	e_import_complete (gci->import, gci->target, NULL);
+	e_import_complete (gci->import, gci->target, error);
 	g_object_unref (gci->import);
 
 	g_free (gci);
@@ -937,16 +981,24 @@ book_client_connect_cb (GObject *source_object,
 {
 	CSVImporter *gci = user_data;
 	EClient *client;
+	GTask *task;
+	GError *local_error = NULL;
 
-	client = e_book_client_connect_finish (result, NULL);
+	client = e_book_client_connect_finish (result, &local_error);
 
 	if (client == NULL) {
-		csv_import_done (gci);
+		csv_import_done (gci, local_error);
+		g_clear_error (&local_error);
 		return;
 	}
 
 	gci->book_client = E_BOOK_CLIENT (client);
-	gci->idle_id = g_idle_add (csv_import_contacts, gci);
+	gci->status_id = e_named_timeout_add (250, csv_import_status_cb, gci);
+
+	task = g_task_new (NULL, gci->cancellable, csv_import_thread_done_cb, gci);
+	g_task_set_task_data (task, gci, NULL);
+	g_task_run_in_thread (task, csv_import_thread);
+	g_object_unref (task);
 }
 
 static void
@@ -989,6 +1041,7 @@ csv_import (EImport *ei,
 	gci->file = file;
 	gci->fields_map = NULL;
 	gci->count = 0;
+	gci->cancellable = g_cancellable_new ();
 	fseek (file, 0, SEEK_END);
 	gci->size = ftell (file);
 	fseek (file, 0, SEEK_SET);
@@ -1037,7 +1090,7 @@ csv_cancel (EImport *ei,
 	CSVImporter *gci = g_datalist_get_data (&target->data, "csv-data");
 
 	if (gci)
-		gci->state = 1;
+		g_cancellable_cancel (gci->cancellable);
 }
 
 static GtkWidget *
@@ -53,32 +53,23 @@ typedef struct {
 	EImport *import;
 	EImportTarget *target;
 
-	guint idle_id;
+	guint status_id;
+	gint percent;		/* set by the import thread, read with atomic functions */
 
-	gint state;		/* 0 - importing, 1 - cancelled/complete */
-	gint total;
-	gint count;
-
-	ESource *primary;
-
-	GSList *contactlist;
-	GSList *iterator;
+	GCancellable *cancellable;
 	EBookClient *book_client;
 
-	/* when opening book */
-	gchar *contents;
+	gchar *filename;
 	VCardEncoding encoding;
 } VCardImporter;
 
-static void vcard_import_done (VCardImporter *gci);
+static void vcard_import_done (VCardImporter *gci, const GError *error);
 
 static void
-vcard_import_contact (VCardImporter *gci,
-                      EContact *contact)
+vcard_prepare_contact (EContact *contact)
 {
 	EContactPhoto *photo;
 	GList *attrs, *attr;
-	gchar *uid = NULL;
 
 	/* Apple's addressbook.app exports PHOTO's without a TYPE
 	 * param, so let's figure out the format here if there's a
@@ -211,43 +202,173 @@ vcard_import_contact (VCardImporter *gci,
 								"OTHER");
 		}
 	}
-
-	/* FIXME Error checking */
-	e_book_client_add_contact_sync (
-		gci->book_client, contact, E_BOOK_OPERATION_FLAG_NONE, &uid, NULL, NULL);
-	if (uid != NULL) {
-		e_contact_set (contact, E_CONTACT_UID, uid);
-		g_free (uid);
-	}
 }
 
-static gboolean
-vcard_import_contacts (gpointer data)
+static void
+vcard_import_thread (GTask *task,
+                     gpointer source_object,
+                     gpointer task_data,
+                     GCancellable *cancellable)
 {
-	VCardImporter *gci = data;
-	gint count = 0;
-	GSList *iterator = gci->iterator;
-
-	if (gci->state == 0) {
-		while (count < 50 && iterator) {
-			vcard_import_contact (gci, iterator->data);
-			count++;
-			iterator = iterator->next;
+	VCardImporter *gci = task_data;
+	GFile *file;
+	GFileInfo *info;
+	GFileInputStream *file_stream;
+	GInputStream *stream;
+	GDataInputStream *data_stream;
+	GString *vcard = NULL;
+	GSList *batch = NULL;
+	goffset size = 0;
+	guint batch_len = 0;
+	gint depth = 0;
+	gboolean success = TRUE;
+	gchar *line;
+	GError *local_error = NULL;
+
+	/* Read the file line by line and send the contacts to the book
+	 * in batches, thus the memory use does not depend on the file size. */
+	file = g_file_new_for_path (gci->filename);
+	file_stream = g_file_read (file, cancellable, &local_error);
+	g_object_unref (file);
+
+	if (!file_stream) {
+		g_task_return_error (task, local_error);
+		return;
+	}
+
+	info = g_file_input_stream_query_info (file_stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+	if (info) {
+		size = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+
+	stream = G_INPUT_STREAM (g_object_ref (file_stream));
+
+	if (gci->encoding == VCARD_ENCODING_UTF16 ||
+	    gci->encoding == VCARD_ENCODING_LOCALE) {
+		GCharsetConverter *converter;
+		const gchar *charset = "UTF-16";
+
+		if (gci->encoding == VCARD_ENCODING_LOCALE)
+			g_get_charset (&charset);
+
+		converter = g_charset_converter_new ("UTF-8", charset, &local_error);
+
+		if (!converter) {
+			g_object_unref (stream);
+			g_object_unref (file_stream);
+			g_task_return_error (task, local_error);
+			return;
 		}
-		gci->count += count;
-		gci->iterator = iterator;
-		if (iterator == NULL)
-			gci->state = 1;
+
+		g_charset_converter_set_use_fallback (converter, TRUE);
+
+		g_object_unref (stream);
+		stream = g_converter_input_stream_new (G_INPUT_STREAM (file_stream), G_CONVERTER (converter));
+		g_object_unref (converter);
 	}
-	if (gci->state == 1) {
-		vcard_import_done (gci);
-		return FALSE;
-	} else {
-		e_import_status (
-			gci->import, gci->target, _("Importing…"),
-			gci->count * 100 / gci->total);
-		return TRUE;
+
+	data_stream = g_data_input_stream_new (stream);
+	g_data_input_stream_set_newline_type (data_stream, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+	while (success && (line = g_data_input_stream_read_line (data_stream, NULL, cancellable, &local_error)) != NULL) {
+		const gchar *ptr = line;
+
+		/* Skip the UTF-8 BOM */
+		if (!vcard && g_str_has_prefix (ptr, "\xEF\xBB\xBF"))
+			ptr += 3;
+
+		if (!g_ascii_strncasecmp (ptr, "BEGIN:VCARD", 11)) {
+			if (!vcard)
+				vcard = g_string_sized_new (1024);
+			depth++;
+		}
+
+		if (depth > 0) {
+			g_string_append (vcard, ptr);
+			g_string_append_c (vcard, '\n');
+
+			if (!g_ascii_strncasecmp (ptr, "END:VCARD", 9)) {
+				depth--;
+
+				if (!depth) {
+					EContact *contact;
+
+					contact = e_contact_new_from_vcard (vcard->str);
+					if (contact) {
+						vcard_prepare_contact (contact);
+						batch = g_slist_prepend (batch, contact);
+						batch_len++;
+					}
+
+					g_string_truncate (vcard, 0);
+				}
+			}
+		}
+
+		g_free (line);
+
+		if (batch_len >= EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE) {
+			batch = g_slist_reverse (batch);
+			success = evolution_contact_importer_add_contacts_sync (gci->book_client, batch, cancellable, &local_error);
+			g_slist_free_full (batch, g_object_unref);
+			batch = NULL;
+			batch_len = 0;
+		}
+
+		if (size > 0) {
+			g_atomic_int_set (&gci->percent,
+				(gint) (g_seekable_tell (G_SEEKABLE (file_stream)) * 100 / size));
+		}
 	}
+
+	if (success && !local_error && batch) {
+		batch = g_slist_reverse (batch);
+		evolution_contact_importer_add_contacts_sync (gci->book_client, batch, cancellable, &local_error);
+	}
+
+	g_slist_free_full (batch, g_object_unref);
+
+	if (vcard)
+		g_string_free (vcard, TRUE);
+
+	g_object_unref (data_stream);
+	g_object_unref (stream);
+	g_object_unref (file_stream);
+
+	if (local_error)
+		g_task_return_error (task, local_error);
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static void
+vcard_import_thread_done_cb (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
+{
+	VCardImporter *gci = user_data;
+	GError *local_error = NULL;
+
+	if (!g_task_propagate_boolean (G_TASK (result), &local_error) &&
+	    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		g_clear_error (&local_error);
+
+	vcard_import_done (gci, local_error);
+
+	g_clear_error (&local_error);
+}
+
+static gboolean
+vcard_import_status_cb (gpointer user_data)
+{
+	VCardImporter *gci = user_data;
+
+	e_import_status (
+		gci->import, gci->target, _("Importing…"),
+		g_atomic_int_get (&gci->percent));
+
+	return G_SOURCE_CONTINUE;
 }
 
 #define BOM (gunichar2)0xFEFF
@@ -452,16 +573,19 @@ vcard_supported (EImport *ei,
 }
 
 static void
-vcard_import_done (VCardImporter *gci)
+vcard_import_done (VCardImporter *gci,
+                   const GError *error)
 {
-	if (gci->idle_id)
-		g_source_remove (gci->idle_id);
+	if (gci->status_id)
+		g_source_remove (gci->status_id);
+
+	g_datalist_set_data (&gci->target->data, "vcard-data", NULL);
 
-	g_free (gci->contents);
-	g_object_unref (gci->book_client);
-	g_slist_free_full (gci->contactlist, (GDestroyNotify) g_object_unref);
+	g_free (gci->filename);
+	g_clear_object (&gci->book_client);
+	g_clear_object (&gci->cancellable);
 
-	e_import_complete (gci->import, gci->target, NULL);
+	e_import_complete (gci->import, gci->target, error);
 	g_object_unref (gci->import);
 	g_free (gci);
 }
@@ -473,41 +597,24 @@ book_client_connect_cb (GObject *source_object,
 {
 	VCardImporter *gci = user_data;
 	EClient *client;
+	GTask *task;
+	GError *local_error = NULL;
 
-	client = e_book_client_connect_finish (result, NULL);
+	client = e_book_client_connect_finish (result, &local_error);
 
 	if (client == NULL) {
-		vcard_import_done (gci);
+		vcard_import_done (gci, local_error);
+		g_clear_error (&local_error);
 		return;
 	}
 
 	gci->book_client = E_BOOK_CLIENT (client);
+	gci->status_id = e_named_timeout_add (250, vcard_import_status_cb, gci);
 
-	if (gci->encoding == VCARD_ENCODING_UTF16) {
-		gchar *tmp;
-
-		gunichar2 *contents_utf16 = (gunichar2 *) gci->contents;
-		tmp = utf16_to_utf8 (contents_utf16);
-		g_free (gci->contents);
-		gci->contents = tmp;
-
-	} else if (gci->encoding == VCARD_ENCODING_LOCALE) {
-		gchar *tmp;
-		tmp = g_locale_to_utf8 (gci->contents, -1, NULL, NULL, NULL);
-		g_free (gci->contents);
-		gci->contents = tmp;
-	}
-
-	gci->contactlist = eab_contact_list_from_string (gci->contents);
-	g_free (gci->contents);
-	gci->contents = NULL;
-	gci->iterator = gci->contactlist;
-	gci->total = g_slist_length (gci->contactlist);
-
-	if (gci->iterator)
-		gci->idle_id = g_idle_add (vcard_import_contacts, gci);
-	else
-		vcard_import_done (gci);
+	task = g_task_new (NULL, gci->cancellable, vcard_import_thread_done_cb, gci);
+	g_task_set_task_data (task, gci, NULL);
+	g_task_run_in_thread (task, vcard_import_thread);
+	g_object_unref (task);
 }
 
 static void
@@ -519,7 +626,6 @@ vcard_import (EImport *ei,
 	ESource *source;
 	EImportTargetURI *s = (EImportTargetURI *) target;
 	gchar *filename;
-	gchar *contents;
 	VCardEncoding encoding;
 	GError *error = NULL;
 
@@ -540,21 +646,13 @@ vcard_import (EImport *ei,
 		return;
 	}
 
-	if (!g_file_get_contents (filename, &contents, NULL, &error)) {
-		g_free (filename);
-		e_import_complete (ei, target, error);
-		g_clear_error (&error);
-
-		return;
-	}
-
-	g_free (filename);
 	gci = g_malloc0 (sizeof (*gci));
 	g_datalist_set_data (&target->data, "vcard-data", gci);
 	gci->import = g_object_ref (ei);
 	gci->target = target;
 	gci->encoding = encoding;
-	gci->contents = contents;
+	gci->filename = filename;
+	gci->cancellable = g_cancellable_new ();
 
 	source = g_datalist_get_data (&target->data, "vcard-source");
 
@@ -569,7 +667,7 @@ vcard_cancel (EImport *ei,
 	VCardImporter *gci = g_datalist_get_data (&target->data, "vcard-data");
 
 	if (gci)
-		gci->state = 1;
+		g_cancellable_cancel (gci->cancellable);
 }
 
 static GtkWidget *
@@ -912,6 +1010,79 @@ preview_selection_changed_cb (GtkTreeSelection *selection,
 	e_web_view_preview_end_update (preview);
 }
 
+/* Whether the book cannot store any contact, thus adding
+ * the contacts one by one would fail the same way */
+static gboolean
+contact_importer_error_is_book_failure (const GError *error)
+{
+	return g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_PERMISSION_DENIED) ||
+		g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_REPOSITORY_OFFLINE) ||
+		g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_OFFLINE_UNAVAILABLE) ||
+		g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_AUTHENTICATION_FAILED) ||
+		g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_AUTHENTICATION_REQUIRED) ||
+		g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_BUSY) ||
+		g_error_matches (error, E_BOOK_CLIENT_ERROR, E_BOOK_CLIENT_ERROR_NO_SPACE);
+}
+
+/* Adds the @contacts in one call; when the book refuses the batch, tries
+ * to add them one by one, thus a single broken contact does not cause
+ * the whole batch to be lost.  The contacts reported as added by the failed
+ * batch are not added again.  Returns FALSE and sets the @error when
+ * cancelled or when the book cannot store any contact. */
+gboolean
+evolution_contact_importer_add_contacts_sync (EBookClient *book_client,
+                                              GSList *contacts,
+                                              GCancellable *cancellable,
+                                              GError **error)
+{
+	GSList *link, *added_uids = NULL;
+	GHashTable *added;
+	GError *local_error = NULL;
+
+	if (!contacts)
+		return TRUE;
+
+	if (e_book_client_add_contacts_sync (book_client, contacts, E_BOOK_OPERATION_FLAG_NONE, &added_uids, cancellable, &local_error)) {
+		g_slist_free_full (added_uids, g_free);
+		return TRUE;
+	}
+
+	if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+	    contact_importer_error_is_book_failure (local_error)) {
+		g_slist_free_full (added_uids, g_free);
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	g_clear_error (&local_error);
+
+	added = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (link = added_uids; link; link = g_slist_next (link)) {
+		if (link->data)
+			g_hash_table_add (added, link->data);
+	}
+
+	for (link = contacts; link; link = g_slist_next (link)) {
+		const gchar *uid;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		uid = e_contact_get_const (link->data, E_CONTACT_UID);
+
+		if (uid && *uid && g_hash_table_contains (added, uid))
+			continue;
+
+		e_book_client_add_contact_sync (book_client, link->data, E_BOOK_OPERATION_FLAG_NONE, NULL, cancellable, NULL);
+	}
+
+	g_hash_table_destroy (added);
+	g_slist_free_full (added_uids, g_free);
+
+	return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
 GtkWidget *
 evolution_contact_importer_get_preview_widget (const GSList *contacts)
 {
@@ -1004,6 +1004,7 @@ struct ForeachTzidData
 	GCancellable *cancellable;
 	GError **error;
 	gboolean success;
+	GHashTable *added_tzids; /* nullable; TZIDs already added to the destination */
 };
 
 static void
@@ -1038,9 +1039,15 @@ add_timezone_to_cal_cb (ICalParameter *param,
 	if (!tzid || !*tzid)
 		return;
 
+	if (ftd->added_tzids && g_hash_table_contains (ftd->added_tzids, tzid))
+		return;
+
 	if (e_cal_client_get_timezone_sync (ftd->source_client, tzid, &tz, ftd->cancellable, NULL) && tz)
 		ftd->success = e_cal_client_add_timezone_sync (
 				ftd->destination_client, tz, ftd->cancellable, ftd->error);
+
+	if (ftd->success && ftd->added_tzids)
+		g_hash_table_add (ftd->added_tzids, g_strdup (tzid));
 }
 
 /* Helper for cal_comp_transfer_item_to() */
@@ -1270,6 +1277,7 @@ cal_comp_transfer_item_to_sync (ECalClient *src_client,
 		ftd.cancellable = cancellable;
 		ftd.error = error;
 		ftd.success = TRUE;
+		ftd.added_tzids = NULL;
 
 		if (i_cal_component_isa (icomp) == I_CAL_VCALENDAR_COMPONENT) {
 			/* in case of a vCalendar, the component might have detached instances,
@@ -1366,6 +1374,194 @@ cal_comp_transfer_item_to_sync (ECalClient *src_client,
 	return success;
 }
 
+/* Removes all the @pids from the @client in one request and frees them */
+static gboolean
+cal_comp_transfer_remove_objects_sync (ECalClient *client,
+				       GSList **pids,
+				       ECalObjModType mod,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	gboolean success = TRUE;
+
+	if (*pids) {
+		*pids = g_slist_reverse (*pids);
+
+		success = e_cal_client_remove_objects_sync (client, *pids, mod,
+			E_CAL_OPERATION_FLAG_DISABLE_ITIP_MESSAGE, cancellable, error);
+
+		g_slist_free_full (*pids, e_cal_component_id_free);
+		*pids = NULL;
+	}
+
+	return success;
+}
+
+/**
+ * cal_comp_transfer_items_to_sync:
+ * @src_client: an #ECalClient the @icomps come from
+ * @dest_client: an #ECalClient to transfer the @icomps to
+ * @icomps: (element-type ICalComponent): components to transfer
+ * @do_copy: whether to copy (%TRUE) or move (%FALSE) the @icomps
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Does the same as cal_comp_transfer_item_to_sync() for each of the @icomps,
+ * only the plain components, which are not in the @dest_client yet, are
+ * created in it, and on move removed from the @src_client, with a single
+ * request each. The rest, like detached instances, is transferred one by one.
+ *
+ * Returns: whether succeeded
+ **/
+gboolean
+cal_comp_transfer_items_to_sync (ECalClient *src_client,
+				 ECalClient *dest_client,
+				 const GSList *icomps,
+				 gboolean do_copy,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	ICalComponentKind icomp_kind;
+	struct ForeachTzidData ftd;
+	GHashTable *existing_uids, *batch_uids;
+	GSList *to_create = NULL, *to_remove_this = NULL, *to_remove_all = NULL, *one_by_one = NULL;
+	const GSList *link;
+	gboolean same_client;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (E_IS_CAL_CLIENT (src_client), FALSE);
+	g_return_val_if_fail (E_IS_CAL_CLIENT (dest_client), FALSE);
+
+	switch (e_cal_client_get_source_type (src_client)) {
+		case E_CAL_CLIENT_SOURCE_TYPE_EVENTS:
+			icomp_kind = I_CAL_VEVENT_COMPONENT;
+			break;
+		case E_CAL_CLIENT_SOURCE_TYPE_TASKS:
+			icomp_kind = I_CAL_VTODO_COMPONENT;
+			break;
+		case E_CAL_CLIENT_SOURCE_TYPE_MEMOS:
+			icomp_kind = I_CAL_VJOURNAL_COMPONENT;
+			break;
+		default:
+			g_return_val_if_reached (FALSE);
+	}
+
+	same_client = src_client == dest_client || e_source_equal (
+		e_client_get_source (E_CLIENT (src_client)), e_client_get_source (E_CLIENT (dest_client)));
+	existing_uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	batch_uids = g_hash_table_new (g_str_hash, g_str_equal);
+
+	/* Look up, with one query, which of the components the destination already has */
+	if (!do_copy || !same_client) {
+		GString *sexp;
+		GSList *objects = NULL, *olink;
+		gboolean any = FALSE;
+
+		sexp = g_string_new ("(or");
+
+		for (link = icomps; link; link = g_slist_next (link)) {
+			const gchar *uid = i_cal_component_get_uid (link->data);
+
+			if (uid && *uid) {
+				g_string_append (sexp, " (uid? ");
+				e_sexp_encode_string (sexp, uid);
+				g_string_append_c (sexp, ')');
+				any = TRUE;
+			}
+		}
+
+		g_string_append_c (sexp, ')');
+
+		if (any)
+			success = e_cal_client_get_object_list_sync (dest_client, sexp->str, &objects, cancellable, error);
+
+		for (olink = objects; olink; olink = g_slist_next (olink)) {
+			const gchar *uid = i_cal_component_get_uid (olink->data);
+
+			if (uid)
+				g_hash_table_add (existing_uids, g_strdup (uid));
+		}
+
+		g_slist_free_full (objects, g_object_unref);
+		g_string_free (sexp, TRUE);
+	}
+
+	ftd.source_client = src_client;
+	ftd.destination_client = dest_client;
+	ftd.cancellable = cancellable;
+	ftd.error = error;
+	ftd.success = TRUE;
+	ftd.added_tzids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (link = icomps; link && success; link = g_slist_next (link)) {
+		ICalComponent *icomp_event = link->data, *icomp;
+		const gchar *uid = i_cal_component_get_uid (icomp_event);
+
+		if (!uid || !*uid ||
+		    i_cal_component_isa (icomp_event) != icomp_kind ||
+		    e_cal_util_component_is_instance (icomp_event) ||
+		    g_hash_table_contains (existing_uids, uid) ||
+		    g_hash_table_contains (batch_uids, uid)) {
+			one_by_one = g_slist_prepend (one_by_one, icomp_event);
+			continue;
+		}
+
+		g_hash_table_add (batch_uids, (gpointer) uid);
+
+		icomp = i_cal_component_clone (icomp_event);
+
+		if (do_copy) {
+			gchar *new_uid;
+
+			/* Change the UID to avoid problems with duplicated UID */
+			new_uid = e_util_generate_uid ();
+			i_cal_component_set_uid (icomp, new_uid);
+			g_free (new_uid);
+		}
+
+		i_cal_component_foreach_tzid (icomp, add_timezone_to_cal_cb, &ftd);
+		success = ftd.success;
+
+		to_create = g_slist_prepend (to_create, icomp);
+
+		if (!do_copy) {
+			if (e_cal_util_component_has_recurrences (icomp_event))
+				to_remove_all = g_slist_prepend (to_remove_all, e_cal_component_id_new (uid, NULL));
+			else
+				to_remove_this = g_slist_prepend (to_remove_this, e_cal_component_id_new (uid, NULL));
+		}
+	}
+
+	if (success && to_create) {
+		to_create = g_slist_reverse (to_create);
+
+		success = e_cal_client_create_objects_sync (dest_client, to_create,
+			E_CAL_OPERATION_FLAG_DISABLE_ITIP_MESSAGE, NULL, cancellable, error);
+	}
+
+	if (success)
+		success = cal_comp_transfer_remove_objects_sync (src_client, &to_remove_this, E_CAL_OBJ_MOD_THIS, cancellable, error);
+
+	if (success)
+		success = cal_comp_transfer_remove_objects_sync (src_client, &to_remove_all, E_CAL_OBJ_MOD_ALL, cancellable, error);
+
+	one_by_one = g_slist_reverse (one_by_one);
+
+	for (link = one_by_one; link && success; link = g_slist_next (link)) {
+		success = cal_comp_transfer_item_to_sync (src_client, dest_client, link->data, do_copy, cancellable, error);
+	}
+
+	g_slist_free_full (to_create, g_object_unref);
+	g_slist_free_full (to_remove_this, e_cal_component_id_free);
+	g_slist_free_full (to_remove_all, e_cal_component_id_free);
+	g_slist_free (one_by_one);
+	g_hash_table_destroy (ftd.added_tzids);
+	g_hash_table_destroy (existing_uids);
+	g_hash_table_destroy (batch_uids);
+
+	return success;
+}
+
 void
 cal_comp_util_update_tzid_parameter (ICalProperty *prop,
 				     const ICalTime *tt)
@@ -73,6 +73,8 @@ typedef struct _ComponentData {
 	time_t instance_start;
 	time_t instance_end;
 	gboolean is_detached;
+	const ECalComponentId *index_id; /* the key in ViewData::components, set while indexed */
+	GSequenceIter *index_iter; /* in ViewData::components_index or ::components_index_long */
 } ComponentData;
 
 typedef struct _ViewData {
@@ -89,6 +91,8 @@ typedef struct _ViewData {
 	gulong complete_id;
 
 	GHashTable *components; /* ECalComponentId ~> ComponentData */
+	GSequence *components_index; /* ComponentData *, sorted by instance_start; short instances only */
+	GSequence *components_index_long; /* ComponentData *, sorted by instance_start; longer instances */
 	GHashTable *lost_components; /* ECalComponentId ~> ComponentData; when re-running view, valid till 'complete' is received */
 	gboolean received_complete;
 	GSList *to_expand_recurrences; /* ICalComponent */
@@ -98,6 +102,11 @@ typedef struct _ViewData {
 	GCancellable *cancellable;
 } ViewData;
 
+/* Instances not longer than this are in the 'components_index', thus
+   a range query can start at the range start minus this duration;
+   the longer instances are in the 'components_index_long'. */
+#define COMPONENT_INDEX_MAX_SHORT_DURATION (7 * 24 * 60 * 60)
+
 typedef struct _SubscriberData {
 	ECalDataModelSubscriber *subscriber;
 	time_t range_start;
@@ -215,6 +224,8 @@ view_data_new (ECalClient *client)
 	view_data->components = g_hash_table_new_full (
 		e_cal_component_id_hash, e_cal_component_id_equal,
 		e_cal_component_id_free, component_data_free);
+	view_data->components_index = g_sequence_new (NULL);
+	view_data->components_index_long = g_sequence_new (NULL);
 
 	return view_data;
 }
@@ -263,6 +274,8 @@ view_data_unref (gpointer ptr)
 			g_clear_object (&view_data->cancellable);
 			g_clear_object (&view_data->client);
 			g_clear_object (&view_data->view);
+			g_sequence_free (view_data->components_index);
+			g_sequence_free (view_data->components_index_long);
 			g_hash_table_destroy (view_data->components);
 			if (view_data->lost_components)
 				g_hash_table_destroy (view_data->lost_components);
@@ -274,6 +287,128 @@ view_data_unref (gpointer ptr)
 	}
 }
 
+static gint
+component_index_compare (gconstpointer ptr1,
+			 gconstpointer ptr2,
+			 gpointer user_data)
+{
+	const ComponentData *comp_data1 = ptr1, *comp_data2 = ptr2;
+
+	if (comp_data1->instance_start != comp_data2->instance_start)
+		return comp_data1->instance_start < comp_data2->instance_start ? -1 : 1;
+
+	/* A search key, without a component, goes before the items with the same instance_start */
+	if (!comp_data1->component && comp_data2->component)
+		return -1;
+
+	if (comp_data1->component && !comp_data2->component)
+		return 1;
+
+	return 0;
+}
+
+/* Call with the view_data locked */
+static void
+view_data_index_add (ViewData *view_data,
+		     const ECalComponentId *id,
+		     ComponentData *comp_data)
+{
+	GSequence *index;
+
+	g_return_if_fail (view_data != NULL);
+	g_return_if_fail (comp_data != NULL);
+	g_return_if_fail (comp_data->index_iter == NULL);
+
+	if (comp_data->instance_end - comp_data->instance_start > COMPONENT_INDEX_MAX_SHORT_DURATION)
+		index = view_data->components_index_long;
+	else
+		index = view_data->components_index;
+
+	comp_data->index_id = id;
+	comp_data->index_iter = g_sequence_insert_sorted (index, comp_data, component_index_compare, NULL);
+}
+
+/* Call with the view_data locked, before the comp_data is freed */
+static void
+view_data_index_remove (ViewData *view_data,
+			ComponentData *comp_data)
+{
+	g_return_if_fail (view_data != NULL);
+	g_return_if_fail (comp_data != NULL);
+
+	if (comp_data->index_iter) {
+		g_sequence_remove (comp_data->index_iter);
+		comp_data->index_iter = NULL;
+		comp_data->index_id = NULL;
+	}
+}
+
+static void
+view_data_index_unset_cb (gpointer data,
+			  gpointer user_data)
+{
+	ComponentData *comp_data = data;
+
+	comp_data->index_iter = NULL;
+	comp_data->index_id = NULL;
+}
+
+/* Call with the view_data locked */
+static void
+view_data_index_clear (ViewData *view_data)
+{
+	g_return_if_fail (view_data != NULL);
+
+	g_sequence_foreach (view_data->components_index, view_data_index_unset_cb, NULL);
+	g_sequence_remove_range (
+		g_sequence_get_begin_iter (view_data->components_index),
+		g_sequence_get_end_iter (view_data->components_index));
+
+	g_sequence_foreach (view_data->components_index_long, view_data_index_unset_cb, NULL);
+	g_sequence_remove_range (
+		g_sequence_get_begin_iter (view_data->components_index_long),
+		g_sequence_get_end_iter (view_data->components_index_long));
+}
+
+/* Call with the view_data locked; the 'id' is stolen */
+static void
+view_data_insert_component (ViewData *view_data,
+			    ECalComponentId *id,
+			    ComponentData *comp_data)
+{
+	ComponentData *old_comp_data;
+
+	g_return_if_fail (view_data != NULL);
+	g_return_if_fail (id != NULL);
+	g_return_if_fail (comp_data != NULL);
+
+	old_comp_data = g_hash_table_lookup (view_data->components, id);
+	if (old_comp_data)
+		view_data_index_remove (view_data, old_comp_data);
+
+	/* Replace also the key, the old one can be freed with the old_comp_data */
+	g_hash_table_replace (view_data->components, id, comp_data);
+
+	view_data_index_add (view_data, id, comp_data);
+}
+
+/* Call with the view_data locked */
+static gboolean
+view_data_remove_component (ViewData *view_data,
+			    const ECalComponentId *id)
+{
+	ComponentData *comp_data;
+
+	g_return_val_if_fail (view_data != NULL, FALSE);
+	g_return_val_if_fail (id != NULL, FALSE);
+
+	comp_data = g_hash_table_lookup (view_data->components, id);
+	if (comp_data)
+		view_data_index_remove (view_data, comp_data);
+
+	return g_hash_table_remove (view_data->components, id);
+}
+
 static void
 view_data_lock (ViewData *view_data)
 {
@@ -680,7 +815,7 @@ static void
 cal_data_model_remove_components (ECalDataModel *data_model,
 				  ECalClient *client,
 				  GHashTable *components,
-				  GHashTable *also_remove_from)
+				  ViewData *also_remove_from_view)
 {
 	GList *ids, *ilink;
 
@@ -710,8 +845,8 @@ cal_data_model_remove_components (ECalDataModel *data_model,
 			instance_start, instance_end,
 			cal_data_model_remove_one_view_component_cb, id);
 
-		if (also_remove_from)
-			g_hash_table_remove (also_remove_from, id);
+		if (also_remove_from_view)
+			view_data_remove_component (also_remove_from_view, id);
 	}
 
 	g_list_free (ids);
@@ -871,7 +1006,7 @@ cal_data_model_process_added_component (ECalDataModel *data_model,
 	/* Note: old_comp_data is freed or NULL now */
 
 	/* 'id' is stolen by view_data->components */
-	g_hash_table_insert (view_data->components, id, comp_data);
+	view_data_insert_component (view_data, id, comp_data);
 
 	if (!comp_data_equal) {
 		if (!old_comp_data) {
@@ -1055,7 +1190,7 @@ cal_data_model_notify_recurrences_cb (gpointer user_data)
 		}
 
 		if (view_data->is_used && g_hash_table_size (known_instances) > 0) {
-			cal_data_model_remove_components (data_model, view_data->client, known_instances, view_data->components);
+			cal_data_model_remove_components (data_model, view_data->client, known_instances, view_data);
 			g_hash_table_remove_all (known_instances);
 		}
 
@@ -1469,7 +1604,7 @@ cal_data_model_view_objects_removed (ECalClientView *view,
 					}
 				}
 
-				g_hash_table_remove (view_data->components, id);
+				view_data_remove_component (view_data, id);
 				if (view_data->lost_components)
 					g_hash_table_remove (view_data->lost_components, id);
 
@@ -1706,6 +1841,7 @@ cal_data_model_update_client_view (ECalDataModel *data_model,
 		g_hash_table_foreach (view_data->components,
 			cal_data_model_notify_remove_components_cb, &nrc_data);
 
+		view_data_index_clear (view_data);
 		g_hash_table_remove_all (view_data->components);
 		if (view_data->lost_components) {
 			g_hash_table_foreach (view_data->lost_components,
@@ -1732,6 +1868,9 @@ cal_data_model_update_client_view (ECalDataModel *data_model,
 			view_data->lost_components = NULL;
 		}
 
+		/* The lost components are not indexed */
+		view_data_index_clear (view_data);
+
 		view_data->lost_components = view_data->components;
 		view_data->components = g_hash_table_new_full (
 			(GHashFunc) e_cal_component_id_hash, (GEqualFunc) e_cal_component_id_equal,
@@ -1802,6 +1941,7 @@ cal_data_model_remove_client_view (ECalDataModel *data_model,
 
 		g_hash_table_foreach (view_data->components,
 			cal_data_model_notify_remove_components_cb, &nrc_data);
+		view_data_index_clear (view_data);
 		g_hash_table_remove_all (view_data->components);
 
 		if (view_data->lost_components) {
@@ -2697,6 +2837,58 @@ e_cal_data_model_get_components (ECalDataModel *data_model,
 	return g_slist_reverse (components);
 }
 
+static gboolean
+cal_data_model_component_in_range (ComponentData *comp_data,
+				   time_t in_range_start,
+				   time_t in_range_end)
+{
+	return (in_range_start == in_range_end && in_range_start == (time_t) 0) ||
+	       (comp_data->instance_start < in_range_end && comp_data->instance_end > in_range_start) ||
+	       (comp_data->instance_start == comp_data->instance_end && comp_data->instance_end == in_range_start);
+}
+
+/* Returns the first item of the index with instance_start not before 'from_start' */
+static GSequenceIter *
+component_index_search (GSequence *index,
+			time_t from_start)
+{
+	ComponentData key = { 0, };
+
+	key.instance_start = from_start;
+
+	return g_sequence_search (index, &key, component_index_compare, NULL);
+}
+
+/* Calls the func for the index items from the 'iter' up to those starting
+   at 'to_start', which intersect the range; stops when the func returns FALSE. */
+static gboolean
+cal_data_model_foreach_indexed_component (ECalDataModel *data_model,
+					  ECalClient *client,
+					  GSequenceIter *iter,
+					  time_t to_start,
+					  time_t in_range_start,
+					  time_t in_range_end,
+					  ECalDataModelForeachFunc func,
+					  gpointer user_data)
+{
+	while (!g_sequence_iter_is_end (iter)) {
+		ComponentData *comp_data = g_sequence_get (iter);
+
+		if (comp_data->instance_start > to_start)
+			break;
+
+		/* Move first, the func can remove the current component */
+		iter = g_sequence_iter_next (iter);
+
+		if (cal_data_model_component_in_range (comp_data, in_range_start, in_range_end) &&
+		    !func (data_model, client, comp_data->index_id, comp_data->component,
+			   comp_data->instance_start, comp_data->instance_end, user_data))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 static gboolean
 cal_data_model_foreach_component (ECalDataModel *data_model,
 				  time_t in_range_start,
@@ -2732,21 +2924,31 @@ cal_data_model_foreach_component (ECalDataModel *data_model,
 
 		view_data_lock (view_data);
 
-		g_hash_table_iter_init (&citer, view_data->components);
-		while (checked_all && g_hash_table_iter_next (&citer, &key, &value)) {
-			ECalComponentId *id = key;
-			ComponentData *comp_data = value;
+		if (in_range_start == in_range_end && in_range_start == (time_t) 0) {
+			g_hash_table_iter_init (&citer, view_data->components);
+			while (checked_all && g_hash_table_iter_next (&citer, &key, &value)) {
+				ECalComponentId *id = key;
+				ComponentData *comp_data = value;
 
-			if (!comp_data)
-				continue;
+				if (!comp_data)
+					continue;
 
-			if ((in_range_start == in_range_end && in_range_start == (time_t) 0) ||
-			    (comp_data->instance_start < in_range_end && comp_data->instance_end > in_range_start) ||
-			    (comp_data->instance_start == comp_data->instance_end && comp_data->instance_end == in_range_start)) {
 				if (!func (data_model, view_data->client, id, comp_data->component,
 					   comp_data->instance_start, comp_data->instance_end, user_data))
 					checked_all = FALSE;
 			}
+		} else {
+			time_t to_start = MAX (in_range_end, in_range_start);
+
+			checked_all = cal_data_model_foreach_indexed_component (data_model, view_data->client,
+				component_index_search (view_data->components_index, in_range_start - COMPONENT_INDEX_MAX_SHORT_DURATION),
+				to_start, in_range_start, in_range_end, func, user_data);
+
+			if (checked_all) {
+				checked_all = cal_data_model_foreach_indexed_component (data_model, view_data->client,
+					g_sequence_get_begin_iter (view_data->components_index_long),
+					to_start, in_range_start, in_range_end, func, user_data);
+			}
 		}
 
 		if (include_lost_components && view_data->lost_components) {
@@ -2758,9 +2960,7 @@ cal_data_model_foreach_component (ECalDataModel *data_model,
 				if (!comp_data)
 					continue;
 
-				if ((in_range_start == in_range_end && in_range_start == (time_t) 0) ||
-				    (comp_data->instance_start < in_range_end && comp_data->instance_end > in_range_start) ||
-				    (comp_data->instance_start == comp_data->instance_end && comp_data->instance_end == in_range_start)) {
+				if (cal_data_model_component_in_range (comp_data, in_range_start, in_range_end)) {
 					if (!func (data_model, view_data->client, id, comp_data->component,
 						   comp_data->instance_start, comp_data->instance_end, user_data))
 						checked_all = FALSE;
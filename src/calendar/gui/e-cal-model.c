@@ -43,6 +43,12 @@
 struct _ECalModelComponentPrivate {
 	GString *categories_str;
 	gint icon_index;
+
+	/* Row in the ECalModel, or -1; and the UID under which
+	 * the component is stored in the model's uid_index. */
+	gint row;
+	gchar *index_uid;
+	gboolean pending_removal;
 };
 
 #define E_CAL_MODEL_GET_PRIVATE(obj) \
@@ -65,6 +71,15 @@ struct _ECalModelPrivate {
 	/* Array for storing the objects. Each element is of type ECalModelComponent */
 	GPtrArray *objects;
 
+	/* UID ~> GPtrArray { ECalModelComponent * }, all components with the UID,
+	 * from any client and with any recurrence ID, in the order of the objects */
+	GHashTable *uid_index;
+
+	/* Components removed while frozen; they are still in the objects array,
+	 * but not in the uid_index, and are removed in bulk when thawed. */
+	guint freeze_count;
+	GPtrArray *pending_removals;
+
 	ICalComponentKind kind;
 	ICalTimezone *zone;
 
@@ -236,6 +251,8 @@ e_cal_model_component_finalize (GObject *object)
 
 	e_cal_model_component_set_icalcomponent (comp_data, NULL, NULL);
 
+	g_free (comp_data->priv->index_uid);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_cal_model_component_parent_class)->finalize (object);
 }
@@ -257,6 +274,7 @@ e_cal_model_component_init (ECalModelComponent *comp)
 {
 	comp->priv = E_CAL_MODEL_COMPONENT_GET_PRIVATE (comp);
 	comp->priv->icon_index = -1;
+	comp->priv->row = -1;
 	comp->is_new_component = FALSE;
 }
 
@@ -1171,6 +1189,8 @@ cal_model_finalize (GObject *object)
 		g_object_unref (comp_data);
 	}
 	g_ptr_array_free (priv->objects, TRUE);
+	g_ptr_array_free (priv->pending_removals, TRUE);
+	g_hash_table_destroy (priv->uid_index);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_cal_model_parent_class)->finalize (object);
@@ -1885,42 +1905,237 @@ cal_model_value_to_string (ETableModel *etm,
 	return g_strdup ("");
 }
 
+/* When more separate row ranges are removed at once, the whole
+ * model is reported as changed, instead of each range separately. */
+#define BULK_REMOVE_MAX_RANGES 32
+
+static void
+cal_model_index_add (ECalModel *model,
+		     ECalModelComponent *comp_data)
+{
+	GPtrArray *comps;
+	const gchar *uid;
+
+	uid = comp_data->icalcomp ? i_cal_component_get_uid (comp_data->icalcomp) : NULL;
+	if (!uid || !*uid)
+		return;
+
+	g_free (comp_data->priv->index_uid);
+	comp_data->priv->index_uid = g_strdup (uid);
+
+	comps = g_hash_table_lookup (model->priv->uid_index, uid);
+	if (!comps) {
+		comps = g_ptr_array_new ();
+		g_hash_table_insert (model->priv->uid_index, g_strdup (uid), comps);
+	}
+
+	g_ptr_array_add (comps, comp_data);
+}
+
+static void
+cal_model_index_remove (ECalModel *model,
+			ECalModelComponent *comp_data)
+{
+	GPtrArray *comps;
+
+	if (!comp_data->priv->index_uid)
+		return;
+
+	comps = g_hash_table_lookup (model->priv->uid_index, comp_data->priv->index_uid);
+	if (comps) {
+		g_ptr_array_remove (comps, comp_data);
+
+		if (!comps->len)
+			g_hash_table_remove (model->priv->uid_index, comp_data->priv->index_uid);
+	}
+
+	g_clear_pointer (&comp_data->priv->index_uid, g_free);
+}
+
+static void
+cal_model_renumber_rows (ECalModel *model,
+			 guint from_row)
+{
+	guint ii;
+
+	for (ii = from_row; ii < model->priv->objects->len; ii++) {
+		ECalModelComponent *comp_data = g_ptr_array_index (model->priv->objects, ii);
+
+		if (comp_data)
+			comp_data->priv->row = ii;
+	}
+}
+
 static gint
-e_cal_model_get_component_index (ECalModel *model,
-				 ECalClient *client,
-				 const ECalComponentId *id)
+cal_model_get_component_row (ECalModel *model,
+			     ECalModelComponent *comp_data)
 {
-	gint ii;
+	gint row = comp_data->priv->row;
+	guint ii;
+
+	if (row >= 0 && row < model->priv->objects->len &&
+	    g_ptr_array_index (model->priv->objects, row) == comp_data)
+		return row;
 
+	/* The rows are kept up to date, thus this is only a safety valve */
 	for (ii = 0; ii < model->priv->objects->len; ii++) {
-		ECalModelComponent *comp_data = g_ptr_array_index (model->priv->objects, ii);
+		if (g_ptr_array_index (model->priv->objects, ii) == comp_data) {
+			comp_data->priv->row = ii;
+			return ii;
+		}
+	}
+
+	return -1;
+}
+
+static ECalModelComponent *
+search_by_id_and_client (ECalModelPrivate *priv,
+                         ECalClient *client,
+                         const ECalComponentId *id)
+{
+	GPtrArray *comps;
+	const gchar *uid, *id_rid;
+	guint ii;
+
+	uid = e_cal_component_id_get_uid (id);
+	if (!uid || !*uid)
+		return NULL;
+
+	comps = g_hash_table_lookup (priv->uid_index, uid);
+	if (!comps)
+		return NULL;
+
+	id_rid = e_cal_component_id_get_rid (id);
 
-		if (comp_data) {
-			const gchar *uid;
+	for (ii = 0; ii < comps->len; ii++) {
+		ECalModelComponent *comp_data = g_ptr_array_index (comps, ii);
+
+		if (client && comp_data->client != client)
+			continue;
+
+		if (id_rid) {
 			gchar *rid;
-			gboolean has_rid = e_cal_component_id_get_rid (id) != NULL;
+			gboolean matches;
 
-			uid = i_cal_component_get_uid (comp_data->icalcomp);
 			rid = e_cal_util_component_get_recurid_as_string (comp_data->icalcomp);
+			matches = rid && *rid && strcmp (rid, id_rid) == 0;
+			g_free (rid);
 
-			if (uid && *uid) {
-				if ((!client || comp_data->client == client) && strcmp (uid, e_cal_component_id_get_uid (id)) == 0) {
-					if (has_rid) {
-						if (!(rid && *rid && strcmp (rid, e_cal_component_id_get_rid (id)) == 0)) {
-							g_free (rid);
-							continue;
-						}
-					}
-					g_free (rid);
-					return ii;
-				}
-			}
+			if (!matches)
+				continue;
+		}
 
-			g_free (rid);
+		return comp_data;
+	}
+
+	return NULL;
+}
+
+static gint
+e_cal_model_get_component_index (ECalModel *model,
+				 ECalClient *client,
+				 const ECalComponentId *id)
+{
+	ECalModelComponent *comp_data;
+
+	comp_data = search_by_id_and_client (model->priv, client, id);
+
+	return comp_data ? cal_model_get_component_row (model, comp_data) : -1;
+}
+
+static gint
+cal_model_compare_rows_desc (gconstpointer ptr1,
+			     gconstpointer ptr2)
+{
+	gint row1 = *((const gint *) ptr1);
+	gint row2 = *((const gint *) ptr2);
+
+	return row2 - row1;
+}
+
+static void
+cal_model_flush_pending_removals (ECalModel *model)
+{
+	ETableModel *table_model;
+	GPtrArray *objects;
+	GSList *removed = NULL;
+	GArray *rows;
+	guint ii, n_ranges = 0;
+
+	if (!model->priv->pending_removals->len)
+		return;
+
+	table_model = E_TABLE_MODEL (model);
+	objects = model->priv->objects;
+
+	rows = g_array_sized_new (FALSE, FALSE, sizeof (gint), model->priv->pending_removals->len);
+
+	for (ii = 0; ii < model->priv->pending_removals->len; ii++) {
+		ECalModelComponent *comp_data = g_ptr_array_index (model->priv->pending_removals, ii);
+		gint row;
+
+		row = cal_model_get_component_row (model, comp_data);
+		if (row >= 0) {
+			g_array_append_val (rows, row);
+			removed = g_slist_prepend (removed, comp_data);
 		}
 	}
 
-	return -1;
+	g_ptr_array_set_size (model->priv->pending_removals, 0);
+
+	if (!rows->len) {
+		g_array_unref (rows);
+		return;
+	}
+
+	g_array_sort (rows, cal_model_compare_rows_desc);
+
+	for (ii = 0; ii < rows->len; ii++) {
+		if (ii == 0 || g_array_index (rows, gint, ii) != g_array_index (rows, gint, ii - 1) - 1)
+			n_ranges++;
+	}
+
+	if (n_ranges <= BULK_REMOVE_MAX_RANGES) {
+		/* From the last row, thus the rows of the next ranges do not change */
+		ii = 0;
+		while (ii < rows->len) {
+			gint first = g_array_index (rows, gint, ii);
+			gint count = 1;
+
+			while (ii + count < rows->len && g_array_index (rows, gint, ii + count) == first - count)
+				count++;
+
+			e_table_model_pre_change (table_model);
+			g_ptr_array_remove_range (objects, first - count + 1, count);
+			e_table_model_rows_deleted (table_model, first - count + 1, count);
+
+			ii += count;
+		}
+
+		cal_model_renumber_rows (model, g_array_index (rows, gint, rows->len - 1));
+	} else {
+		guint jj = 0;
+
+		e_table_model_pre_change (table_model);
+
+		for (ii = 0; ii < objects->len; ii++) {
+			ECalModelComponent *comp_data = g_ptr_array_index (objects, ii);
+
+			if (!comp_data || !comp_data->priv->pending_removal)
+				objects->pdata[jj++] = comp_data;
+		}
+
+		g_ptr_array_set_size (objects, jj);
+		cal_model_renumber_rows (model, 0);
+
+		e_table_model_changed (table_model);
+	}
+
+	g_array_unref (rows);
+
+	g_signal_emit (model, signals[COMPS_DELETED], 0, removed);
+
+	g_slist_free_full (removed, g_object_unref);
 }
 
 static void
@@ -1959,6 +2174,8 @@ cal_model_data_subscriber_component_added_or_modified (ECalDataModelSubscriber *
 		comp_data->icalcomp = icomp;
 		e_cal_model_set_instance_times (comp_data, model->priv->zone);
 		g_ptr_array_add (model->priv->objects, comp_data);
+		comp_data->priv->row = model->priv->objects->len - 1;
+		cal_model_index_add (model, comp_data);
 
 		e_table_model_row_inserted (table_model, model->priv->objects->len - 1);
 	} else {
@@ -1967,6 +2184,11 @@ cal_model_data_subscriber_component_added_or_modified (ECalDataModelSubscriber *
 		comp_data = g_ptr_array_index (model->priv->objects, index);
 		e_cal_model_component_set_icalcomponent (comp_data, model, icomp);
 
+		if (g_strcmp0 (comp_data->priv->index_uid, i_cal_component_get_uid (icomp)) != 0) {
+			cal_model_index_remove (model, comp_data);
+			cal_model_index_add (model, comp_data);
+		}
+
 		e_table_model_row_changed (table_model, index);
 	}
 }
@@ -2004,10 +2226,23 @@ e_cal_model_data_subscriber_component_removed (ECalDataModelSubscriber *subscrib
 
 	id = e_cal_component_id_new (uid, rid);
 
-	index = e_cal_model_get_component_index (model, client, id);
+	comp_data = search_by_id_and_client (model->priv, client, id);
 
 	e_cal_component_id_free (id);
 
+	if (!comp_data)
+		return;
+
+	cal_model_index_remove (model, comp_data);
+
+	/* Remove all the components at once when thawed */
+	if (model->priv->freeze_count > 0) {
+		comp_data->priv->pending_removal = TRUE;
+		g_ptr_array_add (model->priv->pending_removals, comp_data);
+		return;
+	}
+
+	index = cal_model_get_component_row (model, comp_data);
 	if (index < 0)
 		return;
 
@@ -2020,6 +2255,9 @@ e_cal_model_data_subscriber_component_removed (ECalDataModelSubscriber *subscrib
 		return;
 	}
 
+	comp_data->priv->row = -1;
+	cal_model_renumber_rows (model, index);
+
 	link = g_slist_append (NULL, comp_data);
 	g_signal_emit (model, signals[COMPS_DELETED], 0, link);
 
@@ -2032,6 +2270,11 @@ e_cal_model_data_subscriber_component_removed (ECalDataModelSubscriber *subscrib
 static void
 e_cal_model_data_subscriber_freeze (ECalDataModelSubscriber *subscriber)
 {
+	ECalModel *model = E_CAL_MODEL (subscriber);
+
+	/* Only the removals are postponed, to be able to notify about them in bulk */
+	model->priv->freeze_count++;
+
 	/* No freeze/thaw, the ETableModel doesn't notify about changes when frozen */
 
 	/* ETableModel *table_model = E_TABLE_MODEL (subscriber);
@@ -2041,6 +2284,15 @@ e_cal_model_data_subscriber_freeze (ECalDataModelSubscriber *subscriber)
 static void
 e_cal_model_data_subscriber_thaw (ECalDataModelSubscriber *subscriber)
 {
+	ECalModel *model = E_CAL_MODEL (subscriber);
+
+	g_return_if_fail (model->priv->freeze_count > 0);
+
+	model->priv->freeze_count--;
+
+	if (!model->priv->freeze_count)
+		cal_model_flush_pending_removals (model);
+
 	/* No freeze/thaw, the ETableModel doesn't notify about changes when frozen */
 
 	/* ETableModel *table_model = E_TABLE_MODEL (subscriber);
@@ -2590,6 +2842,8 @@ e_cal_model_init (ECalModel *model)
 	model->priv->end = (time_t) -1;
 
 	model->priv->objects = g_ptr_array_new ();
+	model->priv->uid_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+	model->priv->pending_removals = g_ptr_array_new ();
 	model->priv->kind = I_CAL_NO_COMPONENT;
 
 	model->priv->use_24_hour_format = TRUE;
@@ -3590,71 +3844,44 @@ e_cal_model_set_default_source_uid (ECalModel *model,
 	g_object_notify (G_OBJECT (model), "default-source-uid");
 }
 
-static ECalModelComponent *
-search_by_id_and_client (ECalModelPrivate *priv,
-                         ECalClient *client,
-                         const ECalComponentId *id)
-{
-	gint i;
-
-	for (i = 0; i < priv->objects->len; i++) {
-		ECalModelComponent *comp_data = g_ptr_array_index (priv->objects, i);
-
-		if (comp_data) {
-			const gchar *uid;
-			gchar *rid;
-			gboolean has_rid = e_cal_component_id_get_rid (id) != NULL;
-
-			uid = i_cal_component_get_uid (comp_data->icalcomp);
-			rid = e_cal_util_component_get_recurid_as_string (comp_data->icalcomp);
-
-			if (uid && *uid) {
-				if ((!client || comp_data->client == client) &&
-				    !g_strcmp0 (e_cal_component_id_get_uid (id), uid)) {
-					if (has_rid) {
-						if (!(rid && *rid && !g_strcmp0 (e_cal_component_id_get_rid (id), rid))) {
-							g_free (rid);
-							continue;
-						}
-					}
-					g_free (rid);
-					return comp_data;
-				}
-			}
-
-			g_free (rid);
-		}
-	}
-
-	return NULL;
-}
-
 void
 e_cal_model_remove_all_objects (ECalModel *model)
 {
 	ECalModelComponent *comp_data;
 	ETableModel *table_model;
-	GSList *link;
-	gint index;
+	GSList *removed = NULL;
+	gint index, n_rows;
 
 	table_model = E_TABLE_MODEL (model);
-	for (index = model->priv->objects->len - 1; index >= 0; index--) {
-		e_table_model_pre_change (table_model);
+	n_rows = model->priv->objects->len;
 
-		comp_data = g_ptr_array_remove_index (model->priv->objects, index);
-		if (!comp_data) {
-			e_table_model_no_change (table_model);
-			continue;
-		}
+	g_ptr_array_set_size (model->priv->pending_removals, 0);
 
-		link = g_slist_append (NULL, comp_data);
-		g_signal_emit (model, signals[COMPS_DELETED], 0, link);
+	if (!n_rows)
+		return;
 
-		g_slist_free (link);
-		g_object_unref (comp_data);
+	e_table_model_pre_change (table_model);
+
+	for (index = n_rows - 1; index >= 0; index--) {
+		comp_data = g_ptr_array_index (model->priv->objects, index);
+		if (!comp_data)
+			continue;
 
-		e_table_model_row_deleted (table_model, index);
+		comp_data->priv->row = -1;
+		comp_data->priv->pending_removal = FALSE;
+		g_clear_pointer (&comp_data->priv->index_uid, g_free);
+
+		removed = g_slist_prepend (removed, comp_data);
 	}
+
+	g_ptr_array_set_size (model->priv->objects, 0);
+	g_hash_table_remove_all (model->priv->uid_index);
+
+	g_signal_emit (model, signals[COMPS_DELETED], 0, removed);
+
+	g_slist_free_full (removed, g_object_unref);
+
+	e_table_model_rows_deleted (table_model, 0, n_rows);
 }
 
 void
@@ -18,6 +18,7 @@
 
 #include "evolution-config.h"
 
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -882,11 +883,30 @@ e_cal_ops_send_component (ECalModel *model,
 	g_free (display_name);
 }
 
+/* How many clients are purged at once */
+#define PURGE_MAX_THREADS 4
+
+/* Returns how many components are sent to the backend in one request
+ * by the bulk operations, like purge and move/copy. */
+static guint
+cal_ops_get_batch_size (void)
+{
+	GSettings *settings;
+	gint batch_size;
+
+	settings = e_util_ref_settings ("org.gnome.evolution.calendar");
+	batch_size = g_settings_get_int (settings, "batch-operation-size");
+	g_object_unref (settings);
+
+	return MAX (batch_size, 1);
+}
+
 typedef struct {
 	ECalModel *model;
 	GList *clients;
 	ICalComponentKind kind;
 	time_t older_than;
+	guint batch_size;
 } PurgeComponentsData;
 
 static void
@@ -907,6 +927,19 @@ struct purge_data {
 	time_t older_than;
 };
 
+typedef struct {
+	PurgeComponentsData *pcd;
+	const gchar *sexp;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+	guint n_done;
+	guint progress; /* sum of percents of all clients */
+	GError *error;
+	ECalClient *error_client;
+} PurgeJob;
+
 static gboolean
 ca_ops_purge_check_instance_cb (ICalComponent *comp,
 				ICalTime *instance_start,
@@ -923,6 +956,216 @@ ca_ops_purge_check_instance_cb (ICalComponent *comp,
 	return pd->remove;
 }
 
+/* Whether the series of the @icomp has no detached instances, which can
+ * be moved after the end of the recurrence computed from the rules. */
+static gboolean
+cal_ops_purge_has_no_detached_sync (ECalClient *client,
+				    ICalComponent *icomp,
+				    GCancellable *cancellable)
+{
+	GSList *ecalcomps = NULL, *link;
+	gboolean has_no_detached = TRUE;
+
+	if (e_cal_util_component_is_instance (icomp))
+		return FALSE;
+
+	if (!e_cal_util_component_has_recurrences (icomp))
+		return TRUE;
+
+	if (!e_cal_client_get_objects_for_uid_sync (client, i_cal_component_get_uid (icomp), &ecalcomps, cancellable, NULL))
+		return FALSE;
+
+	for (link = ecalcomps; link && has_no_detached; link = g_slist_next (link)) {
+		ECalComponent *comp = link->data;
+
+		has_no_detached = !e_cal_component_is_instance (comp);
+	}
+
+	g_slist_free_full (ecalcomps, g_object_unref);
+
+	return has_no_detached;
+}
+
+/* Returns whether no occurrence of the @icomp ends after the @older_than.
+ * Components whose recurrence, as computed from the recurrence rules,
+ * ended before it are answered without expanding their instances,
+ * unless the series has detached instances. */
+static gboolean
+cal_ops_purge_can_remove_sync (ECalClient *client,
+			       ICalComponent *icomp,
+			       ICalComponentKind kind,
+			       time_t older_than,
+			       GCancellable *cancellable)
+{
+	ECalComponent *comp = NULL;
+	struct purge_data pd;
+
+	if (e_cal_client_check_recurrences_no_master (client))
+		return TRUE;
+
+	if (cal_ops_purge_has_no_detached_sync (client, icomp, cancellable))
+		comp = e_cal_component_new_from_icalcomponent (g_object_ref (icomp));
+
+	if (comp) {
+		time_t occur_start = 0, occur_end = 0;
+
+		e_cal_util_get_component_occur_times (comp, &occur_start, &occur_end,
+			e_cal_client_tzlookup_cb, client,
+			e_cal_client_get_default_timezone (client), kind);
+
+		g_object_unref (comp);
+
+		if (occur_end < older_than)
+			return TRUE;
+	}
+
+	pd.remove = TRUE;
+	pd.older_than = older_than;
+
+	e_cal_client_generate_instances_for_object_sync (client, icomp,
+		older_than, G_MAXINT32, cancellable, ca_ops_purge_check_instance_cb, &pd);
+
+	return pd.remove;
+}
+
+/* Removes all the @pids from the @client in one request and frees them */
+static gboolean
+cal_ops_purge_flush_sync (ECalClient *client,
+			  GSList **pids,
+			  guint *pn_ids,
+			  ECalObjModType mod,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	gboolean success = TRUE;
+
+	if (*pids) {
+		success = e_cal_client_remove_objects_sync (client, *pids, mod, E_CAL_OPERATION_FLAG_NONE, cancellable, error);
+
+		g_slist_free_full (*pids, e_cal_component_id_free);
+		*pids = NULL;
+		*pn_ids = 0;
+	}
+
+	return success;
+}
+
+static void
+cal_ops_purge_job_add_progress (PurgeJob *job,
+				gint delta)
+{
+	g_mutex_lock (&job->lock);
+	job->progress += delta;
+	g_cond_signal (&job->cond);
+	g_mutex_unlock (&job->lock);
+}
+
+static gboolean
+cal_ops_purge_client_sync (PurgeJob *job,
+			   ECalClient *client,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	PurgeComponentsData *pcd = job->pcd;
+	GSList *objects = NULL, *olink;
+	GSList *ids_this = NULL, *ids_all = NULL;
+	GHashTable *uids_all;
+	guint n_this = 0, n_all = 0;
+	gint nobjects, ii, last_percent = 0;
+	gboolean success = TRUE;
+
+	if (!e_cal_client_get_object_list_sync (client, job->sexp, &objects, cancellable, error))
+		return FALSE;
+
+	/* UIDs of the recurring components already scheduled for removal */
+	uids_all = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	nobjects = g_slist_length (objects);
+
+	for (olink = objects, ii = 0; olink && success; olink = g_slist_next (olink), ii++) {
+		ICalComponent *icomp = olink->data;
+		gint percent = 100 * (ii + 1) / nobjects;
+
+		if (cal_ops_purge_can_remove_sync (client, icomp, pcd->kind, pcd->older_than, cancellable)) {
+			const gchar *uid = i_cal_component_get_uid (icomp);
+
+			if (e_cal_util_component_is_instance (icomp) ||
+			    e_cal_util_component_has_recurrences (icomp)) {
+				/* The whole series is removed with the first of its components */
+				if (!g_hash_table_contains (uids_all, uid)) {
+					gchar *rid;
+
+					rid = e_cal_util_component_get_recurid_as_string (icomp);
+
+					ids_all = g_slist_prepend (ids_all, e_cal_component_id_new (uid, rid));
+					g_hash_table_add (uids_all, g_strdup (uid));
+					n_all++;
+
+					g_free (rid);
+				}
+			} else {
+				ids_this = g_slist_prepend (ids_this, e_cal_component_id_new (uid, NULL));
+				n_this++;
+			}
+
+			if (n_all >= pcd->batch_size)
+				success = cal_ops_purge_flush_sync (client, &ids_all, &n_all, E_CAL_OBJ_MOD_ALL, cancellable, error);
+
+			if (success && n_this >= pcd->batch_size)
+				success = cal_ops_purge_flush_sync (client, &ids_this, &n_this, E_CAL_OBJ_MOD_THIS, cancellable, error);
+		}
+
+		if (percent != last_percent) {
+			cal_ops_purge_job_add_progress (job, percent - last_percent);
+			last_percent = percent;
+		}
+	}
+
+	if (success)
+		success = cal_ops_purge_flush_sync (client, &ids_all, &n_all, E_CAL_OBJ_MOD_ALL, cancellable, error);
+
+	if (success)
+		success = cal_ops_purge_flush_sync (client, &ids_this, &n_this, E_CAL_OBJ_MOD_THIS, cancellable, error);
+
+	g_slist_free_full (ids_all, e_cal_component_id_free);
+	g_slist_free_full (ids_this, e_cal_component_id_free);
+	g_slist_free_full (objects, g_object_unref);
+	g_hash_table_destroy (uids_all);
+
+	return success;
+}
+
+static void
+cal_ops_purge_client_thread (gpointer data,
+			     gpointer user_data)
+{
+	ECalClient *client = data;
+	PurgeJob *job = user_data;
+	GError *local_error = NULL;
+	gboolean skip;
+
+	g_mutex_lock (&job->lock);
+	skip = job->error != NULL;
+	g_mutex_unlock (&job->lock);
+
+	/* Stop with the first error, like when purging the clients one after another */
+	if (!skip && !g_cancellable_set_error_if_cancelled (job->cancellable, &local_error))
+		cal_ops_purge_client_sync (job, client, job->cancellable, &local_error);
+
+	g_mutex_lock (&job->lock);
+
+	if (local_error && !job->error) {
+		g_propagate_error (&job->error, local_error);
+		job->error_client = g_object_ref (client);
+	} else {
+		g_clear_error (&local_error);
+	}
+
+	job->n_done++;
+	g_cond_signal (&job->cond);
+
+	g_mutex_unlock (&job->lock);
+}
+
 static void
 cal_ops_purge_components_thread (EAlertSinkThreadJobData *job_data,
 				 gpointer user_data,
@@ -930,157 +1173,130 @@ cal_ops_purge_components_thread (EAlertSinkThreadJobData *job_data,
 				 GError **error)
 {
 	PurgeComponentsData *pcd = user_data;
-	GList *clink;
+	PurgeJob job;
+	GThreadPool *pool;
+	GList *clients = NULL, *clink;
 	gchar *sexp, *start, *end;
 	gboolean pushed_message = FALSE;
 	const gchar *tzloc = NULL;
 	ICalTimezone *zone;
-	ICalComponentKind model_kind;
+	guint n_clients, n_threads, progress = 0;
 
 	g_return_if_fail (pcd != NULL);
 
-	model_kind = e_cal_model_get_component_kind (pcd->model);
-	zone = e_cal_model_get_timezone (pcd->model);
-	if (zone && zone != i_cal_timezone_get_utc_timezone ()) {
-		tzloc = i_cal_timezone_get_location (zone);
-		if (tzloc && g_ascii_strcasecmp (tzloc, "UTC") == 0)
-			tzloc = NULL;
-	}
-
-	start = isodate_from_time_t (0);
-	end = isodate_from_time_t (pcd->older_than);
-	sexp = g_strdup_printf (
-		"(occur-in-time-range? (make-time \"%s\") (make-time \"%s\") \"%s\")",
-		start, end, tzloc ? tzloc : "");
-	g_free (start);
-	g_free (end);
-
-	for (clink = pcd->clients; clink && !g_cancellable_is_cancelled (cancellable); clink = g_list_next (clink)) {
+	for (clink = pcd->clients; clink; clink = g_list_next (clink)) {
 		ECalClient *client = clink->data;
-		GSList *objects, *olink;
-		gint nobjects, ii, last_percent = 0;
-		gchar *display_name;
-		gboolean success = TRUE;
-
-		if (!client || e_client_is_readonly (E_CLIENT (client)))
-			continue;
-
-		display_name = e_util_get_source_full_name (e_cal_model_get_registry (pcd->model), e_client_get_source (E_CLIENT (client)));
-		e_alert_sink_thread_job_set_alert_arg_0 (job_data, display_name);
 
-		switch (model_kind) {
-			case I_CAL_VEVENT_COMPONENT:
-				camel_operation_push_message (cancellable,
-					_("Getting events to purge in the calendar “%s”"), display_name);
-				break;
-			case I_CAL_VJOURNAL_COMPONENT:
-				camel_operation_push_message (cancellable,
-					_("Getting memos to purge in the memo list “%s”"), display_name);
-				break;
-			case I_CAL_VTODO_COMPONENT:
-				camel_operation_push_message (cancellable,
-					_("Getting tasks to purge in the task list “%s”"), display_name);
-				break;
-			default:
-				g_warn_if_reached ();
-				g_free (display_name);
-				return;
-		}
+		if (client && !e_client_is_readonly (E_CLIENT (client)))
+			clients = g_list_prepend (clients, client);
+	}
 
-		pushed_message = TRUE;
+	if (!clients)
+		return;
 
-		if (!e_cal_client_get_object_list_sync (client, sexp, &objects, cancellable, error)) {
-			g_free (display_name);
-			break;
-		}
+	clients = g_list_reverse (clients);
+	n_clients = g_list_length (clients);
 
-		camel_operation_pop_message (cancellable);
-		pushed_message = FALSE;
+	/* Name the calendar in the progress message, when there is only one */
+	if (n_clients == 1) {
+		gchar *display_name;
 
-		if (!objects) {
-			g_free (display_name);
-			continue;
-		}
+		display_name = e_util_get_source_full_name (e_cal_model_get_registry (pcd->model), e_client_get_source (clients->data));
 
-		switch (model_kind) {
+		switch (pcd->kind) {
 			case I_CAL_VEVENT_COMPONENT:
 				camel_operation_push_message (cancellable,
 					_("Purging events in the calendar “%s”"), display_name);
+				pushed_message = TRUE;
 				break;
 			case I_CAL_VJOURNAL_COMPONENT:
 				camel_operation_push_message (cancellable,
 					_("Purging memos in the memo list “%s”"), display_name);
+				pushed_message = TRUE;
 				break;
 			case I_CAL_VTODO_COMPONENT:
 				camel_operation_push_message (cancellable,
 					_("Purging tasks in the task list “%s”"), display_name);
+				pushed_message = TRUE;
 				break;
 			default:
 				g_warn_if_reached ();
-				g_free (display_name);
-				return;
+				break;
 		}
 
 		g_free (display_name);
-		pushed_message = TRUE;
-		nobjects = g_slist_length (objects);
+	}
 
-		for (olink = objects, ii = 0; olink; olink = g_slist_next (olink), ii++) {
-			ICalComponent *icomp = olink->data;
-			gboolean remove = TRUE;
-			gint percent = 100 * (ii + 1) / nobjects;
+	zone = e_cal_model_get_timezone (pcd->model);
+	if (zone && zone != i_cal_timezone_get_utc_timezone ()) {
+		tzloc = i_cal_timezone_get_location (zone);
+		if (tzloc && g_ascii_strcasecmp (tzloc, "UTC") == 0)
+			tzloc = NULL;
+	}
 
-			if (!e_cal_client_check_recurrences_no_master (client)) {
-				struct purge_data pd;
+	start = isodate_from_time_t (0);
+	end = isodate_from_time_t (pcd->older_than);
+	sexp = g_strdup_printf (
+		"(occur-in-time-range? (make-time \"%s\") (make-time \"%s\") \"%s\")",
+		start, end, tzloc ? tzloc : "");
+	g_free (start);
+	g_free (end);
 
-				pd.remove = TRUE;
-				pd.older_than = pcd->older_than;
+	memset (&job, 0, sizeof (PurgeJob));
+	job.pcd = pcd;
+	job.sexp = sexp;
+	job.cancellable = cancellable;
+	g_mutex_init (&job.lock);
+	g_cond_init (&job.cond);
 
-				e_cal_client_generate_instances_for_object_sync (client, icomp,
-					pcd->older_than, G_MAXINT32, cancellable, ca_ops_purge_check_instance_cb, &pd);
+	/* The clients are independent, thus purge several of them at once */
+	n_threads = CLAMP (g_get_num_processors (), 1, PURGE_MAX_THREADS);
+	n_threads = MIN (n_threads, n_clients);
 
-				remove = pd.remove;
-			}
+	pool = g_thread_pool_new (cal_ops_purge_client_thread, &job, n_threads, FALSE, NULL);
 
-			if (remove) {
-				const gchar *uid = i_cal_component_get_uid (icomp);
+	for (clink = clients; clink; clink = g_list_next (clink)) {
+		g_thread_pool_push (pool, clink->data, NULL);
+	}
 
-				if (e_cal_util_component_is_instance (icomp) ||
-				    e_cal_util_component_has_recurrences (icomp)) {
-					gchar *rid;
+	g_mutex_lock (&job.lock);
 
-					rid = e_cal_util_component_get_recurid_as_string (icomp);
+	while (job.n_done < n_clients) {
+		g_cond_wait (&job.cond, &job.lock);
 
-					success = e_cal_client_remove_object_sync (client, uid, rid, E_CAL_OBJ_MOD_ALL, E_CAL_OPERATION_FLAG_NONE, cancellable, error);
+		if (progress != job.progress) {
+			progress = job.progress;
 
-					g_free (rid);
-				} else {
-					success = e_cal_client_remove_object_sync (client, uid, NULL, E_CAL_OBJ_MOD_THIS, E_CAL_OPERATION_FLAG_NONE, cancellable, error);
-				}
+			g_mutex_unlock (&job.lock);
+			camel_operation_progress (cancellable, progress / n_clients);
+			g_mutex_lock (&job.lock);
+		}
+	}
 
-				if (!success)
-					break;
-			}
+	g_mutex_unlock (&job.lock);
 
-			if (percent != last_percent) {
-				camel_operation_progress (cancellable, percent);
-				last_percent = percent;
-			}
-		}
+	g_thread_pool_free (pool, FALSE, TRUE);
 
-		g_slist_free_full (objects, g_object_unref);
+	if (job.error) {
+		gchar *display_name;
 
-		camel_operation_progress (cancellable, 0);
-		camel_operation_pop_message (cancellable);
-		pushed_message = FALSE;
+		display_name = e_util_get_source_full_name (e_cal_model_get_registry (pcd->model), e_client_get_source (E_CLIENT (job.error_client)));
+		e_alert_sink_thread_job_set_alert_arg_0 (job_data, display_name);
+		g_free (display_name);
 
-		if (!success)
-			break;
+		g_propagate_error (error, job.error);
 	}
 
+	g_clear_object (&job.error_client);
+	g_mutex_clear (&job.lock);
+	g_cond_clear (&job.cond);
+
+	camel_operation_progress (cancellable, 0);
+
 	if (pushed_message)
 		camel_operation_pop_message (cancellable);
 
+	g_list_free (clients);
 	g_free (sexp);
 }
 
@@ -1131,6 +1347,7 @@ e_cal_ops_purge_components (ECalModel *model,
 	pcd->clients = e_cal_data_model_get_clients (data_model);
 	pcd->kind = e_cal_model_get_component_kind (model);
 	pcd->older_than = older_than;
+	pcd->batch_size = cal_ops_get_batch_size ();
 
 	cancellable = e_cal_data_model_submit_thread_job (data_model, description, alert_ident,
 		NULL, cal_ops_purge_components_thread,
@@ -1902,6 +2119,7 @@ typedef struct {
 	GHashTable *icomps_by_source;
 	gboolean is_move;
 	gint nobjects;
+	guint batch_size;
 } TransferComponentsData;
 
 static void
@@ -1992,15 +2210,26 @@ transfer_components_thread (EAlertSinkThreadJobData *job_data,
 
 		from_cal_client = E_CAL_CLIENT (from_client);
 
-		for (link = icomps; link && !g_cancellable_is_cancelled (cancellable); link = g_slist_next (link), ii++) {
-			gint percent = 100 * (ii + 1) / nobjects;
-			ICalComponent *icomp = link->data;
+		/* Transfer the components in batches, with one request for all of them */
+		for (link = icomps; link && !g_cancellable_is_cancelled (cancellable);) {
+			GSList *batch = NULL;
+			gint percent;
+			guint n_batch;
 
-			if (!cal_comp_transfer_item_to_sync (from_cal_client, to_cal_client, icomp, !tcd->is_move, cancellable, error)) {
-				success = FALSE;
-				break;
+			for (n_batch = 0; link && n_batch < tcd->batch_size; link = g_slist_next (link), n_batch++) {
+				batch = g_slist_prepend (batch, link->data);
 			}
 
+			batch = g_slist_reverse (batch);
+			success = cal_comp_transfer_items_to_sync (from_cal_client, to_cal_client, batch, !tcd->is_move, cancellable, error);
+			g_slist_free (batch);
+
+			if (!success)
+				break;
+
+			ii += n_batch;
+			percent = 100 * ii / nobjects;
+
 			if (percent != last_percent) {
 				camel_operation_progress (cancellable, percent);
 				last_percent = percent;
@@ -2099,6 +2328,7 @@ e_cal_ops_transfer_components (EShellView *shell_view,
 	tcd->source_type = source_type;
 	tcd->is_move = is_move;
 	tcd->nobjects = nobjects;
+	tcd->batch_size = cal_ops_get_batch_size ();
 	tcd->destination_client = NULL;
 
 	g_hash_table_iter_init (&iter, icomps_by_source);
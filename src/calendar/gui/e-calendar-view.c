@@ -2259,6 +2259,207 @@ is_array_index_in_bounds_func (GArray *array,
 	return TRUE;
 }
 
+typedef struct _EventIndexEntry {
+	gchar *rid_key;
+	gchar *uid_key;
+	GList *rid_link; /* in the queue of by_rid for rid_key */
+	GList *uid_link; /* in the queue of by_uid for uid_key */
+	gint day;
+	gint event_num;
+} EventIndexEntry;
+
+struct _ECalendarViewEventIndex {
+	GHashTable *by_rid; /* gchar *rid_key ~> GQueue { EventIndexEntry * } */
+	GHashTable *by_uid; /* gchar *uid_key ~> GQueue { EventIndexEntry * } */
+};
+
+static void
+event_index_queue_free (gpointer ptr)
+{
+	GQueue *queue = ptr;
+
+	g_queue_free (queue);
+}
+
+ECalendarViewEventIndex *
+e_calendar_view_event_index_new (void)
+{
+	ECalendarViewEventIndex *event_index;
+
+	event_index = g_slice_new0 (ECalendarViewEventIndex);
+	event_index->by_rid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, event_index_queue_free);
+	event_index->by_uid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, event_index_queue_free);
+
+	return event_index;
+}
+
+/* The entries are referenced by the events, thus all the events
+ * should be removed from the index before it is freed. */
+void
+e_calendar_view_event_index_free (ECalendarViewEventIndex *event_index)
+{
+	if (!event_index)
+		return;
+
+	g_hash_table_destroy (event_index->by_rid);
+	g_hash_table_destroy (event_index->by_uid);
+	g_slice_free (ECalendarViewEventIndex, event_index);
+}
+
+static GList *
+event_index_insert (GHashTable *hash_table,
+		    const gchar *key,
+		    EventIndexEntry *entry)
+{
+	GQueue *queue;
+
+	queue = g_hash_table_lookup (hash_table, key);
+	if (!queue) {
+		queue = g_queue_new ();
+		g_hash_table_insert (hash_table, g_strdup (key), queue);
+	}
+
+	g_queue_push_tail (queue, entry);
+
+	return g_queue_peek_tail_link (queue);
+}
+
+static void
+event_index_delete (GHashTable *hash_table,
+		    const gchar *key,
+		    GList *link)
+{
+	GQueue *queue;
+
+	queue = g_hash_table_lookup (hash_table, key);
+	g_return_if_fail (queue != NULL);
+
+	g_queue_delete_link (queue, link);
+
+	if (g_queue_is_empty (queue))
+		g_hash_table_remove (hash_table, key);
+}
+
+/* Adds the @event, which is at @event_num of the @day, to the @event_index.
+ * Views with only one array of events use 0 for the @day. The @event's
+ * comp_data should be set already. */
+void
+e_calendar_view_event_index_add (ECalendarViewEventIndex *event_index,
+				 ECalendarViewEvent *event,
+				 gint day,
+				 gint event_num)
+{
+	EventIndexEntry *entry;
+	gchar *rid;
+
+	g_return_if_fail (event_index != NULL);
+	g_return_if_fail (event != NULL);
+
+	event->index_entry = NULL;
+
+	if (!is_comp_data_valid (event))
+		return;
+
+	rid = e_cal_util_component_get_recurid_as_string (event->comp_data->icalcomp);
+
+	entry = g_slice_new0 (EventIndexEntry);
+	entry->uid_key = g_strdup_printf ("%p\n%s", event->comp_data->client,
+		i_cal_component_get_uid (event->comp_data->icalcomp));
+	entry->rid_key = g_strconcat (entry->uid_key, "\n", rid ? rid : "", NULL);
+	entry->rid_link = event_index_insert (event_index->by_rid, entry->rid_key, entry);
+	entry->uid_link = event_index_insert (event_index->by_uid, entry->uid_key, entry);
+	entry->day = day;
+	entry->event_num = event_num;
+
+	event->index_entry = entry;
+
+	g_free (rid);
+}
+
+void
+e_calendar_view_event_index_remove (ECalendarViewEventIndex *event_index,
+				    ECalendarViewEvent *event)
+{
+	EventIndexEntry *entry;
+
+	g_return_if_fail (event_index != NULL);
+	g_return_if_fail (event != NULL);
+
+	entry = event->index_entry;
+	if (!entry)
+		return;
+
+	event_index_delete (event_index->by_rid, entry->rid_key, entry->rid_link);
+	event_index_delete (event_index->by_uid, entry->uid_key, entry->uid_link);
+
+	g_free (entry->rid_key);
+	g_free (entry->uid_key);
+	g_slice_free (EventIndexEntry, entry);
+
+	event->index_entry = NULL;
+}
+
+/* To be called for each event which moved in its array,
+ * like after a sort or a removal of a preceding event. */
+void
+e_calendar_view_event_index_set_position (ECalendarViewEvent *event,
+					  gint day,
+					  gint event_num)
+{
+	EventIndexEntry *entry;
+
+	g_return_if_fail (event != NULL);
+
+	entry = event->index_entry;
+	if (entry) {
+		entry->day = day;
+		entry->event_num = event_num;
+	}
+}
+
+/* Finds the event of the @client with the given @uid and @rid. When
+ * the @rid is %NULL or empty any event with the @uid is returned. */
+gboolean
+e_calendar_view_event_index_lookup (ECalendarViewEventIndex *event_index,
+				    ECalClient *client,
+				    const gchar *uid,
+				    const gchar *rid,
+				    gint *out_day,
+				    gint *out_event_num)
+{
+	EventIndexEntry *entry = NULL;
+	GQueue *queue;
+	gchar *key;
+
+	g_return_val_if_fail (event_index != NULL, FALSE);
+
+	if (!uid)
+		return FALSE;
+
+	if (rid && *rid) {
+		key = g_strdup_printf ("%p\n%s\n%s", client, uid, rid);
+		queue = g_hash_table_lookup (event_index->by_rid, key);
+	} else {
+		key = g_strdup_printf ("%p\n%s", client, uid);
+		queue = g_hash_table_lookup (event_index->by_uid, key);
+	}
+
+	if (queue)
+		entry = g_queue_peek_head (queue);
+
+	g_free (key);
+
+	if (!entry)
+		return FALSE;
+
+	if (out_day)
+		*out_day = entry->day;
+	if (out_event_num)
+		*out_event_num = entry->event_num;
+
+	return TRUE;
+}
+
 gboolean
 e_calendar_view_is_editing (ECalendarView *cal_view)
 {
@@ -80,7 +80,8 @@ typedef enum {
 	GtkWidget *tooltip; \
 	gint	timeout; \
 	GdkColor *color; \
-	gint x,y;
+	gint x,y; \
+	gpointer index_entry;
 
 typedef struct {
 	E_CALENDAR_VIEW_EVENT_FIELDS
@@ -101,6 +102,32 @@ gboolean	is_array_index_in_bounds_func	(GArray *array,
 #define is_array_index_in_bounds(_array, _index) \
 	is_array_index_in_bounds_func (_array, _index, G_STRFUNC)
 
+/* maps (client, UID, RID) of the view's events to their (day, event_num) */
+typedef struct _ECalendarViewEventIndex ECalendarViewEventIndex;
+
+ECalendarViewEventIndex *
+		e_calendar_view_event_index_new	(void);
+void		e_calendar_view_event_index_free
+						(ECalendarViewEventIndex *event_index);
+void		e_calendar_view_event_index_add	(ECalendarViewEventIndex *event_index,
+						 ECalendarViewEvent *event,
+						 gint day,
+						 gint event_num);
+void		e_calendar_view_event_index_remove
+						(ECalendarViewEventIndex *event_index,
+						 ECalendarViewEvent *event);
+void		e_calendar_view_event_index_set_position
+						(ECalendarViewEvent *event,
+						 gint day,
+						 gint event_num);
+gboolean	e_calendar_view_event_index_lookup
+						(ECalendarViewEventIndex *event_index,
+						 ECalClient *client,
+						 const gchar *uid,
+						 const gchar *rid,
+						 gint *out_day,
+						 gint *out_event_num);
+
 typedef struct _ECalendarView ECalendarView;
 typedef struct _ECalendarViewClass ECalendarViewClass;
 typedef struct _ECalendarViewPrivate ECalendarViewPrivate;
@@ -87,6 +87,14 @@
 
 struct _EDayViewPrivate {
 	ECalModel *model;
+
+	/* Positions of the events in the long_events and events arrays */
+	ECalendarViewEventIndex *event_index;
+
+	/* Hidden EText items of the main canvas, ready to be reused by
+	 * events scrolled into the visible area. Each holds a reference. */
+	GSList *free_text_items;
+
 	gulong notify_work_day_monday_handler_id;
 	gulong notify_work_day_tuesday_handler_id;
 	gulong notify_work_day_wednesday_handler_id;
@@ -144,6 +152,7 @@ struct _EDayViewPrivate {
 	gulong main_canvas_drag_end_handler_id;
 	gulong main_canvas_drag_data_get_handler_id;
 	gulong main_canvas_drag_data_received_handler_id;
+	gulong main_canvas_vadjustment_value_changed_handler_id;
 
 	/* "time_canvas" signal handlers */
 	gulong time_canvas_scroll_event_handler_id;
@@ -373,9 +382,18 @@ static void e_day_view_reshape_day_events (EDayView *day_view,
 static void e_day_view_reshape_day_event (EDayView *day_view,
 					  gint	day,
 					  gint	event_num);
+static void e_day_view_reshape_day_event_full (EDayView *day_view,
+					       gint day,
+					       gint event_num,
+					       gboolean ensure_item);
+static void e_day_view_update_visible_event_items (EDayView *day_view);
 static void e_day_view_reshape_main_canvas_resize_bars (EDayView *day_view);
 
 static void e_day_view_ensure_events_sorted (EDayView *day_view);
+static void e_day_view_update_event_index (EDayView *day_view,
+					   GArray *array,
+					   gint day,
+					   gint from_event_num);
 
 static void e_day_view_start_editing_event (EDayView *day_view,
 					    gint day,
@@ -1003,6 +1021,11 @@ day_view_dispose (GObject *object)
 		day_view->long_events = NULL;
 	}
 
+	g_clear_pointer (&day_view->priv->event_index, e_calendar_view_event_index_free);
+
+	g_slist_free_full (day_view->priv->free_text_items, g_object_unref);
+	day_view->priv->free_text_items = NULL;
+
 	for (day = 0; day < E_DAY_VIEW_MAX_DAYS; day++) {
 		if (day_view->events[day]) {
 			g_array_free (day_view->events[day], TRUE);
@@ -1137,6 +1160,13 @@ day_view_dispose (GObject *object)
 		day_view->priv->main_canvas_realize_handler_id = 0;
 	}
 
+	if (day_view->priv->main_canvas_vadjustment_value_changed_handler_id > 0) {
+		g_signal_handler_disconnect (
+			gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (day_view->main_canvas)),
+			day_view->priv->main_canvas_vadjustment_value_changed_handler_id);
+		day_view->priv->main_canvas_vadjustment_value_changed_handler_id = 0;
+	}
+
 	if (day_view->priv->main_canvas_button_press_event_handler_id > 0) {
 		g_signal_handler_disconnect (
 			day_view->main_canvas,
@@ -2079,6 +2109,8 @@ e_day_view_init (EDayView *day_view)
 
 	gtk_widget_set_can_focus (GTK_WIDGET (day_view), TRUE);
 
+	day_view->priv->event_index = e_calendar_view_event_index_new ();
+
 	day_view->long_events = g_array_new (
 		FALSE, FALSE,
 		sizeof (EDayViewEvent));
@@ -2339,6 +2371,11 @@ e_day_view_init (EDayView *day_view)
 		G_CALLBACK (e_day_view_on_canvas_realized), day_view);
 	day_view->priv->main_canvas_realize_handler_id = handler_id;
 
+	handler_id = g_signal_connect_swapped (
+		gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (day_view->main_canvas)), "value-changed",
+		G_CALLBACK (e_day_view_update_visible_event_items), day_view);
+	day_view->priv->main_canvas_vadjustment_value_changed_handler_id = handler_id;
+
 	handler_id = g_signal_connect (
 		day_view->main_canvas, "button_press_event",
 		G_CALLBACK (e_day_view_on_main_canvas_button_press), day_view);
@@ -3264,16 +3301,21 @@ e_day_view_remove_event_cb (EDayView *day_view,
 	if (event->canvas_item)
 		g_object_run_dispose (G_OBJECT (event->canvas_item));
 
+	if (day_view->priv->event_index)
+		e_calendar_view_event_index_remove (day_view->priv->event_index, (ECalendarViewEvent *) event);
+
 	if (is_comp_data_valid (event))
 		g_object_unref (event->comp_data);
 	event->comp_data = NULL;
 
 	if (day == E_DAY_VIEW_LONG_EVENT) {
 		g_array_remove_index (day_view->long_events, event_num);
+		e_day_view_update_event_index (day_view, day_view->long_events, E_DAY_VIEW_LONG_EVENT, event_num);
 		day_view->long_events_need_layout = TRUE;
 		gtk_widget_grab_focus (GTK_WIDGET (day_view->top_canvas));
 	} else {
 		g_array_remove_index (day_view->events[day], event_num);
+		e_day_view_update_event_index (day_view, day_view->events[day], day, event_num);
 		day_view->need_layout[day] = TRUE;
 		gtk_widget_grab_focus (GTK_WIDGET (day_view->main_canvas));
 	}
@@ -3515,7 +3557,7 @@ e_day_view_find_event_from_item (EDayView *day_view,
  * Note that for recurring events there may be several EDayViewEvents, one
  * for each instance, all with the same iCalObject and uid. So only use this
  * function if you know the event doesn't recur or you are just checking to
- * see if any events with the uid exist. */
+ * see if any events with the uid exist, or pass the @rid of the instance. */
 static gboolean
 e_day_view_find_event_from_uid (EDayView *day_view,
                                 ECalClient *client,
@@ -3524,69 +3566,11 @@ e_day_view_find_event_from_uid (EDayView *day_view,
                                 gint *day_return,
                                 gint *event_num_return)
 {
-	EDayViewEvent *event;
-	gint day, event_num;
-	gint days_shown;
-	const gchar *u;
-	gchar *r = NULL;
-
-	if (!uid)
+	if (!uid || !day_view->priv->event_index)
 		return FALSE;
 
-	days_shown = e_day_view_get_days_shown (day_view);
-
-	for (day = 0; day < days_shown; day++) {
-		for (event_num = 0; event_num < day_view->events[day]->len;
-		     event_num++) {
-			event = &g_array_index (day_view->events[day],
-						EDayViewEvent, event_num);
-
-			if (!is_comp_data_valid (event))
-				continue;
-
-			if (event->comp_data->client != client)
-				continue;
-
-			u = i_cal_component_get_uid (event->comp_data->icalcomp);
-			if (u && !strcmp (uid, u)) {
-				if (rid && *rid) {
-					r = e_cal_util_component_get_recurid_as_string (event->comp_data->icalcomp);
-
-					if (!r || !*r || strcmp (rid, r) != 0) {
-						g_free (r);
-						continue;
-					}
-
-					g_free (r);
-				}
-
-				*day_return = day;
-				*event_num_return = event_num;
-				return TRUE;
-			}
-		}
-	}
-
-	for (event_num = 0; event_num < day_view->long_events->len;
-	     event_num++) {
-		event = &g_array_index (day_view->long_events,
-					EDayViewEvent, event_num);
-
-		if (!is_comp_data_valid (event))
-			continue;
-
-		if (event->comp_data->client != client)
-			continue;
-
-		u = i_cal_component_get_uid (event->comp_data->icalcomp);
-		if (u && !strcmp (uid, u)) {
-			*day_return = E_DAY_VIEW_LONG_EVENT;
-			*event_num_return = event_num;
-			return TRUE;
-		}
-	}
-
-	return FALSE;
+	return e_calendar_view_event_index_lookup (day_view->priv->event_index,
+		client, uid, rid, day_return, event_num_return);
 }
 
 static void
@@ -5732,6 +5716,9 @@ e_day_view_free_event_array (EDayView *day_view,
 		if (event->canvas_item)
 			g_object_run_dispose (G_OBJECT (event->canvas_item));
 
+		if (day_view->priv->event_index)
+			e_calendar_view_event_index_remove (day_view->priv->event_index, (ECalendarViewEvent *) event);
+
 		if (is_comp_data_valid (event))
 			g_object_unref (event->comp_data);
 
@@ -5848,6 +5835,8 @@ e_day_view_add_event (ESourceRegistry *registry,
 				event.end_minute = 24 * 60;
 			}
 
+			e_calendar_view_event_index_add (add_event_data->day_view->priv->event_index,
+				(ECalendarViewEvent *) &event, day, add_event_data->day_view->events[day]->len);
 			g_array_append_val (add_event_data->day_view->events[day], event);
 			add_event_data->day_view->events_sorted[day] = FALSE;
 			add_event_data->day_view->need_layout[day] = TRUE;
@@ -5857,6 +5846,8 @@ e_day_view_add_event (ESourceRegistry *registry,
 
 	/* The event wasn't within one day so it must be a long event,
 	 * i.e. shown in the top canvas. */
+	e_calendar_view_event_index_add (add_event_data->day_view->priv->event_index,
+		(ECalendarViewEvent *) &event, E_DAY_VIEW_LONG_EVENT, add_event_data->day_view->long_events->len);
 	g_array_append_val (add_event_data->day_view->long_events, event);
 	add_event_data->day_view->long_events_sorted = FALSE;
 	add_event_data->day_view->long_events_need_layout = TRUE;
@@ -6186,8 +6177,12 @@ e_day_view_reshape_day_events (EDayView *day_view,
 		}
 
 		if (strncmp (current_comp_string, day_view->last_edited_comp_string, 50) == 0) {
-			if (e_calendar_view_get_allow_direct_summary_edit (E_CALENDAR_VIEW (day_view)))
-				e_canvas_item_grab_focus (event->canvas_item, TRUE);
+			if (e_calendar_view_get_allow_direct_summary_edit (E_CALENDAR_VIEW (day_view))) {
+				e_day_view_reshape_day_event_full (day_view, day, event_num, TRUE);
+
+				if (event->canvas_item)
+					e_canvas_item_grab_focus (event->canvas_item, TRUE);
+			}
 
 			g_free (day_view->last_edited_comp_string);
 			day_view-> last_edited_comp_string = NULL;
@@ -6196,10 +6191,170 @@ e_day_view_reshape_day_events (EDayView *day_view,
 	}
 }
 
+/* Whether the area of the main canvas is in or near the visible part of it.
+ * Items of the events outside of it are not needed and can be reused. */
+static gboolean
+e_day_view_main_canvas_area_visible (EDayView *day_view,
+                                     gint item_y,
+                                     gint item_h)
+{
+	GtkAdjustment *adjustment;
+	gdouble value, page_size;
+
+	adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (day_view->main_canvas));
+	if (!adjustment)
+		return TRUE;
+
+	value = gtk_adjustment_get_value (adjustment);
+	page_size = gtk_adjustment_get_page_size (adjustment);
+
+	/* Not allocated yet */
+	if (page_size <= 0)
+		return TRUE;
+
+	/* Keep one page above and below the visible area, thus small
+	 * scroll steps do not recycle and recreate the same items. */
+	return item_y + item_h >= value - page_size &&
+	       item_y <= value + 2 * page_size;
+}
+
+static gboolean
+e_day_view_can_release_event_item (EDayView *day_view,
+                                   gint day,
+                                   gint event_num)
+{
+	EDayViewEvent *event;
+
+	#define is_event(_what) (day_view->_what ## _event_day == day && day_view->_what ## _event_num == event_num)
+
+	event = &g_array_index (day_view->events[day], EDayViewEvent, event_num);
+
+	/* An accessible object describes the event of its item,
+	 * thus the item cannot be reused for another event. */
+	if (event->canvas_item && g_object_get_data (G_OBJECT (event->canvas_item), "accessible-object"))
+		return FALSE;
+
+	return !is_event (editing) && !is_event (popup) && !is_event (resize) &&
+	       !is_event (resize_bars) && !is_event (pressed) && !is_event (drag);
+
+	#undef is_event
+}
+
+/* Hides the event's item and keeps it for reuse by another event. */
+static void
+e_day_view_release_event_item (EDayView *day_view,
+                               EDayViewEvent *event)
+{
+	GnomeCanvasItem *item = event->canvas_item;
+
+	if (event->timeout > 0) {
+		g_source_remove (event->timeout);
+		event->timeout = -1;
+	}
+
+	if (event->tooltip) {
+		GtkWidget *tooltip = g_object_get_data (G_OBJECT (day_view), "tooltip-window");
+
+		if (tooltip) {
+			gtk_widget_destroy (tooltip);
+			g_object_set_data (G_OBJECT (day_view), "tooltip-window", NULL);
+		}
+
+		event->tooltip = NULL;
+	}
+
+	gnome_canvas_item_hide (item);
+	g_object_set_data (G_OBJECT (item), "event-num", GINT_TO_POINTER (-1));
+	g_object_set_data (G_OBJECT (item), "event-day", GINT_TO_POINTER (-1));
+
+	day_view->priv->free_text_items = g_slist_prepend (day_view->priv->free_text_items, g_object_ref (item));
+
+	event->canvas_item = NULL;
+}
+
+/* Creates or releases the items of the main canvas events, which
+ * got into or out of the visible area after scrolling. */
+static void
+e_day_view_update_visible_event_items (EDayView *day_view)
+{
+	gint day, days_shown;
+
+	/* Also when not in focus, the items are not updated
+	 * later, when the view gets the focus. */
+	if (!day_view->long_events)
+		return;
+
+	days_shown = e_day_view_get_days_shown (day_view);
+
+	for (day = 0; day < days_shown; day++) {
+		gint event_num;
+
+		/* The layout will reshape all the events of the day */
+		if (day_view->need_layout[day] || day_view->need_reshape[day])
+			continue;
+
+		for (event_num = 0; event_num < day_view->events[day]->len; event_num++) {
+			EDayViewEvent *event;
+			gint item_x, item_y, item_w, item_h;
+
+			event = &g_array_index (day_view->events[day], EDayViewEvent, event_num);
+
+			if (!e_day_view_get_event_position (day_view, day, event_num, &item_x, &item_y, &item_w, &item_h))
+				continue;
+
+			if (e_day_view_main_canvas_area_visible (day_view, item_y, item_h) != (event->canvas_item != NULL))
+				e_day_view_reshape_day_event (day_view, day, event_num);
+		}
+	}
+}
+
+/**
+ * e_day_view_ensure_event_item:
+ * @day_view: an #EDayView
+ * @day: the day of the event
+ * @event_num: the index of the event
+ *
+ * Events of the main canvas out of the visible area do not have their
+ * canvas item; this creates it, if the event is shown at all.
+ *
+ * Returns: (transfer none) (nullable): the event's canvas item, or %NULL
+ **/
+GnomeCanvasItem *
+e_day_view_ensure_event_item (EDayView *day_view,
+                              gint day,
+                              gint event_num)
+{
+	EDayViewEvent *event;
+	GArray *array;
+
+	g_return_val_if_fail (E_IS_DAY_VIEW (day_view), NULL);
+
+	array = day == E_DAY_VIEW_LONG_EVENT ? day_view->long_events : day_view->events[day];
+
+	if (!is_array_index_in_bounds (array, event_num))
+		return NULL;
+
+	event = &g_array_index (array, EDayViewEvent, event_num);
+
+	if (!event->canvas_item && day != E_DAY_VIEW_LONG_EVENT)
+		e_day_view_reshape_day_event_full (day_view, day, event_num, TRUE);
+
+	return event->canvas_item;
+}
+
 static void
 e_day_view_reshape_day_event (EDayView *day_view,
                               gint day,
                               gint event_num)
+{
+	e_day_view_reshape_day_event_full (day_view, day, event_num, FALSE);
+}
+
+static void
+e_day_view_reshape_day_event_full (EDayView *day_view,
+                                   gint day,
+                                   gint event_num,
+                                   gboolean ensure_item)
 {
 	EDayViewEvent *event;
 	gint item_x, item_y, item_w, item_h;
@@ -6225,6 +6380,16 @@ e_day_view_reshape_day_event (EDayView *day_view,
 		item_y += E_DAY_VIEW_EVENT_BORDER_HEIGHT + E_DAY_VIEW_EVENT_Y_PAD;
 		item_h -= (E_DAY_VIEW_EVENT_BORDER_HEIGHT + E_DAY_VIEW_EVENT_Y_PAD) * 2;
 
+		/* Events far from the visible area do not need their item; the main
+		 * canvas item draws them and clicks are found by their position. */
+		if (!ensure_item && !e_day_view_main_canvas_area_visible (day_view, item_y, item_h)) {
+			if (event->canvas_item && e_day_view_can_release_event_item (day_view, day, event_num))
+				e_day_view_release_event_item (day_view, event);
+
+			if (!event->canvas_item)
+				return;
+		}
+
 		/* We don't show the icons while resizing, since we'd have to
 		 * draw them on top of the resize rect. */
 		icons_offset = 0;
@@ -6266,21 +6431,45 @@ e_day_view_reshape_day_event (EDayView *day_view,
 
 			color = e_day_view_get_text_color (day_view, event);
 
-			event->canvas_item = gnome_canvas_item_new (
-				GNOME_CANVAS_GROUP (GNOME_CANVAS (day_view->main_canvas)->root),
-				e_text_get_type (),
-				"line_wrap", TRUE,
-				"editable", TRUE,
-				"clip", TRUE,
-				"use_ellipsis", TRUE,
-				"fill_color_gdk", &color,
-				"im_context", E_CANVAS (day_view->main_canvas)->im_context,
-				NULL);
+			if (day_view->priv->free_text_items) {
+				GSList *link = day_view->priv->free_text_items;
+
+				day_view->priv->free_text_items = g_slist_remove_link (day_view->priv->free_text_items, link);
+
+				/* The canvas group holds its own reference */
+				event->canvas_item = link->data;
+				g_object_unref (event->canvas_item);
+				g_slist_free_1 (link);
+
+				gnome_canvas_item_set (
+					event->canvas_item,
+					"fill_color_gdk", &color,
+					"bold", FALSE,
+					"italic", FALSE,
+					"strikeout", FALSE,
+					NULL);
+				gnome_canvas_item_show (event->canvas_item);
+			} else {
+				event->canvas_item = gnome_canvas_item_new (
+					GNOME_CANVAS_GROUP (GNOME_CANVAS (day_view->main_canvas)->root),
+					e_text_get_type (),
+					"line_wrap", TRUE,
+					"editable", TRUE,
+					"clip", TRUE,
+					"use_ellipsis", TRUE,
+					"fill_color_gdk", &color,
+					"im_context", E_CANVAS (day_view->main_canvas)->im_context,
+					NULL);
+				g_signal_connect (
+					event->canvas_item, "event",
+					G_CALLBACK (e_day_view_on_text_item_event), day_view);
+			}
+
 			g_object_set_data (G_OBJECT (event->canvas_item), "event-num", GINT_TO_POINTER (event_num));
 			g_object_set_data (G_OBJECT (event->canvas_item), "event-day", GINT_TO_POINTER (day));
-			g_signal_connect (
-				event->canvas_item, "event",
-				G_CALLBACK (e_day_view_on_text_item_event), day_view);
+
+			/* The reused items had no accessible object, thus
+			 * they are announced as added for this event too. */
 			g_signal_emit_by_name (day_view, "event_added", event);
 
 			e_day_view_update_event_label (day_view, day, event_num);
@@ -6342,6 +6531,24 @@ e_day_view_reshape_main_canvas_resize_bars (EDayView *day_view)
 	}
 }
 
+/* Sets the current position in the event index of the events
+ * in the @array, starting with the @from_event_num. */
+static void
+e_day_view_update_event_index (EDayView *day_view,
+                               GArray *array,
+                               gint day,
+                               gint from_event_num)
+{
+	gint event_num;
+
+	for (event_num = from_event_num; event_num < array->len; event_num++) {
+		EDayViewEvent *event;
+
+		event = &g_array_index (array, EDayViewEvent, event_num);
+		e_calendar_view_event_index_set_position ((ECalendarViewEvent *) event, day, event_num);
+	}
+}
+
 static void
 e_day_view_ensure_events_sorted (EDayView *day_view)
 {
@@ -6357,6 +6564,7 @@ e_day_view_ensure_events_sorted (EDayView *day_view)
 			day_view->long_events->len,
 			sizeof (EDayViewEvent),
 			e_day_view_event_sort_func);
+		e_day_view_update_event_index (day_view, day_view->long_events, E_DAY_VIEW_LONG_EVENT, 0);
 		day_view->long_events_sorted = TRUE;
 	}
 
@@ -6368,6 +6576,7 @@ e_day_view_ensure_events_sorted (EDayView *day_view)
 				day_view->events[day]->len,
 				sizeof (EDayViewEvent),
 				e_day_view_event_sort_func);
+			e_day_view_update_event_index (day_view, day_view->events[day], day, 0);
 			day_view->events_sorted[day] = TRUE;
 		}
 	}
@@ -7257,6 +7466,10 @@ e_day_view_start_editing_event (EDayView *day_view,
 	    (!key_event && !e_calendar_view_get_allow_direct_summary_edit (E_CALENDAR_VIEW (day_view))))
 		return;
 
+	/* The event can be out of the visible area, without its item. */
+	if (!event->canvas_item && day != E_DAY_VIEW_LONG_EVENT)
+		e_day_view_reshape_day_event_full (day_view, day, event_num, TRUE);
+
 	/* If the event is not shown, don't try to edit it. */
 	if (!event->canvas_item)
 		return;
@@ -560,6 +560,10 @@ gboolean	e_day_view_find_event_from_item	(EDayView *day_view,
 						 GnomeCanvasItem *item,
 						 gint *day_return,
 						 gint *event_num_return);
+GnomeCanvasItem *
+		e_day_view_ensure_event_item	(EDayView *day_view,
+						 gint day,
+						 gint event_num);
 void		e_day_view_update_calendar_selection_time
 						(EDayView *day_view);
 void		e_day_view_ensure_rows_visible	(EDayView *day_view,
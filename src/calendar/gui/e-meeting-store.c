@@ -58,6 +58,7 @@ struct _EMeetingStorePrivate {
 
 	GPtrArray *refresh_queue;
 	GHashTable *refresh_data;
+	GHashTable *fb_cache; /* gchar *key ~> FreeBusyCacheData * */
 	GMutex mutex;
 	guint refresh_idle_id;
 
@@ -69,6 +70,17 @@ struct _EMeetingStorePrivate {
 
 #define BUF_SIZE 1024
 
+/* How many free/busy queries can run at once, for all the stores */
+#define FREE_BUSY_MAX_THREADS 8
+
+/* How long the received free/busy information can be reused, in seconds */
+#define FREE_BUSY_CACHE_TIMEOUT 60
+
+typedef struct _FreeBusyCacheData {
+	gchar *text;
+	gint64 stored; /* g_get_monotonic_time() */
+} FreeBusyCacheData;
+
 typedef struct _EMeetingStoreQueueData EMeetingStoreQueueData;
 struct _EMeetingStoreQueueData {
 	EMeetingStore *store;
@@ -585,6 +597,103 @@ find_attendee_cb (gpointer key,
 		fad->qdata = qdata;
 }
 
+static void
+free_busy_cache_data_free (gpointer ptr)
+{
+	FreeBusyCacheData *fbc_data = ptr;
+
+	if (fbc_data) {
+		g_free (fbc_data->text);
+		g_free (fbc_data);
+	}
+}
+
+static void
+free_busy_cache_clear (EMeetingStore *store)
+{
+	g_mutex_lock (&store->priv->mutex);
+	g_hash_table_remove_all (store->priv->fb_cache);
+	g_mutex_unlock (&store->priv->mutex);
+}
+
+/* The attendee's own free/busy URL is part of the key,
+ * thus its change is not answered from the cache. */
+static gchar *
+free_busy_cache_key (EMeetingStoreQueueData *qdata)
+{
+	const gchar *fburi = e_meeting_attendee_get_fburi (qdata->attendee);
+
+	return g_strdup_printf ("%s\n%s\n%04d%02d%02dT%02d%02d\n%04d%02d%02dT%02d%02d",
+		itip_strip_mailto (e_meeting_attendee_get_address (qdata->attendee)),
+		fburi ? fburi : "",
+		g_date_get_year (&qdata->start.date),
+		g_date_get_month (&qdata->start.date),
+		g_date_get_day (&qdata->start.date),
+		qdata->start.hour,
+		qdata->start.minute,
+		g_date_get_year (&qdata->end.date),
+		g_date_get_month (&qdata->end.date),
+		g_date_get_day (&qdata->end.date),
+		qdata->end.hour,
+		qdata->end.minute);
+}
+
+static void
+free_busy_cache_store (EMeetingStoreQueueData *qdata,
+                       const gchar *text)
+{
+	EMeetingStorePrivate *priv = qdata->store->priv;
+	FreeBusyCacheData *fbc_data;
+	gchar *key;
+
+	key = free_busy_cache_key (qdata);
+
+	g_mutex_lock (&priv->mutex);
+
+	fbc_data = g_hash_table_lookup (priv->fb_cache, key);
+
+	/* Do not prolong the life of the reused information */
+	if (fbc_data && g_strcmp0 (fbc_data->text, text) == 0) {
+		g_free (key);
+	} else {
+		fbc_data = g_new0 (FreeBusyCacheData, 1);
+		fbc_data->text = g_strdup (text);
+		fbc_data->stored = g_get_monotonic_time ();
+
+		g_hash_table_insert (priv->fb_cache, key, fbc_data);
+	}
+
+	g_mutex_unlock (&priv->mutex);
+}
+
+/* Returns a copy of the cached free/busy text, or NULL, when there is none
+ * or it is too old. */
+static gchar *
+free_busy_cache_lookup (EMeetingStoreQueueData *qdata)
+{
+	EMeetingStorePrivate *priv = qdata->store->priv;
+	FreeBusyCacheData *fbc_data;
+	gchar *key, *text = NULL;
+
+	key = free_busy_cache_key (qdata);
+
+	g_mutex_lock (&priv->mutex);
+
+	fbc_data = g_hash_table_lookup (priv->fb_cache, key);
+	if (fbc_data) {
+		if (g_get_monotonic_time () - fbc_data->stored < ((gint64) FREE_BUSY_CACHE_TIMEOUT) * G_USEC_PER_SEC)
+			text = g_strdup (fbc_data->text);
+		else
+			g_hash_table_remove (priv->fb_cache, key);
+	}
+
+	g_mutex_unlock (&priv->mutex);
+
+	g_free (key);
+
+	return text;
+}
+
 static void
 refresh_queue_remove (EMeetingStore *store,
                       EMeetingAttendee *attendee)
@@ -594,6 +703,8 @@ refresh_queue_remove (EMeetingStore *store,
 
 	priv = store->priv;
 
+	g_mutex_lock (&priv->mutex);
+
 	/* Free the queue data */
 	qdata = g_hash_table_lookup (
 		priv->refresh_data, itip_strip_mailto (
@@ -610,11 +721,9 @@ refresh_queue_remove (EMeetingStore *store,
 	}
 
 	if (qdata) {
-		g_mutex_lock (&priv->mutex);
 		g_hash_table_remove (
 			priv->refresh_data, itip_strip_mailto (
 			e_meeting_attendee_get_address (attendee)));
-		g_mutex_unlock (&priv->mutex);
 		g_ptr_array_free (qdata->call_backs, TRUE);
 		g_ptr_array_free (qdata->data, TRUE);
 		g_free (qdata);
@@ -622,6 +731,9 @@ refresh_queue_remove (EMeetingStore *store,
 
 	/* Unref the attendee */
 	g_ptr_array_remove (priv->refresh_queue, attendee);
+
+	g_mutex_unlock (&priv->mutex);
+
 	g_object_unref (attendee);
 }
 
@@ -755,6 +867,7 @@ meeting_store_finalize (GObject *object)
 			g_ptr_array_index (priv->refresh_queue, 0));
 	g_ptr_array_free (priv->refresh_queue, TRUE);
 	g_hash_table_destroy (priv->refresh_data);
+	g_hash_table_destroy (priv->fb_cache);
 
 	if (priv->refresh_idle_id)
 		g_source_remove (priv->refresh_idle_id);
@@ -856,6 +969,8 @@ e_meeting_store_init (EMeetingStore *store)
 	store->priv->refresh_queue = g_ptr_array_new ();
 	store->priv->refresh_data = g_hash_table_new_full (
 		g_str_hash, g_str_equal, g_free, NULL);
+	store->priv->fb_cache = g_hash_table_new_full (
+		g_str_hash, g_str_equal, g_free, free_busy_cache_data_free);
 
 	g_mutex_init (&store->priv->mutex);
 
@@ -895,6 +1010,9 @@ e_meeting_store_set_client (EMeetingStore *store,
 
 	store->priv->client = client;
 
+	/* The cached free/busy information can come from the previous client */
+	free_busy_cache_clear (store);
+
 	g_object_notify (G_OBJECT (store), "client");
 }
 
@@ -962,6 +1080,9 @@ e_meeting_store_set_free_busy_template (EMeetingStore *store,
 	g_free (store->priv->fb_uri);
 	store->priv->fb_uri = g_strdup (free_busy_template);
 
+	/* The cached free/busy information can come from the previous server */
+	free_busy_cache_clear (store);
+
 	g_object_notify (G_OBJECT (store), "free-busy-template");
 }
 
@@ -1555,6 +1676,8 @@ process_free_busy (EMeetingStoreQueueData *qdata,
 		return;
 	}
 
+	free_busy_cache_store (qdata, text);
+
 	kind = i_cal_component_isa (main_comp);
 	if (kind == I_CAL_VCALENDAR_COMPONENT) {
 		ICalCompIter *iter;
@@ -1639,6 +1762,15 @@ typedef struct {
 #define USER_SUB   "%u"
 #define DOMAIN_SUB "%d"
 
+static void
+meeting_store_inc_num_queries (EMeetingStore *store,
+                               gint delta)
+{
+	g_mutex_lock (&store->priv->mutex);
+	store->priv->num_queries += delta;
+	g_mutex_unlock (&store->priv->mutex);
+}
+
 static gboolean
 freebusy_async (gpointer data)
 {
@@ -1646,20 +1778,15 @@ freebusy_async (gpointer data)
 	EMeetingAttendee *attendee = fbd->attendee;
 	gchar *default_fb_uri = NULL;
 	gchar *fburi = NULL;
-	static GMutex mutex;
-	EMeetingStorePrivate *priv = fbd->store->priv;
 
 	if (fbd->client) {
-		/* FIXME This a workaround for getting all the free busy
-		 *       information for the users.  We should be able to
-		 *       get free busy asynchronously. */
-		g_mutex_lock (&mutex);
-		priv->num_queries++;
+		/* The queries run in parallel, limited by the number
+		 * of threads in the free/busy thread pool. */
+		meeting_store_inc_num_queries (fbd->store, 1);
 		e_cal_client_get_free_busy_sync (
 			fbd->client, fbd->startt,
 			fbd->endt, fbd->users, &fbd->fb_data, NULL, NULL);
-		priv->num_queries--;
-		g_mutex_unlock (&mutex);
+		meeting_store_inc_num_queries (fbd->store, -1);
 
 		g_slist_foreach (fbd->users, (GFunc) g_free, NULL);
 		g_slist_free (fbd->users);
@@ -1692,7 +1819,7 @@ freebusy_async (gpointer data)
 	}
 
 	if (fburi) {
-		priv->num_queries++;
+		meeting_store_inc_num_queries (fbd->store, 1);
 		start_async_read (fburi, fbd->qdata);
 		g_free (fburi);
 	} else if (default_fb_uri != NULL && !g_str_equal (default_fb_uri, "")) {
@@ -1705,7 +1832,7 @@ freebusy_async (gpointer data)
 		g_free (default_fb_uri);
 		default_fb_uri = replace_string (tmp_fb_uri, DOMAIN_SUB, split_email[1]);
 
-		priv->num_queries++;
+		meeting_store_inc_num_queries (fbd->store, 1);
 		start_async_read (default_fb_uri, fbd->qdata);
 		g_free (tmp_fb_uri);
 		g_strfreev (split_email);
@@ -1720,6 +1847,33 @@ freebusy_async (gpointer data)
 #undef USER_SUB
 #undef DOMAIN_SUB
 
+static void
+freebusy_async_thread (gpointer data,
+                       gpointer user_data)
+{
+	FreeBusyAsyncData *fbd = data;
+
+	freebusy_async (fbd);
+
+	g_slist_free_full (fbd->fb_data, g_object_unref);
+	g_free (fbd->email);
+	g_free (fbd);
+}
+
+static GThreadPool *
+meeting_store_get_free_busy_pool (void)
+{
+	static GThreadPool *pool = NULL;
+	static gsize pool_initialized = 0;
+
+	if (g_once_init_enter (&pool_initialized)) {
+		pool = g_thread_pool_new (freebusy_async_thread, NULL, FREE_BUSY_MAX_THREADS, FALSE, NULL);
+		g_once_init_leave (&pool_initialized, 1);
+	}
+
+	return pool;
+}
+
 static gboolean
 refresh_busy_periods (gpointer data)
 {
@@ -1728,16 +1882,21 @@ refresh_busy_periods (gpointer data)
 	EMeetingAttendee *attendee = NULL;
 	EMeetingStoreQueueData *qdata = NULL;
 	gint i;
-	GThread *thread;
 	GError *error = NULL;
 	FreeBusyAsyncData *fbd;
+	gchar *cached_text;
 
 	priv = store->priv;
 
+	g_mutex_lock (&priv->mutex);
+
 	/* Check to see if there are any remaining attendees in the queue */
 	for (i = 0; i < priv->refresh_queue->len; i++) {
 		attendee = g_ptr_array_index (priv->refresh_queue, i);
-		g_return_val_if_fail (attendee != NULL, FALSE);
+		if (!attendee) {
+			g_warn_if_reached ();
+			continue;
+		}
 
 		qdata = g_hash_table_lookup (
 			priv->refresh_data, itip_strip_mailto (
@@ -1752,15 +1911,31 @@ refresh_busy_periods (gpointer data)
 	/* The everything in the queue is being refreshed */
 	if (i >= priv->refresh_queue->len) {
 		priv->refresh_idle_id = 0;
+		g_mutex_unlock (&priv->mutex);
 		return FALSE;
 	}
 
 	/* Indicate we are trying to refresh it */
 	qdata->refreshing = TRUE;
 
+	g_mutex_unlock (&priv->mutex);
+
 	/* We take a ref in case we get destroyed in the gui during a callback */
 	g_object_ref (qdata->store);
 
+	/* Reuse recently received information for the same time window */
+	cached_text = free_busy_cache_lookup (qdata);
+	if (cached_text) {
+		g_mutex_lock (&store->priv->mutex);
+		store->priv->num_threads++;
+		g_mutex_unlock (&store->priv->mutex);
+
+		process_free_busy (qdata, cached_text);
+		g_free (cached_text);
+
+		return TRUE;
+	}
+
 	fbd = g_new0 (FreeBusyAsyncData, 1);
 	fbd->client = priv->client;
 	fbd->attendee = attendee;
@@ -1809,23 +1984,12 @@ refresh_busy_periods (gpointer data)
 	store->priv->num_threads++;
 	g_mutex_unlock (&store->priv->mutex);
 
-	thread = g_thread_try_new (NULL, (GThreadFunc) freebusy_async, fbd, &error);
-	if (!thread) {
-		/* do clean up stuff here */
-		g_slist_foreach (fbd->users, (GFunc) g_free, NULL);
-		g_slist_free (fbd->users);
-		g_free (fbd->email);
-		priv->refresh_idle_id = 0;
-
-		g_mutex_lock (&store->priv->mutex);
-		store->priv->num_threads--;
-		g_mutex_unlock (&store->priv->mutex);
-
-		return FALSE;
+	/* The data is queued even when a new thread cannot be created */
+	if (!g_thread_pool_push (meeting_store_get_free_busy_pool (), fbd, &error)) {
+		g_warning ("%s: Failed to start free/busy query: %s", G_STRFUNC, error ? error->message : "Unknown error");
+		g_clear_error (&error);
 	}
 
-	g_thread_unref (thread);
-
 	return TRUE;
 }
 
@@ -1849,18 +2013,19 @@ refresh_queue_add (EMeetingStore *store,
 		e_meeting_attendee_get_address (attendee)), ""))
 		return;
 
+	g_mutex_lock (&priv->mutex);
+
 	/* check the queue if the attendee is already in there*/
 	for (i = 0; i < priv->refresh_queue->len; i++) {
-		if (attendee == g_ptr_array_index (priv->refresh_queue, i))
-			return;
-
-		if (!strcmp (e_meeting_attendee_get_address (attendee),
+		if (attendee == g_ptr_array_index (priv->refresh_queue, i) ||
+		    !strcmp (e_meeting_attendee_get_address (attendee),
 			e_meeting_attendee_get_address (
-			g_ptr_array_index (priv->refresh_queue, i))))
+			g_ptr_array_index (priv->refresh_queue, i)))) {
+			g_mutex_unlock (&priv->mutex);
 			return;
+		}
 	}
 
-	g_mutex_lock (&priv->mutex);
 	qdata = g_hash_table_lookup (
 		priv->refresh_data, itip_strip_mailto (
 		e_meeting_attendee_get_address (attendee)));
@@ -1892,11 +2057,12 @@ refresh_queue_add (EMeetingStore *store,
 		g_ptr_array_add (qdata->call_backs, call_back);
 		g_ptr_array_add (qdata->data, data);
 	}
-	g_mutex_unlock (&priv->mutex);
 
 	g_object_ref (attendee);
 	g_ptr_array_add (priv->refresh_queue, attendee);
 
+	g_mutex_unlock (&priv->mutex);
+
 	if (priv->refresh_idle_id == 0)
 		priv->refresh_idle_id = g_idle_add (refresh_busy_periods, store);
 }
@@ -2135,7 +2301,7 @@ start_async_read (const gchar *uri,
 	g_return_if_fail (uri != NULL);
 	g_return_if_fail (data != NULL);
 
-	qdata->store->priv->num_queries--;
+	meeting_store_inc_num_queries (qdata->store, -1);
 	file = g_file_new_for_uri (uri);
 
 	g_return_if_fail (file != NULL);
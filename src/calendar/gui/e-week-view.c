@@ -101,6 +101,9 @@ struct _EWeekViewPrivate {
 	gboolean show_icons_month_view;
 	gboolean draw_flat_events;
 	gboolean days_left_to_right;
+
+	/* Positions of the events in the events array */
+	ECalendarViewEventIndex *event_index;
 };
 
 typedef struct {
@@ -145,6 +148,8 @@ static void e_week_view_add_event (ECalClient *client,
 				   gpointer data);
 static void e_week_view_check_layout (EWeekView *week_view);
 static void e_week_view_ensure_events_sorted (EWeekView *week_view);
+static void e_week_view_update_event_index (EWeekView *week_view,
+					    gint from_event_num);
 static void e_week_view_reshape_events (EWeekView *week_view);
 static void e_week_view_reshape_event_span (EWeekView *week_view,
 					    gint event_num,
@@ -866,6 +871,8 @@ week_view_dispose (GObject *object)
 		week_view->events = NULL;
 	}
 
+	g_clear_pointer (&week_view->priv->event_index, e_calendar_view_event_index_free);
+
 	if (week_view->small_font_desc) {
 		pango_font_description_free (week_view->small_font_desc);
 		week_view->small_font_desc = NULL;
@@ -1717,6 +1724,8 @@ e_week_view_init (EWeekView *week_view)
 
 	gtk_widget_set_can_focus (GTK_WIDGET (week_view), TRUE);
 
+	week_view->priv->event_index = e_calendar_view_event_index_new ();
+
 	week_view->event_destroyed = FALSE;
 	week_view->events = g_array_new (
 		FALSE, FALSE,
@@ -2806,7 +2815,11 @@ e_week_view_remove_event_cb (EWeekView *week_view,
 		}
 	}
 
+	if (week_view->priv->event_index)
+		e_calendar_view_event_index_remove (week_view->priv->event_index, (ECalendarViewEvent *) event);
+
 	g_array_remove_index (week_view->events, event_num);
+	e_week_view_update_event_index (week_view, event_num);
 
 	week_view->events_need_layout = TRUE;
 
@@ -3285,6 +3298,9 @@ e_week_view_free_events (EWeekView *week_view)
 		event = &g_array_index (week_view->events, EWeekViewEvent,
 					event_num);
 
+		if (week_view->priv->event_index)
+			e_calendar_view_event_index_remove (week_view->priv->event_index, (ECalendarViewEvent *) event);
+
 		if (is_comp_data_valid (event))
 			g_object_unref (event->comp_data);
 	}
@@ -3392,10 +3408,16 @@ e_week_view_add_event (ECalClient *client,
 		    e_calendar_view_get_timezone (E_CALENDAR_VIEW (add_event_data->week_view))))
 		event.different_timezone = TRUE;
 
-	if (prepend)
+	if (prepend) {
+		e_calendar_view_event_index_add (add_event_data->week_view->priv->event_index,
+			(ECalendarViewEvent *) &event, 0, 0);
 		g_array_prepend_val (add_event_data->week_view->events, event);
-	else
+		e_week_view_update_event_index (add_event_data->week_view, 1);
+	} else {
+		e_calendar_view_event_index_add (add_event_data->week_view->priv->event_index,
+			(ECalendarViewEvent *) &event, 0, add_event_data->week_view->events->len);
 		g_array_append_val (add_event_data->week_view->events, event);
+	}
 	add_event_data->week_view->events_sorted = FALSE;
 	add_event_data->week_view->events_need_layout = TRUE;
 
@@ -3444,10 +3466,27 @@ e_week_view_ensure_events_sorted (EWeekView *week_view)
 			week_view->events->len,
 			sizeof (EWeekViewEvent),
 			e_week_view_event_sort_func);
+		e_week_view_update_event_index (week_view, 0);
 		week_view->events_sorted = TRUE;
 	}
 }
 
+/* Sets the current position in the event index of the events,
+ * starting with the @from_event_num. */
+static void
+e_week_view_update_event_index (EWeekView *week_view,
+                                gint from_event_num)
+{
+	gint event_num;
+
+	for (event_num = from_event_num; event_num < week_view->events->len; event_num++) {
+		EWeekViewEvent *event;
+
+		event = &g_array_index (week_view->events, EWeekViewEvent, event_num);
+		e_calendar_view_event_index_set_position ((ECalendarViewEvent *) event, 0, event_num);
+	}
+}
+
 gint
 e_week_view_event_sort_func (gconstpointer arg1,
                              gconstpointer arg2)
@@ -4902,7 +4941,7 @@ e_week_view_find_event_from_item (EWeekView *week_view,
  * Note that for recurring events there may be several EWeekViewEvents, one
  * for each instance, all with the same iCalObject and uid. So only use this
  * function if you know the event doesn't recur or you are just checking to
- * see if any events with the uid exist. */
+ * see if any events with the uid exist, or pass the @rid of the instance. */
 static gboolean
 e_week_view_find_event_from_uid (EWeekView *week_view,
                                  ECalClient *client,
@@ -4910,45 +4949,12 @@ e_week_view_find_event_from_uid (EWeekView *week_view,
                                  const gchar *rid,
                                  gint *event_num_return)
 {
-	EWeekViewEvent *event;
-	gint event_num, num_events;
-
 	*event_num_return = -1;
-	if (!uid)
+	if (!uid || !week_view->priv->event_index)
 		return FALSE;
 
-	num_events = week_view->events->len;
-	for (event_num = 0; event_num < num_events; event_num++) {
-		const gchar *u;
-		gchar *r = NULL;
-
-		event = &g_array_index (week_view->events, EWeekViewEvent,
-					event_num);
-
-		if (!is_comp_data_valid (event))
-			continue;
-
-		if (event->comp_data->client != client)
-			continue;
-
-		u = i_cal_component_get_uid (event->comp_data->icalcomp);
-		if (u && !strcmp (uid, u)) {
-			if (rid && *rid) {
-				r = e_cal_util_component_get_recurid_as_string (event->comp_data->icalcomp);
-				if (!r || !*r || strcmp (rid, r) != 0) {
-					g_free (r);
-					continue;
-				}
-
-				g_free (r);
-			}
-
-			*event_num_return = event_num;
-			return TRUE;
-		}
-	}
-
-	return FALSE;
+	return e_calendar_view_event_index_lookup (week_view->priv->event_index,
+		client, uid, rid, NULL, event_num_return);
 }
 
 gboolean
@@ -196,6 +196,7 @@ ea_day_view_ref_child (AtkObject *accessible,
 	AtkObject *atk_object = NULL;
 	EDayViewEvent *event = NULL;
 	GtkWidget *widget;
+	GnomeCanvasItem *item = NULL;
 
 	g_return_val_if_fail (EA_IS_DAY_VIEW (accessible), NULL);
 
@@ -221,6 +222,7 @@ ea_day_view_ref_child (AtkObject *accessible,
 		if (index < day_view->long_events->len) {
 			event = &g_array_index (day_view->long_events,
 						EDayViewEvent, index);
+			item = event->canvas_item;
 		}
 		else {
 			index -= day_view->long_events->len;
@@ -230,15 +232,15 @@ ea_day_view_ref_child (AtkObject *accessible,
 				++day;
 			}
 
-			event = &g_array_index (day_view->events[day],
-						EDayViewEvent, index);
+			/* the event can be scrolled away, without its item */
+			item = e_day_view_ensure_event_item (day_view, day, index);
 		}
-		if (event && event->canvas_item) {
+		if (item) {
 			/* Not use atk_gobject_accessible_for_object here,
 			 * we need to do special thing here
 			 */
 			atk_object = ea_calendar_helpers_get_accessible_for (
-				event->canvas_item);
+				item);
 			g_object_ref (atk_object);
 		}
 	}
@@ -23,6 +23,7 @@
 #include "e-attachment.h"
 
 #include <errno.h>
+#include <string.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 
@@ -55,7 +56,13 @@
 #define EMBLEM_SIGN_UNKNOWN	"stock_signature"
 
 /* Attributes needed for EAttachmentStore columns. */
-#define ATTACHMENT_QUERY "standard::*,preview::*,thumbnail::*"
+#define ATTACHMENT_QUERY "standard::*,preview::*,thumbnail::*,time::modified"
+
+/* Regular files at least this large are not loaded into memory;
+ * their content is read only when the message is being written. */
+#define ATTACHMENT_FILE_BACKED_MIN_SIZE (1024 * 1024)
+
+#define ATTACHMENT_LOAD_BUFFER_SIZE 65536
 
 struct _EAttachmentPrivate {
 	GMutex property_lock;
@@ -1780,6 +1787,186 @@ e_attachment_update_store_columns (EAttachment *attachment)
 	attachment_update_progress_columns (attachment);
 }
 
+/************************* EAttachmentFileWrapper ***************************/
+
+#define E_TYPE_ATTACHMENT_FILE_WRAPPER (e_attachment_file_wrapper_get_type ())
+#define E_ATTACHMENT_FILE_WRAPPER(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST \
+	((obj), E_TYPE_ATTACHMENT_FILE_WRAPPER, EAttachmentFileWrapper))
+
+typedef struct _EAttachmentFileWrapper EAttachmentFileWrapper;
+typedef struct _EAttachmentFileWrapperClass EAttachmentFileWrapperClass;
+
+/* A data wrapper streaming its content from the file, instead of
+ * holding a copy of the file in memory. */
+struct _EAttachmentFileWrapper {
+	CamelDataWrapper parent;
+	GFile *file;
+	goffset size;
+	guint64 mtime;
+};
+
+struct _EAttachmentFileWrapperClass {
+	CamelDataWrapperClass parent_class;
+};
+
+GType e_attachment_file_wrapper_get_type (void);
+
+G_DEFINE_TYPE (
+	EAttachmentFileWrapper,
+	e_attachment_file_wrapper,
+	CAMEL_TYPE_DATA_WRAPPER)
+
+static GInputStream *
+attachment_file_wrapper_open (EAttachmentFileWrapper *file_wrapper,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	GFileInputStream *input_stream;
+	GFileInfo *file_info;
+
+	input_stream = g_file_read (file_wrapper->file, cancellable, error);
+	if (input_stream == NULL)
+		return NULL;
+
+	/* The file is read only now, thus make sure it's the same
+	 * file, which had been attached, not a modified one. */
+	file_info = g_file_input_stream_query_info (
+		input_stream,
+		G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+		G_FILE_ATTRIBUTE_TIME_MODIFIED,
+		cancellable, NULL);
+
+	if (file_info != NULL && (
+	    g_file_info_get_size (file_info) != file_wrapper->size ||
+	    g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) != file_wrapper->mtime)) {
+		gchar *basename;
+
+		basename = g_file_get_basename (file_wrapper->file);
+		g_set_error (
+			error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			_("Attachment “%s” was modified after it had been attached"),
+			basename);
+		g_free (basename);
+
+		g_clear_object (&input_stream);
+	}
+
+	g_clear_object (&file_info);
+
+	return (GInputStream *) input_stream;
+}
+
+static void
+attachment_file_wrapper_dispose (GObject *object)
+{
+	EAttachmentFileWrapper *file_wrapper;
+
+	file_wrapper = E_ATTACHMENT_FILE_WRAPPER (object);
+
+	g_clear_object (&file_wrapper->file);
+
+	/* Chain up to parent's dispose() method. */
+	G_OBJECT_CLASS (e_attachment_file_wrapper_parent_class)->dispose (object);
+}
+
+static gssize
+attachment_file_wrapper_write_to_stream_sync (CamelDataWrapper *data_wrapper,
+                                              CamelStream *stream,
+                                              GCancellable *cancellable,
+                                              GError **error)
+{
+	GInputStream *input_stream;
+	gchar *buffer;
+	gssize bytes_read;
+	gssize bytes_written = 0;
+
+	input_stream = attachment_file_wrapper_open (
+		E_ATTACHMENT_FILE_WRAPPER (data_wrapper), cancellable, error);
+	if (input_stream == NULL)
+		return -1;
+
+	buffer = g_malloc (ATTACHMENT_LOAD_BUFFER_SIZE);
+
+	do {
+		bytes_read = g_input_stream_read (
+			input_stream, buffer, ATTACHMENT_LOAD_BUFFER_SIZE,
+			cancellable, error);
+
+		if (bytes_read > 0) {
+			if (camel_stream_write (stream, buffer, bytes_read, cancellable, error) == -1)
+				bytes_read = -1;
+			else
+				bytes_written += bytes_read;
+		}
+	} while (bytes_read > 0);
+
+	g_free (buffer);
+	g_object_unref (input_stream);
+
+	return bytes_read < 0 ? -1 : bytes_written;
+}
+
+static gssize
+attachment_file_wrapper_write_to_output_stream_sync (CamelDataWrapper *data_wrapper,
+                                                     GOutputStream *output_stream,
+                                                     GCancellable *cancellable,
+                                                     GError **error)
+{
+	GInputStream *input_stream;
+	gssize bytes_written;
+
+	input_stream = attachment_file_wrapper_open (
+		E_ATTACHMENT_FILE_WRAPPER (data_wrapper), cancellable, error);
+	if (input_stream == NULL)
+		return -1;
+
+	bytes_written = g_output_stream_splice (
+		output_stream, input_stream,
+		G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+		cancellable, error);
+
+	g_object_unref (input_stream);
+
+	return bytes_written;
+}
+
+static void
+e_attachment_file_wrapper_class_init (EAttachmentFileWrapperClass *class)
+{
+	GObjectClass *object_class;
+	CamelDataWrapperClass *data_wrapper_class;
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->dispose = attachment_file_wrapper_dispose;
+
+	/* The decode_to_*() methods of the parent class use these,
+	 * the content is never encoded. */
+	data_wrapper_class = CAMEL_DATA_WRAPPER_CLASS (class);
+	data_wrapper_class->write_to_stream_sync = attachment_file_wrapper_write_to_stream_sync;
+	data_wrapper_class->write_to_output_stream_sync = attachment_file_wrapper_write_to_output_stream_sync;
+}
+
+static void
+e_attachment_file_wrapper_init (EAttachmentFileWrapper *file_wrapper)
+{
+}
+
+static CamelDataWrapper *
+attachment_file_wrapper_new (GFile *file,
+                             GFileInfo *file_info)
+{
+	EAttachmentFileWrapper *file_wrapper;
+
+	file_wrapper = g_object_new (E_TYPE_ATTACHMENT_FILE_WRAPPER, NULL);
+	file_wrapper->file = g_object_ref (file);
+	file_wrapper->size = g_file_info_get_size (file_info);
+	file_wrapper->mtime = g_file_info_get_attribute_uint64 (
+		file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+	return CAMEL_DATA_WRAPPER (file_wrapper);
+}
+
 /************************* e_attachment_load_async() *************************/
 
 typedef struct _LoadContext LoadContext;
@@ -1794,7 +1981,7 @@ struct _LoadContext {
 	GFileInfo *file_info;
 	goffset total_num_bytes;
 	gssize bytes_read;
-	gchar buffer[4096];
+	gchar buffer[ATTACHMENT_LOAD_BUFFER_SIZE];
 };
 
 /* Forward Declaration */
@@ -1869,48 +2056,114 @@ attachment_load_check_for_error (LoadContext *load_context,
 	return TRUE;
 }
 
+static gboolean
+attachment_path_is_in_dir (const gchar *path,
+                           const gchar *dir)
+{
+	gsize dir_len;
+
+	if (!dir || !*dir)
+		return FALSE;
+
+	dir_len = strlen (dir);
+
+	while (dir_len > 1 && G_IS_DIR_SEPARATOR (dir[dir_len - 1]))
+		dir_len--;
+
+	return strncmp (path, dir, dir_len) == 0 &&
+		G_IS_DIR_SEPARATOR (path[dir_len]);
+}
+
+/* Whether the file can be read only when the message is being written.
+ * Remote files and temporary files, like those of drag-and-drop or of
+ * a mailto: 'attach=', can be gone or changed till then, thus they are
+ * always loaded. */
+static gboolean
+attachment_load_can_use_file (EAttachment *attachment,
+                              GFile *file,
+                              GFileInfo *file_info)
+{
+	gchar *path, *evo_tmp_dir;
+	gboolean can_use;
+
+	if (e_attachment_is_rfc822 (attachment) ||
+	    g_file_info_get_file_type (file_info) != G_FILE_TYPE_REGULAR ||
+	    g_file_info_get_size (file_info) < ATTACHMENT_FILE_BACKED_MIN_SIZE ||
+	    !g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) ||
+	    !g_file_is_native (file))
+		return FALSE;
+
+	path = g_file_get_path (file);
+	if (!path)
+		return FALSE;
+
+	evo_tmp_dir = g_build_filename (e_get_user_cache_dir (), "tmp", NULL);
+
+	can_use = !attachment_path_is_in_dir (path, g_get_tmp_dir ()) &&
+		!attachment_path_is_in_dir (path, evo_tmp_dir);
+
+	g_free (evo_tmp_dir);
+	g_free (path);
+
+	return can_use;
+}
+
+/* The @file is set when the content is not loaded, but read from
+ * the @file, when the message is being written. */
 static void
-attachment_load_finish (LoadContext *load_context)
+attachment_load_finish (LoadContext *load_context,
+                        GFile *file)
 {
 	GFileInfo *file_info;
 	EAttachment *attachment;
-	GMemoryOutputStream *output_stream;
 	GSimpleAsyncResult *simple;
 	CamelDataWrapper *wrapper;
 	CamelMimePart *mime_part;
-	CamelStream *stream;
 	const gchar *attribute;
 	const gchar *content_type;
 	const gchar *display_name;
 	const gchar *description;
 	const gchar *disposition;
 	gchar *mime_type;
-	gpointer data;
-	gsize size;
 
 	simple = load_context->simple;
 
 	file_info = load_context->file_info;
 	attachment = load_context->attachment;
-	output_stream = G_MEMORY_OUTPUT_STREAM (load_context->output_stream);
-
-	if (e_attachment_is_rfc822 (attachment))
-		wrapper = (CamelDataWrapper *) camel_mime_message_new ();
-	else
-		wrapper = camel_data_wrapper_new ();
 
 	content_type = g_file_info_get_content_type (file_info);
 	mime_type = g_content_type_get_mime_type (content_type);
 
-	data = g_memory_output_stream_get_data (output_stream);
-	size = g_memory_output_stream_get_data_size (output_stream);
+	if (file != NULL) {
+		wrapper = attachment_file_wrapper_new (file, file_info);
+	} else {
+		GMemoryOutputStream *output_stream;
+		CamelStream *stream;
+		gpointer data;
+		gsize size;
+
+		output_stream = G_MEMORY_OUTPUT_STREAM (load_context->output_stream);
+
+		if (e_attachment_is_rfc822 (attachment))
+			wrapper = (CamelDataWrapper *) camel_mime_message_new ();
+		else
+			wrapper = camel_data_wrapper_new ();
+
+		data = g_memory_output_stream_get_data (output_stream);
+		size = g_memory_output_stream_get_data_size (output_stream);
+
+		stream = camel_stream_mem_new_with_buffer (data, size);
+		camel_data_wrapper_construct_from_stream_sync (
+			wrapper, stream, NULL, NULL);
+		camel_stream_close (stream, NULL, NULL);
+		g_object_unref (stream);
+
+		/* Correctly report the size of zero length special files. */
+		if (g_file_info_get_size (file_info) == 0)
+			g_file_info_set_size (file_info, size);
+	}
 
-	stream = camel_stream_mem_new_with_buffer (data, size);
-	camel_data_wrapper_construct_from_stream_sync (
-		wrapper, stream, NULL, NULL);
 	camel_data_wrapper_set_mime_type (wrapper, mime_type);
-	camel_stream_close (stream, NULL, NULL);
-	g_object_unref (stream);
 
 	mime_part = camel_mime_part_new ();
 	camel_medium_set_content (CAMEL_MEDIUM (mime_part), wrapper);
@@ -1931,10 +2184,6 @@ attachment_load_finish (LoadContext *load_context)
 	if (disposition != NULL)
 		camel_mime_part_set_disposition (mime_part, disposition);
 
-	/* Correctly report the size of zero length special files. */
-	if (g_file_info_get_size (file_info) == 0)
-		g_file_info_set_size (file_info, size);
-
 	load_context->mime_part = mime_part;
 
 	g_simple_async_result_set_op_res_gpointer (
@@ -2014,7 +2263,7 @@ attachment_load_stream_read_cb (GInputStream *input_stream,
 		return;
 
 	if (bytes_read == 0) {
-		attachment_load_finish (load_context);
+		attachment_load_finish (load_context, NULL);
 		return;
 	}
 
@@ -2189,10 +2438,14 @@ attachment_load_query_info_cb (GFile *file,
 		g_object_unref (temporary);
 	} else {
 #endif
-		g_file_read_async (
-			file, G_PRIORITY_DEFAULT,
-			cancellable, (GAsyncReadyCallback)
-			attachment_load_file_read_cb, load_context);
+		if (attachment_load_can_use_file (attachment, file, file_info)) {
+			attachment_load_finish (load_context, file);
+		} else {
+			g_file_read_async (
+				file, G_PRIORITY_DEFAULT,
+				cancellable, (GAsyncReadyCallback)
+				attachment_load_file_read_cb, load_context);
+		}
 #ifdef HAVE_AUTOAR
 	}
 #endif
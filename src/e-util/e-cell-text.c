@@ -110,6 +110,16 @@ G_DEFINE_TYPE (ECellText, e_cell_text, E_TYPE_CELL)
 
 #define TEXT_PAD 4
 
+/* How many layouts each view keeps before dropping them all. */
+#define LAYOUT_CACHE_MAX_SIZE 2048
+
+enum {
+	TEXT_ATTR_BOLD      = 1 << 0,
+	TEXT_ATTR_STRIKEOUT = 1 << 1,
+	TEXT_ATTR_UNDERLINE = 1 << 2,
+	TEXT_ATTR_ITALIC    = 1 << 3
+};
+
 typedef struct {
 	gpointer lines;			/* Text split into lines (private field) */
 	gint num_lines;			/* Number of lines of text */
@@ -133,8 +143,24 @@ typedef struct {
 	gint xofs, yofs;                 /* This gets added to the x
                                            and y for the cell text. */
 	gdouble ellipsis_width[2];      /* The width of the ellipsis. */
+
+	/* Layouts of drawn and measured cells, to not shape the same
+	 * text again on each expose.  LayoutCacheEntry ~> itself. */
+	GHashTable *layout_cache;
+	gulong model_handler_ids[5];
+	gulong style_updated_handler_id;
 } ECellTextView;
 
+typedef struct {
+	gint model_col;
+	gint row;
+	gint width;
+	guint attributes;
+	guint strikeout_color;
+	gchar *text;
+	PangoLayout *layout;
+} LayoutCacheEntry;
+
 struct _CellEdit {
 
 	ECellTextView *text_view;
@@ -329,6 +355,101 @@ ect_cancel_edit (ECellTextView *text_view)
 	e_table_item_leave_edit_ (text_view->cell_view.e_table_item_view);
 }
 
+static guint
+layout_cache_entry_hash (gconstpointer ptr)
+{
+	const LayoutCacheEntry *entry = ptr;
+
+	return ((guint) entry->row * 31 + (guint) entry->model_col) * 31 +
+		(guint) entry->width;
+}
+
+static gboolean
+layout_cache_entry_equal (gconstpointer ptr1,
+                          gconstpointer ptr2)
+{
+	const LayoutCacheEntry *entry1 = ptr1;
+	const LayoutCacheEntry *entry2 = ptr2;
+
+	return entry1->row == entry2->row &&
+		entry1->model_col == entry2->model_col &&
+		entry1->width == entry2->width;
+}
+
+static void
+layout_cache_entry_free (gpointer ptr)
+{
+	LayoutCacheEntry *entry = ptr;
+
+	if (entry) {
+		g_free (entry->text);
+		g_clear_object (&entry->layout);
+		g_slice_free (LayoutCacheEntry, entry);
+	}
+}
+
+static gboolean
+layout_cache_entry_matches_row (gpointer key,
+                                gpointer value,
+                                gpointer user_data)
+{
+	LayoutCacheEntry *entry = key;
+
+	return entry->row == GPOINTER_TO_INT (user_data);
+}
+
+static void
+ect_layout_cache_clear (ECellTextView *text_view)
+{
+	g_hash_table_remove_all (text_view->layout_cache);
+}
+
+static void
+ect_layout_cache_model_changed_cb (ETableModel *table_model,
+                                   ECellTextView *text_view)
+{
+	ect_layout_cache_clear (text_view);
+}
+
+static void
+ect_layout_cache_row_changed_cb (ETableModel *table_model,
+                                 gint row,
+                                 ECellTextView *text_view)
+{
+	g_hash_table_foreach_remove (
+		text_view->layout_cache,
+		layout_cache_entry_matches_row,
+		GINT_TO_POINTER (row));
+}
+
+static void
+ect_layout_cache_cell_changed_cb (ETableModel *table_model,
+                                  gint col,
+                                  gint row,
+                                  ECellTextView *text_view)
+{
+	/* Other columns can be affected too, like with the bold column. */
+	ect_layout_cache_row_changed_cb (table_model, row, text_view);
+}
+
+static void
+ect_layout_cache_rows_changed_cb (ETableModel *table_model,
+                                  gint row,
+                                  gint count,
+                                  ECellTextView *text_view)
+{
+	/* The rows after the change are renumbered. */
+	ect_layout_cache_clear (text_view);
+}
+
+static void
+ect_layout_cache_style_updated_cb (GtkWidget *widget,
+                                   ECellTextView *text_view)
+{
+	/* The font description is copied into the layouts. */
+	ect_layout_cache_clear (text_view);
+}
+
 /*
  * ECell::new_view method
  */
@@ -351,6 +472,34 @@ ect_new_view (ECell *ecell,
 	text_view->xofs = 0.0;
 	text_view->yofs = 0.0;
 
+	text_view->layout_cache = g_hash_table_new_full (
+		layout_cache_entry_hash,
+		layout_cache_entry_equal,
+		layout_cache_entry_free,
+		NULL);
+
+	if (table_model) {
+		text_view->model_handler_ids[0] = g_signal_connect (
+			table_model, "model_changed",
+			G_CALLBACK (ect_layout_cache_model_changed_cb), text_view);
+		text_view->model_handler_ids[1] = g_signal_connect (
+			table_model, "model_row_changed",
+			G_CALLBACK (ect_layout_cache_row_changed_cb), text_view);
+		text_view->model_handler_ids[2] = g_signal_connect (
+			table_model, "model_cell_changed",
+			G_CALLBACK (ect_layout_cache_cell_changed_cb), text_view);
+		text_view->model_handler_ids[3] = g_signal_connect (
+			table_model, "model_rows_inserted",
+			G_CALLBACK (ect_layout_cache_rows_changed_cb), text_view);
+		text_view->model_handler_ids[4] = g_signal_connect (
+			table_model, "model_rows_deleted",
+			G_CALLBACK (ect_layout_cache_rows_changed_cb), text_view);
+	}
+
+	text_view->style_updated_handler_id = g_signal_connect (
+		canvas, "style-updated",
+		G_CALLBACK (ect_layout_cache_style_updated_cb), text_view);
+
 	return (ECellView *) text_view;
 }
 
@@ -368,6 +517,24 @@ ect_kill_view (ECellView *ecv)
 	if (text_view->cell_view.kill_view_cb_data)
 	    g_list_free (text_view->cell_view.kill_view_cb_data);
 
+	if (text_view->cell_view.e_table_model) {
+		guint ii;
+
+		for (ii = 0; ii < G_N_ELEMENTS (text_view->model_handler_ids); ii++) {
+			if (text_view->model_handler_ids[ii])
+				g_signal_handler_disconnect (
+					text_view->cell_view.e_table_model,
+					text_view->model_handler_ids[ii]);
+		}
+	}
+
+	if (text_view->style_updated_handler_id)
+		g_signal_handler_disconnect (
+			text_view->canvas,
+			text_view->style_updated_handler_id);
+
+	g_hash_table_destroy (text_view->layout_cache);
+
 	g_free (text_view);
 }
 
@@ -404,33 +571,54 @@ ect_unrealize (ECellView *ecv)
 
 }
 
+static guint
+get_text_attributes (ECellTextView *text_view,
+                     gint row,
+                     guint *out_strikeout_color)
+{
+	ECellView *ecell_view = (ECellView *) text_view;
+	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
+	guint attributes = 0;
+
+	*out_strikeout_color = 0;
+
+	if (row < 0)
+		return attributes;
+
+	if (ect->bold_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->bold_column, row))
+		attributes |= TEXT_ATTR_BOLD;
+	if (ect->strikeout_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_column, row))
+		attributes |= TEXT_ATTR_STRIKEOUT;
+	if (ect->underline_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->underline_column, row))
+		attributes |= TEXT_ATTR_UNDERLINE;
+	if (ect->italic_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->italic_column, row))
+		attributes |= TEXT_ATTR_ITALIC;
+
+	if (ect->strikeout_color_column >= 0)
+		*out_strikeout_color = GPOINTER_TO_UINT (e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_color_column, row));
+
+	return attributes;
+}
+
 static PangoAttrList *
 build_attr_list (ECellTextView *text_view,
                  gint row,
                  gint text_length)
 {
-
-	ECellView *ecell_view = (ECellView *) text_view;
-	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
 	PangoAttrList *attrs = pango_attr_list_new ();
 	gboolean bold, strikeout, underline, italic;
-	gint strikeout_color = 0;
+	guint attributes, strikeout_color = 0;
 
-	bold = ect->bold_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->bold_column, row);
-	strikeout = ect->strikeout_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_column, row);
-	underline = ect->underline_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->underline_column, row);
-	italic = ect->italic_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->italic_column, row);
+	attributes = get_text_attributes (text_view, row, &strikeout_color);
 
-	if (ect->strikeout_color_column >= 0 && row >= 0)
-		strikeout_color = GPOINTER_TO_UINT (e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_color_column, row));
+	bold = (attributes & TEXT_ATTR_BOLD) != 0;
+	strikeout = (attributes & TEXT_ATTR_STRIKEOUT) != 0;
+	underline = (attributes & TEXT_ATTR_UNDERLINE) != 0;
+	italic = (attributes & TEXT_ATTR_ITALIC) != 0;
 
 	if (bold) {
 		PangoAttribute *attr = pango_attr_weight_new (PANGO_WEIGHT_BOLD);
@@ -621,17 +809,61 @@ generate_layout (ECellTextView *text_view,
 	PangoLayout *layout;
 	CellEdit *edit = text_view->edit;
 
+	LayoutCacheEntry key, *entry;
+	gchar *temp = NULL;
+	const gchar *text;
+
 	if (edit && edit->layout && edit->model_col == model_col && edit->row == row) {
 		g_object_ref (edit->layout);
 		return edit->layout;
 	}
 
 	if (row >= 0) {
-		gchar *temp = e_cell_text_get_text (ect, ecell_view->e_table_model, model_col, row);
-		layout = build_layout (text_view, row, temp ? temp : "", width);
-		e_cell_text_free_text (ect, ecell_view->e_table_model, model_col, temp);
+		temp = e_cell_text_get_text (ect, ecell_view->e_table_model, model_col, row);
+		text = temp ? temp : "";
 	} else
-		layout = build_layout (text_view, row, "Mumbo Jumbo", width);
+		text = "Mumbo Jumbo";
+
+	/* Layouts built while editing are not finished by build_layout()
+	 * and the edited one is modified in place, thus do not cache them. */
+	if (edit) {
+		layout = build_layout (text_view, row, text, width);
+		goto exit;
+	}
+
+	key.model_col = model_col;
+	key.row = row;
+	key.width = MAX (width, 0);
+	key.attributes = get_text_attributes (text_view, row, &key.strikeout_color);
+
+	entry = g_hash_table_lookup (text_view->layout_cache, &key);
+
+	/* Compare the text too, the model does not always
+	 * notify about changes of the text of a row. */
+	if (entry &&
+	    entry->attributes == key.attributes &&
+	    entry->strikeout_color == key.strikeout_color &&
+	    g_strcmp0 (entry->text, text) == 0) {
+		layout = g_object_ref (entry->layout);
+		goto exit;
+	}
+
+	layout = build_layout (text_view, row, text, width);
+
+	if (g_hash_table_size (text_view->layout_cache) >= LAYOUT_CACHE_MAX_SIZE)
+		ect_layout_cache_clear (text_view);
+
+	entry = g_slice_new (LayoutCacheEntry);
+	*entry = key;
+	entry->text = g_strdup (text);
+	entry->layout = g_object_ref (layout);
+
+	/* Replaces the stale entry, if any. */
+	g_hash_table_add (text_view->layout_cache, entry);
+
+exit:
+	if (temp)
+		e_cell_text_free_text (ect, ecell_view->e_table_model, model_col, temp);
 
 	return layout;
 }
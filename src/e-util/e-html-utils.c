@@ -27,22 +27,6 @@
 
 #include "e-html-utils.h"
 
-static gchar *
-check_size (gchar **buffer,
-            gint *buffer_size,
-            gchar *out,
-            gint len)
-{
-	if (out + len + 1> *buffer + *buffer_size) {
-		gint index = out - *buffer;
-
-		*buffer_size = MAX (index + len + 1, *buffer_size * 2);
-		*buffer = g_realloc (*buffer, *buffer_size);
-		out = *buffer + index;
-	}
-	return out;
-}
-
 /* auto-urlification hints: the goal is not to be strictly RFC-compliant,
  * but rather to accurately distinguish urls/addresses from non-urls/
  * addresses in real-world email.
@@ -68,6 +52,104 @@ static gint special_chars[] = {
 #define is_trailing_garbage(c) (c > 127 || (special_chars[c] & 2))
 #define is_domain_name_char(c) (c < 128 && (special_chars[c] & 4))
 
+/* Returns whether the @text starts with a URL scheme recognized
+ * by the auto-urlification.  The first letter is used to pick
+ * the candidates, thus most words are rejected immediately. */
+static gboolean
+has_url_scheme (const guchar *text)
+{
+	const gchar *str = (const gchar *) text;
+
+	switch (*text) {
+	case 'c':
+	case 'C':
+		return !g_ascii_strncasecmp (str, "callto:", 7);
+	case 'f':
+	case 'F':
+		return !g_ascii_strncasecmp (str, "ftp://", 6) ||
+			!g_ascii_strncasecmp (str, "file:", 5);
+	case 'h':
+	case 'H':
+		return !g_ascii_strncasecmp (str, "http://", 7) ||
+			!g_ascii_strncasecmp (str, "https://", 8) ||
+			!g_ascii_strncasecmp (str, "h323:", 5);
+	case 'm':
+	case 'M':
+		return !g_ascii_strncasecmp (str, "mailto:", 7);
+	case 'n':
+	case 'N':
+		return !g_ascii_strncasecmp (str, "nntp://", 7) ||
+			!g_ascii_strncasecmp (str, "news:", 5);
+	case 's':
+	case 'S':
+		return !g_ascii_strncasecmp (str, "sip:", 4);
+	case 't':
+	case 'T':
+		return !g_ascii_strncasecmp (str, "tel:", 4);
+	case 'w':
+	case 'W':
+		return !g_ascii_strncasecmp (str, "webcal:", 7);
+	default:
+		break;
+	}
+
+	return FALSE;
+}
+
+/* Fills @plain_chars with TRUE for bytes, which are copied to the output
+ * unchanged with the given @flags, thus runs of them can be copied at once. */
+static void
+fill_plain_chars (gboolean *plain_chars,
+                  guint flags)
+{
+	const gchar *url_letters = "cfhmnstwCFHMNSTW";
+	gint ii;
+
+	for (ii = 0; ii < 256; ii++)
+		plain_chars[ii] = ii >= 0x21 && ii < 0x80;
+
+	plain_chars['<'] = FALSE;
+	plain_chars['>'] = FALSE;
+	plain_chars['&'] = FALSE;
+	plain_chars['"'] = FALSE;
+	plain_chars['\r'] = TRUE;
+
+	if (!(flags & (E_TEXT_TO_HTML_CONVERT_SPACES | E_TEXT_TO_HTML_CONVERT_ALL_SPACES)))
+		plain_chars[' '] = TRUE;
+
+	if (!(flags & (E_TEXT_TO_HTML_CONVERT_SPACES | E_TEXT_TO_HTML_CONVERT_ALL_SPACES | E_TEXT_TO_HTML_CONVERT_NL)))
+		plain_chars['\t'] = TRUE;
+
+	if (flags & E_TEXT_TO_HTML_CONVERT_ADDRESSES)
+		plain_chars['@'] = FALSE;
+
+	/* Letters which can start a URL */
+	if (flags & E_TEXT_TO_HTML_CONVERT_URLS) {
+		for (ii = 0; url_letters[ii]; ii++)
+			plain_chars[(guchar) url_letters[ii]] = FALSE;
+	}
+}
+
+static void
+append_char_entity (GString *out,
+                    gunichar u)
+{
+	gchar buf[16];
+	gint pos = sizeof (buf);
+
+	buf[--pos] = ';';
+
+	do {
+		buf[--pos] = '0' + (u % 10);
+		u /= 10;
+	} while (u);
+
+	buf[--pos] = '#';
+	buf[--pos] = '&';
+
+	g_string_append_len (out, buf + pos, sizeof (buf) - pos);
+}
+
 /* (http|https|ftp|nntp)://[^ "|/]+\.([^ "|]*[^ ,.!?;:>)\]}`'"|_-])+ */
 /* www\.[A-Za-z0-9.-]+(/([^ "|]*[^ ,.!?;:>)\]}`'"|_-])+)             */
 
@@ -112,7 +194,7 @@ url_extract (const guchar **text,
 
 static gchar *
 email_address_extract (const guchar **cur,
-                       gchar **out,
+                       GString *out,
                        const guchar *linestart)
 {
 	const guchar *start, *end, *dot;
@@ -142,7 +224,7 @@ email_address_extract (const guchar **cur,
 		return NULL;
 
 	addr = g_strndup ((gchar *) start, end - start);
-	*out -= *cur - start;
+	g_string_truncate (out, out->len - (*cur - start));
 	*cur = end;
 
 	return addr;
@@ -242,18 +324,18 @@ e_text_to_html_full (const gchar *input,
                      guint32 color)
 {
 	const guchar *cur, *next, *linestart;
-	gchar *buffer = NULL;
-	gchar *out = NULL;
-	gint buffer_size = 0, col;
+	GString *out;
+	gboolean plain_chars[256];
+	gint col;
 	gboolean colored = FALSE, saw_citation = FALSE;
 
+	fill_plain_chars (plain_chars, flags);
+
 	/* Allocate a translation buffer.  */
-	buffer_size = strlen (input) * 2 + 5;
-	buffer = g_malloc (buffer_size);
+	out = g_string_sized_new (strlen (input) * 2 + 5);
 
-	out = buffer;
 	if (flags & E_TEXT_TO_HTML_PRE)
-		out += sprintf (out, "<PRE>");
+		g_string_append (out, "<PRE>");
 
 	col = 0;
 
@@ -264,19 +346,11 @@ e_text_to_html_full (const gchar *input,
 			saw_citation = is_citation (cur, saw_citation);
 			if (saw_citation) {
 				if (!colored) {
-					gchar font[25];
-
-					g_snprintf (font, 25, "<FONT COLOR=\"#%06x\">", color);
-
-					out = check_size (&buffer, &buffer_size, out, 25);
-					out += sprintf (out, "%s", font);
+					g_string_append_printf (out, "<FONT COLOR=\"#%06x\">", color);
 					colored = TRUE;
 				}
 			} else if (colored) {
-				const gchar *no_font = "</FONT>";
-
-				out = check_size (&buffer, &buffer_size, out, 9);
-				out += sprintf (out, "%s", no_font);
+				g_string_append (out, "</FONT>");
 				colored = FALSE;
 			}
 
@@ -284,8 +358,20 @@ e_text_to_html_full (const gchar *input,
 			if (*cur == '>' && !saw_citation)
 				cur++;
 		} else if (flags & E_TEXT_TO_HTML_CITE && col == 0) {
-			out = check_size (&buffer, &buffer_size, out, 5);
-			out += sprintf (out, "&gt; ");
+			g_string_append (out, "&gt; ");
+		}
+
+		/* Copy the run of characters, which do not need
+		 * any conversion, all at once. */
+		if (plain_chars[*cur]) {
+			next = cur + 1;
+
+			while (plain_chars[*next])
+				next++;
+
+			g_string_append_len (out, (const gchar *) cur, next - cur);
+			col += next - cur;
+			continue;
 		}
 
 		u = g_utf8_get_char ((gchar *) cur);
@@ -293,18 +379,7 @@ e_text_to_html_full (const gchar *input,
 		    (flags & E_TEXT_TO_HTML_CONVERT_URLS)) {
 			gchar *tmpurl = NULL, *refurl = NULL, *dispurl = NULL;
 
-			if (!g_ascii_strncasecmp ((gchar *) cur, "http://", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "https://", 8) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "ftp://", 6) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "nntp://", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "mailto:", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "news:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "file:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "callto:", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "h323:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "sip:", 4) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "tel:", 4) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "webcal:", 7)) {
+			if (has_url_scheme (cur)) {
 				tmpurl = url_extract (&cur, TRUE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
 				if (tmpurl) {
 					refurl = e_text_to_html (tmpurl, 0);
@@ -326,7 +401,8 @@ e_text_to_html_full (const gchar *input,
 						dispurl = g_strdup (refurl);
 					}
 				}
-			} else if (!g_ascii_strncasecmp ((gchar *) cur, "www.", 4) &&
+			} else if ((*cur == 'w' || *cur == 'W') &&
+				   !g_ascii_strncasecmp ((gchar *) cur, "www.", 4) &&
 				   is_url_char (*(cur + 4))) {
 				tmpurl = url_extract (&cur, FALSE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
 				if (tmpurl) {
@@ -349,13 +425,11 @@ e_text_to_html_full (const gchar *input,
 					refurl = replaced;
 				}
 
-				out = check_size (
-					&buffer, &buffer_size, out,
-					strlen (refurl) +
-					strlen (dispurl) + 15);
-				out += sprintf (out,
-						"<a href=\"%s\">%s</a>",
-						refurl, dispurl);
+				g_string_append (out, "<a href=\"");
+				g_string_append (out, refurl);
+				g_string_append (out, "\">");
+				g_string_append (out, dispurl);
+				g_string_append (out, "</a>");
 				col += strlen (tmpurl);
 				g_free (tmpurl);
 				g_free (refurl);
@@ -368,20 +442,19 @@ e_text_to_html_full (const gchar *input,
 		}
 
 		if (u == '@' && (flags & E_TEXT_TO_HTML_CONVERT_ADDRESSES)) {
-			gchar *addr, *dispaddr, *outaddr;
+			gchar *addr, *dispaddr;
 
-			addr = email_address_extract (&cur, &out, linestart);
+			addr = email_address_extract (&cur, out, linestart);
 			if (addr) {
 				dispaddr = e_text_to_html (addr, 0);
-				outaddr = g_strdup_printf (
-					"<a href=\"mailto:%s\">%s</a>",
-					addr, dispaddr);
-				out = check_size (&buffer, &buffer_size, out, strlen (outaddr));
-				out += sprintf (out, "%s", outaddr);
+				g_string_append (out, "<a href=\"mailto:");
+				g_string_append (out, addr);
+				g_string_append (out, "\">");
+				g_string_append (out, dispaddr);
+				g_string_append (out, "</a>");
 				col += strlen (addr);
 				g_free (addr);
 				g_free (dispaddr);
-				g_free (outaddr);
 
 				if (!*cur)
 					break;
@@ -398,39 +471,31 @@ e_text_to_html_full (const gchar *input,
 		} else
 			next = (const guchar *) g_utf8_next_char (cur);
 
-		out = check_size (&buffer, &buffer_size, out, 10);
-
 		switch (u) {
 		case '<':
-			strcpy (out, "&lt;");
-			out += 4;
+			g_string_append_len (out, "&lt;", 4);
 			col++;
 			break;
 
 		case '>':
-			strcpy (out, "&gt;");
-			out += 4;
+			g_string_append_len (out, "&gt;", 4);
 			col++;
 			break;
 
 		case '&':
-			strcpy (out, "&amp;");
-			out += 5;
+			g_string_append_len (out, "&amp;", 5);
 			col++;
 			break;
 
 		case '"':
-			strcpy (out, "&quot;");
-			out += 6;
+			g_string_append_len (out, "&quot;", 6);
 			col++;
 			break;
 
 		case '\n':
-			if (flags & E_TEXT_TO_HTML_CONVERT_NL) {
-				strcpy (out, "<br>");
-				out += 4;
-			}
-			*out++ = *cur;
+			if (flags & E_TEXT_TO_HTML_CONVERT_NL)
+				g_string_append_len (out, "<br>", 4);
+			g_string_append_c (out, *cur);
 			linestart = cur;
 			col = 0;
 			break;
@@ -439,10 +504,7 @@ e_text_to_html_full (const gchar *input,
 			if (flags & (E_TEXT_TO_HTML_CONVERT_SPACES |
 				     E_TEXT_TO_HTML_CONVERT_NL)) {
 				do {
-					out = check_size (
-						&buffer, &buffer_size, out, 7);
-					strcpy (out, "&nbsp;");
-					out += 6;
+					g_string_append_len (out, "&nbsp;", 6);
 					col++;
 				} while (col % 8);
 				break;
@@ -455,8 +517,7 @@ e_text_to_html_full (const gchar *input,
 				    cur == (const guchar *) input ||
 				    *(cur + 1) == ' ' || *(cur + 1) == '\t' ||
 				    *(cur - 1) == '\n') {
-					strcpy (out, "&nbsp;");
-					out += 6;
+					g_string_append_len (out, "&nbsp;", 6);
 					col++;
 					break;
 				}
@@ -467,25 +528,22 @@ e_text_to_html_full (const gchar *input,
 			if ((u >= 0x20 && u < 0x80) ||
 			    (u == '\r' || u == '\t')) {
 				/* Default case, just copy. */
-				*out++ = u;
+				g_string_append_c (out, u);
 			} else {
 				if (flags & E_TEXT_TO_HTML_ESCAPE_8BIT)
-					*out++ = '?';
+					g_string_append_c (out, '?');
 				else
-					out += g_snprintf (out, 9, "&#%d;", u);
+					append_char_entity (out, u);
 			}
 			col++;
 			break;
 		}
 	}
 
-	out = check_size (&buffer, &buffer_size, out, 7);
 	if (flags & E_TEXT_TO_HTML_PRE)
-		strcpy (out, "</PRE>");
-	else
-		*out = '\0';
+		g_string_append (out, "</PRE>");
 
-	return buffer;
+	return g_string_free (out, FALSE);
 }
 
 gchar *
@@ -559,6 +617,89 @@ struct {
 };
 gint num_url_tests = G_N_ELEMENTS (url_tests);
 
+struct {
+	gchar *text;
+	guint flags;
+	gchar *html;
+} html_tests[] = {
+	{ "Plain text line\nwith two lines",
+	  0,
+	  "Plain text line\nwith two lines" },
+	{ "<b>\"Tom & Jerry\"</b>",
+	  0,
+	  "&lt;b&gt;&quot;Tom &amp; Jerry&quot;&lt;/b&gt;" },
+	{ "a\tb  c\n  d",
+	  E_TEXT_TO_HTML_CONVERT_SPACES,
+	  "a&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;b&nbsp; c\n&nbsp; d" },
+	{ "a\tb\nc",
+	  E_TEXT_TO_HTML_CONVERT_NL,
+	  "a&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;b<br>\nc" },
+	{ "a b  c",
+	  E_TEXT_TO_HTML_CONVERT_ALL_SPACES,
+	  "a&nbsp;b&nbsp;&nbsp;c" },
+	{ "caf\xc3\xa9 \xe2\x82\xac \xff",
+	  0,
+	  "caf&#233; &#8364; &#255;" },
+	{ "smile \xf0\x9f\x98\x80 ok",
+	  0,
+	  "smile &#128512; ok" },
+	{ "caf\xc3\xa9 \xe2\x82\xac",
+	  E_TEXT_TO_HTML_ESCAPE_8BIT,
+	  "caf? ?" },
+	{ "see http://www.foo.com/a?b=1&c=2, or www.gnome.org.",
+	  E_TEXT_TO_HTML_CONVERT_URLS,
+	  "see <a href=\"http://www.foo.com/a?b=1&amp;c=2\">http://www.foo.com/a?b=1&amp;c=2</a>, or <a href=\"http://www.gnome.org\">www.gnome.org</a>." },
+	{ "write to bob@foo.com or mailto:alice@foo.com",
+	  E_TEXT_TO_HTML_CONVERT_URLS | E_TEXT_TO_HTML_CONVERT_ADDRESSES,
+	  "write to <a href=\"mailto:bob@foo.com\">bob@foo.com</a> or <a href=\"mailto:alice@foo.com\">mailto:alice@foo.com</a>" },
+	{ "see https://www.foo.com/",
+	  E_TEXT_TO_HTML_CONVERT_URLS | E_TEXT_TO_HTML_HIDE_URL_SCHEME,
+	  "see <a href=\"https://www.foo.com/\">www.foo.com/</a>" },
+	{ "> quoted\n>> deeper\n>From mbox\nplain",
+	  E_TEXT_TO_HTML_MARK_CITATION,
+	  "<FONT COLOR=\"#737373\">&gt; quoted\n&gt;&gt; deeper\n&gt;From mbox\n</FONT>plain" },
+	{ "one\ntwo",
+	  E_TEXT_TO_HTML_PRE | E_TEXT_TO_HTML_CITE,
+	  "<PRE>&gt; one\n&gt; two</PRE>" },
+};
+gint num_html_tests = G_N_ELEMENTS (html_tests);
+
+/* Converts a large quoted plain-text message repeatedly
+ * and prints how long it took. */
+static void
+benchmark (void)
+{
+	GString *text;
+	GTimer *timer;
+	gint i;
+
+	text = g_string_new ("");
+	for (i = 0; i < 50000; i++) {
+		g_string_append (text, "> On Monday, bob@foo.com wrote about http://www.foo.com/:\n");
+		g_string_append (text, "Plain text line with \"quotes\", <tags> & caf\xc3\xa9.\n");
+		g_string_append (text, "\tindented   line with  several spaces\n");
+	}
+
+	timer = g_timer_new ();
+	for (i = 0; i < 10; i++) {
+		g_free (e_text_to_html_full (
+			text->str,
+			E_TEXT_TO_HTML_CONVERT_NL |
+			E_TEXT_TO_HTML_CONVERT_SPACES |
+			E_TEXT_TO_HTML_CONVERT_URLS |
+			E_TEXT_TO_HTML_MARK_CITATION |
+			E_TEXT_TO_HTML_CONVERT_ADDRESSES, 0x737373));
+	}
+	g_timer_stop (timer);
+
+	printf (
+		"Converted %d bytes 10 times in %.3f seconds\n",
+		(gint) text->len, g_timer_elapsed (timer, NULL));
+
+	g_timer_destroy (timer);
+	g_string_free (text, TRUE);
+}
+
 gint
 main (gint argc,
       gchar **argv)
@@ -596,6 +737,23 @@ main (gint argc,
 		g_free (html);
 	}
 
+	for (i = 0; i < num_html_tests; i++) {
+		html = e_text_to_html_full (html_tests[i].text, html_tests[i].flags, 0x737373);
+
+		if (strcmp (html, html_tests[i].html) != 0) {
+			printf (
+				"FAILED on \"%s\" (flags 0x%x) -> %s\n  (got %s)\n\n",
+				html_tests[i].text, html_tests[i].flags,
+				html_tests[i].html, html);
+			errors++;
+		}
+
+		g_free (html);
+	}
+
+	if (argc > 1 && g_strcmp0 (argv[1], "--benchmark") == 0)
+		benchmark ();
+
 	printf ("\n%d errors\n", errors);
 	return errors;
 }
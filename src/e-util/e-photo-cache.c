@@ -23,13 +23,15 @@
  * #EPhotoCache finds photos associated with an email address.
  *
  * A limited internal cache is employed to speed up frequently searched
- * email addresses.  The exact caching semantics are private and subject
- * to change.
+ * email addresses.  Search results, including those with no photo found,
+ * are also kept on disk for a limited time, thus they survive restarts.
+ * The exact caching semantics are private and subject to change.
  **/
 
 #include "e-photo-cache.h"
 
 #include <string.h>
+#include <glib/gstdio.h>
 #include <libebackend/libebackend.h>
 
 #include <e-util/e-data-capture.h>
@@ -42,11 +44,26 @@
  * priority photo source, after which we settle for what we have. */
 #define ASYNC_TIMEOUT_SECONDS 3.0
 
-/* How many email addresses we track at once, regardless of whether
- * the email address has a photo.  As new cache entries are added, we
- * discard the least recently accessed entries to keep the cache size
- * within the limit. */
-#define MAX_CACHE_SIZE 20
+/* How many email addresses we track at once by default, regardless
+ * of whether the email address has a photo.  As new cache entries are
+ * added, we discard the least recently accessed entries to keep the
+ * cache size within the limit. */
+#define DEFAULT_MAX_CACHE_SIZE 200
+
+/* How many days the search results are kept on disk by default. */
+#define DEFAULT_DISK_CACHE_DAYS 7
+
+/* How long (in seconds) to remember that an email address has no
+ * photo, in memory and on disk respectively.  Kept shorter than for
+ * found photos, because a contact can be added to a book any time. */
+#define NEGATIVE_CACHE_SECONDS (30 * 60)
+#define NEGATIVE_DISK_CACHE_SECONDS (24 * 60 * 60)
+
+/* How long (in seconds) after the start and then between the removals
+ * of the expired files from the disk cache.  The lookups remove only
+ * the files of the email addresses being looked up. */
+#define DISK_CACHE_SWEEP_FIRST_SECONDS 60
+#define DISK_CACHE_SWEEP_INTERVAL_SECONDS (24 * 60 * 60)
 
 #define ERROR_IS_CANCELLED(error) \
 	(g_error_matches ((error), G_IO_ERROR, G_IO_ERROR_CANCELLED))
@@ -54,6 +71,7 @@
 typedef struct _AsyncContext AsyncContext;
 typedef struct _AsyncSubtask AsyncSubtask;
 typedef struct _DataCaptureClosure DataCaptureClosure;
+typedef struct _DiskCacheJob DiskCacheJob;
 typedef struct _PhotoData PhotoData;
 
 struct _EPhotoCachePrivate {
@@ -63,6 +81,12 @@ struct _EPhotoCachePrivate {
 	GHashTable *photo_ht;
 	GQueue photo_ht_keys;
 	GMutex photo_ht_lock;
+	guint max_cache_size;
+
+	gchar *disk_cache_dir;
+	GThreadPool *disk_cache_pool;
+	guint disk_cache_days;
+	guint disk_cache_sweep_id;
 
 	GHashTable *sources_ht;
 	GMutex sources_ht_lock;
@@ -70,6 +94,8 @@ struct _EPhotoCachePrivate {
 
 struct _AsyncContext {
 	GMutex lock;
+	GWeakRef photo_cache;
+	gchar *email_address;
 	GTimer *timer;
 	GHashTable *subtasks;
 	GQueue results;
@@ -95,19 +121,51 @@ struct _DataCaptureClosure {
 	gchar *email_address;
 };
 
+typedef enum {
+	DISK_CACHE_JOB_STORE,
+	DISK_CACHE_JOB_LOOKUP,
+	DISK_CACHE_JOB_REMOVE,
+	DISK_CACHE_JOB_SWEEP
+} DiskCacheJobKind;
+
+struct _DiskCacheJob {
+	DiskCacheJobKind kind;
+	gchar *filename;
+	GBytes *bytes;
+
+	/* For DISK_CACHE_JOB_LOOKUP and DISK_CACHE_JOB_SWEEP. */
+	guint disk_cache_days;
+	GSimpleAsyncResult *simple;
+	GMainContext *main_context;
+};
+
 struct _PhotoData {
 	volatile gint ref_count;
 	GMutex lock;
 	GBytes *bytes;
+
+	/* Protected by photo_ht_lock. */
+	GList *mru_link;
+	gint64 stored_time;
 };
 
 enum {
 	PROP_0,
-	PROP_CLIENT_CACHE
+	PROP_CLIENT_CACHE,
+	PROP_DISK_CACHE_DAYS,
+	PROP_MAX_CACHE_SIZE
 };
 
 /* Forward Declarations */
 static void	async_context_cancel_subtasks	(AsyncContext *async_context);
+static void	photo_ht_insert			(EPhotoCache *photo_cache,
+						 const gchar *email_address,
+						 GBytes *bytes);
+static void	photo_cache_dispatch_subtasks	(EPhotoCache *photo_cache,
+						 GSimpleAsyncResult *simple);
+static void	photo_disk_store		(EPhotoCache *photo_cache,
+						 const gchar *email_address,
+						 GBytes *bytes);
 
 G_DEFINE_TYPE_WITH_CODE (
 	EPhotoCache,
@@ -216,6 +274,7 @@ async_subtask_complete (AsyncSubtask *async_subtask)
 	GSimpleAsyncResult *simple;
 	AsyncContext *async_context;
 	gboolean cancel_subtasks = FALSE;
+	gboolean no_photo = FALSE;
 	gdouble seconds_elapsed;
 
 	simple = async_subtask->simple;
@@ -276,6 +335,10 @@ async_subtask_complete (AsyncSubtask *async_subtask)
 		}
 
 		async_subtask_unref (async_subtask);
+	} else {
+		/* All photo sources finished without an error
+		 * and none of them found a photo.  Remember it. */
+		no_photo = TRUE;
 	}
 
 	g_simple_async_result_complete_in_idle (simple);
@@ -283,6 +346,22 @@ async_subtask_complete (AsyncSubtask *async_subtask)
 exit:
 	g_mutex_unlock (&async_context->lock);
 
+	if (no_photo) {
+		EPhotoCache *photo_cache;
+
+		photo_cache = g_weak_ref_get (&async_context->photo_cache);
+
+		if (photo_cache != NULL) {
+			photo_ht_insert (
+				photo_cache,
+				async_context->email_address, NULL);
+			photo_disk_store (
+				photo_cache,
+				async_context->email_address, NULL);
+			g_object_unref (photo_cache);
+		}
+	}
+
 	if (cancel_subtasks) {
 		/* Call this after the mutex is unlocked. */
 		async_context_cancel_subtasks (async_context);
@@ -297,13 +376,17 @@ async_context_cancelled_cb (GCancellable *cancellable,
 }
 
 static AsyncContext *
-async_context_new (EDataCapture *data_capture,
+async_context_new (EPhotoCache *photo_cache,
+                   const gchar *email_address,
+                   EDataCapture *data_capture,
                    GCancellable *cancellable)
 {
 	AsyncContext *async_context;
 
 	async_context = g_slice_new0 (AsyncContext);
 	g_mutex_init (&async_context->lock);
+	g_weak_ref_init (&async_context->photo_cache, photo_cache);
+	async_context->email_address = g_strdup (email_address);
 	async_context->timer = g_timer_new ();
 
 	async_context->subtasks = g_hash_table_new_full (
@@ -341,6 +424,8 @@ async_context_free (AsyncContext *async_context)
 			async_context->cancelled_handler_id);
 
 	g_mutex_clear (&async_context->lock);
+	g_weak_ref_clear (&async_context->photo_cache);
+	g_free (async_context->email_address);
 	g_timer_destroy (async_context->timer);
 
 	g_hash_table_destroy (async_context->subtasks);
@@ -419,6 +504,7 @@ photo_data_new (GBytes *bytes)
 
 	photo_data = g_slice_new0 (PhotoData);
 	photo_data->ref_count = 1;
+	photo_data->stored_time = g_get_monotonic_time ();
 	g_mutex_init (&photo_data->lock);
 
 	if (bytes != NULL)
@@ -497,6 +583,28 @@ photo_ht_normalize_key (const gchar *email_address)
 	return collation_key;
 }
 
+/* Call with photo_ht_lock held. */
+static void
+photo_ht_trim (EPhotoCache *photo_cache)
+{
+	GHashTable *photo_ht;
+	GQueue *photo_ht_keys;
+
+	photo_ht = photo_cache->priv->photo_ht;
+	photo_ht_keys = &photo_cache->priv->photo_ht_keys;
+
+	while (g_queue_get_length (photo_ht_keys) >
+	       photo_cache->priv->max_cache_size) {
+		GList *link;
+
+		/* The link data is the hash table key,
+		 * which is freed by the hash table. */
+		link = g_queue_pop_tail_link (photo_ht_keys);
+		g_hash_table_remove (photo_ht, link->data);
+		g_list_free_1 (link);
+	}
+}
+
 static void
 photo_ht_insert (EPhotoCache *photo_cache,
                  const gchar *email_address,
@@ -519,41 +627,31 @@ photo_ht_insert (EPhotoCache *photo_cache,
 	photo_data = g_hash_table_lookup (photo_ht, key);
 
 	if (photo_data != NULL) {
-		GList *link;
-
 		/* Replace the old photo data if we have new photo
 		 * data, otherwise leave the old photo data alone. */
 		if (bytes != NULL)
 			photo_data_set_bytes (photo_data, bytes);
 
+		photo_data->stored_time = g_get_monotonic_time ();
+
 		/* Move the key to the head of the MRU queue. */
-		link = g_queue_find_custom (
-			photo_ht_keys, key,
-			(GCompareFunc) strcmp);
-		if (link != NULL) {
-			g_queue_unlink (photo_ht_keys, link);
-			g_queue_push_head_link (photo_ht_keys, link);
-		}
+		g_queue_unlink (photo_ht_keys, photo_data->mru_link);
+		g_queue_push_head_link (photo_ht_keys, photo_data->mru_link);
+
+		g_free (key);
 	} else {
 		photo_data = photo_data_new (bytes);
 
-		g_hash_table_insert (
-			photo_ht, g_strdup (key),
-			photo_data_ref (photo_data));
+		/* The hash table takes ownership of the key,
+		 * the MRU queue only borrows it. */
+		g_hash_table_insert (photo_ht, key, photo_data);
 
 		/* Push the key to the head of the MRU queue. */
-		g_queue_push_head (photo_ht_keys, g_strdup (key));
+		g_queue_push_head (photo_ht_keys, key);
+		photo_data->mru_link = g_queue_peek_head_link (photo_ht_keys);
 
 		/* Trim the cache if necessary. */
-		while (g_queue_get_length (photo_ht_keys) > MAX_CACHE_SIZE) {
-			gchar *oldest_key;
-
-			oldest_key = g_queue_pop_tail (photo_ht_keys);
-			g_hash_table_remove (photo_ht, oldest_key);
-			g_free (oldest_key);
-		}
-
-		photo_data_unref (photo_data);
+		photo_ht_trim (photo_cache);
 	}
 
 	/* Hash table and queue sizes should be equal at all times. */
@@ -562,8 +660,6 @@ photo_ht_insert (EPhotoCache *photo_cache,
 		g_queue_get_length (photo_ht_keys));
 
 	g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
-
-	g_free (key);
 }
 
 static gboolean
@@ -572,6 +668,7 @@ photo_ht_lookup (EPhotoCache *photo_cache,
                  GInputStream **out_stream)
 {
 	GHashTable *photo_ht;
+	GQueue *photo_ht_keys;
 	PhotoData *photo_data;
 	gboolean found = FALSE;
 	gchar *key;
@@ -580,6 +677,7 @@ photo_ht_lookup (EPhotoCache *photo_cache,
 	g_return_val_if_fail (out_stream != NULL, FALSE);
 
 	photo_ht = photo_cache->priv->photo_ht;
+	photo_ht_keys = &photo_cache->priv->photo_ht_keys;
 
 	key = photo_ht_normalize_key (email_address);
 
@@ -591,14 +689,29 @@ photo_ht_lookup (EPhotoCache *photo_cache,
 		GBytes *bytes;
 
 		bytes = photo_data_ref_bytes (photo_data);
-		if (bytes != NULL) {
-			*out_stream =
-				g_memory_input_stream_new_from_bytes (bytes);
-			g_bytes_unref (bytes);
+
+		if (bytes == NULL && g_get_monotonic_time () -
+		    photo_data->stored_time >
+		    NEGATIVE_CACHE_SECONDS * G_USEC_PER_SEC) {
+			/* Expired "no photo" entry, search again. */
+			g_queue_delete_link (
+				photo_ht_keys, photo_data->mru_link);
+			g_hash_table_remove (photo_ht, key);
 		} else {
-			*out_stream = NULL;
+			if (bytes != NULL) {
+				*out_stream =
+					g_memory_input_stream_new_from_bytes (bytes);
+				g_bytes_unref (bytes);
+			} else {
+				*out_stream = NULL;
+			}
+			found = TRUE;
+
+			/* Move the key to the head of the MRU queue. */
+			g_queue_unlink (photo_ht_keys, photo_data->mru_link);
+			g_queue_push_head_link (
+				photo_ht_keys, photo_data->mru_link);
 		}
-		found = TRUE;
 	}
 
 	g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
@@ -614,6 +727,7 @@ photo_ht_remove (EPhotoCache *photo_cache,
 {
 	GHashTable *photo_ht;
 	GQueue *photo_ht_keys;
+	PhotoData *photo_data;
 	gchar *key;
 	gboolean removed = FALSE;
 
@@ -626,17 +740,12 @@ photo_ht_remove (EPhotoCache *photo_cache,
 
 	g_mutex_lock (&photo_cache->priv->photo_ht_lock);
 
-	if (g_hash_table_remove (photo_ht, key)) {
-		GList *link;
+	photo_data = g_hash_table_lookup (photo_ht, key);
 
-		link = g_queue_find_custom (
-			photo_ht_keys, key,
-			(GCompareFunc) strcmp);
-		if (link != NULL) {
-			g_free (link->data);
-			g_queue_delete_link (photo_ht_keys, link);
-			removed = TRUE;
-		}
+	if (photo_data != NULL) {
+		g_queue_delete_link (photo_ht_keys, photo_data->mru_link);
+		g_hash_table_remove (photo_ht, key);
+		removed = TRUE;
 	}
 
 	/* Hash table and queue sizes should be equal at all times. */
@@ -654,20 +763,387 @@ photo_ht_remove (EPhotoCache *photo_cache,
 static void
 photo_ht_remove_all (EPhotoCache *photo_cache)
 {
-	GHashTable *photo_ht;
-	GQueue *photo_ht_keys;
+	g_mutex_lock (&photo_cache->priv->photo_ht_lock);
 
-	photo_ht = photo_cache->priv->photo_ht;
-	photo_ht_keys = &photo_cache->priv->photo_ht_keys;
+	/* The queue only borrows the keys. */
+	g_queue_clear (&photo_cache->priv->photo_ht_keys);
+	g_hash_table_remove_all (photo_cache->priv->photo_ht);
 
-	g_mutex_lock (&photo_cache->priv->photo_ht_lock);
+	g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
+}
 
-	g_hash_table_remove_all (photo_ht);
+static void
+disk_cache_job_free (DiskCacheJob *job)
+{
+	g_free (job->filename);
+	if (job->bytes != NULL)
+		g_bytes_unref (job->bytes);
+	g_clear_object (&job->simple);
+	if (job->main_context != NULL)
+		g_main_context_unref (job->main_context);
+	g_slice_free (DiskCacheJob, job);
+}
 
-	while (!g_queue_is_empty (photo_ht_keys))
-		g_free (g_queue_pop_head (photo_ht_keys));
+static void
+photo_disk_write (DiskCacheJob *job)
+{
+	gchar *dirname;
+	GStatBuf st;
+	GError *local_error = NULL;
+
+	/* Do not replace a found photo with a "no photo" entry,
+	 * the photo could be added to the cache meanwhile. */
+	if (job->bytes == NULL &&
+	    g_stat (job->filename, &st) == 0 && st.st_size > 0)
+		return;
+
+	dirname = g_path_get_dirname (job->filename);
+	g_mkdir_with_parents (dirname, 0700);
+	g_free (dirname);
+
+	if (job->bytes != NULL) {
+		gconstpointer contents;
+		gsize length = 0;
+
+		contents = g_bytes_get_data (job->bytes, &length);
+		g_file_set_contents (
+			job->filename, contents, length, &local_error);
+	} else {
+		g_file_set_contents (job->filename, "", 0, &local_error);
+	}
 
-	g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
+	if (local_error != NULL) {
+		g_warning (
+			"%s: Failed to write '%s': %s",
+			G_STRFUNC, job->filename, local_error->message);
+		g_error_free (local_error);
+	}
+}
+
+static gboolean
+photo_disk_expired (const GStatBuf *st,
+                    guint disk_cache_days)
+{
+	gint64 lifetime;
+
+	lifetime = (gint64) disk_cache_days * 24 * 60 * 60;
+	if (st->st_size == 0)
+		lifetime = MIN (lifetime, NEGATIVE_DISK_CACHE_SECONDS);
+
+	return g_get_real_time () / G_USEC_PER_SEC - st->st_mtime > lifetime;
+}
+
+static gboolean
+photo_disk_lookup (const gchar *filename,
+                   guint disk_cache_days,
+                   GBytes **out_bytes)
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	GStatBuf st;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (out_bytes != NULL, FALSE);
+
+	*out_bytes = NULL;
+
+	if (g_stat (filename, &st) != 0 || !S_ISREG (st.st_mode))
+		return FALSE;
+
+	if (photo_disk_expired (&st, disk_cache_days)) {
+		g_unlink (filename);
+		return FALSE;
+	}
+
+	/* An empty file means nobody had a photo for this email address. */
+	if (st.st_size == 0)
+		return TRUE;
+
+	if (!g_file_get_contents (filename, &contents, &length, NULL))
+		return FALSE;
+
+	*out_bytes = g_bytes_new_take (contents, length);
+
+	return TRUE;
+}
+
+static gboolean
+photo_disk_lookup_found_cb (gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+
+	g_simple_async_result_complete (simple);
+
+	return FALSE;
+}
+
+static gboolean
+photo_disk_lookup_not_found_cb (gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	GObject *photo_cache;
+
+	photo_cache = g_async_result_get_source_object (G_ASYNC_RESULT (simple));
+
+	photo_cache_dispatch_subtasks (E_PHOTO_CACHE (photo_cache), simple);
+
+	g_object_unref (photo_cache);
+
+	return FALSE;
+}
+
+static void
+photo_disk_lookup_finish (DiskCacheJob *job)
+{
+	AsyncContext *async_context;
+	GSource *source;
+	GBytes *bytes = NULL;
+
+	async_context = g_simple_async_result_get_op_res_gpointer (job->simple);
+	source = g_idle_source_new ();
+
+	if (photo_disk_lookup (job->filename, job->disk_cache_days, &bytes)) {
+		GObject *photo_cache;
+
+		photo_cache = g_async_result_get_source_object (G_ASYNC_RESULT (job->simple));
+		photo_ht_insert (E_PHOTO_CACHE (photo_cache), async_context->email_address, bytes);
+		g_object_unref (photo_cache);
+
+		if (bytes != NULL) {
+			async_context->stream =
+				g_memory_input_stream_new_from_bytes (bytes);
+			g_bytes_unref (bytes);
+		}
+
+		g_source_set_callback (
+			source, photo_disk_lookup_found_cb,
+			job->simple, g_object_unref);
+	} else {
+		/* Ask the photo sources from the caller's main context */
+		g_source_set_callback (
+			source, photo_disk_lookup_not_found_cb,
+			job->simple, g_object_unref);
+	}
+
+	/* The source owns the 'simple' now, thus the photo cache
+	 * is not freed in this thread. */
+	job->simple = NULL;
+
+	g_source_attach (source, job->main_context);
+	g_source_unref (source);
+}
+
+static void
+photo_disk_sweep (DiskCacheJob *job)
+{
+	GDir *dir;
+	const gchar *name;
+
+	/* The job's filename is the disk cache directory. */
+	dir = g_dir_open (job->filename, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *filename;
+		GStatBuf st;
+
+		filename = g_build_filename (job->filename, name, NULL);
+
+		if (g_stat (filename, &st) == 0 && S_ISREG (st.st_mode) &&
+		    photo_disk_expired (&st, job->disk_cache_days))
+			g_unlink (filename);
+
+		g_free (filename);
+	}
+
+	g_dir_close (dir);
+}
+
+static void
+photo_disk_cache_thread (gpointer data,
+                         gpointer user_data)
+{
+	DiskCacheJob *job = data;
+
+	switch (job->kind) {
+		case DISK_CACHE_JOB_STORE:
+			photo_disk_write (job);
+			break;
+		case DISK_CACHE_JOB_LOOKUP:
+			photo_disk_lookup_finish (job);
+			break;
+		case DISK_CACHE_JOB_REMOVE:
+			g_unlink (job->filename);
+			break;
+		case DISK_CACHE_JOB_SWEEP:
+			photo_disk_sweep (job);
+			break;
+	}
+
+	disk_cache_job_free (job);
+}
+
+static gchar *
+photo_disk_build_filename (EPhotoCache *photo_cache,
+                           const gchar *email_address)
+{
+	gchar *lowercase_email_address;
+	gchar *checksum;
+	gchar *filename;
+
+	/* The collation key used in memory depends on the locale,
+	 * thus key the files by the lowercase address instead. */
+	lowercase_email_address = g_utf8_strdown (email_address, -1);
+	checksum = g_compute_checksum_for_string (
+		G_CHECKSUM_SHA1, lowercase_email_address, -1);
+
+	filename = g_build_filename (
+		photo_cache->priv->disk_cache_dir, checksum, NULL);
+
+	g_free (lowercase_email_address);
+	g_free (checksum);
+
+	return filename;
+}
+
+static void
+photo_disk_store (EPhotoCache *photo_cache,
+                  const gchar *email_address,
+                  GBytes *bytes)
+{
+	DiskCacheJob *job;
+
+	g_return_if_fail (email_address != NULL);
+
+	if (e_photo_cache_get_disk_cache_days (photo_cache) == 0)
+		return;
+
+	job = g_slice_new0 (DiskCacheJob);
+	job->kind = DISK_CACHE_JOB_STORE;
+	job->filename = photo_disk_build_filename (photo_cache, email_address);
+	if (bytes != NULL)
+		job->bytes = g_bytes_ref (bytes);
+
+	/* Write from a dedicated thread, to not block the caller.
+	 * The pool runs a single thread, thus the reads, writes and
+	 * removals of the same file are done in the order they were
+	 * requested. */
+	g_thread_pool_push (photo_cache->priv->disk_cache_pool, job, NULL);
+}
+
+/* Returns FALSE when the disk cache is disabled, otherwise the 'simple'
+ * is completed from the disk cache or the photo sources are asked. */
+static gboolean
+photo_disk_lookup_async (EPhotoCache *photo_cache,
+                         GSimpleAsyncResult *simple)
+{
+	AsyncContext *async_context;
+	DiskCacheJob *job;
+	guint disk_cache_days;
+
+	disk_cache_days = e_photo_cache_get_disk_cache_days (photo_cache);
+
+	if (disk_cache_days == 0)
+		return FALSE;
+
+	async_context = g_simple_async_result_get_op_res_gpointer (simple);
+
+	job = g_slice_new0 (DiskCacheJob);
+	job->kind = DISK_CACHE_JOB_LOOKUP;
+	job->filename = photo_disk_build_filename (photo_cache, async_context->email_address);
+	job->disk_cache_days = disk_cache_days;
+	job->simple = g_object_ref (simple);
+	job->main_context = g_main_context_ref_thread_default ();
+
+	g_thread_pool_push (photo_cache->priv->disk_cache_pool, job, NULL);
+
+	return TRUE;
+}
+
+static void
+photo_disk_remove (EPhotoCache *photo_cache,
+                   const gchar *email_address)
+{
+	DiskCacheJob *job;
+
+	g_return_if_fail (email_address != NULL);
+
+	job = g_slice_new0 (DiskCacheJob);
+	job->kind = DISK_CACHE_JOB_REMOVE;
+	job->filename = photo_disk_build_filename (photo_cache, email_address);
+
+	/* Do not remove the file before the queued writes of it. */
+	g_thread_pool_push (photo_cache->priv->disk_cache_pool, job, NULL);
+}
+
+static gboolean
+photo_disk_sweep_cb (gpointer user_data)
+{
+	EPhotoCache *photo_cache = user_data;
+	DiskCacheJob *job;
+
+	job = g_slice_new0 (DiskCacheJob);
+	job->kind = DISK_CACHE_JOB_SWEEP;
+	job->filename = g_strdup (photo_cache->priv->disk_cache_dir);
+
+	/* With the disk cache disabled all the files are removed. */
+	job->disk_cache_days = e_photo_cache_get_disk_cache_days (photo_cache);
+
+	g_thread_pool_push (photo_cache->priv->disk_cache_pool, job, NULL);
+
+	photo_cache->priv->disk_cache_sweep_id = e_named_timeout_add_seconds (
+		DISK_CACHE_SWEEP_INTERVAL_SECONDS, photo_disk_sweep_cb, photo_cache);
+
+	return FALSE;
+}
+
+static void
+photo_cache_dispatch_subtasks (EPhotoCache *photo_cache,
+                               GSimpleAsyncResult *simple)
+{
+	AsyncContext *async_context;
+	GList *list, *link;
+
+	async_context = g_simple_async_result_get_op_res_gpointer (simple);
+
+	list = e_photo_cache_list_photo_sources (photo_cache);
+
+	if (list == NULL) {
+		g_simple_async_result_complete_in_idle (simple);
+		return;
+	}
+
+	g_mutex_lock (&async_context->lock);
+
+	/* Dispatch a subtask for each photo source. */
+	for (link = list; link != NULL; link = g_list_next (link)) {
+		EPhotoSource *photo_source;
+		AsyncSubtask *async_subtask;
+
+		photo_source = E_PHOTO_SOURCE (link->data);
+		async_subtask = async_subtask_new (photo_source, simple);
+
+		g_hash_table_add (
+			async_context->subtasks,
+			async_subtask_ref (async_subtask));
+
+		e_photo_source_get_photo (
+			photo_source, async_context->email_address,
+			async_subtask->cancellable,
+			photo_cache_async_subtask_done_cb,
+			async_subtask_ref (async_subtask));
+
+		async_subtask_unref (async_subtask);
+	}
+
+	g_mutex_unlock (&async_context->lock);
+
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+	/* Check if we were cancelled while dispatching subtasks. */
+	if (g_cancellable_is_cancelled (async_context->cancellable))
+		async_context_cancel_subtasks (async_context);
 }
 
 static void
@@ -726,6 +1202,18 @@ photo_cache_set_property (GObject *object,
 				E_PHOTO_CACHE (object),
 				g_value_get_object (value));
 			return;
+
+		case PROP_DISK_CACHE_DAYS:
+			e_photo_cache_set_disk_cache_days (
+				E_PHOTO_CACHE (object),
+				g_value_get_uint (value));
+			return;
+
+		case PROP_MAX_CACHE_SIZE:
+			e_photo_cache_set_max_cache_size (
+				E_PHOTO_CACHE (object),
+				g_value_get_uint (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -744,6 +1232,20 @@ photo_cache_get_property (GObject *object,
 				e_photo_cache_ref_client_cache (
 				E_PHOTO_CACHE (object)));
 			return;
+
+		case PROP_DISK_CACHE_DAYS:
+			g_value_set_uint (
+				value,
+				e_photo_cache_get_disk_cache_days (
+				E_PHOTO_CACHE (object)));
+			return;
+
+		case PROP_MAX_CACHE_SIZE:
+			g_value_set_uint (
+				value,
+				e_photo_cache_get_max_cache_size (
+				E_PHOTO_CACHE (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -756,6 +1258,11 @@ photo_cache_dispose (GObject *object)
 
 	priv = E_PHOTO_CACHE_GET_PRIVATE (object);
 
+	if (priv->disk_cache_sweep_id > 0) {
+		g_source_remove (priv->disk_cache_sweep_id);
+		priv->disk_cache_sweep_id = 0;
+	}
+
 	g_clear_object (&priv->client_cache);
 
 	photo_ht_remove_all (E_PHOTO_CACHE (object));
@@ -771,6 +1278,10 @@ photo_cache_finalize (GObject *object)
 
 	priv = E_PHOTO_CACHE_GET_PRIVATE (object);
 
+	/* Let the pending disk writes finish. */
+	g_thread_pool_free (priv->disk_cache_pool, FALSE, TRUE);
+	g_free (priv->disk_cache_dir);
+
 	g_main_context_unref (priv->main_context);
 
 	g_hash_table_destroy (priv->photo_ht);
@@ -790,6 +1301,12 @@ photo_cache_constructed (GObject *object)
 	G_OBJECT_CLASS (e_photo_cache_parent_class)->constructed (object);
 
 	e_extensible_load_extensions (E_EXTENSIBLE (object));
+
+	/* Delayed, thus the owner can set the disk-cache-days first. */
+	E_PHOTO_CACHE (object)->priv->disk_cache_sweep_id =
+		e_named_timeout_add_seconds (
+			DISK_CACHE_SWEEP_FIRST_SECONDS,
+			photo_disk_sweep_cb, object);
 }
 
 static void
@@ -822,6 +1339,47 @@ e_photo_cache_class_init (EPhotoCacheClass *class)
 			G_PARAM_READWRITE |
 			G_PARAM_CONSTRUCT_ONLY |
 			G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * EPhotoCache:disk-cache-days:
+	 *
+	 * How many days to keep search results on disk.
+	 * Zero disables the disk cache.
+	 *
+	 * Since: 3.36
+	 **/
+	g_object_class_install_property (
+		object_class,
+		PROP_DISK_CACHE_DAYS,
+		g_param_spec_uint (
+			"disk-cache-days",
+			"Disk Cache Days",
+			"How many days to keep search results on disk",
+			0, G_MAXUINT16,
+			DEFAULT_DISK_CACHE_DAYS,
+			G_PARAM_READWRITE |
+			G_PARAM_EXPLICIT_NOTIFY |
+			G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * EPhotoCache:max-cache-size:
+	 *
+	 * How many email addresses to keep in memory.
+	 *
+	 * Since: 3.36
+	 **/
+	g_object_class_install_property (
+		object_class,
+		PROP_MAX_CACHE_SIZE,
+		g_param_spec_uint (
+			"max-cache-size",
+			"Max Cache Size",
+			"How many email addresses to keep in memory",
+			1, G_MAXUINT,
+			DEFAULT_MAX_CACHE_SIZE,
+			G_PARAM_READWRITE |
+			G_PARAM_EXPLICIT_NOTIFY |
+			G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -845,8 +1403,15 @@ e_photo_cache_init (EPhotoCache *photo_cache)
 	photo_cache->priv = E_PHOTO_CACHE_GET_PRIVATE (photo_cache);
 	photo_cache->priv->main_context = g_main_context_ref_thread_default ();
 	photo_cache->priv->photo_ht = photo_ht;
+	photo_cache->priv->max_cache_size = DEFAULT_MAX_CACHE_SIZE;
 	photo_cache->priv->sources_ht = sources_ht;
 
+	photo_cache->priv->disk_cache_dir = g_build_filename (
+		e_get_user_cache_dir (), "photos", NULL);
+	photo_cache->priv->disk_cache_days = DEFAULT_DISK_CACHE_DAYS;
+	photo_cache->priv->disk_cache_pool = g_thread_pool_new (
+		photo_disk_cache_thread, NULL, 1, FALSE, NULL);
+
 	g_mutex_init (&photo_cache->priv->photo_ht_lock);
 	g_mutex_init (&photo_cache->priv->sources_ht_lock);
 }
@@ -888,6 +1453,108 @@ e_photo_cache_ref_client_cache (EPhotoCache *photo_cache)
 	return g_object_ref (photo_cache->priv->client_cache);
 }
 
+/**
+ * e_photo_cache_get_max_cache_size:
+ * @photo_cache: an #EPhotoCache
+ *
+ * Returns how many email addresses @photo_cache keeps in memory,
+ * regardless of whether the email address has a photo.
+ *
+ * Returns: the maximum number of email addresses kept in memory
+ *
+ * Since: 3.36
+ **/
+guint
+e_photo_cache_get_max_cache_size (EPhotoCache *photo_cache)
+{
+	guint max_cache_size;
+
+	g_return_val_if_fail (E_IS_PHOTO_CACHE (photo_cache), 0);
+
+	g_mutex_lock (&photo_cache->priv->photo_ht_lock);
+	max_cache_size = photo_cache->priv->max_cache_size;
+	g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
+
+	return max_cache_size;
+}
+
+/**
+ * e_photo_cache_set_max_cache_size:
+ * @photo_cache: an #EPhotoCache
+ * @max_cache_size: how many email addresses to keep in memory
+ *
+ * Sets how many email addresses @photo_cache keeps in memory.  When the
+ * limit is reached, the least recently used entries are discarded.
+ *
+ * Since: 3.36
+ **/
+void
+e_photo_cache_set_max_cache_size (EPhotoCache *photo_cache,
+                                  guint max_cache_size)
+{
+	g_return_if_fail (E_IS_PHOTO_CACHE (photo_cache));
+
+	max_cache_size = MAX (max_cache_size, 1);
+
+	g_mutex_lock (&photo_cache->priv->photo_ht_lock);
+
+	if (photo_cache->priv->max_cache_size == max_cache_size) {
+		g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
+		return;
+	}
+
+	photo_cache->priv->max_cache_size = max_cache_size;
+	photo_ht_trim (photo_cache);
+
+	g_mutex_unlock (&photo_cache->priv->photo_ht_lock);
+
+	g_object_notify (G_OBJECT (photo_cache), "max-cache-size");
+}
+
+/**
+ * e_photo_cache_get_disk_cache_days:
+ * @photo_cache: an #EPhotoCache
+ *
+ * Returns how many days @photo_cache keeps search results on disk.
+ * Zero means the disk cache is disabled.
+ *
+ * Returns: how many days search results are kept on disk
+ *
+ * Since: 3.36
+ **/
+guint
+e_photo_cache_get_disk_cache_days (EPhotoCache *photo_cache)
+{
+	g_return_val_if_fail (E_IS_PHOTO_CACHE (photo_cache), 0);
+
+	return (guint) g_atomic_int_get (&photo_cache->priv->disk_cache_days);
+}
+
+/**
+ * e_photo_cache_set_disk_cache_days:
+ * @photo_cache: an #EPhotoCache
+ * @disk_cache_days: how many days to keep search results on disk
+ *
+ * Sets how many days @photo_cache keeps search results on disk.  Older
+ * entries are ignored and removed when found.  Zero disables the disk
+ * cache.
+ *
+ * Since: 3.36
+ **/
+void
+e_photo_cache_set_disk_cache_days (EPhotoCache *photo_cache,
+                                   guint disk_cache_days)
+{
+	g_return_if_fail (E_IS_PHOTO_CACHE (photo_cache));
+
+	if (e_photo_cache_get_disk_cache_days (photo_cache) == disk_cache_days)
+		return;
+
+	g_atomic_int_set (&photo_cache->priv->disk_cache_days, disk_cache_days);
+
+	g_object_notify (G_OBJECT (photo_cache), "disk-cache-days");
+}
+
 /**
  * e_photo_cache_add_photo_source:
  * @photo_cache: an #EPhotoCache
@@ -995,6 +1662,9 @@ e_photo_cache_remove_photo_source (EPhotoCache *photo_cache,
  * @email_address.  Subsequent photo requests for @email_address will yield no
  * input stream.
  *
+ * The entry is also stored on disk, unless the disk cache is disabled with
+ * #EPhotoCache:disk-cache-days.
+ *
  * The entry may be removed without notice however, subject to @photo_cache's
  * internal caching policy.
  **/
@@ -1007,6 +1677,7 @@ e_photo_cache_add_photo (EPhotoCache *photo_cache,
 	g_return_if_fail (email_address != NULL);
 
 	photo_ht_insert (photo_cache, email_address, bytes);
+	photo_disk_store (photo_cache, email_address, bytes);
 }
 
 /**
@@ -1014,7 +1685,8 @@ e_photo_cache_add_photo (EPhotoCache *photo_cache,
  * @photo_cache: an #EPhotoCache
  * @email_address: an email address
  *
- * Removes the cache entry for @email_address, if such an entry exists.
+ * Removes the cache entry for @email_address, if such an entry exists,
+ * both from memory and from disk.
  *
  * Returns: %TRUE if a cache entry was found and removed
  **/
@@ -1025,6 +1697,8 @@ e_photo_cache_remove_photo (EPhotoCache *photo_cache,
 	g_return_val_if_fail (E_IS_PHOTO_CACHE (photo_cache), FALSE);
 	g_return_val_if_fail (email_address != NULL, FALSE);
 
+	photo_disk_remove (photo_cache, email_address);
+
 	return photo_ht_remove (photo_cache, email_address);
 }
 
@@ -1101,7 +1775,6 @@ e_photo_cache_get_photo (EPhotoCache *photo_cache,
 	AsyncContext *async_context;
 	EDataCapture *data_capture;
 	GInputStream *stream = NULL;
-	GList *list, *link;
 
 	g_return_if_fail (E_IS_PHOTO_CACHE (photo_cache));
 	g_return_if_fail (email_address != NULL);
@@ -1116,7 +1789,8 @@ e_photo_cache_get_photo (EPhotoCache *photo_cache,
 		data_capture_closure_new (photo_cache, email_address),
 		(GClosureNotify) data_capture_closure_free, 0);
 
-	async_context = async_context_new (data_capture, cancellable);
+	async_context = async_context_new (
+		photo_cache, email_address, data_capture, cancellable);
 
 	simple = g_simple_async_result_new (
 		G_OBJECT (photo_cache), callback,
@@ -1134,43 +1808,11 @@ e_photo_cache_get_photo (EPhotoCache *photo_cache,
 		goto exit;
 	}
 
-	list = e_photo_cache_list_photo_sources (photo_cache);
-
-	if (list == NULL) {
-		g_simple_async_result_complete_in_idle (simple);
-		goto exit;
-	}
-
-	g_mutex_lock (&async_context->lock);
-
-	/* Dispatch a subtask for each photo source. */
-	for (link = list; link != NULL; link = g_list_next (link)) {
-		EPhotoSource *photo_source;
-		AsyncSubtask *async_subtask;
-
-		photo_source = E_PHOTO_SOURCE (link->data);
-		async_subtask = async_subtask_new (photo_source, simple);
-
-		g_hash_table_add (
-			async_context->subtasks,
-			async_subtask_ref (async_subtask));
-
-		e_photo_source_get_photo (
-			photo_source, email_address,
-			async_subtask->cancellable,
-			photo_cache_async_subtask_done_cb,
-			async_subtask_ref (async_subtask));
-
-		async_subtask_unref (async_subtask);
-	}
-
-	g_mutex_unlock (&async_context->lock);
-
-	g_list_free_full (list, (GDestroyNotify) g_object_unref);
-
-	/* Check if we were cancelled while dispatching subtasks. */
-	if (g_cancellable_is_cancelled (cancellable))
-		async_context_cancel_subtasks (async_context);
+	/* Then check the disk cache, which survives restarts.
+	 * The file is read in the disk cache thread, which asks
+	 * the photo sources when it's not found. */
+	if (!photo_disk_lookup_async (photo_cache, simple))
+		photo_cache_dispatch_subtasks (photo_cache, simple);
 
 exit:
 	g_object_unref (simple);
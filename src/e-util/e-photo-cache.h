@@ -69,6 +69,16 @@ struct _EPhotoCacheClass {
 GType		e_photo_cache_get_type		(void) G_GNUC_CONST;
 EPhotoCache *	e_photo_cache_new		(EClientCache *client_cache);
 EClientCache *	e_photo_cache_ref_client_cache	(EPhotoCache *photo_cache);
+guint		e_photo_cache_get_max_cache_size
+						(EPhotoCache *photo_cache);
+void		e_photo_cache_set_max_cache_size
+						(EPhotoCache *photo_cache,
+						 guint max_cache_size);
+guint		e_photo_cache_get_disk_cache_days
+						(EPhotoCache *photo_cache);
+void		e_photo_cache_set_disk_cache_days
+						(EPhotoCache *photo_cache,
+						 guint disk_cache_days);
 void		e_photo_cache_add_photo_source	(EPhotoCache *photo_cache,
 						 EPhotoSource *photo_source);
 GList *		e_photo_cache_list_photo_sources
@@ -34,9 +34,16 @@
 
 #define MAX_SUGGESTIONS 10
 
+/* Upper bound of remembered check results; the cache is simply
+ * dropped when it grows over this, there is no need for an LRU. */
+#define MAX_CACHED_WORDS 8192
+
 struct _ESpellCheckerPrivate {
 	GHashTable *active_dictionaries;
 	GHashTable *dictionaries_cache;
+
+	GHashTable *words_cache; /* gchar *word ~> GINT_TO_POINTER (recognized) */
+	gint words_cache_generation;
 };
 
 enum {
@@ -68,6 +75,11 @@ static GHashTable *global_language_tags; /* gchar * ~> NULL */
 static EnchantBroker *global_broker;
 G_LOCK_DEFINE_STATIC (global_memory);
 
+/* The EnchantDict's are shared by all checkers, thus a word learned
+ * or ignored through one of them is recognized by all the others too.
+ * Bumping this makes every checker drop its cached results. */
+static volatile gint global_words_generation = 0;
+
 static gboolean
 spell_checker_enchant_dicts_foreach_cb (gpointer key,
                                         gpointer value,
@@ -109,6 +121,7 @@ spell_checker_dispose (GObject *object)
 
 	g_hash_table_remove_all (priv->active_dictionaries);
 	g_hash_table_remove_all (priv->dictionaries_cache);
+	g_hash_table_remove_all (priv->words_cache);
 
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_spell_checker_parent_class)->dispose (object);
@@ -123,6 +136,7 @@ spell_checker_finalize (GObject *object)
 
 	g_hash_table_destroy (priv->active_dictionaries);
 	g_hash_table_destroy (priv->dictionaries_cache);
+	g_hash_table_destroy (priv->words_cache);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_spell_checker_parent_class)->finalize (object);
@@ -184,6 +198,8 @@ e_spell_checker_init (ESpellChecker *checker)
 
 	checker->priv->active_dictionaries = active_dictionaries;
 	checker->priv->dictionaries_cache = dictionaries_cache;
+	checker->priv->words_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	checker->priv->words_cache_generation = g_atomic_int_get (&global_words_generation);
 }
 
 /**
@@ -462,9 +478,11 @@ e_spell_checker_set_language_active (ESpellChecker *checker,
 	if (active && !is_active) {
 		g_object_ref (dictionary);
 		g_hash_table_add (active_dictionaries, dictionary);
+		g_hash_table_remove_all (checker->priv->words_cache);
 		g_object_notify (G_OBJECT (checker), "active-languages");
 	} else if (!active && is_active) {
 		g_hash_table_remove (active_dictionaries, dictionary);
+		g_hash_table_remove_all (checker->priv->words_cache);
 		g_object_notify (G_OBJECT (checker), "active-languages");
 	}
 
@@ -499,6 +517,7 @@ e_spell_checker_set_active_languages (ESpellChecker *checker,
 	}
 
 	g_hash_table_remove_all (checker->priv->active_dictionaries);
+	g_hash_table_remove_all (checker->priv->words_cache);
 	for (ii = 0; languages && languages[ii]; ii++) {
 		e_spell_checker_set_language_active (checker, languages[ii], TRUE);
 	}
@@ -570,15 +589,82 @@ e_spell_checker_count_active_languages (ESpellChecker *checker)
 	return g_hash_table_size (checker->priv->active_dictionaries);
 }
 
+static void
+spell_checker_words_cache_validate (ESpellChecker *checker)
+{
+	gint generation;
+
+	generation = g_atomic_int_get (&global_words_generation);
+
+	if (checker->priv->words_cache_generation != generation ||
+	    g_hash_table_size (checker->priv->words_cache) >= MAX_CACHED_WORDS) {
+		g_hash_table_remove_all (checker->priv->words_cache);
+		checker->priv->words_cache_generation = generation;
+	}
+}
+
+/* Resolves the EnchantDict of each active dictionary only once,
+ * instead of once per checked word. */
+static GPtrArray *
+spell_checker_dup_active_enchant_dicts (ESpellChecker *checker)
+{
+	GHashTableIter iter;
+	GPtrArray *enchant_dicts;
+	gpointer key;
+
+	enchant_dicts = g_ptr_array_sized_new (g_hash_table_size (checker->priv->active_dictionaries));
+
+	g_hash_table_iter_init (&iter, checker->priv->active_dictionaries);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		EnchantDict *enchant_dict;
+
+		enchant_dict = e_spell_checker_get_enchant_dict (checker,
+			e_spell_dictionary_get_code (E_SPELL_DICTIONARY (key)));
+
+		if (enchant_dict)
+			g_ptr_array_add (enchant_dicts, enchant_dict);
+	}
+
+	return enchant_dicts;
+}
+
+/* Expects the words cache to be validated by the caller;
+ * the @enchant_dicts are those of the active dictionaries. */
+static gboolean
+spell_checker_check_word_cached (ESpellChecker *checker,
+				 GPtrArray *enchant_dicts,
+				 const gchar *word)
+{
+	gpointer value = NULL;
+	gboolean recognized = FALSE;
+	guint ii;
+
+	if (g_hash_table_lookup_extended (checker->priv->words_cache, word, NULL, &value))
+		return GPOINTER_TO_INT (value);
+
+	for (ii = 0; ii < enchant_dicts->len && !recognized; ii++) {
+		recognized = enchant_dict_check (g_ptr_array_index (enchant_dicts, ii), word, -1) == 0;
+	}
+
+	g_hash_table_insert (checker->priv->words_cache, g_strdup (word), GINT_TO_POINTER (recognized));
+
+	return recognized;
+}
+
 /**
  * e_spell_checker_check_word:
  * @checker: an #SpellChecker
  * @word: a word to spell-check
  * @length: length of @word in bytes or -1 when %NULL-terminated
  *
- * Calls e_spell_dictionary_check_word() on all active dictionaries in
+ * Checks @word with the Enchant dictionaries of all active languages in
  * @checker, and returns %TRUE if @word is recognized by any of them.
  *
+ * The result is looked up in and stored into a word cache of the @checker,
+ * which is invalidated when the active languages change or a word is learned
+ * or ignored in any dictionary.  The cache is bounded; it is dropped as a whole
+ * when it grows too large.
+ *
  * Returns: %TRUE if @word is recognized, %FALSE otherwise
  **/
 gboolean
@@ -586,27 +672,106 @@ e_spell_checker_check_word (ESpellChecker *checker,
                             const gchar *word,
                             gsize length)
 {
-	GList *list, *link;
-	gboolean recognized = FALSE;
+	GPtrArray *enchant_dicts;
+	gchar *tmp = NULL;
+	gboolean recognized;
 
 	g_return_val_if_fail (E_IS_SPELL_CHECKER (checker), TRUE);
 	g_return_val_if_fail (word != NULL && *word != '\0', TRUE);
 
-	list = g_hash_table_get_keys (checker->priv->active_dictionaries);
+	if (length != (gsize) -1 && word[length] != '\0') {
+		tmp = g_strndup (word, length);
+		word = tmp;
+	}
 
-	for (link = list; link != NULL; link = g_list_next (link)) {
-		ESpellDictionary *dictionary;
+	spell_checker_words_cache_validate (checker);
 
-		dictionary = E_SPELL_DICTIONARY (link->data);
-		if (e_spell_dictionary_check_word (dictionary, word, length)) {
-			recognized = TRUE;
-			break;
+	enchant_dicts = spell_checker_dup_active_enchant_dicts (checker);
+
+	recognized = spell_checker_check_word_cached (checker, enchant_dicts, word);
+
+	g_ptr_array_unref (enchant_dicts);
+	g_free (tmp);
+
+	return recognized;
+}
+
+/**
+ * e_spell_checker_check_words:
+ * @checker: an #ESpellChecker
+ * @words: a %NULL-terminated array of words to spell-check
+ * @out_recognized: (array): return location for the results; it should
+ *    have space for as many items as there are words in @words
+ *
+ * Checks all the @words in one call, which is cheaper than calling
+ * e_spell_checker_check_word() for each of them, like when checking
+ * a whole paragraph. The n-th item of @out_recognized is set to %TRUE
+ * if the n-th word is recognized by any of the active dictionaries.
+ * Empty words are considered recognized.
+ *
+ * Returns: how many words from @words had not been recognized
+ *
+ * Since: 3.36
+ **/
+guint
+e_spell_checker_check_words (ESpellChecker *checker,
+			     const gchar * const *words,
+			     gboolean *out_recognized)
+{
+	GPtrArray *enchant_dicts;
+	guint ii, n_misspelled = 0;
+
+	g_return_val_if_fail (E_IS_SPELL_CHECKER (checker), 0);
+	g_return_val_if_fail (words != NULL, 0);
+	g_return_val_if_fail (out_recognized != NULL, 0);
+
+	spell_checker_words_cache_validate (checker);
+
+	enchant_dicts = spell_checker_dup_active_enchant_dicts (checker);
+
+	for (ii = 0; words[ii]; ii++) {
+		if (!*words[ii]) {
+			out_recognized[ii] = TRUE;
+			continue;
 		}
+
+		/* The cache can fill up in the middle of a long paragraph */
+		if (g_hash_table_size (checker->priv->words_cache) >= MAX_CACHED_WORDS)
+			g_hash_table_remove_all (checker->priv->words_cache);
+
+		out_recognized[ii] = spell_checker_check_word_cached (checker, enchant_dicts, words[ii]);
+
+		if (!out_recognized[ii])
+			n_misspelled++;
 	}
 
-	g_list_free (list);
+	g_ptr_array_unref (enchant_dicts);
 
-	return recognized;
+	return n_misspelled;
+}
+
+/**
+ * e_spell_checker_invalidate_words_cache:
+ * @checker: an #ESpellChecker
+ *
+ * Forgets results of the previous spell checks. This is done
+ * automatically when a word is learned or ignored through the @checker
+ * or through any of its dictionaries and when the active languages
+ * change, thus it is needed only when the underlying dictionaries
+ * are modified behind the @checker's back.
+ *
+ * As the dictionaries are shared between all the checkers, the results
+ * are dropped by all of them, not only by the @checker.
+ *
+ * Since: 3.36
+ **/
+void
+e_spell_checker_invalidate_words_cache (ESpellChecker *checker)
+{
+	g_return_if_fail (E_IS_SPELL_CHECKER (checker));
+
+	g_atomic_int_inc (&global_words_generation);
+	g_hash_table_remove_all (checker->priv->words_cache);
 }
 
 /**
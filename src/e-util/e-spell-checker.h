@@ -93,6 +93,11 @@ guint		e_spell_checker_count_active_languages
 gboolean	e_spell_checker_check_word	(ESpellChecker *checker,
 						 const gchar *word,
 						 gsize length);
+guint		e_spell_checker_check_words	(ESpellChecker *checker,
+						 const gchar * const *words,
+						 gboolean *out_recognized);
+void		e_spell_checker_invalidate_words_cache
+						(ESpellChecker *checker);
 void		e_spell_checker_learn_word	(ESpellChecker *checker,
 						 const gchar *word);
 void		e_spell_checker_ignore_word	(ESpellChecker *checker,
@@ -426,6 +426,7 @@ e_spell_dictionary_learn_word (ESpellDictionary *dictionary,
 	g_return_if_fail (enchant_dict != NULL);
 
 	enchant_dict_add (enchant_dict, word, length);
+	e_spell_checker_invalidate_words_cache (spell_checker);
 
 	g_object_unref (spell_checker);
 }
@@ -459,6 +460,7 @@ e_spell_dictionary_ignore_word (ESpellDictionary *dictionary,
 	g_return_if_fail (enchant_dict != NULL);
 
 	enchant_dict_add_to_session (enchant_dict, word, length);
+	e_spell_checker_invalidate_words_cache (spell_checker);
 
 	g_object_unref (spell_checker);
 }
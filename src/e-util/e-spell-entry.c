@@ -109,43 +109,13 @@ insert_underline (ESpellEntry *entry,
 	pango_attr_list_insert (entry->priv->attr_list, unline);
 }
 
-static void
-check_word (ESpellEntry *entry,
-            gint start,
-            gint end)
-{
-	PangoAttrIterator *it;
-
-	/* Check to see if we've got any attributes at this position.
-	 * If so, free them, since we'll read it if the word is misspelled */
-	it = pango_attr_list_get_iterator (entry->priv->attr_list);
-
-	if (it == NULL)
-		return;
-	do {
-		gint s, e;
-		pango_attr_iterator_range (it, &s, &e);
-		if (s == start) {
-			/* XXX What does this do? */
-			GSList *attrs = pango_attr_iterator_get_attrs (it);
-			g_slist_free_full (
-				attrs, (GDestroyNotify)
-				pango_attribute_destroy);
-		}
-	} while (pango_attr_iterator_next (it));
-	pango_attr_iterator_destroy (it);
-
-	if (word_misspelled (entry, start, end))
-		insert_underline (entry, start, end);
-}
-
 static void
 spell_entry_recheck_all (ESpellEntry *entry)
 {
 	GtkWidget *widget = GTK_WIDGET (entry);
+	ESpellChecker *spell_checker = NULL;
 	PangoLayout *layout;
-	gint length, i;
-	gboolean check_words = FALSE;
+	gint i;
 
 	if (entry->priv->words == NULL)
 		return;
@@ -156,25 +126,31 @@ spell_entry_recheck_all (ESpellEntry *entry)
 	entry->priv->attr_list = pango_attr_list_new ();
 
 	if (e_spell_entry_get_checking_enabled (entry)) {
-		ESpellChecker *spell_checker;
-
 		spell_checker = e_spell_entry_get_spell_checker (entry);
-		if (e_spell_checker_count_active_languages (spell_checker) > 0)
-			check_words = TRUE;
+		if (e_spell_checker_count_active_languages (spell_checker) == 0)
+			spell_checker = NULL;
 	}
 
-	if (check_words) {
-		/* Loop through words */
-		for (i = 0; entry->priv->words[i]; i++) {
-			length = strlen (entry->priv->words[i]);
-			if (length == 0)
-				continue;
-			check_word (
-				entry,
-				entry->priv->word_starts[i],
-				entry->priv->word_ends[i]);
+	if (spell_checker) {
+		gboolean *recognized;
+
+		recognized = g_new0 (gboolean, g_strv_length (entry->priv->words) + 1);
+
+		/* Check all words at once; the attribute list is empty,
+		 * thus the misspelled ones can be underlined directly */
+		if (e_spell_checker_check_words (spell_checker, (const gchar * const *) entry->priv->words, recognized) > 0) {
+			for (i = 0; entry->priv->words[i]; i++) {
+				if (!recognized[i]) {
+					insert_underline (
+						entry,
+						entry->priv->word_starts[i],
+						entry->priv->word_ends[i]);
+				}
+			}
 		}
 
+		g_free (recognized);
+
 		layout = gtk_entry_get_layout (GTK_ENTRY (entry));
 		pango_layout_set_attributes (layout, entry->priv->attr_list);
 	}
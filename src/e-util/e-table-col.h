@@ -31,6 +31,7 @@
 
 #include <e-util/e-cell.h>
 #include <e-util/e-table-column-specification.h>
+#include <e-util/e-util-enums.h>
 
 /* Standard GObject macros */
 #define E_TYPE_TABLE_COL \
@@ -79,6 +80,7 @@ struct _ETableCol {
 	gshort x;
 	GCompareDataFunc compare;
 	ETableSearchFunc search;
+	ETableSortKey sort_key;
 
 	gboolean selected;
 
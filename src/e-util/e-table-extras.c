@@ -46,6 +46,7 @@
 struct _ETableExtrasPrivate {
 	GHashTable *cells;
 	GHashTable *compares;
+	GHashTable *sort_keys;
 	GHashTable *icon_names;
 	GHashTable *searches;
 };
@@ -72,6 +73,11 @@ ete_finalize (GObject *object)
 		priv->compares = NULL;
 	}
 
+	if (priv->sort_keys) {
+		g_hash_table_destroy (priv->sort_keys);
+		priv->sort_keys = NULL;
+	}
+
 	if (priv->searches) {
 		g_hash_table_destroy (priv->searches);
 		priv->searches = NULL;
@@ -263,6 +269,11 @@ e_table_extras_init (ETableExtras *extras)
 		(GDestroyNotify) g_free,
 		(GDestroyNotify) NULL);
 
+	extras->priv->sort_keys = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
 	extras->priv->icon_names = g_hash_table_new_full (
 		g_str_hash, g_str_equal,
 		(GDestroyNotify) g_free,
@@ -292,6 +303,13 @@ e_table_extras_init (ETableExtras *extras)
 		extras, "pointer-integer64",
 		(GCompareDataFunc) e_int64ptr_compare);
 
+	e_table_extras_set_sort_key (extras, "string", E_TABLE_SORT_KEY_STRING);
+	e_table_extras_set_sort_key (extras, "stringcase", E_TABLE_SORT_KEY_COLLATE_CASE);
+	e_table_extras_set_sort_key (extras, "collate", E_TABLE_SORT_KEY_COLLATE);
+	e_table_extras_set_sort_key (extras, "integer", E_TABLE_SORT_KEY_INT);
+	e_table_extras_set_sort_key (extras, "string-integer", E_TABLE_SORT_KEY_STRING_INT);
+	e_table_extras_set_sort_key (extras, "pointer-integer64", E_TABLE_SORT_KEY_INT64_PTR);
+
 	e_table_extras_add_search (extras, "string", e_string_search);
 
 	cell = e_cell_checkbox_new ();
@@ -370,6 +388,9 @@ e_table_extras_add_compare (ETableExtras *extras,
 	g_hash_table_insert (
 		extras->priv->compares,
 		g_strdup (id), (gpointer) compare);
+
+	/* The new function can expect different values. */
+	g_hash_table_remove (extras->priv->sort_keys, id);
 }
 
 GCompareDataFunc
@@ -382,6 +403,56 @@ e_table_extras_get_compare (ETableExtras *extras,
 	return g_hash_table_lookup (extras->priv->compares, id);
 }
 
+/**
+ * e_table_extras_set_sort_key:
+ * @extras: an #ETableExtras
+ * @id: a compare function ID
+ * @sort_key: an #ETableSortKey
+ *
+ * Declares what values the compare function registered under @id
+ * expects, thus the sorting can precompute sort keys for the columns
+ * using it. The compare function should be added first, because
+ * e_table_extras_add_compare() resets the sort key to
+ * %E_TABLE_SORT_KEY_NONE.
+ *
+ * Since: 3.36
+ **/
+void
+e_table_extras_set_sort_key (ETableExtras *extras,
+                             const gchar *id,
+                             ETableSortKey sort_key)
+{
+	g_return_if_fail (E_IS_TABLE_EXTRAS (extras));
+	g_return_if_fail (id != NULL);
+
+	if (sort_key == E_TABLE_SORT_KEY_NONE)
+		g_hash_table_remove (extras->priv->sort_keys, id);
+	else
+		g_hash_table_insert (
+			extras->priv->sort_keys,
+			g_strdup (id), GINT_TO_POINTER (sort_key));
+}
+
+/**
+ * e_table_extras_get_sort_key:
+ * @extras: an #ETableExtras
+ * @id: a compare function ID
+ *
+ * Returns: an #ETableSortKey for the compare function registered
+ *    under @id, as set by e_table_extras_set_sort_key()
+ *
+ * Since: 3.36
+ **/
+ETableSortKey
+e_table_extras_get_sort_key (ETableExtras *extras,
+                             const gchar *id)
+{
+	g_return_val_if_fail (E_IS_TABLE_EXTRAS (extras), E_TABLE_SORT_KEY_NONE);
+	g_return_val_if_fail (id != NULL, E_TABLE_SORT_KEY_NONE);
+
+	return GPOINTER_TO_INT (g_hash_table_lookup (extras->priv->sort_keys, id));
+}
+
 void
 e_table_extras_add_search (ETableExtras *extras,
                            const gchar *id,
@@ -29,6 +29,7 @@
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <e-util/e-cell.h>
+#include <e-util/e-util-enums.h>
 
 /* Standard GObject macros */
 #define E_TYPE_TABLE_EXTRAS \
@@ -77,6 +78,11 @@ void		e_table_extras_add_compare	(ETableExtras *extras,
 GCompareDataFunc
 		e_table_extras_get_compare	(ETableExtras *extras,
 						 const gchar *id);
+void		e_table_extras_set_sort_key	(ETableExtras *extras,
+						 const gchar *id,
+						 ETableSortKey sort_key);
+ETableSortKey	e_table_extras_get_sort_key	(ETableExtras *extras,
+						 const gchar *id);
 void		e_table_extras_add_search	(ETableExtras *extras,
 						 const gchar *id,
 						 ETableSearchFunc search);
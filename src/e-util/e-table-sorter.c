@@ -43,54 +43,6 @@ G_DEFINE_TYPE_WITH_CODE (
 		E_TYPE_SORTER,
 		e_table_sorter_interface_init))
 
-struct qsort_data {
-	ETableSorter *table_sorter;
-	gpointer *vals;
-	gint cols;
-	gint *ascending;
-	GCompareDataFunc *compare;
-	gpointer cmp_cache;
-};
-
-/* FIXME: Make it not cache the second and later columns (as if anyone cares.) */
-
-static gint
-qsort_callback (gconstpointer data1,
-                gconstpointer data2,
-                gpointer user_data)
-{
-	struct qsort_data *qd = (struct qsort_data *) user_data;
-	gint row1 = *(gint *) data1;
-	gint row2 = *(gint *) data2;
-	gint j;
-	gint sort_count;
-	gint comp_val = 0;
-	gint ascending = 1;
-
-	sort_count =
-		e_table_sort_info_sorting_get_count (
-			qd->table_sorter->sort_info) +
-		e_table_sort_info_grouping_get_count (
-			qd->table_sorter->sort_info);
-
-	for (j = 0; j < sort_count; j++) {
-		comp_val = (*(qd->compare[j]))(qd->vals[qd->cols * row1 + j], qd->vals[qd->cols * row2 + j], qd->cmp_cache);
-		ascending = qd->ascending[j];
-		if (comp_val != 0)
-			break;
-	}
-	if (comp_val == 0) {
-		if (row1 < row2)
-			comp_val = -1;
-		if (row1 > row2)
-			comp_val = 1;
-	}
-	if (!ascending)
-		comp_val = -comp_val;
-
-	return comp_val;
-}
-
 static void
 table_sorter_clean (ETableSorter *table_sorter)
 {
@@ -111,7 +63,9 @@ table_sorter_sort (ETableSorter *table_sorter)
 	gint j;
 	gint cols;
 	gint group_cols;
-	struct qsort_data qd;
+	gpointer *vals;
+	gpointer cmp_cache;
+	ETableSortKeys *sort_keys;
 
 	if (table_sorter->sorted)
 		return;
@@ -124,13 +78,9 @@ table_sorter_sort (ETableSorter *table_sorter)
 	for (i = 0; i < rows; i++)
 		table_sorter->sorted[i] = i;
 
-	qd.cols = cols;
-	qd.table_sorter = table_sorter;
-
-	qd.vals = g_new (gpointer , rows * cols);
-	qd.ascending = g_new (int, cols);
-	qd.compare = g_new (GCompareDataFunc, cols);
-	qd.cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	vals = g_new (gpointer , rows * cols);
+	cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	sort_keys = e_table_sort_keys_new (rows, cols, cmp_cache);
 
 	for (j = 0; j < cols; j++) {
 		ETableColumnSpecification *spec;
@@ -155,17 +105,17 @@ table_sorter_sort (ETableSorter *table_sorter)
 				table_sorter->full_header, last);
 		}
 
+		e_table_sort_keys_set_column (sort_keys, j, col, sort_type);
+
 		for (i = 0; i < rows; i++) {
-			qd.vals[i * cols + j] = e_table_model_value_at (
+			vals[i * cols + j] = e_table_model_value_at (
 				table_sorter->source,
 				col->spec->model_col, i);
+			e_table_sort_keys_set_value (sort_keys, j, i, vals[i * cols + j]);
 		}
-
-		qd.compare[j] = col->compare;
-		qd.ascending[j] = (sort_type == GTK_SORT_ASCENDING);
 	}
 
-	g_qsort_with_data (table_sorter->sorted, rows, sizeof (gint), qsort_callback, &qd);
+	e_table_sort_keys_sort (sort_keys, table_sorter->sorted, rows);
 
 	for (j = 0; j < cols; j++) {
 		ETableColumnSpecification *spec;
@@ -191,14 +141,13 @@ table_sorter_sort (ETableSorter *table_sorter)
 		}
 
 		for (i = 0; i < rows; i++) {
-			e_table_model_free_value (table_sorter->source, col->spec->model_col, qd.vals[i * cols + j]);
+			e_table_model_free_value (table_sorter->source, col->spec->model_col, vals[i * cols + j]);
 		}
 	}
 
-	g_free (qd.vals);
-	g_free (qd.ascending);
-	g_free (qd.compare);
-	e_table_sorting_utils_free_cmp_cache (qd.cmp_cache);
+	e_table_sort_keys_free (sort_keys);
+	e_table_sorting_utils_free_cmp_cache (cmp_cache);
+	g_free (vals);
 }
 
 static void
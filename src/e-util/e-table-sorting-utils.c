@@ -23,6 +23,7 @@
 
 #include "e-table-sorting-utils.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <camel/camel.h>
 
@@ -83,14 +84,6 @@ etsu_compare (ETableModel *source,
 	return comp_val;
 }
 
-typedef struct {
-	gint cols;
-	gpointer *vals;
-	GtkSortType *sort_type;
-	GCompareDataFunc *compare;
-	gpointer cmp_cache;
-} ETableSortClosure;
-
 typedef struct {
 	ETreeModel *tree;
 	ETableSortInfo *sort_info;
@@ -98,43 +91,6 @@ typedef struct {
 	gpointer cmp_cache;
 } ETreeSortClosure;
 
-/* FIXME: Make it not cache the second and later columns (as if anyone cares.) */
-
-static gint
-e_sort_callback (gconstpointer data1,
-                 gconstpointer data2,
-                 gpointer user_data)
-{
-	gint row1 = *(gint *) data1;
-	gint row2 = *(gint *) data2;
-	ETableSortClosure *closure = user_data;
-	gint j;
-	gint sort_count = closure->cols;
-	gint comp_val = 0;
-	GtkSortType sort_type = GTK_SORT_ASCENDING;
-
-	for (j = 0; j < sort_count; j++) {
-		comp_val = (*(closure->compare[j])) (
-			closure->vals[closure->cols * row1 + j],
-			closure->vals[closure->cols * row2 + j],
-			closure->cmp_cache);
-		sort_type = closure->sort_type[j];
-		if (comp_val != 0)
-			break;
-	}
-	if (comp_val == 0) {
-		if (row1 < row2)
-			comp_val = -1;
-		if (row1 > row2)
-			comp_val = 1;
-	}
-
-	if (sort_type == GTK_SORT_DESCENDING)
-		comp_val = -comp_val;
-
-	return comp_val;
-}
-
 void
 e_table_sorting_utils_sort (ETableModel *source,
                             ETableSortInfo *sort_info,
@@ -142,11 +98,13 @@ e_table_sorting_utils_sort (ETableModel *source,
                             gint *map_table,
                             gint rows)
 {
+	ETableSortKeys *sort_keys;
+	gpointer cmp_cache;
+	gpointer *vals;
 	gint total_rows;
 	gint i;
 	gint j;
 	gint cols;
-	ETableSortClosure closure;
 
 	g_return_if_fail (E_IS_TABLE_MODEL (source));
 	g_return_if_fail (E_IS_TABLE_SORT_INFO (sort_info));
@@ -154,19 +112,18 @@ e_table_sorting_utils_sort (ETableModel *source,
 
 	total_rows = e_table_model_row_count (source);
 	cols = e_table_sort_info_sorting_get_count (sort_info);
-	closure.cols = cols;
 
-	closure.vals = g_new (gpointer, total_rows * cols);
-	closure.sort_type = g_new (GtkSortType, cols);
-	closure.compare = g_new (GCompareDataFunc, cols);
-	closure.cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	vals = g_new (gpointer, total_rows * cols);
+	cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	sort_keys = e_table_sort_keys_new (total_rows, cols, cmp_cache);
 
 	for (j = 0; j < cols; j++) {
 		ETableColumnSpecification *spec;
 		ETableCol *col;
+		GtkSortType sort_type;
 
 		spec = e_table_sort_info_sorting_get_nth (
-			sort_info, j, &closure.sort_type[j]);
+			sort_info, j, &sort_type);
 
 		col = e_table_header_get_column_by_spec (full_header, spec);
 		if (col == NULL) {
@@ -174,21 +131,22 @@ e_table_sorting_utils_sort (ETableModel *source,
 			col = e_table_header_get_column (full_header, last);
 		}
 
+		e_table_sort_keys_set_column (sort_keys, j, col, sort_type);
+
 		for (i = 0; i < rows; i++) {
-			closure.vals[map_table[i] * cols + j] = e_table_model_value_at (source, col->spec->compare_col, map_table[i]);
+			vals[map_table[i] * cols + j] = e_table_model_value_at (source, col->spec->compare_col, map_table[i]);
+			e_table_sort_keys_set_value (sort_keys, j, map_table[i], vals[map_table[i] * cols + j]);
 		}
-		closure.compare[j] = col->compare;
 	}
 
-	g_qsort_with_data (
-		map_table, rows, sizeof (gint), e_sort_callback, &closure);
+	e_table_sort_keys_sort (sort_keys, map_table, rows);
 
 	for (j = 0; j < cols; j++) {
 		ETableColumnSpecification *spec;
 		ETableCol *col;
 
 		spec = e_table_sort_info_sorting_get_nth (
-			sort_info, j, &closure.sort_type[j]);
+			sort_info, j, NULL);
 
 		col = e_table_header_get_column_by_spec (full_header, spec);
 		if (col == NULL) {
@@ -197,14 +155,13 @@ e_table_sorting_utils_sort (ETableModel *source,
 		}
 
 		for (i = 0; i < rows; i++) {
-			e_table_model_free_value (source, col->spec->compare_col, closure.vals[map_table[i] * cols + j]);
+			e_table_model_free_value (source, col->spec->compare_col, vals[map_table[i] * cols + j]);
 		}
 	}
 
-	g_free (closure.vals);
-	g_free (closure.sort_type);
-	g_free (closure.compare);
-	e_table_sorting_utils_free_cmp_cache (closure.cmp_cache);
+	e_table_sort_keys_free (sort_keys);
+	e_table_sorting_utils_free_cmp_cache (cmp_cache);
+	g_free (vals);
 }
 
 gboolean
@@ -357,7 +314,9 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
                                  ETreePath *map_table,
                                  gint count)
 {
-	ETableSortClosure closure;
+	ETableSortKeys *sort_keys;
+	gpointer cmp_cache;
+	gpointer *vals;
 	gint cols;
 	gint i, j;
 	gint *map;
@@ -368,19 +327,18 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
 	g_return_if_fail (E_IS_TABLE_HEADER (full_header));
 
 	cols = e_table_sort_info_sorting_get_count (sort_info);
-	closure.cols = cols;
 
-	closure.vals = g_new (gpointer , count * cols);
-	closure.sort_type = g_new (GtkSortType, cols);
-	closure.compare = g_new (GCompareDataFunc, cols);
-	closure.cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	vals = g_new (gpointer , count * cols);
+	cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	sort_keys = e_table_sort_keys_new (count, cols, cmp_cache);
 
 	for (j = 0; j < cols; j++) {
 		ETableColumnSpecification *spec;
 		ETableCol *col;
+		GtkSortType sort_type;
 
 		spec = e_table_sort_info_sorting_get_nth (
-			sort_info, j, &closure.sort_type[j]);
+			sort_info, j, &sort_type);
 
 		col = e_table_header_get_column_by_spec (full_header, spec);
 		if (col == NULL) {
@@ -388,10 +346,12 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
 			col = e_table_header_get_column (full_header, last);
 		}
 
+		e_table_sort_keys_set_column (sort_keys, j, col, sort_type);
+
 		for (i = 0; i < count; i++) {
-			closure.vals[i * cols + j] = e_tree_model_sort_value_at (source, map_table[i], col->spec->compare_col);
+			vals[i * cols + j] = e_tree_model_sort_value_at (source, map_table[i], col->spec->compare_col);
+			e_table_sort_keys_set_value (sort_keys, j, i, vals[i * cols + j]);
 		}
-		closure.compare[j] = col->compare;
 	}
 
 	map = g_new (int, count);
@@ -399,8 +359,7 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
 		map[i] = i;
 	}
 
-	g_qsort_with_data (
-		map, count, sizeof (gint), e_sort_callback, &closure);
+	e_table_sort_keys_sort (sort_keys, map, count);
 
 	map_copy = g_new (ETreePath, count);
 	for (i = 0; i < count; i++) {
@@ -415,7 +374,7 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
 		ETableCol *col;
 
 		spec = e_table_sort_info_sorting_get_nth (
-			sort_info, j, &closure.sort_type[j]);
+			sort_info, j, NULL);
 
 		col = e_table_header_get_column_by_spec (full_header, spec);
 		if (col == NULL) {
@@ -424,17 +383,16 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
 		}
 
 		for (i = 0; i < count; i++) {
-			e_tree_model_free_value (source, col->spec->compare_col, closure.vals[i * cols + j]);
+			e_tree_model_free_value (source, col->spec->compare_col, vals[i * cols + j]);
 		}
 	}
 
 	g_free (map);
 	g_free (map_copy);
 
-	g_free (closure.vals);
-	g_free (closure.sort_type);
-	g_free (closure.compare);
-	e_table_sorting_utils_free_cmp_cache (closure.cmp_cache);
+	e_table_sort_keys_free (sort_keys);
+	e_table_sorting_utils_free_cmp_cache (cmp_cache);
+	g_free (vals);
 }
 
 /* FIXME: This could be done in time log n instead of time n with a binary search. */
@@ -572,3 +530,601 @@ e_table_sorting_utils_lookup_cmp_cache (gpointer cmp_cache,
 
 	return g_hash_table_lookup (cmp_cache, key);
 }
+
+typedef struct _ETableSortKeysColumn {
+	ETableSortKey sort_key;
+	GtkSortType sort_type;
+	GCompareDataFunc compare;
+
+	gpointer *values;	/* E_TABLE_SORT_KEY_NONE */
+	gint64 *ints;		/* integer sort keys */
+	guint8 *unset;		/* E_TABLE_SORT_KEY_INT64_PTR */
+	const gchar **strings;	/* string sort keys */
+	GHashTable *collate_keys; /* gchar *value ~> gchar *collate key */
+} ETableSortKeysColumn;
+
+struct _ETableSortKeys {
+	gint n_rows;
+	gint n_cols;
+	ETableSortKeysColumn *cols;
+	gpointer cmp_cache;
+};
+
+/**
+ * e_table_sort_keys_new:
+ * @n_rows: how many rows will be sorted
+ * @n_cols: how many columns the rows are sorted by
+ * @cmp_cache: (nullable): a compare cache, as created by
+ *    e_table_sorting_utils_create_cmp_cache(), or %NULL
+ *
+ * Creates a new #ETableSortKeys, which holds sort keys for @n_rows rows
+ * in @n_cols columns. Each column should be set up with
+ * e_table_sort_keys_set_column() and then filled with values for
+ * the rows with e_table_sort_keys_set_value().
+ *
+ * The values of columns with a known #ETableSortKey are converted into
+ * typed sort keys once per row, thus sorting does not call the column's
+ * compare function, nor it looks up collation keys in the @cmp_cache,
+ * for every comparison.
+ *
+ * Returns: (transfer full): a new #ETableSortKeys; free it with
+ *    e_table_sort_keys_free(), when no longer needed
+ *
+ * Since: 3.36
+ **/
+ETableSortKeys *
+e_table_sort_keys_new (gint n_rows,
+                       gint n_cols,
+                       gpointer cmp_cache)
+{
+	ETableSortKeys *sort_keys;
+
+	g_return_val_if_fail (n_rows >= 0, NULL);
+	g_return_val_if_fail (n_cols >= 0, NULL);
+
+	sort_keys = g_slice_new0 (ETableSortKeys);
+	sort_keys->n_rows = n_rows;
+	sort_keys->n_cols = n_cols;
+	sort_keys->cols = g_new0 (ETableSortKeysColumn, n_cols);
+	sort_keys->cmp_cache = cmp_cache;
+
+	return sort_keys;
+}
+
+/**
+ * e_table_sort_keys_free:
+ * @sort_keys: (nullable): an #ETableSortKeys
+ *
+ * Frees the @sort_keys, previously created with e_table_sort_keys_new().
+ *
+ * Since: 3.36
+ **/
+void
+e_table_sort_keys_free (ETableSortKeys *sort_keys)
+{
+	gint ii;
+
+	if (!sort_keys)
+		return;
+
+	for (ii = 0; ii < sort_keys->n_cols; ii++) {
+		ETableSortKeysColumn *column = &sort_keys->cols[ii];
+
+		g_free (column->values);
+		g_free (column->ints);
+		g_free (column->unset);
+		g_free (column->strings);
+
+		if (column->collate_keys)
+			g_hash_table_destroy (column->collate_keys);
+	}
+
+	g_free (sort_keys->cols);
+	g_slice_free (ETableSortKeys, sort_keys);
+}
+
+/**
+ * e_table_sort_keys_set_column:
+ * @sort_keys: an #ETableSortKeys
+ * @col: index of the sort column
+ * @table_col: an #ETableCol the @col is sorted by
+ * @sort_type: a #GtkSortType
+ *
+ * Sets up the sort column @col to compare values of the @table_col.
+ *
+ * Since: 3.36
+ **/
+void
+e_table_sort_keys_set_column (ETableSortKeys *sort_keys,
+                              gint col,
+                              ETableCol *table_col,
+                              GtkSortType sort_type)
+{
+	ETableSortKeysColumn *column;
+
+	g_return_if_fail (sort_keys != NULL);
+	g_return_if_fail (col >= 0 && col < sort_keys->n_cols);
+	g_return_if_fail (E_IS_TABLE_COL (table_col));
+
+	column = &sort_keys->cols[col];
+
+	g_return_if_fail (column->values == NULL && column->ints == NULL && column->strings == NULL);
+
+	column->sort_key = table_col->sort_key;
+	column->sort_type = sort_type;
+	column->compare = table_col->compare;
+
+	switch (column->sort_key) {
+	case E_TABLE_SORT_KEY_INT64_PTR:
+		column->unset = g_new0 (guint8, sort_keys->n_rows);
+		column->ints = g_new0 (gint64, sort_keys->n_rows);
+		break;
+	case E_TABLE_SORT_KEY_INT:
+	case E_TABLE_SORT_KEY_STRING_INT:
+		column->ints = g_new0 (gint64, sort_keys->n_rows);
+		break;
+	case E_TABLE_SORT_KEY_COLLATE:
+	case E_TABLE_SORT_KEY_COLLATE_CASE:
+		column->collate_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		column->strings = g_new0 (const gchar *, sort_keys->n_rows);
+		break;
+	case E_TABLE_SORT_KEY_STRING:
+		column->strings = g_new0 (const gchar *, sort_keys->n_rows);
+		break;
+	case E_TABLE_SORT_KEY_NONE:
+	default:
+		column->sort_key = E_TABLE_SORT_KEY_NONE;
+		column->values = g_new0 (gpointer, sort_keys->n_rows);
+		break;
+	}
+}
+
+/**
+ * e_table_sort_keys_set_value:
+ * @sort_keys: an #ETableSortKeys
+ * @col: index of the sort column
+ * @row: index of the row
+ * @value: the row value in the @col
+ *
+ * Sets the @value of the @row in the sort column @col. The @value is
+ * not copied, it should be valid until the rows are sorted with
+ * e_table_sort_keys_sort().
+ *
+ * Since: 3.36
+ **/
+void
+e_table_sort_keys_set_value (ETableSortKeys *sort_keys,
+                             gint col,
+                             gint row,
+                             gconstpointer value)
+{
+	ETableSortKeysColumn *column;
+
+	g_return_if_fail (sort_keys != NULL);
+	g_return_if_fail (col >= 0 && col < sort_keys->n_cols);
+	g_return_if_fail (row >= 0 && row < sort_keys->n_rows);
+
+	column = &sort_keys->cols[col];
+
+	switch (column->sort_key) {
+	case E_TABLE_SORT_KEY_INT:
+		column->ints[row] = GPOINTER_TO_INT (value);
+		break;
+	case E_TABLE_SORT_KEY_INT64_PTR:
+		if (value)
+			column->ints[row] = *((const gint64 *) value);
+		else
+			column->unset[row] = 1;
+		break;
+	case E_TABLE_SORT_KEY_STRING_INT:
+		column->ints[row] = value ? atoi (value) : 0;
+		break;
+	case E_TABLE_SORT_KEY_STRING:
+		column->strings[row] = value;
+		break;
+	case E_TABLE_SORT_KEY_COLLATE:
+	case E_TABLE_SORT_KEY_COLLATE_CASE:
+		if (value) {
+			gchar *collate_key;
+
+			collate_key = g_hash_table_lookup (column->collate_keys, value);
+
+			if (!collate_key) {
+				if (column->sort_key == E_TABLE_SORT_KEY_COLLATE_CASE) {
+					gchar *tmp = g_utf8_casefold (value, -1);
+					collate_key = g_utf8_collate_key (tmp, -1);
+					g_free (tmp);
+				} else {
+					collate_key = g_utf8_collate_key (value, -1);
+				}
+
+				g_hash_table_insert (column->collate_keys, g_strdup (value), collate_key);
+			}
+
+			column->strings[row] = collate_key;
+		} else {
+			column->strings[row] = NULL;
+		}
+		break;
+	case E_TABLE_SORT_KEY_NONE:
+	default:
+		column->values[row] = (gpointer) value;
+		break;
+	}
+}
+
+static gint
+sort_keys_compare_column (ETableSortKeys *sort_keys,
+                          ETableSortKeysColumn *column,
+                          gint row1,
+                          gint row2)
+{
+	switch (column->sort_key) {
+	case E_TABLE_SORT_KEY_INT64_PTR:
+		/* Unset values sort first */
+		if (column->unset[row1] || column->unset[row2]) {
+			if (column->unset[row1] && column->unset[row2])
+				return 0;
+			return column->unset[row1] ? -1 : 1;
+		}
+		/* falls through */
+	case E_TABLE_SORT_KEY_INT:
+	case E_TABLE_SORT_KEY_STRING_INT:
+		if (column->ints[row1] == column->ints[row2])
+			return 0;
+		return column->ints[row1] < column->ints[row2] ? -1 : 1;
+	case E_TABLE_SORT_KEY_STRING:
+	case E_TABLE_SORT_KEY_COLLATE:
+	case E_TABLE_SORT_KEY_COLLATE_CASE:
+		/* NULL strings sort last */
+		if (!column->strings[row1] || !column->strings[row2]) {
+			if (column->strings[row1] == column->strings[row2])
+				return 0;
+			return column->strings[row1] ? -1 : 1;
+		}
+		return strcmp (column->strings[row1], column->strings[row2]);
+	case E_TABLE_SORT_KEY_NONE:
+	default:
+		break;
+	}
+
+	return column->compare (column->values[row1], column->values[row2], sort_keys->cmp_cache);
+}
+
+static gint
+sort_keys_compare_cb (gconstpointer data1,
+                      gconstpointer data2,
+                      gpointer user_data)
+{
+	ETableSortKeys *sort_keys = user_data;
+	gint row1 = *(gint *) data1;
+	gint row2 = *(gint *) data2;
+	gint j;
+	gint comp_val = 0;
+	GtkSortType sort_type = GTK_SORT_ASCENDING;
+
+	for (j = 0; j < sort_keys->n_cols; j++) {
+		comp_val = sort_keys_compare_column (sort_keys, &sort_keys->cols[j], row1, row2);
+		sort_type = sort_keys->cols[j].sort_type;
+		if (comp_val != 0)
+			break;
+	}
+
+	if (comp_val == 0) {
+		if (row1 < row2)
+			comp_val = -1;
+		if (row1 > row2)
+			comp_val = 1;
+	}
+
+	if (sort_type == GTK_SORT_DESCENDING)
+		comp_val = -comp_val;
+
+	return comp_val;
+}
+
+/* Sorts the @rows, which are in ascending order, by the integer
+ * sort keys of the @column with a stable LSD radix sort. */
+static void
+sort_keys_radix_sort (ETableSortKeysColumn *column,
+                      gint *rows,
+                      gint n_rows)
+{
+	guint64 *keys, *tmp_keys, *swap_keys;
+	gint *src_rows, *dst_rows, *tmp_rows, *swap_rows;
+	gint counts[256];
+	gint ii, jj, shift;
+
+	keys = g_new (guint64, n_rows);
+	tmp_keys = g_new (guint64, n_rows);
+	tmp_rows = g_new (gint, n_rows);
+
+	/* Flip the sign bit, thus the unsigned order matches the signed order. */
+	for (ii = 0; ii < n_rows; ii++) {
+		keys[ii] = ((guint64) column->ints[rows[ii]]) ^ G_GUINT64_CONSTANT (0x8000000000000000);
+	}
+
+	src_rows = rows;
+	dst_rows = tmp_rows;
+
+	for (shift = 0; shift < 64; shift += 8) {
+		gint offset = 0;
+
+		memset (counts, 0, sizeof (counts));
+
+		for (ii = 0; ii < n_rows; ii++) {
+			counts[(keys[ii] >> shift) & 0xFF]++;
+		}
+
+		/* All keys have the same byte here, like the high bytes of dates. */
+		if (counts[(keys[0] >> shift) & 0xFF] == n_rows)
+			continue;
+
+		for (jj = 0; jj < 256; jj++) {
+			gint count = counts[jj];
+
+			counts[jj] = offset;
+			offset += count;
+		}
+
+		for (ii = 0; ii < n_rows; ii++) {
+			gint pos = counts[(keys[ii] >> shift) & 0xFF]++;
+
+			tmp_keys[pos] = keys[ii];
+			dst_rows[pos] = src_rows[ii];
+		}
+
+		swap_keys = keys;
+		keys = tmp_keys;
+		tmp_keys = swap_keys;
+
+		swap_rows = src_rows;
+		src_rows = dst_rows;
+		dst_rows = swap_rows;
+	}
+
+	/* Unset values sort first, otherwise keep the order. */
+	if (column->unset) {
+		gint n_unset = 0, n_set = 0;
+
+		for (ii = 0; ii < n_rows; ii++) {
+			if (column->unset[src_rows[ii]])
+				n_unset++;
+		}
+
+		if (n_unset > 0) {
+			for (ii = 0; ii < n_rows; ii++) {
+				if (column->unset[src_rows[ii]])
+					dst_rows[ii - n_set] = src_rows[ii];
+				else
+					dst_rows[n_unset + n_set++] = src_rows[ii];
+			}
+
+			swap_rows = src_rows;
+			src_rows = dst_rows;
+			dst_rows = swap_rows;
+		}
+	}
+
+	if (src_rows != rows)
+		memcpy (rows, src_rows, sizeof (gint) * n_rows);
+
+	g_free (keys);
+	g_free (tmp_keys);
+	g_free (tmp_rows);
+}
+
+/* Rows per thread, below which sorting in parallel does not pay off. */
+#define SORT_KEYS_PARALLEL_MIN_ROWS 25000
+#define SORT_KEYS_PARALLEL_MAX_THREADS 16
+
+typedef struct _SortKeysRun {
+	ETableSortKeys *sort_keys;
+	gint *rows;
+	gint *tmp;	/* merge buffer with the same size as the rows */
+	gint n_rows;
+	gint n_left;	/* when merging, the length of the first sorted run */
+} SortKeysRun;
+
+static gpointer
+sort_keys_sort_run_thread (gpointer user_data)
+{
+	SortKeysRun *run = user_data;
+
+	g_qsort_with_data (run->rows, run->n_rows, sizeof (gint), sort_keys_compare_cb, run->sort_keys);
+
+	return NULL;
+}
+
+static gpointer
+sort_keys_merge_runs_thread (gpointer user_data)
+{
+	SortKeysRun *run = user_data;
+	gint ii = 0, jj = run->n_left, kk = 0;
+
+	while (ii < run->n_left && jj < run->n_rows) {
+		if (sort_keys_compare_cb (&run->rows[ii], &run->rows[jj], run->sort_keys) <= 0)
+			run->tmp[kk++] = run->rows[ii++];
+		else
+			run->tmp[kk++] = run->rows[jj++];
+	}
+
+	while (ii < run->n_left) {
+		run->tmp[kk++] = run->rows[ii++];
+	}
+
+	/* What is left from the second run is already in place. */
+	memcpy (run->rows, run->tmp, sizeof (gint) * kk);
+
+	return NULL;
+}
+
+static void
+sort_keys_run_threads (GThreadFunc func,
+                       SortKeysRun *runs,
+                       gint n_runs)
+{
+	GThread **threads;
+	gint ii;
+
+	threads = g_new0 (GThread *, n_runs);
+
+	/* The current thread takes the first run. */
+	for (ii = 1; ii < n_runs; ii++) {
+		threads[ii] = g_thread_try_new ("e-table-sort", func, &runs[ii], NULL);
+	}
+
+	func (&runs[0]);
+
+	for (ii = 1; ii < n_runs; ii++) {
+		if (threads[ii])
+			g_thread_join (threads[ii]);
+		else
+			func (&runs[ii]);
+	}
+
+	g_free (threads);
+}
+
+/* Sorts the runs of the @rows in separate threads, then merges
+ * pairs of the sorted runs, also in parallel, until one is left. */
+static void
+sort_keys_parallel_sort (ETableSortKeys *sort_keys,
+                         gint *rows,
+                         gint n_rows,
+                         gint n_threads)
+{
+	SortKeysRun *runs, *merges, *swap_runs;
+	gint *tmp;
+	gint n_runs, ii;
+
+	runs = g_new0 (SortKeysRun, n_threads);
+	merges = g_new0 (SortKeysRun, n_threads);
+	tmp = g_new (gint, n_rows);
+
+	for (ii = 0; ii < n_threads; ii++) {
+		gint from = (gint) ((gint64) n_rows * ii / n_threads);
+		gint to = (gint) ((gint64) n_rows * (ii + 1) / n_threads);
+
+		runs[ii].sort_keys = sort_keys;
+		runs[ii].rows = rows + from;
+		runs[ii].tmp = tmp + from;
+		runs[ii].n_rows = to - from;
+	}
+
+	sort_keys_run_threads (sort_keys_sort_run_thread, runs, n_threads);
+
+	for (n_runs = n_threads; n_runs > 1;) {
+		gint n_merges = 0;
+
+		for (ii = 0; ii + 1 < n_runs; ii += 2) {
+			merges[n_merges] = runs[ii];
+			merges[n_merges].n_left = runs[ii].n_rows;
+			merges[n_merges].n_rows += runs[ii + 1].n_rows;
+			n_merges++;
+		}
+
+		sort_keys_run_threads (sort_keys_merge_runs_thread, merges, n_merges);
+
+		/* An odd run is carried to the next round as is. */
+		if (n_runs % 2 == 1) {
+			merges[n_merges] = runs[n_runs - 1];
+			n_merges++;
+		}
+
+		swap_runs = runs;
+		runs = merges;
+		merges = swap_runs;
+		n_runs = n_merges;
+	}
+
+	g_free (runs);
+	g_free (merges);
+	g_free (tmp);
+}
+
+static gint
+sort_keys_get_n_threads (ETableSortKeys *sort_keys,
+                         gint n_rows)
+{
+	gint n_threads, ii;
+
+	n_threads = MIN (g_get_num_processors (), SORT_KEYS_PARALLEL_MAX_THREADS);
+	n_threads = MIN (n_threads, n_rows / SORT_KEYS_PARALLEL_MIN_ROWS);
+
+	if (n_threads < 2)
+		return 1;
+
+	/* Custom compare functions and the shared compare cache
+	 * are not meant to be used from multiple threads. */
+	for (ii = 0; ii < sort_keys->n_cols; ii++) {
+		if (sort_keys->cols[ii].sort_key == E_TABLE_SORT_KEY_NONE)
+			return 1;
+	}
+
+	return n_threads;
+}
+
+/**
+ * e_table_sort_keys_sort:
+ * @sort_keys: an #ETableSortKeys
+ * @rows: (array length=n_rows): row indexes to sort
+ * @n_rows: how many items the @rows has
+ *
+ * Sorts the @rows by values set in the @sort_keys. Rows with equal values
+ * are ordered by their index, the same as when comparing the values with
+ * the columns' compare functions.
+ *
+ * Large sets of rows are sorted in multiple threads, when all the sort
+ * columns have a known #ETableSortKey.
+ *
+ * Since: 3.36
+ **/
+void
+e_table_sort_keys_sort (ETableSortKeys *sort_keys,
+                        gint *rows,
+                        gint n_rows)
+{
+	gboolean use_radix_sort = FALSE;
+	gint n_threads;
+
+	g_return_if_fail (sort_keys != NULL);
+
+	if (n_rows < 2)
+		return;
+
+	/* A single integer column can be sorted without any comparison,
+	 * when the rows are in the order the equal values should end in. */
+	if (sort_keys->n_cols == 1 && sort_keys->cols[0].ints) {
+		gint ii;
+
+		use_radix_sort = TRUE;
+
+		for (ii = 1; ii < n_rows && use_radix_sort; ii++) {
+			use_radix_sort = rows[ii - 1] < rows[ii];
+		}
+	}
+
+	n_threads = use_radix_sort ? 1 : sort_keys_get_n_threads (sort_keys, n_rows);
+
+	if (use_radix_sort) {
+		sort_keys_radix_sort (&sort_keys->cols[0], rows, n_rows);
+
+		/* The descending order is the exact reverse of the ascending order,
+		 * because the comparison is negated including the row index. */
+		if (sort_keys->cols[0].sort_type == GTK_SORT_DESCENDING) {
+			gint ii, jj;
+
+			for (ii = 0, jj = n_rows - 1; ii < jj; ii++, jj--) {
+				gint tmp = rows[ii];
+
+				rows[ii] = rows[jj];
+				rows[jj] = tmp;
+			}
+		}
+	} else if (n_threads > 1) {
+		sort_keys_parallel_sort (sort_keys, rows, n_rows, n_threads);
+	} else {
+		g_qsort_with_data (rows, n_rows, sizeof (gint), sort_keys_compare_cb, sort_keys);
+	}
+}
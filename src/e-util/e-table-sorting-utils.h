@@ -33,6 +33,15 @@
 
 G_BEGIN_DECLS
 
+/**
+ * ETableSortKeys:
+ *
+ * An opaque structure holding precomputed sort keys of table rows.
+ *
+ * Since: 3.36
+ **/
+typedef struct _ETableSortKeys ETableSortKeys;
+
 gboolean	e_table_sorting_utils_affects_sort
 						(ETableSortInfo *sort_info,
 						 ETableHeader *full_header,
@@ -89,6 +98,23 @@ const gchar *	e_table_sorting_utils_lookup_cmp_cache
 						(gpointer cmp_cache,
 						 const gchar *key);
 
+ETableSortKeys *
+		e_table_sort_keys_new		(gint n_rows,
+						 gint n_cols,
+						 gpointer cmp_cache);
+void		e_table_sort_keys_free		(ETableSortKeys *sort_keys);
+void		e_table_sort_keys_set_column	(ETableSortKeys *sort_keys,
+						 gint col,
+						 ETableCol *table_col,
+						 GtkSortType sort_type);
+void		e_table_sort_keys_set_value	(ETableSortKeys *sort_keys,
+						 gint col,
+						 gint row,
+						 gconstpointer value);
+void		e_table_sort_keys_sort		(ETableSortKeys *sort_keys,
+						 gint *rows,
+						 gint n_rows);
+
 G_END_DECLS
 
 #endif /* _E_TABLE_SORTING_UTILS_H_ */
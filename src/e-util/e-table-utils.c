@@ -109,8 +109,10 @@ et_col_spec_to_col (ETableColumnSpecification *col_spec,
 				cell, compare);
 		}
 
-		if (col != NULL)
+		if (col != NULL) {
 			col->search = search;
+			col->sort_key = e_table_extras_get_sort_key (ete, col_spec->compare);
+		}
 
 		g_free (title);
 	}
@@ -627,6 +627,33 @@ typedef enum {
  **/
 #define E_CONFIG_LOOKUP_RESULT_LAST_KIND E_CONFIG_LOOKUP_RESULT_TASK_LIST
 
+/**
+ * ETableSortKey:
+ * @E_TABLE_SORT_KEY_NONE: the values can be compared only with the compare function
+ * @E_TABLE_SORT_KEY_INT: the values are integers stored with GINT_TO_POINTER()
+ * @E_TABLE_SORT_KEY_INT64_PTR: the values are pointers to gint64, or %NULL, which sorts first
+ * @E_TABLE_SORT_KEY_STRING_INT: the values are strings containing an integer
+ * @E_TABLE_SORT_KEY_STRING: the values are strings compared byte by byte, %NULL sorts last
+ * @E_TABLE_SORT_KEY_COLLATE: the values are strings compared with g_utf8_collate(), %NULL sorts last
+ * @E_TABLE_SORT_KEY_COLLATE_CASE: the values are strings compared case insensitively
+ *    with g_utf8_collate(), %NULL sorts last
+ *
+ * Describes what values a table column compare function expects. Sorting
+ * can then use a precomputed key for each row, instead of calling
+ * the compare function for each comparison.
+ *
+ * Since: 3.36
+ **/
+typedef enum {
+	E_TABLE_SORT_KEY_NONE = 0,
+	E_TABLE_SORT_KEY_INT,
+	E_TABLE_SORT_KEY_INT64_PTR,
+	E_TABLE_SORT_KEY_STRING_INT,
+	E_TABLE_SORT_KEY_STRING,
+	E_TABLE_SORT_KEY_COLLATE,
+	E_TABLE_SORT_KEY_COLLATE_CASE
+} ETableSortKey;
+
 G_END_DECLS
 
 #endif /* E_UTIL_ENUMS_H */
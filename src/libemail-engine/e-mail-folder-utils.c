@@ -17,6 +17,8 @@
 
 #include "evolution-config.h"
 
+#include <string.h>
+
 #include "e-mail-folder-utils.h"
 
 #include <glib/gi18n-lib.h>
@@ -656,99 +658,331 @@ mail_folder_find_duplicate_messages_thread (GSimpleAsyncResult *simple,
 		g_simple_async_result_take_error (simple, error);
 }
 
-static GHashTable *
-emfu_get_messages_hash_sync (CamelFolder *folder,
-                             GPtrArray *message_uids,
-                             GCancellable *cancellable,
-                             GError **error)
+/* Upper limit of messages being fetched at once when looking for duplicates. */
+#define DIGEST_MAX_THREADS 4
+
+typedef struct _DigestItem DigestItem;
+typedef struct _DigestJob DigestJob;
+
+struct _DigestItem {
+	gchar *uid;
+	guint64 message_id;
+	guint32 size;
+	gchar *digest;	/* NULL when the message has no content */
+};
+
+struct _DigestJob {
+	CamelFolder *folder;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+	guint n_done;
+	GError *error;
+};
+
+static DigestItem *
+digest_item_new (const gchar *uid,
+                 guint64 message_id,
+                 guint32 size)
 {
-	GHashTable *hash_table;
-	CamelMimeMessage *message;
-	guint ii;
+	DigestItem *item;
 
-	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
-	g_return_val_if_fail (message_uids != NULL, NULL);
+	item = g_slice_new0 (DigestItem);
+	item->uid = g_strdup (uid);
+	item->message_id = message_id;
+	item->size = size;
+
+	return item;
+}
+
+static void
+digest_item_free (gpointer ptr)
+{
+	DigestItem *item = ptr;
+
+	if (item) {
+		g_free (item->uid);
+		g_free (item->digest);
+		g_slice_free (DigestItem, item);
+	}
+}
+
+/* Generates a digest string from the message's content. */
+static gchar *
+emfu_dup_message_digest_sync (CamelMimeMessage *message,
+                              GCancellable *cancellable)
+{
+	CamelDataWrapper *content;
+	CamelStream *stream;
+	GByteArray *buffer;
+	gchar *digest = NULL;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+	if (!content)
+		return NULL;
+
+	stream = camel_stream_mem_new ();
+
+	if (camel_data_wrapper_decode_to_stream_sync (content, stream, cancellable, NULL) >= 0) {
+		guint data_len;
+
+		/* The CamelStreamMem owns the buffer. */
+		buffer = camel_stream_mem_get_byte_array (CAMEL_STREAM_MEM (stream));
+		data_len = buffer ? buffer->len : 0;
+
+		/* Strip trailing white-spaces and empty lines */
+		while (data_len > 0 && g_ascii_isspace (buffer->data[data_len - 1]))
+			data_len--;
+
+		if (data_len > 0)
+			digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, buffer->data, data_len);
+	}
+
+	g_object_unref (stream);
+
+	return digest;
+}
+
+static void
+emfu_digest_thread (gpointer data,
+                    gpointer user_data)
+{
+	DigestItem *item = data;
+	DigestJob *job = user_data;
+	CamelMimeMessage *message = NULL;
+	GError *local_error = NULL;
+	gboolean skip;
+
+	g_mutex_lock (&job->lock);
+	skip = job->error != NULL;
+	g_mutex_unlock (&job->lock);
+
+	/* This is an all or nothing operation, thus
+	 * stop fetching messages after the first error. */
+	if (!skip && !g_cancellable_set_error_if_cancelled (job->cancellable, &local_error))
+		message = camel_folder_get_message_sync (job->folder, item->uid, job->cancellable, &local_error);
+
+	if (CAMEL_IS_MIME_MESSAGE (message)) {
+		item->digest = emfu_dup_message_digest_sync (message, job->cancellable);
+	} else if (!skip && !local_error) {
+		g_set_error (
+			&local_error, CAMEL_FOLDER_ERROR, CAMEL_FOLDER_ERROR_INVALID_UID,
+			_("No such message %s"), item->uid);
+	}
+
+	g_clear_object (&message);
+
+	g_mutex_lock (&job->lock);
+
+	if (local_error && !job->error)
+		g_propagate_error (&job->error, local_error);
+	else
+		g_clear_error (&local_error);
+
+	job->n_done++;
+	g_cond_signal (&job->cond);
+
+	g_mutex_unlock (&job->lock);
+}
+
+/* Fetches the messages and sets digests of the @items in parallel. */
+static gboolean
+emfu_digest_messages_sync (CamelFolder *folder,
+                           GPtrArray *items,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	DigestJob job;
+	GThreadPool *pool;
+	guint ii, n_threads, n_done = 0;
+	gboolean success;
+
+	if (!items->len)
+		return TRUE;
 
 	camel_operation_push_message (
 		cancellable,
 		ngettext (
 			"Retrieving %d message",
 			"Retrieving %d messages",
-			message_uids->len),
-		message_uids->len);
+			items->len),
+		items->len);
 
-	hash_table = g_hash_table_new_full (
-		(GHashFunc) g_str_hash,
-		(GEqualFunc) g_str_equal,
-		(GDestroyNotify) g_free,
-		(GDestroyNotify) g_free);
+	memset (&job, 0, sizeof (DigestJob));
+	job.folder = folder;
+	job.cancellable = cancellable;
+	g_mutex_init (&job.lock);
+	g_cond_init (&job.cond);
 
-	/* This is an all or nothing operation.  Destroy the
-	 * hash table if we fail to retrieve any message. */
+	n_threads = CLAMP (g_get_num_processors (), 1, DIGEST_MAX_THREADS);
+	n_threads = MIN (n_threads, items->len);
 
-	for (ii = 0; ii < message_uids->len; ii++) {
-		const gchar *uid;
-		gint percent;
+	pool = g_thread_pool_new (emfu_digest_thread, &job, n_threads, FALSE, NULL);
 
-		uid = g_ptr_array_index (message_uids, ii);
-		percent = ((ii + 1) * 100) / message_uids->len;
+	for (ii = 0; ii < items->len; ii++) {
+		g_thread_pool_push (pool, items->pdata[ii], NULL);
+	}
 
-		message = camel_folder_get_message_sync (
-			folder, uid, cancellable, error);
+	g_mutex_lock (&job.lock);
 
-		camel_operation_progress (cancellable, percent);
+	while (job.n_done < items->len) {
+		g_cond_wait (&job.cond, &job.lock);
 
-		if (CAMEL_IS_MIME_MESSAGE (message)) {
-			CamelDataWrapper *content;
-			gchar *digest = NULL;
+		if (n_done != job.n_done) {
+			n_done = job.n_done;
+
+			g_mutex_unlock (&job.lock);
+			camel_operation_progress (cancellable, (n_done * 100) / items->len);
+			g_mutex_lock (&job.lock);
+		}
+	}
+
+	g_mutex_unlock (&job.lock);
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	success = !job.error;
+
+	if (job.error)
+		g_propagate_error (error, job.error);
+
+	g_mutex_clear (&job.lock);
+	g_cond_clear (&job.cond);
+
+	camel_operation_pop_message (cancellable);
+
+	return success;
+}
+
+/* The digests are cached per folder, in a file with one line per message:
+ * "uid <TAB> message-id <TAB> size <TAB> digest", where the digest is "-"
+ * when the message has no content.  The message-id and the size are used
+ * to recognize the message did not change since the digest was computed. */
+static gchar *
+emfu_digest_cache_get_filename (CamelFolder *folder)
+{
+	CamelStore *store;
+	gchar *key, *checksum, *filename;
+
+	store = camel_folder_get_parent_store (folder);
+	if (!store)
+		return NULL;
+
+	key = g_strconcat (
+		camel_service_get_uid (CAMEL_SERVICE (store)), "/",
+		camel_folder_get_full_name (folder), NULL);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
 
-			/* Generate a digest string from the message's content. */
-			content = camel_medium_get_content (CAMEL_MEDIUM (message));
+	filename = g_build_filename (mail_session_get_cache_dir (), "digests", checksum, NULL);
 
-			if (content != NULL) {
-				CamelStream *stream;
-				GByteArray *buffer;
-				gssize n_bytes;
+	g_free (checksum);
+	g_free (key);
 
-				stream = camel_stream_mem_new ();
+	return filename;
+}
+
+/* Returns a hash table { uid : DigestItem } */
+static GHashTable *
+emfu_digest_cache_load (CamelFolder *folder)
+{
+	GHashTable *cache;
+	gchar *filename, *contents = NULL;
+
+	cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, digest_item_free);
 
-				n_bytes = camel_data_wrapper_decode_to_stream_sync (
-					content, stream, cancellable, error);
+	filename = emfu_digest_cache_get_filename (folder);
 
-				if (n_bytes >= 0) {
-					guint data_len;
+	if (filename && g_file_get_contents (filename, &contents, NULL, NULL)) {
+		gchar **lines;
+		guint ii;
 
-					/* The CamelStreamMem owns the buffer. */
-					buffer = camel_stream_mem_get_byte_array (
-						CAMEL_STREAM_MEM (stream));
-					g_return_val_if_fail (buffer != NULL, NULL);
+		lines = g_strsplit (contents, "\n", -1);
 
-					data_len = buffer->len;
+		for (ii = 0; lines[ii]; ii++) {
+			gchar **parts;
 
-					/* Strip trailing white-spaces and empty lines */
-					while (data_len > 0 && g_ascii_isspace (buffer->data[data_len - 1]))
-						data_len--;
+			parts = g_strsplit (lines[ii], "\t", 4);
 
-					if (data_len > 0)
-						digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, buffer->data, data_len);
-				}
+			if (g_strv_length (parts) == 4 && *parts[0]) {
+				DigestItem *item;
 
-				g_object_unref (stream);
+				item = digest_item_new (parts[0],
+					g_ascii_strtoull (parts[1], NULL, 16),
+					(guint32) g_ascii_strtoull (parts[2], NULL, 10));
+
+				if (g_strcmp0 (parts[3], "-") != 0)
+					item->digest = g_strdup (parts[3]);
+
+				g_hash_table_replace (cache, item->uid, item);
 			}
 
-			g_hash_table_insert (
-				hash_table, g_strdup (uid), digest);
-			g_object_unref (message);
-		} else {
-			g_hash_table_destroy (hash_table);
-			hash_table = NULL;
-			break;
+			g_strfreev (parts);
 		}
+
+		g_strfreev (lines);
+		g_free (contents);
 	}
 
-	camel_operation_pop_message (cancellable);
+	g_free (filename);
 
-	return hash_table;
+	return cache;
+}
+
+static void
+emfu_digest_cache_save (CamelFolder *folder,
+                        GHashTable *cache)
+{
+	GHashTable *known_uids;
+	GHashTableIter iter;
+	GPtrArray *uids;
+	GString *contents;
+	gpointer value;
+	gchar *filename, *dirname;
+	guint ii;
+
+	filename = emfu_digest_cache_get_filename (folder);
+	if (!filename)
+		return;
+
+	/* Forget the messages which are not in the folder anymore. */
+	known_uids = g_hash_table_new (g_str_hash, g_str_equal);
+
+	uids = camel_folder_get_uids (folder);
+
+	for (ii = 0; uids && ii < uids->len; ii++) {
+		g_hash_table_add (known_uids, uids->pdata[ii]);
+	}
+
+	contents = g_string_sized_new (g_hash_table_size (cache) * 100);
+
+	g_hash_table_iter_init (&iter, cache);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		DigestItem *item = value;
+
+		if (!g_hash_table_contains (known_uids, item->uid) ||
+		    strpbrk (item->uid, "\t\n"))
+			continue;
+
+		g_string_append_printf (contents, "%s\t%" G_GINT64_MODIFIER "x\t%u\t%s\n",
+			item->uid, item->message_id, item->size,
+			item->digest ? item->digest : "-");
+	}
+
+	g_hash_table_destroy (known_uids);
+
+	if (uids)
+		camel_folder_free_uids (folder, uids);
+
+	dirname = g_path_get_dirname (filename);
+
+	if (g_mkdir_with_parents (dirname, 0700) == 0)
+		g_file_set_contents (filename, contents->str, contents->len, NULL);
+
+	g_string_free (contents, TRUE);
+	g_free (dirname);
+	g_free (filename);
 }
 
 GHashTable *
@@ -757,90 +991,150 @@ e_mail_folder_find_duplicate_messages_sync (CamelFolder *folder,
                                             GCancellable *cancellable,
                                             GError **error)
 {
-	GQueue trash = G_QUEUE_INIT;
-	GHashTable *hash_table;
+	GHashTable *hash_table = NULL;
+	GHashTable *groups;
+	GHashTable *digest_cache;
 	GHashTable *unique_ids;
 	GHashTableIter iter;
-	gpointer key, value;
+	GPtrArray *items;
+	GPtrArray *to_fetch;
+	gpointer value;
+	guint ii;
 
 	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
 	g_return_val_if_fail (message_uids != NULL, NULL);
 
-	/* hash_table = { MessageUID : digest-as-string } */
-	hash_table = emfu_get_messages_hash_sync (
-		folder, message_uids, cancellable, error);
-
-	if (hash_table == NULL)
-		return NULL;
-
 	camel_operation_push_message (
 		cancellable, _("Scanning messages for duplicates"));
 
-	unique_ids = g_hash_table_new_full (
+	items = g_ptr_array_new_with_free_func (digest_item_free);
+
+	/* groups = { message-id : GPtrArray { DigestItem } }, the keys point
+	 * to the message_id members of the items. */
+	groups = g_hash_table_new_full (
 		(GHashFunc) g_int64_hash,
 		(GEqualFunc) g_int64_equal,
-		(GDestroyNotify) g_free,
-		(GDestroyNotify) g_free);
-
-	g_hash_table_iter_init (&iter, hash_table);
+		NULL,
+		(GDestroyNotify) g_ptr_array_unref);
 
-	while (g_hash_table_iter_next (&iter, &key, &value)) {
-		CamelSummaryMessageID message_id;
-		CamelMessageFlags flags;
+	/* Only messages sharing the Message-ID can be duplicates, thus
+	 * group them using the summary data first and do not download
+	 * messages with a unique Message-ID at all. */
+	for (ii = 0; ii < message_uids->len; ii++) {
 		CamelMessageInfo *info;
-		gboolean duplicate;
-		const gchar *digest;
+		DigestItem *item;
+		GPtrArray *group;
 
-		info = camel_folder_get_message_info (folder, key);
+		info = camel_folder_get_message_info (folder, message_uids->pdata[ii]);
 		if (!info)
 			continue;
 
-		message_id.id.id = camel_message_info_get_message_id (info);
-		flags = camel_message_info_get_flags (info);
-
 		/* Skip messages marked for deletion. */
-		if (flags & CAMEL_MESSAGE_DELETED) {
-			g_queue_push_tail (&trash, key);
+		if (camel_message_info_get_flags (info) & CAMEL_MESSAGE_DELETED) {
 			g_clear_object (&info);
 			continue;
 		}
 
-		digest = value;
+		item = digest_item_new (message_uids->pdata[ii],
+			camel_message_info_get_message_id (info),
+			camel_message_info_get_size (info));
 
-		if (digest == NULL) {
-			g_queue_push_tail (&trash, key);
-			g_clear_object (&info);
+		g_clear_object (&info);
+
+		g_ptr_array_add (items, item);
+
+		group = g_hash_table_lookup (groups, &item->message_id);
+
+		if (!group) {
+			group = g_ptr_array_new ();
+			g_hash_table_insert (groups, &item->message_id, group);
+		}
+
+		g_ptr_array_add (group, item);
+	}
+
+	digest_cache = emfu_digest_cache_load (folder);
+	to_fetch = g_ptr_array_new ();
+
+	g_hash_table_iter_init (&iter, groups);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		GPtrArray *group = value;
+
+		if (group->len < 2)
 			continue;
+
+		for (ii = 0; ii < group->len; ii++) {
+			DigestItem *item = group->pdata[ii];
+			DigestItem *cached;
+
+			cached = g_hash_table_lookup (digest_cache, item->uid);
+
+			if (cached &&
+			    cached->message_id == item->message_id &&
+			    cached->size == item->size)
+				item->digest = g_strdup (cached->digest);
+			else
+				g_ptr_array_add (to_fetch, item);
 		}
+	}
 
-		/* Determine if the message a duplicate. */
+	if (emfu_digest_messages_sync (folder, to_fetch, cancellable, error)) {
+		/* hash_table = { MessageUID : digest-as-string } */
+		hash_table = g_hash_table_new_full (
+			(GHashFunc) g_str_hash,
+			(GEqualFunc) g_str_equal,
+			(GDestroyNotify) g_free,
+			(GDestroyNotify) g_free);
 
-		value = g_hash_table_lookup (unique_ids, &message_id.id.id);
-		duplicate = (value != NULL) && g_str_equal (digest, value);
+		/* unique_ids = { message-id : digest }, both borrowed from the items */
+		unique_ids = g_hash_table_new (
+			(GHashFunc) g_int64_hash,
+			(GEqualFunc) g_int64_equal);
 
-		if (!duplicate) {
-			gint64 *v_int64;
+		for (ii = 0; ii < items->len; ii++) {
+			DigestItem *item = items->pdata[ii];
+			GPtrArray *group;
 
-			/* XXX Might be better to create a GArray
-			 *     of 64-bit integers and have the hash
-			 *     table keys point to array elements. */
-			v_int64 = g_new0 (gint64, 1);
-			*v_int64 = (gint64) message_id.id.id;
+			if (!item->digest)
+				continue;
 
-			g_hash_table_insert (unique_ids, v_int64, g_strdup (digest));
-			g_queue_push_tail (&trash, key);
+			group = g_hash_table_lookup (groups, &item->message_id);
+			if (!group || group->len < 2)
+				continue;
+
+			/* Determine if the message a duplicate. */
+			value = g_hash_table_lookup (unique_ids, &item->message_id);
+
+			if (value != NULL && g_str_equal (item->digest, value))
+				g_hash_table_insert (hash_table, g_strdup (item->uid), g_strdup (item->digest));
+			else
+				g_hash_table_insert (unique_ids, &item->message_id, item->digest);
 		}
 
-		g_clear_object (&info);
-	}
+		g_hash_table_destroy (unique_ids);
+
+		if (to_fetch->len > 0) {
+			for (ii = 0; ii < to_fetch->len; ii++) {
+				DigestItem *item = to_fetch->pdata[ii];
+				DigestItem *cached;
 
-	/* Delete all non-duplicate messages from the hash table. */
-	while ((key = g_queue_pop_head (&trash)) != NULL)
-		g_hash_table_remove (hash_table, key);
+				cached = digest_item_new (item->uid, item->message_id, item->size);
+				cached->digest = g_strdup (item->digest);
+
+				g_hash_table_replace (digest_cache, cached->uid, cached);
+			}
+
+			emfu_digest_cache_save (folder, digest_cache);
+		}
+	}
 
 	camel_operation_pop_message (cancellable);
 
-	g_hash_table_destroy (unique_ids);
+	g_ptr_array_unref (to_fetch);
+	g_hash_table_destroy (digest_cache);
+	g_hash_table_destroy (groups);
+	g_ptr_array_unref (items);
 
 	return hash_table;
 }
@@ -60,9 +60,19 @@ typedef struct _FolderInfo FolderInfo;
 typedef struct _AsyncContext AsyncContext;
 typedef struct _UpdateClosure UpdateClosure;
 
+/* How long to gather folder updates before delivering them at once,
+ * which is about one frame. */
+#define UPDATE_BATCH_INTERVAL_MS 16
+
 struct _MailFolderCachePrivate {
 	GMainContext *main_context;
 
+	/* Updates waiting for delivery in the main context. */
+	GMutex pending_updates_lock;
+	GQueue pending_updates; /* UpdateClosure * */
+	GHashTable *pending_folder_updates; /* gchar *key ~> UpdateClosure * */
+	GSource *pending_updates_source;
+
 	/* Store to storeinfo table, active stores */
 	GHashTable *store_info_ht;
 	GMutex store_info_ht_lock;
@@ -86,6 +96,7 @@ enum {
 	FOLDER_DELETED,
 	FOLDER_RENAMED,
 	FOLDER_UNREAD_UPDATED,
+	FOLDERS_UNREAD_UPDATED,
 	FOLDER_CHANGED,
 	LAST_SIGNAL
 };
@@ -138,8 +149,24 @@ struct _FolderInfo {
 
 	GWeakRef folder;
 	gulong folder_changed_handler_id;
+
+	/* Built on demand, then kept up to date from the folder changes.
+	 * Protected by the lock. */
+	GHashTable *msgid_index;	/* guint64 *msgid ~> GPtrArray { camel_pstring uid } */
+	GHashTable *uid_msgids;		/* camel_pstring uid ~> guint64 *msgid */
+
+	/* While the index is being built, the changes are queued here
+	 * and applied once it is done. Protected by the lock. */
+	guint msgid_index_build_id;	/* non-zero while building */
+	guint msgid_index_n_builds;
+	GQueue msgid_index_pending;	/* MsgidIndexChange * */
 };
 
+typedef struct _MsgidIndexChange {
+	const gchar *uid;		/* camel_pstring */
+	guint64 msgid;			/* 0 for a removed message */
+} MsgidIndexChange;
+
 struct _AsyncContext {
 	StoreInfo *store_info;
 	CamelFolderInfo *info;
@@ -165,6 +192,10 @@ struct _UpdateClosure {
 	gchar *msg_uid;
 	gchar *msg_sender;
 	gchar *msg_subject;
+
+	/* Key in pending_folder_updates, when it can be merged with
+	 * later updates of the same folder. */
+	gchar *pending_key;
 };
 
 /* Forward Declarations */
@@ -219,6 +250,40 @@ folder_info_ref (FolderInfo *folder_info)
 	return folder_info;
 }
 
+static void
+msgid_index_change_free (gpointer ptr)
+{
+	MsgidIndexChange *change = ptr;
+
+	if (change) {
+		camel_pstring_free (change->uid);
+		g_slice_free (MsgidIndexChange, change);
+	}
+}
+
+/* Call with the folder_info->lock held. */
+static void
+folder_info_msgid_index_clear_pending (FolderInfo *folder_info)
+{
+	while (!g_queue_is_empty (&folder_info->msgid_index_pending))
+		msgid_index_change_free (g_queue_pop_head (&folder_info->msgid_index_pending));
+}
+
+/* Call with the folder_info->lock held. */
+static void
+folder_info_msgid_index_queue_change (FolderInfo *folder_info,
+                                      const gchar *uid,
+                                      guint64 msgid)
+{
+	MsgidIndexChange *change;
+
+	change = g_slice_new (MsgidIndexChange);
+	change->uid = camel_pstring_strdup (uid);
+	change->msgid = msgid;
+
+	g_queue_push_tail (&folder_info->msgid_index_pending, change);
+}
+
 static void
 folder_info_clear_folder (FolderInfo *folder_info)
 {
@@ -241,6 +306,12 @@ folder_info_clear_folder (FolderInfo *folder_info)
 		g_object_unref (folder);
 	}
 
+	/* The changes are not tracked anymore, thus the index would get stale. */
+	g_clear_pointer (&folder_info->msgid_index, g_hash_table_destroy);
+	g_clear_pointer (&folder_info->uid_msgids, g_hash_table_destroy);
+	folder_info_msgid_index_clear_pending (folder_info);
+	folder_info->msgid_index_build_id = 0;
+
 	g_mutex_unlock (&folder_info->lock);
 }
 
@@ -262,6 +333,261 @@ folder_info_unref (FolderInfo *folder_info)
 	}
 }
 
+static guint64 *
+msgid_index_key_new (guint64 msgid)
+{
+	guint64 *key;
+
+	key = g_new (guint64, 1);
+	*key = msgid;
+
+	return key;
+}
+
+/* Call with the folder_info->lock held. */
+static void
+folder_info_msgid_index_remove (FolderInfo *folder_info,
+                                const gchar *uid)
+{
+	guint64 *msgid;
+
+	msgid = g_hash_table_lookup (folder_info->uid_msgids, uid);
+
+	if (msgid) {
+		GPtrArray *uids;
+
+		uids = g_hash_table_lookup (folder_info->msgid_index, msgid);
+
+		if (uids) {
+			guint ii;
+
+			for (ii = 0; ii < uids->len; ii++) {
+				if (g_strcmp0 (uids->pdata[ii], uid) == 0) {
+					g_ptr_array_remove_index_fast (uids, ii);
+					break;
+				}
+			}
+
+			if (!uids->len)
+				g_hash_table_remove (folder_info->msgid_index, msgid);
+		}
+
+		g_hash_table_remove (folder_info->uid_msgids, uid);
+	}
+}
+
+/* Call with the folder_info->lock held. */
+static void
+folder_info_msgid_index_add (FolderInfo *folder_info,
+                             const gchar *uid,
+                             guint64 msgid)
+{
+	GPtrArray *uids;
+
+	if (!msgid)
+		return;
+
+	folder_info_msgid_index_remove (folder_info, uid);
+
+	uids = g_hash_table_lookup (folder_info->msgid_index, &msgid);
+
+	if (!uids) {
+		uids = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_pstring_free);
+		g_hash_table_insert (folder_info->msgid_index, msgid_index_key_new (msgid), uids);
+	}
+
+	g_ptr_array_add (uids, (gpointer) camel_pstring_strdup (uid));
+
+	g_hash_table_insert (
+		folder_info->uid_msgids,
+		(gpointer) camel_pstring_strdup (uid),
+		msgid_index_key_new (msgid));
+}
+
+/* Updates the Message-ID index of the folder with the @changes, or builds
+ * it from the folder summary, when it does not exist yet and @build is set.
+ * The index lets the references be resolved without searching the folder. */
+static void
+folder_info_update_msgid_index (FolderInfo *folder_info,
+                                CamelFolder *folder,
+                                CamelFolderChangeInfo *changes,
+                                gboolean build)
+{
+	GHashTable *msgid_index = NULL, *uid_msgids = NULL;
+	GArray *added_msgids = NULL;
+	guint build_id = 0;
+	guint ii;
+
+	g_mutex_lock (&folder_info->lock);
+
+	if (!folder_info->msgid_index && !folder_info->msgid_index_build_id) {
+		if (!build) {
+			g_mutex_unlock (&folder_info->lock);
+			return;
+		}
+
+		folder_info->msgid_index_n_builds++;
+		if (!folder_info->msgid_index_n_builds)
+			folder_info->msgid_index_n_builds++;
+
+		build_id = folder_info->msgid_index_n_builds;
+		folder_info->msgid_index_build_id = build_id;
+	}
+
+	g_mutex_unlock (&folder_info->lock);
+
+	if (build_id) {
+		CamelFolderSummary *summary;
+		GPtrArray *uids;
+		FolderInfo tmp_info;
+		GList *link;
+
+		summary = camel_folder_get_folder_summary (folder);
+
+		msgid_index = g_hash_table_new_full (
+			g_int64_hash, g_int64_equal,
+			g_free, (GDestroyNotify) g_ptr_array_unref);
+		uid_msgids = g_hash_table_new_full (
+			g_str_hash, g_str_equal,
+			(GDestroyNotify) camel_pstring_free, g_free);
+
+		/* Fill the new tables without holding the lock, the message
+		 * infos can be loaded from the disk.  The changes received
+		 * meanwhile are queued and applied below. */
+		tmp_info.msgid_index = msgid_index;
+		tmp_info.uid_msgids = uid_msgids;
+
+		uids = summary ? camel_folder_summary_get_array (summary) : NULL;
+
+		for (ii = 0; uids && ii < uids->len; ii++) {
+			CamelMessageInfo *info;
+
+			info = camel_folder_summary_get (summary, uids->pdata[ii]);
+			if (info) {
+				folder_info_msgid_index_add (&tmp_info,
+					camel_message_info_get_uid (info),
+					camel_message_info_get_message_id (info));
+				g_object_unref (info);
+			}
+		}
+
+		if (uids)
+			camel_folder_summary_free_array (uids);
+
+		g_mutex_lock (&folder_info->lock);
+
+		/* Not cleared nor rebuilt by another thread meanwhile */
+		if (summary && folder_info->msgid_index_build_id == build_id) {
+			folder_info->msgid_index = msgid_index;
+			folder_info->uid_msgids = uid_msgids;
+			msgid_index = NULL;
+			uid_msgids = NULL;
+
+			for (link = g_queue_peek_head_link (&folder_info->msgid_index_pending); link; link = g_list_next (link)) {
+				MsgidIndexChange *change = link->data;
+
+				if (change->msgid)
+					folder_info_msgid_index_add (folder_info, change->uid, change->msgid);
+				else
+					folder_info_msgid_index_remove (folder_info, change->uid);
+			}
+		}
+
+		if (folder_info->msgid_index_build_id == build_id) {
+			folder_info_msgid_index_clear_pending (folder_info);
+			folder_info->msgid_index_build_id = 0;
+		}
+
+		g_mutex_unlock (&folder_info->lock);
+
+		if (msgid_index)
+			g_hash_table_destroy (msgid_index);
+		if (uid_msgids)
+			g_hash_table_destroy (uid_msgids);
+
+		/* The summary contains the changes already. */
+		return;
+	}
+
+	if (!changes)
+		return;
+
+	if (changes->uid_added && changes->uid_added->len) {
+		added_msgids = g_array_sized_new (FALSE, TRUE, sizeof (guint64), changes->uid_added->len);
+
+		for (ii = 0; ii < changes->uid_added->len; ii++) {
+			CamelMessageInfo *info;
+			guint64 msgid = 0;
+
+			info = camel_folder_get_message_info (folder, changes->uid_added->pdata[ii]);
+			if (info) {
+				msgid = camel_message_info_get_message_id (info);
+				g_object_unref (info);
+			}
+
+			g_array_append_val (added_msgids, msgid);
+		}
+	}
+
+	g_mutex_lock (&folder_info->lock);
+
+	if (folder_info->msgid_index) {
+		for (ii = 0; changes->uid_removed && ii < changes->uid_removed->len; ii++) {
+			folder_info_msgid_index_remove (folder_info, changes->uid_removed->pdata[ii]);
+		}
+
+		for (ii = 0; added_msgids && ii < added_msgids->len; ii++) {
+			folder_info_msgid_index_add (folder_info,
+				changes->uid_added->pdata[ii],
+				g_array_index (added_msgids, guint64, ii));
+		}
+	} else if (folder_info->msgid_index_build_id) {
+		/* Being built; a message without Message-ID is
+		 * queued as removed, to drop any stale entry. */
+		for (ii = 0; changes->uid_removed && ii < changes->uid_removed->len; ii++) {
+			folder_info_msgid_index_queue_change (folder_info, changes->uid_removed->pdata[ii], 0);
+		}
+
+		for (ii = 0; added_msgids && ii < added_msgids->len; ii++) {
+			folder_info_msgid_index_queue_change (folder_info,
+				changes->uid_added->pdata[ii],
+				g_array_index (added_msgids, guint64, ii));
+		}
+	}
+
+	g_mutex_unlock (&folder_info->lock);
+
+	if (added_msgids)
+		g_array_unref (added_msgids);
+}
+
+/* Adds UIDs of the messages with @msgid into @uids, which is expected
+ * to free its items with camel_pstring_free().  Returns FALSE when the
+ * folder has no Message-ID index. */
+static gboolean
+folder_info_collect_uids_by_msgid (FolderInfo *folder_info,
+                                   guint64 msgid,
+                                   GPtrArray *uids)
+{
+	GPtrArray *found;
+	gboolean has_index;
+	guint ii;
+
+	g_mutex_lock (&folder_info->lock);
+
+	has_index = folder_info->msgid_index != NULL;
+
+	found = has_index ? g_hash_table_lookup (folder_info->msgid_index, &msgid) : NULL;
+
+	for (ii = 0; found && ii < found->len; ii++) {
+		g_ptr_array_add (uids, (gpointer) camel_pstring_strdup (found->pdata[ii]));
+	}
+
+	g_mutex_unlock (&folder_info->lock);
+
+	return has_index;
+}
+
 static StoreInfo *
 store_info_new (CamelStore *store)
 {
@@ -498,10 +824,64 @@ update_closure_free (UpdateClosure *closure)
 	g_free (closure->msg_uid);
 	g_free (closure->msg_sender);
 	g_free (closure->msg_subject);
+	g_free (closure->pending_key);
 
 	g_slice_free (UpdateClosure, closure);
 }
 
+static gchar *
+update_closure_build_key (CamelStore *store,
+                          const gchar *full_name)
+{
+	return g_strdup_printf ("%p:%s", (gpointer) store, full_name);
+}
+
+/* Merges a later plain update of the same folder into @closure. */
+static void
+update_closure_merge (UpdateClosure *closure,
+                      UpdateClosure *later)
+{
+	gint new_messages;
+
+	new_messages = closure->new_messages + later->new_messages;
+
+	if (later->new_messages > 0) {
+		g_free (closure->msg_uid);
+		g_free (closure->msg_sender);
+		g_free (closure->msg_subject);
+
+		closure->msg_uid = later->msg_uid;
+		closure->msg_sender = later->msg_sender;
+		closure->msg_subject = later->msg_subject;
+
+		later->msg_uid = NULL;
+		later->msg_sender = NULL;
+		later->msg_subject = NULL;
+	}
+
+	/* The message details are valid only for exactly one message. */
+	if (new_messages != 1) {
+		g_clear_pointer (&closure->msg_uid, g_free);
+		g_clear_pointer (&closure->msg_sender, g_free);
+		g_clear_pointer (&closure->msg_subject, g_free);
+	}
+
+	closure->new_messages = new_messages;
+	closure->unread = later->unread;
+}
+
+static void
+mail_folder_cache_unread_free (gpointer ptr)
+{
+	MailFolderCacheUnread *unread = ptr;
+
+	if (unread) {
+		g_clear_object (&unread->store);
+		g_free (unread->folder_name);
+		g_slice_free (MailFolderCacheUnread, unread);
+	}
+}
+
 static void
 mail_folder_cache_check_connection_status_cb (CamelStore *store,
 					      GParamSpec *param,
@@ -697,130 +1077,245 @@ mail_folder_cache_check_connection_status_cb (CamelStore *store,
 	store_info_unref (store_info);
 }
 
-static gboolean
-mail_folder_cache_update_idle_cb (gpointer user_data)
+static void
+mail_folder_cache_emit_update (MailFolderCache *cache,
+                               UpdateClosure *closure,
+                               GPtrArray *unread_updates,
+                               GHashTable *unread_indexes)
 {
-	MailFolderCache *cache;
-	UpdateClosure *closure;
-
-	closure = (UpdateClosure *) user_data;
+	MailFolderCacheUnread *unread_update;
+	gchar *key;
+	gpointer index;
 
 	/* Sanity checks. */
-	g_return_val_if_fail (closure->full_name != NULL, FALSE);
+	g_return_if_fail (closure->full_name != NULL);
 
-	cache = g_weak_ref_get (&closure->cache);
+	if (closure->signal_id == signals[FOLDER_DELETED]) {
+		g_signal_emit (
+			cache,
+			closure->signal_id, 0,
+			closure->store,
+			closure->full_name);
+	}
 
-	if (cache != NULL) {
-		if (closure->signal_id == signals[FOLDER_DELETED]) {
-			g_signal_emit (
-				cache,
-				closure->signal_id, 0,
-				closure->store,
-				closure->full_name);
-		}
+	if (closure->signal_id == signals[FOLDER_UNAVAILABLE]) {
+		g_signal_emit (
+			cache,
+			closure->signal_id, 0,
+			closure->store,
+			closure->full_name);
+	}
 
-		if (closure->signal_id == signals[FOLDER_UNAVAILABLE]) {
-			g_signal_emit (
-				cache,
-				closure->signal_id, 0,
-				closure->store,
-				closure->full_name);
-		}
+	if (closure->signal_id == signals[FOLDER_AVAILABLE]) {
+		g_signal_emit (
+			cache,
+			closure->signal_id, 0,
+			closure->store,
+			closure->full_name);
+	}
 
-		if (closure->signal_id == signals[FOLDER_AVAILABLE]) {
-			g_signal_emit (
-				cache,
-				closure->signal_id, 0,
-				closure->store,
-				closure->full_name);
-		}
+	if (closure->signal_id == signals[FOLDER_RENAMED]) {
+		g_signal_emit (
+			cache,
+			closure->signal_id, 0,
+			closure->store,
+			closure->oldfull,
+			closure->full_name);
+	}
 
-		if (closure->signal_id == signals[FOLDER_RENAMED]) {
-			g_signal_emit (
-				cache,
-				closure->signal_id, 0,
-				closure->store,
-				closure->oldfull,
-				closure->full_name);
-		}
+	/* update unread counts */
+	g_signal_emit (
+		cache,
+		signals[FOLDER_UNREAD_UPDATED], 0,
+		closure->store,
+		closure->full_name,
+		closure->unread);
+
+	/* Gather the unread counts for the batch signal,
+	 * the last value for each folder wins. */
+	key = update_closure_build_key (closure->store, closure->full_name);
+
+	if (g_hash_table_lookup_extended (unread_indexes, key, NULL, &index)) {
+		unread_update = g_ptr_array_index (unread_updates, GPOINTER_TO_UINT (index));
+		unread_update->unread = closure->unread;
+		g_free (key);
+	} else {
+		unread_update = g_slice_new0 (MailFolderCacheUnread);
+		unread_update->store = g_object_ref (closure->store);
+		unread_update->folder_name = g_strdup (closure->full_name);
+		unread_update->unread = closure->unread;
 
-		/* update unread counts */
+		g_hash_table_insert (unread_indexes, key, GUINT_TO_POINTER (unread_updates->len));
+		g_ptr_array_add (unread_updates, unread_update);
+	}
+
+	/* XXX The old code excluded this on FOLDER_RENAMED.
+	 *     Not sure if that was intentional (if so it was
+	 *     very subtle!) but we'll preserve the behavior.
+	 *     If it turns out to be a bug then just remove
+	 *     the signal_id check. */
+	if (closure->signal_id != signals[FOLDER_RENAMED]) {
 		g_signal_emit (
 			cache,
-			signals[FOLDER_UNREAD_UPDATED], 0,
+			signals[FOLDER_CHANGED], 0,
 			closure->store,
 			closure->full_name,
-			closure->unread);
-
-		/* XXX The old code excluded this on FOLDER_RENAMED.
-		 *     Not sure if that was intentional (if so it was
-		 *     very subtle!) but we'll preserve the behavior.
-		 *     If it turns out to be a bug then just remove
-		 *     the signal_id check. */
-		if (closure->signal_id != signals[FOLDER_RENAMED]) {
-			g_signal_emit (
-				cache,
-				signals[FOLDER_CHANGED], 0,
-				closure->store,
-				closure->full_name,
-				closure->new_messages,
-				closure->msg_uid,
-				closure->msg_sender,
-				closure->msg_subject);
-		}
+			closure->new_messages,
+			closure->msg_uid,
+			closure->msg_sender,
+			closure->msg_subject);
+	}
 
-		if (CAMEL_IS_VEE_STORE (closure->store) &&
-		   (closure->signal_id == signals[FOLDER_AVAILABLE] ||
-		    closure->signal_id == signals[FOLDER_RENAMED])) {
-			/* Normally the vfolder store takes care of the
-			 * folder_opened event itself, but we add folder to
-			 * the noting system later, thus we do not know about
-			 * search folders to update them in a tree, thus
-			 * ensure their changes will be tracked correctly. */
-			CamelFolder *folder;
-
-			/* FIXME camel_store_get_folder_sync() may block. */
-			folder = camel_store_get_folder_sync (
-				closure->store,
-				closure->full_name,
-				0, NULL, NULL);
-
-			if (folder != NULL) {
-				mail_folder_cache_note_folder (cache, folder);
-				g_object_unref (folder);
-			}
+	if (CAMEL_IS_VEE_STORE (closure->store) &&
+	   (closure->signal_id == signals[FOLDER_AVAILABLE] ||
+	    closure->signal_id == signals[FOLDER_RENAMED])) {
+		/* Normally the vfolder store takes care of the
+		 * folder_opened event itself, but we add folder to
+		 * the noting system later, thus we do not know about
+		 * search folders to update them in a tree, thus
+		 * ensure their changes will be tracked correctly. */
+		CamelFolder *folder;
+
+		/* FIXME camel_store_get_folder_sync() may block. */
+		folder = camel_store_get_folder_sync (
+			closure->store,
+			closure->full_name,
+			0, NULL, NULL);
+
+		if (folder != NULL) {
+			mail_folder_cache_note_folder (cache, folder);
+			g_object_unref (folder);
 		}
+	}
+}
 
-		g_object_unref (cache);
+static gboolean
+mail_folder_cache_update_batch_cb (gpointer user_data)
+{
+	MailFolderCache *cache;
+	GQueue updates = G_QUEUE_INIT;
+	GPtrArray *unread_updates;
+	GHashTable *unread_indexes;
+
+	cache = g_weak_ref_get (user_data);
+
+	if (cache == NULL)
+		return FALSE;
+
+	g_mutex_lock (&cache->priv->pending_updates_lock);
+
+	updates = cache->priv->pending_updates;
+	g_queue_init (&cache->priv->pending_updates);
+	g_hash_table_remove_all (cache->priv->pending_folder_updates);
+
+	g_source_unref (cache->priv->pending_updates_source);
+	cache->priv->pending_updates_source = NULL;
+
+	g_mutex_unlock (&cache->priv->pending_updates_lock);
+
+	unread_updates = g_ptr_array_new_with_free_func (mail_folder_cache_unread_free);
+	unread_indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	while (!g_queue_is_empty (&updates)) {
+		UpdateClosure *closure = g_queue_pop_head (&updates);
+
+		mail_folder_cache_emit_update (cache, closure, unread_updates, unread_indexes);
+
+		update_closure_free (closure);
+	}
+
+	if (unread_updates->len > 0) {
+		g_signal_emit (
+			cache,
+			signals[FOLDERS_UNREAD_UPDATED], 0,
+			unread_updates);
 	}
 
+	g_hash_table_destroy (unread_indexes);
+	g_ptr_array_unref (unread_updates);
+
+	g_object_unref (cache);
+
 	return FALSE;
 }
 
+static void
+mail_folder_cache_weak_ref_free (gpointer ptr)
+{
+	GWeakRef *weak_ref = ptr;
+
+	g_weak_ref_clear (weak_ref);
+	g_slice_free (GWeakRef, weak_ref);
+}
+
+/* Updates are delivered in batches, at most one per frame.  Plain updates
+ * of one folder, which carry only the unread and new message counts, are
+ * merged while they wait, thus a burst of changes during the first
+ * synchronization of an account does not flood the main loop. */
 static void
 mail_folder_cache_submit_update (UpdateClosure *closure)
 {
-	GMainContext *main_context;
 	MailFolderCache *cache;
-	GSource *idle_source;
+	UpdateClosure *pending;
+	gchar *key;
 
 	g_return_if_fail (closure != NULL);
 
 	cache = g_weak_ref_get (&closure->cache);
 	g_return_if_fail (cache != NULL);
 
-	main_context = mail_folder_cache_ref_main_context (cache);
+	key = update_closure_build_key (closure->store, closure->full_name);
+
+	g_mutex_lock (&cache->priv->pending_updates_lock);
+
+	pending = g_hash_table_lookup (cache->priv->pending_folder_updates, key);
+
+	if (pending != NULL && closure->signal_id == 0) {
+		update_closure_merge (pending, closure);
+		update_closure_free (closure);
+		g_free (key);
+	} else {
+		if (closure->signal_id == 0) {
+			closure->pending_key = key;
+			g_hash_table_insert (
+				cache->priv->pending_folder_updates,
+				key, closure);
+		} else {
+			/* Keep the order with the structural change,
+			 * later updates of the folder are queued after it. */
+			g_hash_table_remove (cache->priv->pending_folder_updates, key);
+			g_free (key);
+		}
+
+		g_queue_push_tail (&cache->priv->pending_updates, closure);
+	}
+
+	if (cache->priv->pending_updates_source == NULL) {
+		GMainContext *main_context;
+		GWeakRef *weak_ref;
+		GSource *source;
 
-	idle_source = g_idle_source_new ();
-	g_source_set_callback (
-		idle_source,
-		mail_folder_cache_update_idle_cb,
-		closure,
-		(GDestroyNotify) update_closure_free);
-	g_source_attach (idle_source, main_context);
-	g_source_unref (idle_source);
+		weak_ref = g_slice_new0 (GWeakRef);
+		g_weak_ref_init (weak_ref, cache);
 
-	g_main_context_unref (main_context);
+		main_context = mail_folder_cache_ref_main_context (cache);
+
+		source = g_timeout_source_new (UPDATE_BATCH_INTERVAL_MS);
+		g_source_set_name (source, "[evolution] mail_folder_cache_update_batch_cb");
+		g_source_set_callback (
+			source,
+			mail_folder_cache_update_batch_cb,
+			weak_ref,
+			mail_folder_cache_weak_ref_free);
+		g_source_attach (source, main_context);
+
+		/* Keep the reference, to be able to destroy it in finalize(). */
+		cache->priv->pending_updates_source = source;
+
+		g_main_context_unref (main_context);
+	}
+
+	g_mutex_unlock (&cache->priv->pending_updates_lock);
 
 	g_object_unref (cache);
 }
@@ -943,6 +1438,7 @@ update_1folder (MailFolderCache *cache,
 
 static gboolean
 folder_cache_check_ignore_thread (CamelFolder *folder,
+				  FolderInfo *folder_info,
 				  CamelMessageInfo *info,
 				  GHashTable *added_uids, /* gchar *uid ~> IGNORE_THREAD_VALUE_... */
 				  GCancellable *cancellable,
@@ -950,7 +1446,9 @@ folder_cache_check_ignore_thread (CamelFolder *folder,
 {
 	GArray *references;
 	gboolean has_ignore_thread = FALSE, first_ignore_thread = FALSE, found_first_msgid = FALSE;
+	gboolean uids_from_search = FALSE;
 	guint64 first_msgid;
+	GPtrArray *uids = NULL;
 	GString *expr = NULL;
 	guint ii;
 
@@ -971,7 +1469,22 @@ folder_cache_check_ignore_thread (CamelFolder *folder,
 
 	first_msgid = g_array_index (references, guint64, 0);
 
-	for (ii = 0; ii < references->len; ii++) {
+	/* Prefer the Message-ID index, it avoids searching the folder. */
+	if (folder_info) {
+		uids = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_pstring_free);
+
+		for (ii = 0; ii < references->len; ii++) {
+			guint64 msgid = g_array_index (references, guint64, ii);
+
+			if (msgid && !folder_info_collect_uids_by_msgid (folder_info, msgid, uids)) {
+				g_ptr_array_unref (uids);
+				uids = NULL;
+				break;
+			}
+		}
+	}
+
+	for (ii = 0; !uids && ii < references->len; ii++) {
 		CamelSummaryMessageID msgid;
 
 		msgid.id.id = g_array_index (references, guint64, ii);
@@ -987,65 +1500,68 @@ folder_cache_check_ignore_thread (CamelFolder *folder,
 	}
 
 	if (expr) {
-		GPtrArray *uids;
-
 		g_string_append (expr, "))");
 
 		uids = camel_folder_search_by_expression (folder, expr->str, cancellable, error);
-		if (uids) {
-			for (ii = 0; ii < uids->len; ii++) {
-				const gchar *refruid = uids->pdata[ii];
-				CamelMessageInfo *refrinfo;
-				gpointer cached_value;
-
-				refrinfo = camel_folder_get_message_info (folder, refruid);
-				if (!refrinfo)
-					continue;
+		uids_from_search = uids != NULL;
 
-				/* This is for cases when a subthread is received and the order of UIDs
-				   doesn't match the order in the thread (parent before child). */
-				cached_value = g_hash_table_lookup (added_uids, refruid);
-				if (cached_value == IGNORE_THREAD_VALUE_TODO) {
-					GError *local_error = NULL;
+		g_string_free (expr, TRUE);
+	}
 
-					/* To avoid infinite recursion */
-					g_hash_table_insert (added_uids, (gpointer) camel_pstring_strdup (refruid), IGNORE_THREAD_VALUE_IN_PROGRESS);
+	if (uids) {
+		for (ii = 0; ii < uids->len; ii++) {
+			const gchar *refruid = uids->pdata[ii];
+			CamelMessageInfo *refrinfo;
+			gpointer cached_value;
 
-					if (folder_cache_check_ignore_thread (folder, refrinfo, added_uids, cancellable, &local_error))
-						camel_message_info_set_user_flag (refrinfo, "ignore-thread", TRUE);
+			refrinfo = camel_folder_get_message_info (folder, refruid);
+			if (!refrinfo)
+				continue;
 
-					if (local_error) {
-						g_clear_error (&local_error);
-					} else {
-						cached_value = IGNORE_THREAD_VALUE_DONE;
-						g_hash_table_insert (added_uids, (gpointer) camel_pstring_strdup (refruid), IGNORE_THREAD_VALUE_DONE);
-					}
-				}
+			/* This is for cases when a subthread is received and the order of UIDs
+			   doesn't match the order in the thread (parent before child). */
+			cached_value = g_hash_table_lookup (added_uids, refruid);
+			if (cached_value == IGNORE_THREAD_VALUE_TODO) {
+				GError *local_error = NULL;
 
-				if (!cached_value)
-					cached_value = IGNORE_THREAD_VALUE_DONE;
+				/* To avoid infinite recursion */
+				g_hash_table_insert (added_uids, (gpointer) camel_pstring_strdup (refruid), IGNORE_THREAD_VALUE_IN_PROGRESS);
 
-				if (first_msgid && camel_message_info_get_message_id (refrinfo) == first_msgid) {
-					/* The first msgid in the references is In-Reply-To, which is the master;
-					   the rest is just a guess. */
-					first_ignore_thread = camel_message_info_get_user_flag (refrinfo, "ignore-thread");
-					found_first_msgid = first_ignore_thread || cached_value == IGNORE_THREAD_VALUE_DONE;
+				if (folder_cache_check_ignore_thread (folder, folder_info, refrinfo, added_uids, cancellable, &local_error))
+					camel_message_info_set_user_flag (refrinfo, "ignore-thread", TRUE);
 
-					if (found_first_msgid) {
-						g_clear_object (&refrinfo);
-						break;
-					}
+				if (local_error) {
+					g_clear_error (&local_error);
+				} else {
+					cached_value = IGNORE_THREAD_VALUE_DONE;
+					g_hash_table_insert (added_uids, (gpointer) camel_pstring_strdup (refruid), IGNORE_THREAD_VALUE_DONE);
 				}
+			}
 
-				has_ignore_thread = has_ignore_thread || camel_message_info_get_user_flag (refrinfo, "ignore-thread");
+			if (!cached_value)
+				cached_value = IGNORE_THREAD_VALUE_DONE;
 
-				g_clear_object (&refrinfo);
+			if (first_msgid && camel_message_info_get_message_id (refrinfo) == first_msgid) {
+				/* The first msgid in the references is In-Reply-To, which is the master;
+				   the rest is just a guess. */
+				first_ignore_thread = camel_message_info_get_user_flag (refrinfo, "ignore-thread");
+				found_first_msgid = first_ignore_thread || cached_value == IGNORE_THREAD_VALUE_DONE;
+
+				if (found_first_msgid) {
+					g_clear_object (&refrinfo);
+					break;
+				}
 			}
 
-			camel_folder_search_free (folder, uids);
+			has_ignore_thread = has_ignore_thread || camel_message_info_get_user_flag (refrinfo, "ignore-thread");
+
+			g_clear_object (&refrinfo);
 		}
 
-		g_string_free (expr, TRUE);
+		if (uids_from_search)
+			camel_folder_search_free (folder, uids);
+		else
+			g_ptr_array_unref (uids);
 	}
 
 	g_array_unref (references);
@@ -1072,6 +1588,7 @@ folder_cache_process_folder_changes_thread (CamelFolder *folder,
 	CamelMessageInfo *info;
 	FolderInfo *folder_info;
 	const gchar *full_name;
+	gboolean check_new_messages;
 	gint new = 0;
 	gint i;
 	guint32 flags;
@@ -1103,11 +1620,21 @@ folder_cache_process_folder_changes_thread (CamelFolder *folder,
 	local_sent = e_mail_session_get_local_folder (
 		E_MAIL_SESSION (session), E_MAIL_LOCAL_FOLDER_SENT);
 
-	if (!CAMEL_IS_VEE_FOLDER (folder)
-	    && folder != local_drafts
-	    && folder != local_outbox
-	    && folder != local_sent
-	    && changes && (changes->uid_added->len > 0)) {
+	check_new_messages = !CAMEL_IS_VEE_FOLDER (folder)
+		&& folder != local_drafts
+		&& folder != local_outbox
+		&& folder != local_sent
+		&& changes && (changes->uid_added->len > 0);
+
+	folder_info = mail_folder_cache_ref_folder_info (
+		cache, parent_store, full_name);
+
+	/* Build the Message-ID index only when it is needed for the first time,
+	   then keep it in sync with the changes, even when no new message arrived. */
+	if (folder_info)
+		folder_info_update_msgid_index (folder_info, folder, changes, check_new_messages);
+
+	if (check_new_messages) {
 		GHashTable *added_uids; /* gchar *uid ~> IGNORE_THREAD_VALUE_... */
 
 		/* The messages can be received in a wrong order (by UID), the same as the In-Reply-To
@@ -1133,7 +1660,7 @@ folder_cache_process_folder_changes_thread (CamelFolder *folder,
 				flags = camel_message_info_get_flags (info);
 				if (((flags & CAMEL_MESSAGE_SEEN) == 0) &&
 				    ((flags & CAMEL_MESSAGE_DELETED) == 0) &&
-				    folder_cache_check_ignore_thread (folder, info, added_uids, cancellable, &local_error)) {
+				    folder_cache_check_ignore_thread (folder, folder_info, info, added_uids, cancellable, &local_error)) {
 					camel_message_info_set_flags (info, CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_SEEN);
 					camel_message_info_set_user_flag (info, "ignore-thread", TRUE);
 					flags = flags | CAMEL_MESSAGE_SEEN;
@@ -1181,8 +1708,6 @@ folder_cache_process_folder_changes_thread (CamelFolder *folder,
 		g_mutex_unlock (&last_newmail_per_folder_mutex);
 	}
 
-	folder_info = mail_folder_cache_ref_folder_info (
-		cache, parent_store, full_name);
 	if (folder_info != NULL) {
 		update_1folder (
 			cache, folder_info, new,
@@ -1551,6 +2076,17 @@ mail_folder_cache_finalize (GObject *object)
 
 	priv = MAIL_FOLDER_CACHE_GET_PRIVATE (object);
 
+	if (priv->pending_updates_source) {
+		g_source_destroy (priv->pending_updates_source);
+		g_source_unref (priv->pending_updates_source);
+		priv->pending_updates_source = NULL;
+	}
+
+	g_hash_table_destroy (priv->pending_folder_updates);
+	g_queue_foreach (&priv->pending_updates, (GFunc) update_closure_free, NULL);
+	g_queue_clear (&priv->pending_updates);
+	g_mutex_clear (&priv->pending_updates_lock);
+
 	g_main_context_unref (priv->main_context);
 
 	g_hash_table_destroy (priv->store_info_ht);
@@ -1842,6 +2378,25 @@ mail_folder_cache_class_init (MailFolderCacheClass *class)
 		G_TYPE_STRING,
 		G_TYPE_INT);
 
+	/**
+	 * MailFolderCache::folders-unread-updated
+	 * @updates: (element-type MailFolderCacheUnread): a #GPtrArray
+	 *    of #MailFolderCacheUnread
+	 *
+	 * Emitted once for each batch of updates, with the last unread count
+	 * of each updated folder.  It is emitted after the individual
+	 * MailFolderCache::folder-unread-updated signals of the batch, thus
+	 * the listeners can apply many changes in one pass instead.
+	 **/
+	signals[FOLDERS_UNREAD_UPDATED] = g_signal_new (
+		"folders-unread-updated",
+		G_OBJECT_CLASS_TYPE (object_class),
+		G_SIGNAL_RUN_FIRST,
+		G_STRUCT_OFFSET (MailFolderCacheClass, folders_unread_updated),
+		NULL, NULL, NULL,
+		G_TYPE_NONE, 1,
+		G_TYPE_PTR_ARRAY | G_SIGNAL_TYPE_STATIC_SCOPE);
+
 	/**
 	 * MailFolderCache::folder-changed
 	 * @store: the #CamelStore containing the folder
@@ -1886,6 +2441,10 @@ mail_folder_cache_init (MailFolderCache *cache)
 	cache->priv->store_info_ht = store_info_ht;
 	g_mutex_init (&cache->priv->store_info_ht_lock);
 
+	g_mutex_init (&cache->priv->pending_updates_lock);
+	g_queue_init (&cache->priv->pending_updates);
+	cache->priv->pending_folder_updates = g_hash_table_new (g_str_hash, g_str_equal);
+
 	cache->priv->count_sent = getenv ("EVOLUTION_COUNT_SENT") != NULL;
 	cache->priv->count_trash = getenv ("EVOLUTION_COUNT_TRASH") != NULL;
 
@@ -95,8 +95,25 @@ struct _MailFolderCacheClass {
 						 const gchar *msg_uid,
 						 const gchar *msg_sender,
 						 const gchar *msg_subject);
+	void		(*folders_unread_updated)
+						(MailFolderCache *cache,
+						 GPtrArray *updates);
 };
 
+/**
+ * MailFolderCacheUnread:
+ * @store: the #CamelStore containing the folder
+ * @folder_name: the name of the folder
+ * @unread: the number of unread mails in the folder
+ *
+ * One item of the MailFolderCache::folders-unread-updated signal.
+ */
+typedef struct _MailFolderCacheUnread {
+	CamelStore *store;
+	gchar *folder_name;
+	gint unread;
+} MailFolderCacheUnread;
+
 GType		mail_folder_cache_get_type	(void) G_GNUC_CONST;
 MailFolderCache *
 		mail_folder_cache_new		(void);
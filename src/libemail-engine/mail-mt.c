@@ -420,19 +420,245 @@ mail_msg_compare (const MailMsg *msg1,
 	return (priority1 < priority2) ? 1 : -1;
 }
 
+/* The executor runs the messages pushed by mail_msg_unordered_push() and
+ * mail_msg_ordered_push() in a pool of worker threads.  Each message is
+ * queued by its priority class; interactive messages are taken first and
+ * one worker is always kept available for them, thus long running
+ * background or bulk work cannot starve them.  Messages pushed into the same
+ * lane are run one after another, in the order they were pushed. */
+
+typedef struct _MailMsgJob {
+	MailMsg *msg;
+	MailMsgClass klass;
+	gpointer lane_key;
+	gint64 queued_time;
+} MailMsgJob;
+
+typedef struct _MailMsgLane {
+	GObject *key_object; /* referenced, thus the key cannot be reused */
+	GQueue waiting; /* MailMsgJob * */
+} MailMsgLane;
+
+static GMutex executor_lock;
+static GCond executor_cond;
+static GQueue executor_queues[MAIL_MSG_N_CLASSES]; /* MailMsgJob * */
+static GHashTable *executor_lanes = NULL; /* gpointer lane_key ~> MailMsgLane * */
+static MailMsgQueueStats executor_stats[MAIL_MSG_N_CLASSES];
+static guint executor_n_threads = 0;
+static guint executor_n_idle = 0;
+static guint executor_n_running_noninteractive = 0;
+
+static gint fast_ordered_lane;
+
+static MailMsgClass
+mail_msg_get_class (MailMsg *msg)
+{
+	if (msg->priority >= MAIL_MSG_PRIORITY_INTERACTIVE)
+		return MAIL_MSG_CLASS_INTERACTIVE;
+
+	if (msg->priority <= MAIL_MSG_PRIORITY_BULK)
+		return MAIL_MSG_CLASS_BULK;
+
+	return MAIL_MSG_CLASS_BACKGROUND;
+}
+
+/* The former thread pools ran up to 10 unordered and 2 ordered messages
+ * at once; do not run fewer non-interactive messages than that, plus
+ * the worker kept for the interactive messages. */
+#define EXECUTOR_MIN_THREADS (10 + 2 + 1)
+#define EXECUTOR_MAX_THREADS 32
+
+static guint
+executor_get_max_threads (void)
+{
+	return CLAMP (g_get_num_processors (), EXECUTOR_MIN_THREADS, EXECUTOR_MAX_THREADS);
+}
+
+/* Called with the executor_lock held */
+static void
+executor_enqueue_locked (MailMsgJob *job)
+{
+	GQueue *queue = &executor_queues[job->klass];
+	GList *link;
+
+	/* Keep the queue sorted by the priority, first come first served
+	 * for messages of the same priority. */
+	for (link = g_queue_peek_tail_link (queue); link; link = g_list_previous (link)) {
+		MailMsgJob *queued = link->data;
+
+		if (queued->msg->priority >= job->msg->priority)
+			break;
+	}
+
+	if (link)
+		g_queue_insert_after (queue, link, job);
+	else
+		g_queue_push_head (queue, job);
+}
+
+/* Called with the executor_lock held */
+static MailMsgJob *
+executor_dequeue_locked (void)
+{
+	MailMsgJob *job;
+
+	job = g_queue_pop_head (&executor_queues[MAIL_MSG_CLASS_INTERACTIVE]);
+
+	/* Keep one worker for the interactive messages */
+	if (!job && executor_n_running_noninteractive + 1 < executor_get_max_threads ()) {
+		job = g_queue_pop_head (&executor_queues[MAIL_MSG_CLASS_BACKGROUND]);
+		if (!job)
+			job = g_queue_pop_head (&executor_queues[MAIL_MSG_CLASS_BULK]);
+
+		if (job)
+			executor_n_running_noninteractive++;
+	}
+
+	if (job) {
+		MailMsgQueueStats *stats = &executor_stats[job->klass];
+		gint64 wait_time = g_get_monotonic_time () - job->queued_time;
+
+		stats->queued--;
+		stats->running++;
+		stats->n_started++;
+		stats->total_wait_time += wait_time;
+		if (wait_time > stats->max_wait_time)
+			stats->max_wait_time = wait_time;
+	}
+
+	return job;
+}
+
+/* Called with the executor_lock held.  Returns an object to be
+ * unreferenced after the lock is released, or NULL. */
+static GObject *
+executor_finish_locked (MailMsgJob *job)
+{
+	GObject *key_object = NULL;
+
+	executor_stats[job->klass].running--;
+
+	if (job->klass != MAIL_MSG_CLASS_INTERACTIVE)
+		executor_n_running_noninteractive--;
+
+	if (job->lane_key) {
+		MailMsgLane *lane;
+
+		lane = g_hash_table_lookup (executor_lanes, job->lane_key);
+		g_warn_if_fail (lane != NULL);
+
+		if (lane) {
+			MailMsgJob *next_job;
+
+			next_job = g_queue_pop_head (&lane->waiting);
+			if (next_job) {
+				executor_enqueue_locked (next_job);
+			} else {
+				g_hash_table_remove (executor_lanes, job->lane_key);
+				key_object = lane->key_object;
+				g_slice_free (MailMsgLane, lane);
+			}
+		}
+	}
+
+	g_slice_free (MailMsgJob, job);
+
+	g_cond_broadcast (&executor_cond);
+
+	return key_object;
+}
+
 static gpointer
-create_thread_pool (gpointer data)
+executor_worker_thread (gpointer user_data)
 {
-	GThreadPool *thread_pool;
-	gint max_threads = GPOINTER_TO_INT (data);
+	g_mutex_lock (&executor_lock);
 
 	/* once created, run forever */
-	thread_pool = g_thread_pool_new (
-		(GFunc) mail_msg_proxy, NULL, max_threads, FALSE, NULL);
-	g_thread_pool_set_sort_function (
-		thread_pool, (GCompareDataFunc) mail_msg_compare, NULL);
+	while (TRUE) {
+		MailMsgJob *job;
+		GObject *key_object;
+
+		job = executor_dequeue_locked ();
+		if (!job) {
+			executor_n_idle++;
+			g_cond_wait (&executor_cond, &executor_lock);
+			executor_n_idle--;
+			continue;
+		}
+
+		g_mutex_unlock (&executor_lock);
+
+		mail_msg_proxy (job->msg);
+
+		g_mutex_lock (&executor_lock);
+
+		key_object = executor_finish_locked (job);
+
+		if (key_object) {
+			/* Can be the last reference of the store */
+			g_mutex_unlock (&executor_lock);
+			g_object_unref (key_object);
+			g_mutex_lock (&executor_lock);
+		}
+	}
+
+	g_mutex_unlock (&executor_lock);
+
+	return NULL;
+}
+
+static void
+executor_push (MailMsg *msg,
+               gpointer lane_key,
+               gboolean lane_key_is_object)
+{
+	MailMsgJob *job;
+
+	job = g_slice_new0 (MailMsgJob);
+	job->msg = msg;
+	job->klass = mail_msg_get_class (msg);
+	job->lane_key = lane_key;
+	job->queued_time = g_get_monotonic_time ();
 
-	return thread_pool;
+	g_mutex_lock (&executor_lock);
+
+	executor_stats[job->klass].queued++;
+
+	if (!executor_lanes)
+		executor_lanes = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	if (lane_key) {
+		MailMsgLane *lane;
+
+		lane = g_hash_table_lookup (executor_lanes, lane_key);
+		if (lane) {
+			/* Waits for the previous messages of the lane */
+			g_queue_push_tail (&lane->waiting, job);
+			g_mutex_unlock (&executor_lock);
+			return;
+		}
+
+		lane = g_slice_new0 (MailMsgLane);
+		lane->key_object = lane_key_is_object ? g_object_ref (lane_key) : NULL;
+		g_queue_init (&lane->waiting);
+		g_hash_table_insert (executor_lanes, lane_key, lane);
+	}
+
+	executor_enqueue_locked (job);
+
+	if (executor_n_idle == 0 && executor_n_threads < executor_get_max_threads ()) {
+		GThread *thread;
+
+		thread = g_thread_try_new ("mail-msg-worker", executor_worker_thread, NULL, NULL);
+		if (thread) {
+			executor_n_threads++;
+			g_thread_unref (thread);
+		}
+	}
+
+	g_cond_signal (&executor_cond);
+
+	g_mutex_unlock (&executor_lock);
 }
 
 void
@@ -454,31 +680,38 @@ mail_msg_main_loop_push (gpointer msg)
 void
 mail_msg_unordered_push (gpointer msg)
 {
-	static GOnce once = G_ONCE_INIT;
+	executor_push (msg, NULL, FALSE);
+}
 
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (10));
+/* Messages pushed for the same 'store' are run one after another,
+ * in the order they were pushed; different stores run in parallel.
+ * The 'store' is referenced while any of its messages is queued. */
+void
+mail_msg_ordered_push (gpointer msg,
+                       CamelStore *store)
+{
+	g_return_if_fail (CAMEL_IS_STORE (store));
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	executor_push (msg, store, TRUE);
 }
 
 void
 mail_msg_fast_ordered_push (gpointer msg)
 {
-	static GOnce once = G_ONCE_INIT;
-
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (1));
-
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	executor_push (msg, &fast_ordered_lane, FALSE);
 }
 
+/* Fills the 'out_stats' with the current counters of the 'klass' queue */
 void
-mail_msg_slow_ordered_push (gpointer msg)
+mail_msg_get_queue_stats (MailMsgClass klass,
+                          MailMsgQueueStats *out_stats)
 {
-	static GOnce once = G_ONCE_INIT;
-
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (1));
+	g_return_if_fail ((guint) klass < MAIL_MSG_N_CLASSES);
+	g_return_if_fail (out_stats != NULL);
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	g_mutex_lock (&executor_lock);
+	*out_stats = executor_stats[klass];
+	g_mutex_unlock (&executor_lock);
 }
 
 gboolean
@@ -52,6 +52,28 @@ typedef void    (*MailMsgAlertErrorFunc)	(GCancellable *cancellable,
 typedef EAlertSink *
 		(*MailMsgGetAlertSinkFunc)	(void);
 
+/* Messages with priority of at least MAIL_MSG_PRIORITY_INTERACTIVE are
+ * run before any other, those with priority of at most MAIL_MSG_PRIORITY_BULK
+ * after all the others. */
+#define MAIL_MSG_PRIORITY_INTERACTIVE	10
+#define MAIL_MSG_PRIORITY_DEFAULT	0
+#define MAIL_MSG_PRIORITY_BULK		(-10)
+
+typedef enum {
+	MAIL_MSG_CLASS_INTERACTIVE,
+	MAIL_MSG_CLASS_BACKGROUND,
+	MAIL_MSG_CLASS_BULK,
+	MAIL_MSG_N_CLASSES
+} MailMsgClass;
+
+typedef struct _MailMsgQueueStats {
+	guint queued;			/* waiting to be run */
+	guint running;			/* being run right now */
+	guint64 n_started;		/* how many had been started so far */
+	gint64 total_wait_time;		/* in microseconds, of all the started */
+	gint64 max_wait_time;		/* in microseconds */
+} MailMsgQueueStats;
+
 struct _MailMsg {
 	MailMsgInfo *info;
 	volatile gint ref_count;
@@ -97,8 +119,11 @@ gboolean mail_msg_active (void);
 /* dispatch a message */
 void mail_msg_main_loop_push (gpointer msg);
 void mail_msg_unordered_push (gpointer msg);
+void mail_msg_ordered_push (gpointer msg, CamelStore *store);
 void mail_msg_fast_ordered_push (gpointer msg);
-void mail_msg_slow_ordered_push (gpointer msg);
+
+void mail_msg_get_queue_stats (MailMsgClass klass,
+			       MailMsgQueueStats *out_stats);
 
 /* Call a function in the GUI thread, wait for it to return, type is
  * the marshaller to use.  FIXME This thing is horrible, please put
@@ -213,6 +213,8 @@ mail_filter_folder (EMailSession *session,
 			m->driver, "new-mail-notification");
 	}
 
+	m->base.priority = MAIL_MSG_PRIORITY_BULK;
+
 	mail_msg_unordered_push (m);
 }
 
@@ -521,6 +523,8 @@ mail_fetch_mail (CamelStore *store,
 	if (status)
 		camel_filter_driver_set_status_func (fm->driver, status, status_data);
 
+	fm->base.priority = MAIL_MSG_PRIORITY_BULK;
+
 	mail_msg_unordered_push (m);
 
 	g_object_unref (session);
@@ -1319,7 +1323,10 @@ mail_transfer_messages (EMailSession *session,
 	m->done = done;
 	m->data = data;
 
-	mail_msg_slow_ordered_push (m);
+	/* Moving and copying messages is usually requested by the user */
+	m->base.priority = MAIL_MSG_PRIORITY_INTERACTIVE;
+
+	mail_msg_ordered_push (m, camel_folder_get_parent_store (source));
 }
 
 /* ** SYNC FOLDER ********************************************************* */
@@ -1439,7 +1446,7 @@ mail_sync_folder (CamelFolder *folder,
 	m->data = data;
 	m->done = done;
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_ordered_push (m, camel_folder_get_parent_store (folder));
 }
 
 /* ** SYNC STORE ********************************************************* */
@@ -1520,7 +1527,7 @@ mail_sync_store (CamelStore *store,
 	m->data = data;
 	m->done = done;
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_ordered_push (m, store);
 }
 
 /* ******************************************************************************** */
@@ -1596,7 +1603,7 @@ mail_empty_trash (CamelStore *store)
 	m = mail_msg_new (&empty_trash_info);
 	m->store = g_object_ref (store);
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_ordered_push (m, store);
 }
 
 /* ** Execute Shell Command ************************************************ */
@@ -1694,5 +1701,7 @@ mail_process_folder_changes (CamelFolder *folder,
 	m->done = done;
 	m->user_data = user_data;
 
+	m->base.priority = MAIL_MSG_PRIORITY_BULK;
+
 	mail_msg_unordered_push (m);
 }
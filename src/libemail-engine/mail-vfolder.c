@@ -241,7 +241,13 @@ vfolder_setup (CamelSession *session,
 	camel_folder_freeze (m->folder);
 
 	id = m->base.seq;
-	mail_msg_slow_ordered_push (m);
+
+	/* The setup and the vfolder_adduri() of the vfolders are run one after
+	 * another in the lane of the vfolder store, together with the transfers
+	 * and syncs of its folders.  Operations on the other stores are not
+	 * waited for, the vfolders follow changes of their source folders
+	 * through the folders' change notifications. */
+	mail_msg_ordered_push (m, camel_folder_get_parent_store (folder));
 
 	return id;
 }
@@ -399,7 +405,7 @@ vfolder_adduri (EMailSession *session,
 	g_list_foreach (m->folders, (GFunc) camel_folder_freeze, NULL);
 
 	id = m->base.seq;
-	mail_msg_slow_ordered_push (m);
+	mail_msg_ordered_push (m, e_mail_session_get_vfolder_store (session));
 
 	return id;
 }
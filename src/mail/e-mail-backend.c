@@ -930,6 +930,24 @@ mail_backend_folder_unread_updated_cb (MailFolderCache *folder_cache,
 		(EEventTarget *) target);
 }
 
+static void
+mail_backend_folders_unread_updated_cb (MailFolderCache *folder_cache,
+                                        GPtrArray *updates,
+                                        EMailBackend *mail_backend)
+{
+	guint ii;
+
+	g_return_if_fail (updates != NULL);
+
+	for (ii = 0; ii < updates->len; ii++) {
+		MailFolderCacheUnread *update = g_ptr_array_index (updates, ii);
+
+		mail_backend_folder_unread_updated_cb (
+			folder_cache, update->store, update->folder_name,
+			update->unread, mail_backend);
+	}
+}
+
 static void
 mail_backend_job_started_cb (CamelSession *session,
                              GCancellable *cancellable,
@@ -1392,8 +1410,8 @@ mail_backend_constructed (GObject *object)
 		G_CALLBACK (mail_backend_folder_changed_cb), shell_backend);
 
 	g_signal_connect (
-		folder_cache, "folder-unread-updated",
-		G_CALLBACK (mail_backend_folder_unread_updated_cb),
+		folder_cache, "folders-unread-updated",
+		G_CALLBACK (mail_backend_folders_unread_updated_cb),
 		shell_backend);
 
 	mail_config_init (priv->session);
@@ -63,8 +63,20 @@
 
 #define d(x)
 
+/* How many parsed messages each reader keeps referenced, thus
+ * going back to them does not need to fetch and parse them again. */
+#define PARSED_MESSAGES_MAX 8
+
+/* Larger messages are not read ahead, they are fetched and parsed
+ * only when the user selects them. */
+#define READ_AHEAD_MAX_SIZE (2 * 1024 * 1024)
+
+/* How much of a text/plain part is searched for the inline PGP blocks. */
+#define READ_AHEAD_PGP_SCAN_SIZE (64 * 1024)
+
 typedef struct _EMailReaderClosure EMailReaderClosure;
 typedef struct _EMailReaderPrivate EMailReaderPrivate;
+typedef struct _ReadAheadData ReadAheadData;
 
 struct _EMailReaderClosure {
 	EMailReader *reader;
@@ -106,6 +118,22 @@ struct _EMailReaderPrivate {
 
 	guint main_menu_label_merge_id;
 	guint popup_menu_label_merge_id;
+
+	/* Recently displayed or read ahead messages, the most recent
+	 * first.  The references keep them in the part list registry. */
+	GQueue parsed_messages; /* EMailPartList * */
+	CamelFolder *parsed_messages_folder;
+	gulong parsed_messages_changed_handler_id;
+
+	/* Parsing of the messages around the displayed one. */
+	GHashTable *read_ahead; /* gchar *mail_uri ~> GCancellable * */
+};
+
+struct _ReadAheadData {
+	CamelSession *session;
+	CamelFolder *folder;
+	gchar *message_uid;
+	gchar *mail_uri;
 };
 
 enum {
@@ -148,12 +176,412 @@ mail_reader_closure_free (EMailReaderClosure *closure)
 	g_slice_free (EMailReaderClosure, closure);
 }
 
+static void
+read_ahead_data_free (gpointer ptr)
+{
+	ReadAheadData *rad = ptr;
+
+	if (rad) {
+		g_clear_object (&rad->session);
+		g_clear_object (&rad->folder);
+		g_free (rad->message_uid);
+		g_free (rad->mail_uri);
+		g_slice_free (ReadAheadData, rad);
+	}
+}
+
+static void
+mail_reader_cancel_read_ahead (EMailReaderPrivate *priv)
+{
+	if (priv->read_ahead) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, priv->read_ahead);
+
+		while (g_hash_table_iter_next (&iter, NULL, &value))
+			g_cancellable_cancel (value);
+
+		g_hash_table_remove_all (priv->read_ahead);
+	}
+}
+
+static void
+mail_reader_forget_parsed_messages (EMailReaderPrivate *priv)
+{
+	if (priv->parsed_messages_changed_handler_id) {
+		g_signal_handler_disconnect (
+			priv->parsed_messages_folder,
+			priv->parsed_messages_changed_handler_id);
+		priv->parsed_messages_changed_handler_id = 0;
+	}
+
+	g_clear_object (&priv->parsed_messages_folder);
+
+	while (!g_queue_is_empty (&priv->parsed_messages))
+		g_object_unref (g_queue_pop_head (&priv->parsed_messages));
+}
+
+static void
+mail_reader_parsed_messages_folder_changed_cb (CamelFolder *folder,
+                                               CamelFolderChangeInfo *changes,
+                                               EMailReaderPrivate *priv)
+{
+	GHashTable *removed_uids;
+	GList *link, *next;
+	guint ii;
+
+	if (!changes || !changes->uid_removed || !changes->uid_removed->len)
+		return;
+
+	removed_uids = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (ii = 0; ii < changes->uid_removed->len; ii++)
+		g_hash_table_add (removed_uids, changes->uid_removed->pdata[ii]);
+
+	for (link = g_queue_peek_head_link (&priv->parsed_messages); link; link = next) {
+		EMailPartList *part_list = link->data;
+		const gchar *message_uid;
+
+		next = g_list_next (link);
+
+		message_uid = e_mail_part_list_get_message_uid (part_list);
+
+		if (message_uid && g_hash_table_contains (removed_uids, message_uid)) {
+			g_queue_delete_link (&priv->parsed_messages, link);
+			g_object_unref (part_list);
+		}
+	}
+
+	g_hash_table_destroy (removed_uids);
+}
+
+static void
+mail_reader_remember_part_list (EMailReader *reader,
+                                EMailPartList *part_list)
+{
+	EMailReaderPrivate *priv;
+	CamelFolder *folder;
+	GList *link;
+
+	priv = E_MAIL_READER_GET_PRIVATE (reader);
+
+	folder = e_mail_part_list_get_folder (part_list);
+	if (!priv || !folder)
+		return;
+
+	/* Only changes of one folder are watched, thus forget
+	 * the messages of the previous folder. */
+	if (folder != priv->parsed_messages_folder) {
+		mail_reader_forget_parsed_messages (priv);
+
+		priv->parsed_messages_folder = g_object_ref (folder);
+		priv->parsed_messages_changed_handler_id = g_signal_connect (
+			folder, "changed",
+			G_CALLBACK (mail_reader_parsed_messages_folder_changed_cb), priv);
+	}
+
+	link = g_queue_find (&priv->parsed_messages, part_list);
+
+	if (link) {
+		g_queue_unlink (&priv->parsed_messages, link);
+		g_queue_push_head_link (&priv->parsed_messages, link);
+	} else {
+		g_queue_push_head (&priv->parsed_messages, g_object_ref (part_list));
+
+		while (g_queue_get_length (&priv->parsed_messages) > PARSED_MESSAGES_MAX)
+			g_object_unref (g_queue_pop_tail (&priv->parsed_messages));
+	}
+}
+
+/* Signed and encrypted messages are not parsed ahead, parsing them
+ * can ask for a passphrase or access a smart card or a key server. */
+static gboolean
+mail_reader_part_can_read_ahead (CamelMimePart *part,
+				 GCancellable *cancellable)
+{
+	CamelContentType *ct;
+	CamelDataWrapper *content;
+
+	ct = camel_mime_part_get_content_type (part);
+
+	if (camel_content_type_is (ct, "multipart", "encrypted") ||
+	    camel_content_type_is (ct, "multipart", "signed") ||
+	    camel_content_type_is (ct, "application", "pkcs7-mime") ||
+	    camel_content_type_is (ct, "application", "x-pkcs7-mime"))
+		return FALSE;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (part));
+	if (!content)
+		return TRUE;
+
+	if (CAMEL_IS_MULTIPART (content)) {
+		CamelMultipart *multipart = CAMEL_MULTIPART (content);
+		guint ii, n_parts;
+
+		n_parts = camel_multipart_get_number (multipart);
+
+		for (ii = 0; ii < n_parts; ii++) {
+			CamelMimePart *subpart = camel_multipart_get_part (multipart, ii);
+
+			if (subpart && !mail_reader_part_can_read_ahead (subpart, cancellable))
+				return FALSE;
+		}
+	} else if (CAMEL_IS_MIME_MESSAGE (content)) {
+		return mail_reader_part_can_read_ahead (CAMEL_MIME_PART (content), cancellable);
+	} else if (camel_content_type_is (ct, "text", "plain")) {
+		GOutputStream *stream;
+		const gchar *data;
+		gsize data_len;
+		gboolean can_read_ahead;
+
+		/* Look for the inline PGP signed or encrypted blocks at the beginning
+		 * of the text only. The stream does not grow, thus the decoding stops
+		 * with an error once the buffer is full, which is ignored here. */
+		stream = g_memory_output_stream_new (
+			g_malloc (READ_AHEAD_PGP_SCAN_SIZE),
+			READ_AHEAD_PGP_SCAN_SIZE, NULL, g_free);
+
+		camel_data_wrapper_decode_to_output_stream_sync (content, stream, cancellable, NULL);
+
+		data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream));
+		data_len = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream));
+
+		can_read_ahead = !data || !data_len || (
+			!g_strstr_len (data, data_len, "-----BEGIN PGP MESSAGE-----") &&
+			!g_strstr_len (data, data_len, "-----BEGIN PGP SIGNED MESSAGE-----"));
+
+		g_object_unref (stream);
+
+		return can_read_ahead;
+	}
+
+	return TRUE;
+}
+
+static void
+mail_reader_read_ahead_thread (GTask *task,
+                               gpointer source_object,
+                               gpointer task_data,
+                               GCancellable *cancellable)
+{
+	ReadAheadData *rad = task_data;
+	CamelObjectBag *registry;
+	CamelMimeMessage *message;
+	EMailPartList *part_list = NULL;
+	EMailPartList *existing;
+
+	registry = e_mail_part_list_get_registry ();
+
+	/* The registry is not reserved while the message is fetched and
+	 * parsed, the display would be blocked in camel_object_bag_get()
+	 * when the user selects the message in the meantime. */
+	existing = camel_object_bag_peek (registry, rad->mail_uri);
+	if (existing) {
+		g_task_return_pointer (task, existing, g_object_unref);
+		return;
+	}
+
+	message = camel_folder_get_message_sync (
+		rad->folder, rad->message_uid, cancellable, NULL);
+
+	if (message && !mail_reader_part_can_read_ahead (CAMEL_MIME_PART (message), cancellable))
+		g_clear_object (&message);
+
+	if (message) {
+		EMailParser *parser;
+
+		parser = e_mail_parser_new (rad->session);
+
+		part_list = e_mail_parser_parse_sync (
+			parser, rad->folder, rad->message_uid,
+			message, cancellable);
+
+		g_object_unref (parser);
+		g_object_unref (message);
+	}
+
+	/* Do not store possibly incomplete result. */
+	if (part_list && g_cancellable_is_cancelled (cancellable))
+		g_clear_object (&part_list);
+
+	/* Whatever the display stored meanwhile wins, this result
+	 * is dropped then. The reservation is held only to add it. */
+	if (part_list) {
+		existing = camel_object_bag_peek (registry, rad->mail_uri);
+
+		if (!existing)
+			existing = camel_object_bag_reserve (registry, rad->mail_uri);
+
+		if (existing) {
+			g_object_unref (part_list);
+			part_list = existing;
+		} else {
+			camel_object_bag_add (registry, rad->mail_uri, part_list);
+		}
+	}
+
+	g_task_return_pointer (task, part_list, g_object_unref);
+}
+
+static void
+mail_reader_read_ahead_done_cb (GObject *source_object,
+                                GAsyncResult *result,
+                                gpointer user_data)
+{
+	EMailReaderPrivate *priv;
+	EMailPartList *part_list;
+	GCancellable *cancellable;
+	ReadAheadData *rad;
+
+	priv = E_MAIL_READER_GET_PRIVATE (source_object);
+	cancellable = g_task_get_cancellable (G_TASK (result));
+	rad = g_task_get_task_data (G_TASK (result));
+
+	/* Forget the finished read-ahead, unless it had been
+	 * cancelled and the same message scheduled again. */
+	if (priv && priv->read_ahead &&
+	    g_hash_table_lookup (priv->read_ahead, rad->mail_uri) == cancellable)
+		g_hash_table_remove (priv->read_ahead, rad->mail_uri);
+
+	part_list = g_task_propagate_pointer (G_TASK (result), NULL);
+
+	if (part_list) {
+		if (!g_cancellable_is_cancelled (cancellable))
+			mail_reader_remember_part_list (E_MAIL_READER (source_object), part_list);
+
+		g_object_unref (part_list);
+	}
+}
+
+/* Parses the messages around the displayed one in the background,
+ * thus moving to them in the message list shows them immediately. */
+static void
+mail_reader_schedule_read_ahead (EMailReader *reader,
+                                 CamelFolder *folder)
+{
+	const MessageListSelectDirection directions[] = {
+		MESSAGE_LIST_SELECT_NEXT,
+		MESSAGE_LIST_SELECT_PREVIOUS
+	};
+	EMailReaderPrivate *priv;
+	EMailBackend *backend;
+	EMailSession *session;
+	EMailDisplay *display;
+	CamelObjectBag *registry;
+	GtkWidget *message_list;
+	GHashTable *running;
+	GHashTableIter iter;
+	gpointer value;
+	gchar *mail_uris[G_N_ELEMENTS (directions)] = { NULL, };
+	gchar *message_uids[G_N_ELEMENTS (directions)] = { NULL, };
+	guint ii;
+
+	priv = E_MAIL_READER_GET_PRIVATE (reader);
+
+	display = e_mail_reader_get_mail_display (reader);
+	message_list = e_mail_reader_get_message_list (reader);
+
+	if (!folder || !message_list ||
+	    e_mail_display_get_mode (display) == E_MAIL_FORMATTER_MODE_SOURCE) {
+		mail_reader_cancel_read_ahead (priv);
+		return;
+	}
+
+	for (ii = 0; ii < G_N_ELEMENTS (directions); ii++) {
+		message_uids[ii] = message_list_dup_neighbour_uid (
+			MESSAGE_LIST (message_list), directions[ii]);
+
+		if (message_uids[ii])
+			mail_uris[ii] = e_mail_part_build_uri (folder, message_uids[ii], NULL, NULL);
+	}
+
+	/* Keep running those, which are still next to the displayed message,
+	 * like when moving through the message list one message at a time. */
+	running = priv->read_ahead;
+	priv->read_ahead = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
+	if (running) {
+		for (ii = 0; ii < G_N_ELEMENTS (directions); ii++) {
+			gpointer key = NULL;
+
+			if (mail_uris[ii] && g_hash_table_lookup_extended (running, mail_uris[ii], &key, &value)) {
+				g_hash_table_steal (running, key);
+				g_hash_table_insert (priv->read_ahead, key, value);
+			}
+		}
+
+		g_hash_table_iter_init (&iter, running);
+
+		while (g_hash_table_iter_next (&iter, NULL, &value))
+			g_cancellable_cancel (value);
+
+		g_hash_table_destroy (running);
+	}
+
+	backend = e_mail_reader_get_backend (reader);
+	session = e_mail_backend_get_session (backend);
+	registry = e_mail_part_list_get_registry ();
+
+	for (ii = 0; ii < G_N_ELEMENTS (directions); ii++) {
+		CamelMessageInfo *info;
+		EMailPartList *part_list;
+
+		if (!mail_uris[ii] || g_hash_table_contains (priv->read_ahead, mail_uris[ii]))
+			continue;
+
+		part_list = camel_object_bag_peek (registry, mail_uris[ii]);
+
+		if (part_list) {
+			/* Parsed already, only keep it around. */
+			mail_reader_remember_part_list (reader, part_list);
+			g_object_unref (part_list);
+			continue;
+		}
+
+		info = camel_folder_get_message_info (folder, message_uids[ii]);
+
+		if (info && camel_message_info_get_size (info) <= READ_AHEAD_MAX_SIZE) {
+			ReadAheadData *rad;
+			GCancellable *cancellable;
+			GTask *task;
+
+			rad = g_slice_new0 (ReadAheadData);
+			rad->session = g_object_ref (session);
+			rad->folder = g_object_ref (folder);
+			rad->message_uid = g_strdup (message_uids[ii]);
+			rad->mail_uri = g_strdup (mail_uris[ii]);
+
+			cancellable = g_cancellable_new ();
+			g_hash_table_insert (priv->read_ahead, g_strdup (mail_uris[ii]), cancellable);
+
+			task = g_task_new (reader, cancellable, mail_reader_read_ahead_done_cb, NULL);
+			g_task_set_source_tag (task, mail_reader_schedule_read_ahead);
+			g_task_set_priority (task, G_PRIORITY_LOW);
+			g_task_set_task_data (task, rad, read_ahead_data_free);
+			g_task_run_in_thread (task, mail_reader_read_ahead_thread);
+			g_object_unref (task);
+		}
+
+		g_clear_object (&info);
+	}
+
+	for (ii = 0; ii < G_N_ELEMENTS (directions); ii++) {
+		g_free (message_uids[ii]);
+		g_free (mail_uris[ii]);
+	}
+}
+
 static void
 mail_reader_private_free (EMailReaderPrivate *priv)
 {
 	if (priv->message_selected_timeout_id > 0)
 		g_source_remove (priv->message_selected_timeout_id);
 
+	mail_reader_cancel_read_ahead (priv);
+	g_clear_pointer (&priv->read_ahead, g_hash_table_destroy);
+	mail_reader_forget_parsed_messages (priv);
+
 	if (priv->retrieving_message != NULL) {
 		g_cancellable_cancel (priv->retrieving_message);
 		g_object_unref (priv->retrieving_message);
@@ -3680,8 +4108,41 @@ mail_reader_message_selected_timeout_cb (gpointer user_data)
 			GCancellable *cancellable;
 			CamelFolder *folder;
 			EActivity *activity;
+			EMailPartList *cached_parts;
+			CamelMimeMessage *cached_message = NULL;
+			gchar *mail_uri;
 			gchar *string;
 
+			folder = e_mail_reader_ref_folder (reader);
+
+			/* The message can be parsed already, either it was
+			 * displayed recently or it was read ahead. */
+			mail_uri = e_mail_part_build_uri (folder, cursor_uid, NULL, NULL);
+			cached_parts = camel_object_bag_peek (e_mail_part_list_get_registry (), mail_uri);
+			g_free (mail_uri);
+
+			if (cached_parts)
+				cached_message = e_mail_part_list_get_message (cached_parts);
+
+			if (cached_message) {
+				g_cancellable_cancel (priv->retrieving_message);
+
+				mail_reader_manage_followup_flag (reader, folder, cursor_uid);
+
+				g_signal_emit (
+					reader, signals[MESSAGE_LOADED], 0,
+					cursor_uid, cached_message);
+
+				g_object_unref (cached_parts);
+				g_clear_object (&folder);
+
+				priv->message_selected_timeout_id = 0;
+
+				return FALSE;
+			}
+
+			g_clear_object (&cached_parts);
+
 			string = g_strdup_printf (
 				_("Retrieving message “%s”"), cursor_uid);
 			e_mail_display_set_part_list (display, NULL);
@@ -3697,8 +4158,6 @@ mail_reader_message_selected_timeout_cb (gpointer user_data)
 			closure->reader = g_object_ref (reader);
 			closure->message_uid = g_strdup (cursor_uid);
 
-			folder = e_mail_reader_ref_folder (reader);
-
 			camel_folder_get_message (
 				folder, cursor_uid, G_PRIORITY_DEFAULT,
 				cancellable, (GAsyncReadyCallback)
@@ -4006,8 +4465,11 @@ set_mail_display_part_list (GObject *object,
 	e_mail_display_set_part_list (display, part_list);
 	e_mail_display_load (display, NULL);
 
-	/* Remove the reference added when parts list was
-	 * created, so that only owners are EMailDisplays. */
+	if (part_list)
+		mail_reader_remember_part_list (reader, part_list);
+
+	/* Remove the reference added when parts list was created, so that
+	 * only owners are EMailDisplays and the recently parsed messages. */
 	g_object_unref (part_list);
 }
 
@@ -4040,6 +4502,7 @@ mail_reader_set_display_formatter_for_message (EMailReader *reader,
 	} else {
 		e_mail_display_set_part_list (display, parts);
 		e_mail_display_load (display, NULL);
+		mail_reader_remember_part_list (reader, parts);
 		g_object_unref (parts);
 	}
 }
@@ -4085,6 +4548,8 @@ mail_reader_message_loaded (EMailReader *reader,
 	mail_reader_set_display_formatter_for_message (
 		reader, display, message_uid, message, folder);
 
+	mail_reader_schedule_read_ahead (reader, folder);
+
 	/* Reset the shell view icon. */
 	e_shell_event (shell, "mail-icon", (gpointer) "evolution-mail");
 
@@ -5342,6 +5807,9 @@ e_mail_reader_dispose (EMailReader *reader)
 	if (priv->retrieving_message)
 		g_cancellable_cancel (priv->retrieving_message);
 
+	mail_reader_cancel_read_ahead (priv);
+	mail_reader_forget_parsed_messages (priv);
+
 	ongoing_operations = g_slist_copy_deep (priv->ongoing_operations, (GCopyFunc) g_object_ref, NULL);
 	g_slist_free (priv->ongoing_operations);
 	priv->ongoing_operations = NULL;
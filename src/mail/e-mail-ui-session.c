@@ -465,6 +465,7 @@ mail_ui_session_constructed (GObject *object)
 	ESourceRegistry *registry;
 	EClientCache *client_cache;
 	EMailSession *session;
+	GSettings *settings;
 	EShell *shell;
 
 	session = E_MAIL_SESSION (object);
@@ -487,6 +488,20 @@ mail_ui_session_constructed (GObject *object)
 	client_cache = e_shell_get_client_cache (shell);
 	priv->photo_cache = e_photo_cache_new (client_cache);
 
+	settings = e_util_ref_settings ("org.gnome.evolution.mail");
+
+	g_settings_bind (
+		settings, "photo-cache-size",
+		priv->photo_cache, "max-cache-size",
+		G_SETTINGS_BIND_GET);
+
+	g_settings_bind (
+		settings, "photo-cache-disk-days",
+		priv->photo_cache, "disk-cache-days",
+		G_SETTINGS_BIND_GET);
+
+	g_object_unref (settings);
+
 	/* XXX Make sure the folder tree model is created before we
 	 *     add built-in CamelStores so it gets signals from the
 	 *     EMailAccountStore.
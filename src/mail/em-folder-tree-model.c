@@ -1076,32 +1076,36 @@ em_folder_tree_model_class_init (EMFolderTreeModelClass *class)
 		G_TYPE_POINTER);
 }
 
-static void
+/* Returns whether the folder's row was updated and sets the @out_iter
+ * to it then.  The caller signals the change of the parent rows. */
+static gboolean
 folder_tree_model_set_unread_count (EMFolderTreeModel *model,
                                     CamelStore *store,
                                     const gchar *full,
                                     gint unread,
-				    MailFolderCache *folder_cache)
+				    MailFolderCache *folder_cache,
+				    GtkTreeIter *out_iter)
 {
 	GtkTreeRowReference *reference;
 	GtkTreeModel *tree_model;
 	GtkTreePath *path;
-	GtkTreeIter parent;
 	GtkTreeIter iter;
 	StoreInfo *si;
 	guint old_unread = 0;
 	gboolean unread_increased = FALSE, is_drafts = FALSE;
+	gboolean row_updated = FALSE;
 
-	g_return_if_fail (EM_IS_FOLDER_TREE_MODEL (model));
-	g_return_if_fail (CAMEL_IS_STORE (store));
-	g_return_if_fail (full != NULL);
+	g_return_val_if_fail (EM_IS_FOLDER_TREE_MODEL (model), FALSE);
+	g_return_val_if_fail (CAMEL_IS_STORE (store), FALSE);
+	g_return_val_if_fail (full != NULL, FALSE);
+	g_return_val_if_fail (out_iter != NULL, FALSE);
 
 	if (unread < 0)
-		return;
+		return FALSE;
 
 	si = folder_tree_model_store_index_lookup (model, store);
 	if (si == NULL)
-		return;
+		return FALSE;
 
 	tree_model = GTK_TREE_MODEL (model);
 
@@ -1168,15 +1172,8 @@ folder_tree_model_set_unread_count (EMFolderTreeModel *model,
 		COL_UINT_UNREAD, unread,
 		COL_UINT_UNREAD_LAST_SEL, MIN (old_unread, unread), -1);
 
-	/* Folders are displayed with a bold weight to indicate that
-	 * they contain unread messages.  We signal that parent rows
-	 * have changed here to update them. */
-	while (gtk_tree_model_iter_parent (tree_model, &parent, &iter)) {
-		path = gtk_tree_model_get_path (tree_model, &parent);
-		gtk_tree_model_row_changed (tree_model, path, &parent);
-		gtk_tree_path_free (path);
-		iter = parent;
-	}
+	*out_iter = iter;
+	row_updated = TRUE;
 
 exit:
 	if (unread_increased && !is_drafts && gtk_tree_row_reference_valid (si->row)) {
@@ -1192,6 +1189,63 @@ exit:
 	}
 
 	store_info_unref (si);
+
+	return row_updated;
+}
+
+static void
+folder_tree_model_folders_unread_updated_cb (MailFolderCache *folder_cache,
+                                             GPtrArray *updates,
+                                             EMFolderTreeModel *model)
+{
+	GtkTreeModel *tree_model;
+	GHashTable *changed_parents;
+	GHashTableIter iter;
+	gpointer key;
+	guint ii;
+
+	g_return_if_fail (updates != NULL);
+
+	tree_model = GTK_TREE_MODEL (model);
+	changed_parents = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (ii = 0; ii < updates->len; ii++) {
+		MailFolderCacheUnread *update = g_ptr_array_index (updates, ii);
+		GtkTreeIter child, parent;
+
+		if (!folder_tree_model_set_unread_count (
+			model, update->store, update->folder_name,
+			update->unread, folder_cache, &child))
+			continue;
+
+		/* Folders are displayed with a bold weight to indicate that
+		 * they contain unread messages.  The parent rows are signalled
+		 * as changed once for all the updated folders. */
+		while (gtk_tree_model_iter_parent (tree_model, &parent, &child)) {
+			GtkTreePath *path;
+
+			path = gtk_tree_model_get_path (tree_model, &parent);
+			g_hash_table_add (changed_parents, gtk_tree_path_to_string (path));
+			gtk_tree_path_free (path);
+			child = parent;
+		}
+	}
+
+	/* Nothing is added or removed meanwhile, thus the paths are valid. */
+	g_hash_table_iter_init (&iter, changed_parents);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		GtkTreePath *path;
+		GtkTreeIter parent;
+
+		path = gtk_tree_path_new_from_string (key);
+
+		if (gtk_tree_model_get_iter (tree_model, &parent, path))
+			gtk_tree_model_row_changed (tree_model, path, &parent);
+
+		gtk_tree_path_free (path);
+	}
+
+	g_hash_table_destroy (changed_parents);
 }
 
 static void
@@ -1376,9 +1430,9 @@ em_folder_tree_model_set_session (EMFolderTreeModel *model,
 			G_CALLBACK (folder_tree_model_services_reordered),
 			model);
 
-		g_signal_connect_swapped (
-			folder_cache, "folder-unread-updated",
-			G_CALLBACK (folder_tree_model_set_unread_count),
+		g_signal_connect (
+			folder_cache, "folders-unread-updated",
+			G_CALLBACK (folder_tree_model_folders_unread_updated_cb),
 			model);
 	}
 
@@ -300,6 +300,7 @@ mail_importer_elm_import (EImport *ei,
 		G_CALLBACK (elm_status), m);
 
 	id = m->base.seq;
+	m->base.priority = MAIL_MSG_PRIORITY_BULK;
 
 	mail_msg_fast_ordered_push (m);
 
@@ -102,20 +102,14 @@ decode_mozilla_status (const gchar *tmp)
 	return flags;
 }
 
-static void
-import_mbox_add_message (CamelFolder *folder,
-			 CamelMimeMessage *msg,
-			 GCancellable *cancellable,
-			 GError **error)
+static CamelMessageInfo *
+import_mbox_message_info_new (CamelMimeMessage *msg,
+			      guint32 flags)
 {
 	CamelMessageInfo *info;
 	CamelMedium *medium;
-	guint32 flags = 0;
 	const gchar *tmp;
 
-	g_return_if_fail (CAMEL_IS_FOLDER (folder));
-	g_return_if_fail (CAMEL_IS_MIME_MESSAGE (msg));
-
 	medium = CAMEL_MEDIUM (msg);
 
 	tmp = camel_medium_get_header (medium, "X-Mozilla-Status");
@@ -131,12 +125,445 @@ import_mbox_add_message (CamelFolder *folder,
 	info = camel_message_info_new (NULL);
 
 	camel_message_info_set_flags (info, flags, ~0);
+
+	return info;
+}
+
+static void
+import_mbox_add_message (CamelFolder *folder,
+			 CamelMimeMessage *msg,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	CamelMessageInfo *info;
+
+	g_return_if_fail (CAMEL_IS_FOLDER (folder));
+	g_return_if_fail (CAMEL_IS_MIME_MESSAGE (msg));
+
+	info = import_mbox_message_info_new (msg, 0);
+
 	camel_folder_append_message_sync (
 		folder, msg, info, NULL,
 		cancellable, error);
 	g_clear_object (&info);
 }
 
+/* The import pipeline parses messages on a thread pool, while the messages
+ * are appended to the folder in the order they were pushed, by the thread
+ * which pushes them.  The number of messages in flight is limited, thus
+ * the memory use does not depend on the size of the imported data. */
+
+#define IMPORT_MAX_THREADS 4
+#define IMPORT_MAX_IN_FLIGHT 64
+
+typedef struct _ImportItem ImportItem;
+typedef struct _ImportPipeline ImportPipeline;
+
+typedef void (* ImportAppendedFunc) (ImportPipeline *pipeline,
+				     goffset offset,
+				     gpointer user_data);
+
+struct _ImportItem {
+	GBytes *bytes;
+	guint32 flags;
+	goffset offset;		/* Where the source continues after this message */
+
+	gboolean parsed;
+	gboolean skipped;	/* Not parsed, because the import was cancelled */
+	CamelMimeMessage *message;
+	CamelMessageInfo *info;
+};
+
+struct _ImportPipeline {
+	CamelFolder *folder;
+	GCancellable *cancellable;
+	GThreadPool *pool;
+
+	GMutex lock;
+	GCond cond;
+	GQueue items;		/* ImportItem *, in the order of the source */
+
+	ImportAppendedFunc appended_func;
+	gpointer appended_data;
+};
+
+static void
+import_item_free (ImportItem *item)
+{
+	if (item) {
+		if (item->bytes)
+			g_bytes_unref (item->bytes);
+		g_clear_object (&item->message);
+		g_clear_object (&item->info);
+		g_slice_free (ImportItem, item);
+	}
+}
+
+static void
+import_pipeline_parse_thread (gpointer data,
+			      gpointer user_data)
+{
+	ImportItem *item = data;
+	ImportPipeline *pipeline = user_data;
+	CamelMimeMessage *msg = NULL;
+	CamelMessageInfo *info = NULL;
+
+	if (!g_cancellable_is_cancelled (pipeline->cancellable)) {
+		CamelMimeParser *mp;
+		GInputStream *stream;
+
+		stream = g_memory_input_stream_new_from_bytes (item->bytes);
+
+		mp = camel_mime_parser_new ();
+		camel_mime_parser_scan_from (mp, FALSE);
+		camel_mime_parser_init_with_input_stream (mp, stream);
+
+		msg = camel_mime_message_new ();
+		if (camel_mime_part_construct_from_parser_sync (CAMEL_MIME_PART (msg), mp, NULL, NULL))
+			info = import_mbox_message_info_new (msg, item->flags);
+		else
+			g_clear_object (&msg);
+
+		g_object_unref (mp);
+		g_object_unref (stream);
+	}
+
+	g_mutex_lock (&pipeline->lock);
+
+	g_bytes_unref (item->bytes);
+	item->bytes = NULL;
+	item->message = msg;
+	item->info = info;
+	item->skipped = !msg && g_cancellable_is_cancelled (pipeline->cancellable);
+	item->parsed = TRUE;
+
+	g_cond_broadcast (&pipeline->cond);
+
+	g_mutex_unlock (&pipeline->lock);
+}
+
+static ImportPipeline *
+import_pipeline_new (CamelFolder *folder,
+		     GCancellable *cancellable,
+		     ImportAppendedFunc appended_func,
+		     gpointer appended_data)
+{
+	ImportPipeline *pipeline;
+
+	pipeline = g_slice_new0 (ImportPipeline);
+	pipeline->folder = g_object_ref (folder);
+	pipeline->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	pipeline->appended_func = appended_func;
+	pipeline->appended_data = appended_data;
+
+	g_mutex_init (&pipeline->lock);
+	g_cond_init (&pipeline->cond);
+	g_queue_init (&pipeline->items);
+
+	pipeline->pool = g_thread_pool_new (
+		import_pipeline_parse_thread, pipeline,
+		CLAMP (g_get_num_processors (), 1, IMPORT_MAX_THREADS),
+		FALSE, NULL);
+
+	return pipeline;
+}
+
+static void
+import_pipeline_free (ImportPipeline *pipeline)
+{
+	if (!pipeline)
+		return;
+
+	/* Wait for the parsers to finish */
+	g_thread_pool_free (pipeline->pool, FALSE, TRUE);
+
+	g_queue_free_full (&pipeline->items, (GDestroyNotify) import_item_free);
+	g_mutex_clear (&pipeline->lock);
+	g_cond_clear (&pipeline->cond);
+	g_clear_object (&pipeline->cancellable);
+	g_clear_object (&pipeline->folder);
+	g_slice_free (ImportPipeline, pipeline);
+}
+
+/* Takes ownership of the @bytes */
+static void
+import_pipeline_push (ImportPipeline *pipeline,
+		      GBytes *bytes,
+		      guint32 flags,
+		      goffset offset)
+{
+	ImportItem *item;
+
+	item = g_slice_new0 (ImportItem);
+	item->bytes = bytes;
+	item->flags = flags;
+	item->offset = offset;
+
+	g_mutex_lock (&pipeline->lock);
+	g_queue_push_tail (&pipeline->items, item);
+	g_mutex_unlock (&pipeline->lock);
+
+	g_thread_pool_push (pipeline->pool, item, NULL);
+}
+
+/* Appends already parsed messages to the folder.  With @wait_all set it
+ * waits for all pushed messages, otherwise it waits only when too many
+ * messages are in flight. */
+static gboolean
+import_pipeline_flush (ImportPipeline *pipeline,
+		       gboolean wait_all,
+		       GError **error)
+{
+	gboolean success = TRUE;
+
+	g_mutex_lock (&pipeline->lock);
+
+	while (success) {
+		GQueue batch = G_QUEUE_INIT;
+		ImportItem *item;
+
+		while (item = g_queue_peek_head (&pipeline->items), item && item->parsed) {
+			g_queue_push_tail (&batch, g_queue_pop_head (&pipeline->items));
+		}
+
+		if (g_queue_is_empty (&batch)) {
+			guint length = g_queue_get_length (&pipeline->items);
+
+			if (!length || (!wait_all && length < IMPORT_MAX_IN_FLIGHT))
+				break;
+
+			g_cond_wait (&pipeline->cond, &pipeline->lock);
+			continue;
+		}
+
+		g_mutex_unlock (&pipeline->lock);
+
+		while (item = g_queue_pop_head (&batch), item) {
+			if (success && item->message) {
+				success = camel_folder_append_message_sync (
+					pipeline->folder, item->message, item->info, NULL,
+					pipeline->cancellable, error);
+			}
+
+			/* The offset is advanced only past the messages, which were
+			 * appended or which cannot be parsed, the skipped ones are
+			 * imported again when the import is resumed. */
+			if (success && pipeline->appended_func && !item->skipped &&
+			    !g_cancellable_is_cancelled (pipeline->cancellable))
+				pipeline->appended_func (pipeline, item->offset, pipeline->appended_data);
+
+			import_item_free (item);
+		}
+
+		g_mutex_lock (&pipeline->lock);
+	}
+
+	g_mutex_unlock (&pipeline->lock);
+
+	return success;
+}
+
+/* The offset of the first "From " line at or after @from, or @length */
+static gsize
+import_mbox_find_from_line (const gchar *contents,
+			    gsize from,
+			    gsize length)
+{
+	const gchar *ptr;
+
+	while (from < length) {
+		if ((from == 0 || contents[from - 1] == '\n') &&
+		    length - from >= 5 &&
+		    strncmp (contents + from, "From ", 5) == 0)
+			return from;
+
+		ptr = memchr (contents + from, '\n', length - from);
+		if (!ptr)
+			break;
+
+		from = ptr - contents + 1;
+	}
+
+	return length;
+}
+
+/* The resume information remembers how far the import of a file got,
+ * thus an interrupted import of a large file can continue where it
+ * stopped, instead of starting over and creating duplicates. */
+
+#define IMPORT_RESUME_EVERY 500
+
+typedef struct _ImportMboxProgress {
+	CamelFolder *folder;
+	GCancellable *cancellable;
+	gchar *resume_group;
+	goffset size;
+	guint n_appended;
+} ImportMboxProgress;
+
+static gchar *
+import_mbox_resume_dup_group (const gchar *path,
+			      const gchar *uri,
+			      const struct stat *st)
+{
+	gchar *key, *group;
+
+	key = g_strdup_printf ("%s\n%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT,
+		path, uri ? uri : "", (gint64) st->st_size, (gint64) st->st_mtime);
+	group = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+	g_free (key);
+
+	return group;
+}
+
+static GKeyFile *
+import_mbox_resume_load (gchar **out_filename)
+{
+	GKeyFile *key_file;
+
+	*out_filename = g_build_filename (mail_session_get_cache_dir (), "import-resume.ini", NULL);
+
+	key_file = g_key_file_new ();
+	g_key_file_load_from_file (key_file, *out_filename, G_KEY_FILE_NONE, NULL);
+
+	return key_file;
+}
+
+static goffset
+import_mbox_resume_get_offset (const gchar *group)
+{
+	GKeyFile *key_file;
+	gchar *filename;
+	goffset offset;
+
+	key_file = import_mbox_resume_load (&filename);
+	offset = g_key_file_get_int64 (key_file, group, "offset", NULL);
+	g_key_file_free (key_file);
+	g_free (filename);
+
+	return offset;
+}
+
+/* Offset 0 forgets the resume information */
+static void
+import_mbox_resume_set_offset (const gchar *group,
+			       goffset offset)
+{
+	GKeyFile *key_file;
+	gchar *filename;
+
+	key_file = import_mbox_resume_load (&filename);
+
+	if (offset > 0)
+		g_key_file_set_int64 (key_file, group, "offset", offset);
+	else
+		g_key_file_remove_group (key_file, group, NULL);
+
+	if (g_mkdir_with_parents (mail_session_get_cache_dir (), 0700) == 0)
+		g_key_file_save_to_file (key_file, filename, NULL);
+
+	g_key_file_free (key_file);
+	g_free (filename);
+}
+
+static void
+import_mbox_appended_cb (ImportPipeline *pipeline,
+			 goffset offset,
+			 gpointer user_data)
+{
+	ImportMboxProgress *progress = user_data;
+
+	if (progress->size > 0)
+		camel_operation_progress (progress->cancellable, (gint) (offset * 100 / progress->size));
+
+	progress->n_appended++;
+
+	if ((progress->n_appended % IMPORT_RESUME_EVERY) == 0) {
+		/* Make sure the messages are stored, before claiming so */
+		camel_folder_synchronize_sync (progress->folder, FALSE, NULL, NULL);
+		import_mbox_resume_set_offset (progress->resume_group, offset);
+	}
+}
+
+/* Splits the memory-mapped mbox file at the "From " lines and imports
+ * the messages through the import pipeline.  Returns FALSE, when the file
+ * contains no "From " line, thus it is not an mbox file. */
+static gboolean
+import_mbox_mapped_sync (struct _import_mbox_msg *m,
+			 CamelFolder *folder,
+			 GMappedFile *mapped,
+			 const struct stat *st,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	ImportPipeline *pipeline;
+	ImportMboxProgress progress;
+	GBytes *file_bytes;
+	const gchar *contents;
+	gsize length, pos, resume_offset;
+	gboolean success = TRUE;
+
+	contents = g_mapped_file_get_contents (mapped);
+	length = g_mapped_file_get_length (mapped);
+
+	pos = contents ? import_mbox_find_from_line (contents, 0, length) : length;
+	if (pos >= length)
+		return FALSE;
+
+	memset (&progress, 0, sizeof (ImportMboxProgress));
+	progress.folder = folder;
+	progress.cancellable = cancellable;
+	progress.resume_group = import_mbox_resume_dup_group (m->path, m->uri, st);
+	progress.size = length;
+
+	resume_offset = import_mbox_resume_get_offset (progress.resume_group);
+	if (resume_offset > pos && resume_offset < length &&
+	    import_mbox_find_from_line (contents, resume_offset, length) == resume_offset)
+		pos = resume_offset;
+
+	file_bytes = g_mapped_file_get_bytes (mapped);
+	pipeline = import_pipeline_new (folder, cancellable, import_mbox_appended_cb, &progress);
+
+	while (success && pos < length && !g_cancellable_is_cancelled (cancellable)) {
+		const gchar *from_end;
+		gsize body_start, body_end, next_pos;
+
+		from_end = memchr (contents + pos, '\n', length - pos);
+		if (!from_end)
+			break;
+
+		body_start = from_end - contents + 1;
+		next_pos = import_mbox_find_from_line (contents, body_start, length);
+
+		/* The line break before the next "From " line is a separator */
+		body_end = next_pos;
+		if (body_end < length && body_end > body_start)
+			body_end--;
+
+		import_pipeline_push (pipeline,
+			g_bytes_new_from_bytes (file_bytes, body_start, body_end - body_start),
+			0, next_pos);
+
+		success = import_pipeline_flush (pipeline, FALSE, error);
+
+		pos = next_pos;
+	}
+
+	if (success)
+		success = import_pipeline_flush (pipeline, TRUE, error);
+
+	import_pipeline_free (pipeline);
+	g_bytes_unref (file_bytes);
+
+	/* The whole file is imported, nothing to resume */
+	if (success && pos >= length && !g_cancellable_is_cancelled (cancellable))
+		import_mbox_resume_set_offset (progress.resume_group, 0);
+
+	g_free (progress.resume_group);
+
+	return TRUE;
+}
+
 static void
 import_mbox_exec (struct _import_mbox_msg *m,
                   GCancellable *cancellable,
@@ -169,8 +596,34 @@ import_mbox_exec (struct _import_mbox_msg *m,
 		return;
 
 	if (S_ISREG (st.st_mode)) {
+		GMappedFile *mapped;
 		gboolean any_read = FALSE;
 
+		mapped = g_mapped_file_new (m->path, FALSE, NULL);
+		if (mapped) {
+			camel_operation_push_message (
+				cancellable, _("Importing “%s”"),
+				camel_folder_get_display_name (folder));
+			camel_folder_freeze (folder);
+
+			any_read = import_mbox_mapped_sync (m, folder, mapped, &st, cancellable, error);
+
+			g_mapped_file_unref (mapped);
+
+			if (any_read) {
+				/* Not passing a GCancellable or GError here. */
+				camel_folder_synchronize_sync (folder, FALSE, NULL, NULL);
+				camel_folder_thaw (folder);
+				camel_operation_pop_message (cancellable);
+				goto fail1;
+			}
+
+			camel_folder_thaw (folder);
+			camel_operation_pop_message (cancellable);
+		}
+
+		/* Fallback for files which cannot be mapped, or which are not
+		 * mbox files; these can contain a single message. */
 		fd = g_open (m->path, O_RDONLY | O_BINARY, 0);
 		if (fd == -1) {
 			g_warning (
@@ -278,10 +731,8 @@ import_kmail_folder (struct _import_mbox_msg *m,
 	gchar *special_path;
 	const CamelStore *store;
 	CamelFolder *folder;
-	CamelMimeParser *mp = NULL;
-	CamelMessageInfo *info;
-	CamelMimeMessage *msg;
-	guint32 flags = 0;
+	ImportPipeline *pipeline;
+	gboolean success = TRUE;
 
 	gchar *e_uri, *e_path;
 	gchar *k_path;
@@ -289,7 +740,7 @@ import_kmail_folder (struct _import_mbox_msg *m,
 	gchar *mail_url;
 	GDir *dir;
 	struct stat st;
-	gint fd, i;
+	gint i;
 
 	e_uri = kuri_to_euri (k_path_in);
 	/* we need to drop some folders, like: Trash */
@@ -316,58 +767,54 @@ import_kmail_folder (struct _import_mbox_msg *m,
 			camel_folder_get_display_name (folder));
 	camel_folder_freeze (folder);
 
-	for (i = 0; special_folders [i]; i++) {
+	pipeline = import_pipeline_new (folder, cancellable, NULL, NULL);
+
+	for (i = 0; special_folders [i] && success; i++) {
+		guint32 flags = 0;
+
 		camel_operation_progress (cancellable, 100*i/3);
+
+		if (strcmp (special_folders[i], "cur") == 0) {
+			flags |= CAMEL_MESSAGE_SEEN;
+		} else if (strcmp (special_folders[i], "tmp") == 0) {
+			flags |= CAMEL_MESSAGE_DELETED; /* Mark the 'tmp' mails as 'deleted' */
+		}
+
 		special_path = g_build_filename (k_path, special_folders[i], NULL);
 		dir = g_dir_open (special_path, 0, NULL);
-		while ((d = g_dir_read_name (dir))) {
+		g_free (special_path);
+		if (!dir)
+			continue;
+
+		while (success && (d = g_dir_read_name (dir))) {
+			gchar *contents = NULL;
+			gsize length = 0;
+
 			if ((strcmp (d, ".") == 0) || (strcmp (d, "..") == 0)) {
 				continue;
 			}
-			mail_url = g_build_filename (special_path, d, NULL);
-			if (g_stat (mail_url, &st) == -1) {
+			mail_url = g_build_filename (k_path, special_folders[i], d, NULL);
+			if (g_stat (mail_url, &st) == -1 || !S_ISREG (st.st_mode) ||
+			    !g_file_get_contents (mail_url, &contents, &length, NULL)) {
 				g_free (mail_url);
 				continue;
 			}
-			if (S_ISREG (st.st_mode)) {
-				fd = g_open (mail_url, O_RDONLY | O_BINARY, 0);
-				g_free (mail_url);
-				if (fd == -1) {
-					continue;
-				}
-				mp = camel_mime_parser_new ();
-				camel_mime_parser_scan_from (mp, FALSE);
-				if (camel_mime_parser_init_with_fd (mp, fd) == -1) {
-					/* will never happen - 0 is unconditionally returned */
-					g_object_unref (mp);
-					continue;
-				}
-				msg = camel_mime_message_new ();
-				if (!camel_mime_part_construct_from_parser_sync (
-						(CamelMimePart *) msg, mp, NULL, NULL)) {
-					/* set exception? */
-					g_object_unref (mp);
-					g_object_unref (msg);
-					continue;
-				}
-				info = camel_message_info_new (NULL);
-				if (strcmp (special_folders[i], "cur") == 0) {
-					flags |= CAMEL_MESSAGE_SEEN;
-				} else if (strcmp (special_folders[i], "tmp") == 0) {
-					flags |= CAMEL_MESSAGE_DELETED; /* Mark the 'tmp' mails as 'deleted' */
-				}
-				camel_message_info_set_flags (info, flags, ~0);
-				camel_folder_append_message_sync (
-					folder, msg, info, NULL,
-					cancellable, error);
-				g_clear_object (&info);
-				g_object_unref (msg);
-				g_object_unref (mp);
-			} else {
-				g_free (mail_url);
-			}
+			g_free (mail_url);
+
+			/* Each file is one message, parsed by the pipeline */
+			import_pipeline_push (pipeline, g_bytes_new_take (contents, length), flags, 0);
+
+			success = import_pipeline_flush (pipeline, FALSE, error);
 		}
+
+		g_dir_close (dir);
 	}
+
+	if (success)
+		import_pipeline_flush (pipeline, TRUE, error);
+
+	import_pipeline_free (pipeline);
+
 	camel_operation_progress (cancellable, 100);
 	camel_folder_synchronize_sync (folder, FALSE, NULL, NULL);
 	camel_folder_thaw (folder);
@@ -459,6 +906,7 @@ mail_importer_import_mbox (EMailSession *session,
 	m->uri = g_strdup (folderuri);
 	m->done = done;
 	m->done_data = data;
+	m->base.priority = MAIL_MSG_PRIORITY_BULK;
 
 	id = m->base.seq;
 	mail_msg_fast_ordered_push (m);
@@ -502,6 +950,7 @@ mail_importer_import_kmail (EMailSession *session,
 	m->uri = g_strdup (folderuri);
 	m->done = done;
 	m->done_data = data;
+	m->base.priority = MAIL_MSG_PRIORITY_BULK;
 	id = m->base.seq;
 	mail_msg_fast_ordered_push (m);
 
@@ -372,6 +372,7 @@ mail_importer_pine_import (EImport *ei,
 		G_CALLBACK (pine_status), m);
 
 	id = m->base.seq;
+	m->base.priority = MAIL_MSG_PRIORITY_BULK;
 
 	mail_msg_fast_ordered_push (m);
 
@@ -1437,17 +1437,164 @@ refresh_folders_desc (struct _refresh_folders_msg *m)
 		camel_service_get_display_name (CAMEL_SERVICE (m->store)));
 }
 
+/* Moves the folders opened in the store, like the one shown in the UI
+   and those used recently, to the beginning of the 'folders' array. */
+static void
+refresh_folders_prioritize (CamelStore *store,
+			    GPtrArray *folders)
+{
+	GPtrArray *opened_folders;
+	GHashTable *opened_uris;
+	GPtrArray *sorted;
+	guint ii;
+
+	opened_folders = camel_store_dup_opened_folders (store);
+	if (!opened_folders)
+		return;
+
+	opened_uris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (ii = 0; ii < opened_folders->len; ii++) {
+		CamelFolder *folder = g_ptr_array_index (opened_folders, ii);
+
+		g_hash_table_add (opened_uris, e_mail_folder_uri_from_folder (folder));
+	}
+
+	g_ptr_array_foreach (opened_folders, (GFunc) g_object_unref, NULL);
+	g_ptr_array_free (opened_folders, TRUE);
+
+	if (g_hash_table_size (opened_uris) > 0) {
+		sorted = g_ptr_array_sized_new (folders->len);
+
+		for (ii = 0; ii < folders->len; ii++) {
+			if (g_hash_table_contains (opened_uris, folders->pdata[ii]))
+				g_ptr_array_add (sorted, folders->pdata[ii]);
+		}
+
+		for (ii = 0; ii < folders->len; ii++) {
+			if (!g_hash_table_contains (opened_uris, folders->pdata[ii]))
+				g_ptr_array_add (sorted, folders->pdata[ii]);
+		}
+
+		memcpy (folders->pdata, sorted->pdata, sizeof (gpointer) * folders->len);
+
+		g_ptr_array_free (sorted, TRUE);
+	}
+
+	g_hash_table_destroy (opened_uris);
+}
+
+typedef struct _RefreshFoldersData {
+	struct _refresh_folders_msg *m;
+	GCancellable *cancellable;
+	EMailBackend *mail_backend;
+	gboolean expunge;
+
+	GMutex lock;
+	GHashTable *known_errors;
+	gint next_folder; /* atomic */
+	gint n_done; /* atomic */
+	gint stop; /* atomic */
+} RefreshFoldersData;
+
+static void
+refresh_folders_refresh_one (RefreshFoldersData *rfd,
+			     const gchar *folder_uri)
+{
+	struct _refresh_folders_msg *m = rfd->m;
+	GCancellable *cancellable = rfd->cancellable;
+	CamelFolder *folder;
+	GError *local_error = NULL;
+
+	folder = e_mail_session_uri_to_folder_sync (
+		E_MAIL_SESSION (m->info->session),
+		folder_uri, 0,
+		cancellable, &local_error);
+	if (folder && camel_folder_synchronize_sync (folder, rfd->expunge, cancellable, &local_error))
+		camel_folder_refresh_info_sync (folder, cancellable, &local_error);
+
+	if (folder && !local_error && rfd->mail_backend) {
+		em_utils_process_autoarchive_sync (rfd->mail_backend, folder, folder_uri, cancellable, &local_error);
+	}
+
+	if (local_error != NULL) {
+		const gchar *error_message = local_error->message ? local_error->message : _("Unknown error");
+
+		g_mutex_lock (&rfd->lock);
+
+		if (g_hash_table_contains (rfd->known_errors, error_message)) {
+			/* Received the same error message multiple times; there can be some
+			   connection issue probably, thus skip the rest folder updates for now */
+			g_atomic_int_set (&rfd->stop, 1);
+		} else if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			CamelStore *store;
+			const gchar *full_name;
+
+			if (folder) {
+				store = camel_folder_get_parent_store (folder);
+				full_name = camel_folder_get_full_name (folder);
+			} else {
+				store = m->store;
+				full_name = folder_uri;
+			}
+
+			report_error_to_ui (CAMEL_SERVICE (store), full_name, local_error, NULL);
+
+			/* To not report one error for multiple folders multiple times */
+			g_hash_table_insert (rfd->known_errors, g_strdup (error_message), GINT_TO_POINTER (1));
+		}
+
+		g_mutex_unlock (&rfd->lock);
+
+		g_clear_error (&local_error);
+	}
+
+	if (folder)
+		g_object_unref (folder);
+}
+
+static gpointer
+refresh_folders_thread (gpointer user_data)
+{
+	RefreshFoldersData *rfd = user_data;
+	struct _refresh_folders_msg *m = rfd->m;
+
+	while (!g_atomic_int_get (&rfd->stop)) {
+		gint index, n_done;
+
+		index = g_atomic_int_add (&rfd->next_folder, 1);
+		if (index >= m->folders->len)
+			break;
+
+		refresh_folders_refresh_one (rfd, m->folders->pdata[index]);
+
+		if (g_cancellable_is_cancelled (m->info->cancellable) ||
+		    g_cancellable_is_cancelled (rfd->cancellable)) {
+			g_atomic_int_set (&rfd->stop, 1);
+			break;
+		}
+
+		n_done = g_atomic_int_add (&rfd->n_done, 1) + 1;
+
+		if (m->info->state != SEND_CANCELLED)
+			camel_operation_progress (
+				m->info->cancellable, 100 * n_done / m->folders->len);
+	}
+
+	return NULL;
+}
+
 static void
 refresh_folders_exec (struct _refresh_folders_msg *m,
                       GCancellable *cancellable,
                       GError **error)
 {
-	CamelFolder *folder;
-	gint i;
+	RefreshFoldersData rfd;
+	GPtrArray *threads;
+	GSettings *settings;
+	gint n_threads, ii;
 	gboolean success;
 	gboolean delete_junk = FALSE, expunge = FALSE;
-	GHashTable *known_errors;
-	EMailBackend *mail_backend;
 	GError *local_error = NULL;
 	gulong handler_id = 0;
 
@@ -1466,6 +1613,7 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 	}
 
 	get_folders (m->store, m->folders, m->finfo);
+	refresh_folders_prioritize (m->store, m->folders);
 
 	camel_operation_push_message (m->info->cancellable, _("Updating…"));
 
@@ -1476,66 +1624,44 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 		goto exit;
 	}
 
-	mail_backend = E_MAIL_BACKEND (e_shell_get_backend_by_name (e_shell_get_default (), "mail"));
-
-	known_errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	settings = e_util_ref_settings ("org.gnome.evolution.mail");
+	n_threads = g_settings_get_int (settings, "send-recv-refresh-threads");
+	g_object_unref (settings);
 
-	for (i = 0; i < m->folders->len; i++) {
-		folder = e_mail_session_uri_to_folder_sync (
-			E_MAIL_SESSION (m->info->session),
-			m->folders->pdata[i], 0,
-			cancellable, &local_error);
-		if (folder && camel_folder_synchronize_sync (folder, expunge, cancellable, &local_error))
-			camel_folder_refresh_info_sync (folder, cancellable, &local_error);
+	n_threads = CLAMP (n_threads, 1, MAX ((gint) m->folders->len, 1));
 
-		if (folder && !local_error && mail_backend) {
-			em_utils_process_autoarchive_sync (mail_backend, folder, m->folders->pdata[i], cancellable, &local_error);
-		}
-
-		if (local_error != NULL) {
-			const gchar *error_message = local_error->message ? local_error->message : _("Unknown error");
-
-			if (g_hash_table_contains (known_errors, error_message)) {
-				/* Received the same error message multiple times; there can be some
-				   connection issue probably, thus skip the rest folder updates for now */
-				g_clear_object (&folder);
-				g_clear_error (&local_error);
-				break;
-			} else if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
-				CamelStore *store;
-				const gchar *full_name;
-
-				if (folder) {
-					store = camel_folder_get_parent_store (folder);
-					full_name = camel_folder_get_full_name (folder);
-				} else {
-					store = m->store;
-					full_name = (const gchar *) m->folders->pdata[i];
-				}
+	memset (&rfd, 0, sizeof (RefreshFoldersData));
+	rfd.m = m;
+	rfd.cancellable = cancellable;
+	rfd.mail_backend = E_MAIL_BACKEND (e_shell_get_backend_by_name (e_shell_get_default (), "mail"));
+	rfd.expunge = expunge;
+	rfd.known_errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_mutex_init (&rfd.lock);
 
-				report_error_to_ui (CAMEL_SERVICE (store), full_name, local_error, NULL);
+	threads = g_ptr_array_new ();
 
-				/* To not report one error for multiple folders multiple times */
-				g_hash_table_insert (known_errors, g_strdup (error_message), GINT_TO_POINTER (1));
-			}
+	/* The current thread is one of the workers */
+	for (ii = 1; ii < n_threads; ii++) {
+		GThread *thread;
 
-			g_clear_error (&local_error);
-		}
+		thread = g_thread_try_new ("refresh-folders", refresh_folders_thread, &rfd, NULL);
+		if (!thread)
+			break;
 
-		if (folder)
-			g_object_unref (folder);
+		g_ptr_array_add (threads, thread);
+	}
 
-		if (g_cancellable_is_cancelled (m->info->cancellable) ||
-		    g_cancellable_is_cancelled (cancellable))
-			break;
+	refresh_folders_thread (&rfd);
 
-		if (m->info->state != SEND_CANCELLED)
-			camel_operation_progress (
-				m->info->cancellable, 100 * i / m->folders->len);
+	for (ii = 0; ii < threads->len; ii++) {
+		g_thread_join (threads->pdata[ii]);
 	}
 
+	g_ptr_array_free (threads, TRUE);
+
 	camel_operation_pop_message (m->info->cancellable);
-	g_hash_table_destroy (known_errors);
+	g_hash_table_destroy (rfd.known_errors);
+	g_mutex_clear (&rfd.lock);
 
 exit:
 	if (handler_id > 0)
@@ -1607,6 +1733,7 @@ receive_update_got_folderinfo (GObject *source_object,
 		m->folders = folders;
 		m->info = send_info;
 		m->finfo = info;  /* takes ownership */
+		m->base.priority = MAIL_MSG_PRIORITY_BULK;
 
 		mail_msg_unordered_push (m);
 
@@ -71,6 +71,10 @@
 #define EXCLUDE_DELETED_MESSAGES_EXPR	"(not (system-flag \"deleted\"))"
 #define EXCLUDE_JUNK_MESSAGES_EXPR	"(not (system-flag \"junk\"))"
 
+/* How many changed UIDs the search cache can collect before it is
+ * cheaper to search the whole folder again. */
+#define REGEN_CACHE_MAX_CHANGES 50000
+
 typedef struct _ExtendedGNode ExtendedGNode;
 typedef struct _RegenData RegenData;
 
@@ -92,6 +96,19 @@ struct _MessageListPrivate {
 	RegenData *regen_data;
 	guint regen_idle_id;
 
+	/* Result of the last completed search, which the next regen
+	 * can update with the folder changes received since then,
+	 * instead of searching the whole folder again.  All members
+	 * are guarded by the regen_lock. */
+	CamelFolder *regen_cache_folder; /* not referenced, only compared */
+	gchar *regen_cache_expr;
+	GPtrArray *regen_cache_uids; /* const gchar * from Camel's string pool */
+	guint regen_cache_serial; /* serial of the changes the result includes */
+	guint regen_cache_stamp; /* incremented when the cache is invalidated */
+	GPtrArray *regen_cache_changes; /* CamelFolderChangeInfo * */
+	guint regen_cache_changes_serial; /* serial of the first item */
+	guint regen_cache_n_changes; /* UIDs in all the regen_cache_changes */
+
 	gboolean thaw_needs_regen;
 
 	GMutex thread_tree_lock;
@@ -165,6 +182,13 @@ struct _RegenData {
 	gboolean folder_changed;
 	GHashTable *removed_uids; /* gchar *~>NULL */
 
+	/* Search result to be stored in the search cache when the regen
+	 * finishes, with the cache state it had been computed against. */
+	gchar *cache_expr;
+	GPtrArray *cache_uids;
+	guint cache_serial;
+	guint cache_stamp;
+
 	CamelFolder *folder;
 	GPtrArray *summary;
 
@@ -557,6 +581,11 @@ regen_data_unref (RegenData *regen_data)
 
 		if (regen_data->removed_uids)
 			g_hash_table_destroy (regen_data->removed_uids);
+
+		g_free (regen_data->cache_expr);
+		if (regen_data->cache_uids)
+			g_ptr_array_unref (regen_data->cache_uids);
+
 		g_clear_object (&regen_data->folder);
 
 		if (regen_data->expand_state != NULL)
@@ -604,6 +633,473 @@ message_list_ref_regen_data (MessageList *message_list)
 	return regen_data;
 }
 
+static guint
+ml_change_info_count (CamelFolderChangeInfo *changes)
+{
+	return changes->uid_added->len +
+		changes->uid_removed->len +
+		changes->uid_changed->len;
+}
+
+/* Call with the regen_lock held. */
+static void
+regen_cache_invalidate_locked (MessageList *message_list)
+{
+	MessageListPrivate *priv = message_list->priv;
+
+	g_clear_pointer (&priv->regen_cache_expr, g_free);
+	g_clear_pointer (&priv->regen_cache_uids, g_ptr_array_unref);
+
+	priv->regen_cache_changes_serial += priv->regen_cache_changes->len;
+	priv->regen_cache_serial = priv->regen_cache_changes_serial;
+	g_ptr_array_set_size (priv->regen_cache_changes, 0);
+	priv->regen_cache_n_changes = 0;
+
+	/* Make sure results of already running regens are not stored. */
+	priv->regen_cache_stamp++;
+}
+
+static void
+regen_cache_reset (MessageList *message_list,
+                   CamelFolder *folder)
+{
+	g_mutex_lock (&message_list->priv->regen_lock);
+
+	regen_cache_invalidate_locked (message_list);
+	message_list->priv->regen_cache_folder = folder;
+
+	g_mutex_unlock (&message_list->priv->regen_lock);
+}
+
+static void
+regen_cache_add_changes (MessageList *message_list,
+                         CamelFolder *folder,
+                         CamelFolderChangeInfo *changes)
+{
+	MessageListPrivate *priv = message_list->priv;
+	guint n_changes;
+
+	n_changes = ml_change_info_count (changes);
+
+	if (n_changes == 0)
+		return;
+
+	g_mutex_lock (&priv->regen_lock);
+
+	if (priv->regen_cache_folder == folder) {
+		if (priv->regen_cache_n_changes + n_changes > REGEN_CACHE_MAX_CHANGES) {
+			regen_cache_invalidate_locked (message_list);
+		} else {
+			CamelFolderChangeInfo *copy;
+
+			copy = camel_folder_change_info_new ();
+			camel_folder_change_info_cat (copy, changes);
+
+			g_ptr_array_add (priv->regen_cache_changes, copy);
+			priv->regen_cache_n_changes += n_changes;
+		}
+	}
+
+	g_mutex_unlock (&priv->regen_lock);
+}
+
+#define ML_EXPR_MAX_DEPTH 32
+
+typedef enum {
+	ML_EXPR_TOKEN_END,
+	ML_EXPR_TOKEN_OPEN,
+	ML_EXPR_TOKEN_CLOSE,
+	ML_EXPR_TOKEN_STRING,
+	ML_EXPR_TOKEN_ATOM
+} MLExprToken;
+
+/* Reads the next token of a search expression. The @out_start and @out_len
+ * are set to the token text, which for strings is without the quotes. */
+static MLExprToken
+ml_expr_next_token (const gchar **pexpr,
+                    const gchar **out_start,
+                    gsize *out_len)
+{
+	const gchar *ptr = *pexpr;
+	MLExprToken token;
+
+	while (*ptr && g_ascii_isspace (*ptr))
+		ptr++;
+
+	*out_start = ptr;
+
+	if (!*ptr) {
+		token = ML_EXPR_TOKEN_END;
+	} else if (*ptr == '(') {
+		token = ML_EXPR_TOKEN_OPEN;
+		ptr++;
+	} else if (*ptr == ')') {
+		token = ML_EXPR_TOKEN_CLOSE;
+		ptr++;
+	} else if (*ptr == '\"') {
+		token = ML_EXPR_TOKEN_STRING;
+		ptr++;
+		*out_start = ptr;
+
+		while (*ptr && *ptr != '\"') {
+			if (*ptr == '\\' && ptr[1])
+				ptr++;
+			ptr++;
+		}
+	} else {
+		token = ML_EXPR_TOKEN_ATOM;
+
+		while (*ptr && *ptr != '(' && *ptr != ')' && *ptr != '\"' && !g_ascii_isspace (*ptr))
+			ptr++;
+	}
+
+	*out_len = ptr - *out_start;
+
+	/* Skip the closing quote */
+	if (token == ML_EXPR_TOKEN_STRING && *ptr)
+		ptr++;
+
+	*pexpr = ptr;
+
+	return token;
+}
+
+static gboolean
+ml_expr_token_equal (const gchar *token,
+                     gsize token_len,
+                     const gchar *str)
+{
+	return token && strlen (str) == token_len && strncmp (token, str, token_len) == 0;
+}
+
+/* Whether a string argument at position @arg_index of the innermost of
+ * the @funcs can be extended without the expression matching any message,
+ * which it did not match before. */
+static gboolean
+ml_expr_can_narrow (const gchar **funcs,
+                    const gsize *func_lens,
+                    guint arg_index,
+                    gint depth)
+{
+	gint ii;
+
+	if (depth <= 0)
+		return FALSE;
+
+	if (ml_expr_token_equal (funcs[depth - 1], func_lens[depth - 1], "header-contains") ||
+	    ml_expr_token_equal (funcs[depth - 1], func_lens[depth - 1], "header-starts-with")) {
+		/* The first argument is the header name. */
+		if (arg_index == 0)
+			return FALSE;
+	} else if (!ml_expr_token_equal (funcs[depth - 1], func_lens[depth - 1], "body-contains")) {
+		return FALSE;
+	}
+
+	/* Anything like (not ...) or (match-threads ...) around it can make
+	 * the result bigger, thus allow only plain logical combinations. */
+	for (ii = 0; ii < depth - 1; ii++) {
+		if (!ml_expr_token_equal (funcs[ii], func_lens[ii], "and") &&
+		    !ml_expr_token_equal (funcs[ii], func_lens[ii], "or") &&
+		    !ml_expr_token_equal (funcs[ii], func_lens[ii], "match-all"))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Returns whether @new_expr can only match messages, which @old_expr
+ * matches too. It is judged by the syntax only, the expressions should
+ * be the same, except of search terms extended at their end, like when
+ * the user continues typing into the search entry. */
+static gboolean
+ml_expr_narrows (const gchar *old_expr,
+                 const gchar *new_expr)
+{
+	const gchar *funcs[ML_EXPR_MAX_DEPTH];
+	gsize func_lens[ML_EXPR_MAX_DEPTH];
+	guint n_args[ML_EXPR_MAX_DEPTH];
+	gboolean expect_func = FALSE;
+	gint depth = 0;
+
+	while (TRUE) {
+		MLExprToken old_token, new_token;
+		const gchar *old_start, *new_start;
+		gsize old_len, new_len;
+
+		old_token = ml_expr_next_token (&old_expr, &old_start, &old_len);
+		new_token = ml_expr_next_token (&new_expr, &new_start, &new_len);
+
+		if (old_token != new_token)
+			return FALSE;
+
+		switch (old_token) {
+		case ML_EXPR_TOKEN_END:
+			return depth == 0;
+		case ML_EXPR_TOKEN_OPEN:
+			if (depth >= ML_EXPR_MAX_DEPTH)
+				return FALSE;
+			funcs[depth] = NULL;
+			func_lens[depth] = 0;
+			n_args[depth] = 0;
+			depth++;
+			expect_func = TRUE;
+			break;
+		case ML_EXPR_TOKEN_CLOSE:
+			if (depth <= 0)
+				return FALSE;
+			depth--;
+			if (depth > 0)
+				n_args[depth - 1]++;
+			expect_func = FALSE;
+			break;
+		case ML_EXPR_TOKEN_ATOM:
+			if (old_len != new_len || strncmp (old_start, new_start, old_len) != 0)
+				return FALSE;
+			if (expect_func) {
+				funcs[depth - 1] = old_start;
+				func_lens[depth - 1] = old_len;
+				expect_func = FALSE;
+			} else if (depth > 0) {
+				n_args[depth - 1]++;
+			}
+			break;
+		case ML_EXPR_TOKEN_STRING:
+			if (expect_func)
+				return FALSE;
+			if (old_len != new_len || strncmp (old_start, new_start, old_len) != 0) {
+				if (new_len < old_len || strncmp (old_start, new_start, old_len) != 0)
+					return FALSE;
+				if (!ml_expr_can_narrow (funcs, func_lens, depth > 0 ? n_args[depth - 1] : 0, depth))
+					return FALSE;
+			}
+			if (depth > 0)
+				n_args[depth - 1]++;
+			break;
+		}
+	}
+}
+
+/* Whether the result of the @expr depends only on the matched messages
+ * themselves. Thread matching, dates relative to the current time or
+ * the content of the address books can change the result for messages,
+ * which did not change at all, thus results of such expressions cannot
+ * be updated from the folder changes. */
+static gboolean
+ml_expr_is_cacheable (const gchar *expr)
+{
+	while (TRUE) {
+		MLExprToken token;
+		const gchar *start;
+		gsize len;
+
+		token = ml_expr_next_token (&expr, &start, &len);
+
+		if (token == ML_EXPR_TOKEN_END)
+			break;
+
+		if (token == ML_EXPR_TOKEN_ATOM && (
+		    ml_expr_token_equal (start, len, "match-threads") ||
+		    ml_expr_token_equal (start, len, "get-current-date") ||
+		    ml_expr_token_equal (start, len, "get-relative-months") ||
+		    ml_expr_token_equal (start, len, "addressbook-contains")))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Called from the regen thread. Returns the cached search result, when it
+ * can be used to get the result of the @expr, otherwise returns %NULL.
+ * In both cases it records the cache state into the @regen_data, to be
+ * able to store the new result in regen_cache_store(). */
+static GPtrArray *
+regen_cache_lookup (MessageList *message_list,
+                    RegenData *regen_data,
+                    const gchar *expr,
+                    gboolean *out_same_expr,
+                    CamelFolderChangeInfo **out_changes)
+{
+	MessageListPrivate *priv = message_list->priv;
+	GPtrArray *cached_uids = NULL;
+
+	*out_same_expr = FALSE;
+	*out_changes = NULL;
+
+	g_mutex_lock (&priv->regen_lock);
+
+	regen_data->cache_stamp = priv->regen_cache_stamp;
+	regen_data->cache_serial = priv->regen_cache_changes_serial + priv->regen_cache_changes->len;
+
+	if (priv->regen_cache_folder == regen_data->folder &&
+	    priv->regen_cache_uids && priv->regen_cache_expr) {
+		*out_same_expr = g_strcmp0 (priv->regen_cache_expr, expr) == 0;
+
+		if (*out_same_expr || ml_expr_narrows (priv->regen_cache_expr, expr)) {
+			CamelFolderChangeInfo *changes;
+			guint ii;
+
+			changes = camel_folder_change_info_new ();
+
+			for (ii = 0; ii < priv->regen_cache_changes->len; ii++) {
+				camel_folder_change_info_cat (changes, g_ptr_array_index (priv->regen_cache_changes, ii));
+			}
+
+			cached_uids = g_ptr_array_ref (priv->regen_cache_uids);
+			*out_changes = changes;
+		}
+	}
+
+	g_mutex_unlock (&priv->regen_lock);
+
+	return cached_uids;
+}
+
+/* Called from the main thread, when the regen finished successfully. */
+static void
+regen_cache_store (MessageList *message_list,
+                   RegenData *regen_data)
+{
+	MessageListPrivate *priv = message_list->priv;
+
+	if (!regen_data->cache_uids || !regen_data->cache_expr)
+		return;
+
+	g_mutex_lock (&priv->regen_lock);
+
+	/* Do not replace a newer result, or store a result computed
+	 * against the cache state, which had been invalidated since. */
+	if (priv->regen_cache_folder == regen_data->folder &&
+	    priv->regen_cache_stamp == regen_data->cache_stamp &&
+	    regen_data->cache_serial >= priv->regen_cache_serial) {
+		guint n_drop, ii;
+
+		g_free (priv->regen_cache_expr);
+		priv->regen_cache_expr = regen_data->cache_expr;
+		regen_data->cache_expr = NULL;
+
+		if (priv->regen_cache_uids)
+			g_ptr_array_unref (priv->regen_cache_uids);
+		priv->regen_cache_uids = regen_data->cache_uids;
+		regen_data->cache_uids = NULL;
+
+		priv->regen_cache_serial = regen_data->cache_serial;
+
+		/* Drop changes already included in the stored result. */
+		n_drop = regen_data->cache_serial - priv->regen_cache_changes_serial;
+
+		for (ii = 0; ii < n_drop; ii++) {
+			priv->regen_cache_n_changes -= ml_change_info_count (
+				g_ptr_array_index (priv->regen_cache_changes, ii));
+		}
+
+		if (n_drop > 0)
+			g_ptr_array_remove_range (priv->regen_cache_changes, 0, n_drop);
+
+		priv->regen_cache_changes_serial = regen_data->cache_serial;
+	}
+
+	g_mutex_unlock (&priv->regen_lock);
+}
+
+/* Computes the result of the @expr from the @cached_uids and the folder
+ * @changes received since they had been searched for. When @same_expr is
+ * %TRUE, the @cached_uids are the result of the @expr, otherwise the @expr
+ * narrows the expression the @cached_uids are the result of. */
+static GPtrArray *
+regen_cache_apply_changes (CamelFolder *folder,
+                           const gchar *expr,
+                           gboolean same_expr,
+                           GPtrArray *cached_uids,
+                           CamelFolderChangeInfo *changes,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	GHashTable *touched;
+	GPtrArray *recheck_uids;
+	GPtrArray *found_uids = NULL;
+	GPtrArray *result = NULL;
+	GError *local_error = NULL;
+	guint ii;
+
+	touched = g_hash_table_new (g_str_hash, g_str_equal);
+	recheck_uids = g_ptr_array_new ();
+
+	for (ii = 0; ii < changes->uid_removed->len; ii++) {
+		g_hash_table_add (touched, changes->uid_removed->pdata[ii]);
+	}
+
+	for (ii = 0; ii < changes->uid_added->len; ii++) {
+		if (g_hash_table_add (touched, changes->uid_added->pdata[ii]))
+			g_ptr_array_add (recheck_uids, changes->uid_added->pdata[ii]);
+	}
+
+	for (ii = 0; ii < changes->uid_changed->len; ii++) {
+		if (g_hash_table_add (touched, changes->uid_changed->pdata[ii]))
+			g_ptr_array_add (recheck_uids, changes->uid_changed->pdata[ii]);
+	}
+
+	/* The narrowed expression needs to be checked against
+	 * the whole previous result, but not against the folder. */
+	if (!same_expr) {
+		for (ii = 0; ii < cached_uids->len; ii++) {
+			if (!g_hash_table_contains (touched, cached_uids->pdata[ii]))
+				g_ptr_array_add (recheck_uids, cached_uids->pdata[ii]);
+		}
+	}
+
+	if (recheck_uids->len > 0) {
+		found_uids = camel_folder_search_by_uids (
+			folder, expr, recheck_uids, cancellable, &local_error);
+
+		if (local_error != NULL) {
+			g_propagate_error (error, local_error);
+			goto exit;
+		}
+	}
+
+	result = g_ptr_array_new_full (
+		(same_expr ? cached_uids->len : 0) + (found_uids ? found_uids->len : 0),
+		(GDestroyNotify) camel_pstring_free);
+
+	if (same_expr) {
+		for (ii = 0; ii < cached_uids->len; ii++) {
+			const gchar *uid = cached_uids->pdata[ii];
+
+			if (!g_hash_table_contains (touched, uid))
+				g_ptr_array_add (result, (gpointer) camel_pstring_strdup (uid));
+		}
+	}
+
+	if (found_uids) {
+		for (ii = 0; ii < found_uids->len; ii++) {
+			g_ptr_array_add (result, (gpointer) camel_pstring_strdup (found_uids->pdata[ii]));
+		}
+
+		camel_folder_search_free (folder, found_uids);
+	}
+
+exit:
+	g_ptr_array_unref (recheck_uids);
+	g_hash_table_destroy (touched);
+
+	return result;
+}
+
+static GPtrArray *
+ml_copy_uids (GPtrArray *uids)
+{
+	GPtrArray *copy;
+	guint ii;
+
+	copy = g_ptr_array_new_full (uids->len, (GDestroyNotify) camel_pstring_free);
+
+	for (ii = 0; ii < uids->len; ii++) {
+		g_ptr_array_add (copy, (gpointer) camel_pstring_strdup (uids->pdata[ii]));
+	}
+
+	return copy;
+}
+
 static void
 message_list_tree_model_freeze (MessageList *message_list)
 {
@@ -1167,6 +1663,32 @@ message_list_can_select (MessageList *message_list,
 	return ml_search_path (message_list, direction, flags, mask) != NULL;
 }
 
+/**
+ * message_list_dup_neighbour_uid:
+ * @message_list: a MessageList
+ * @direction: the direction to search in
+ *
+ * Returns the UID of the message which message_list_select() would
+ * select for @direction with no flags required, without changing the
+ * selection.  Free the returned string with g_free() when done with it.
+ *
+ * Return value: a newly allocated message UID, or %NULL if there is none
+ **/
+gchar *
+message_list_dup_neighbour_uid (MessageList *message_list,
+                                MessageListSelectDirection direction)
+{
+	GNode *node;
+
+	g_return_val_if_fail (IS_MESSAGE_LIST (message_list), NULL);
+
+	node = ml_search_path (message_list, direction, 0, 0);
+	if (node == NULL || node->data == NULL)
+		return NULL;
+
+	return g_strdup (get_message_uid (message_list, node));
+}
+
 /**
  * message_list_select_uid:
  * @message_list:
@@ -3269,6 +3791,11 @@ message_list_finalize (GObject *object)
 	g_strfreev (message_list->priv->re_prefixes);
 	g_strfreev (message_list->priv->re_separators);
 
+	g_free (message_list->priv->regen_cache_expr);
+	if (message_list->priv->regen_cache_uids)
+		g_ptr_array_unref (message_list->priv->regen_cache_uids);
+	g_ptr_array_unref (message_list->priv->regen_cache_changes);
+
 	g_mutex_clear (&message_list->priv->regen_lock);
 	g_mutex_clear (&message_list->priv->thread_tree_lock);
 	g_mutex_clear (&message_list->priv->re_prefixes_lock);
@@ -3995,6 +4522,9 @@ message_list_init (MessageList *message_list)
 	g_mutex_init (&message_list->priv->thread_tree_lock);
 	g_mutex_init (&message_list->priv->re_prefixes_lock);
 
+	message_list->priv->regen_cache_changes = g_ptr_array_new_with_free_func (
+		(GDestroyNotify) camel_folder_change_info_free);
+
 	/* TODO: Should this only get the selection if we're realised? */
 	p = message_list->priv;
 	p->invisible = gtk_invisible_new ();
@@ -4978,6 +5508,8 @@ message_list_folder_changed (CamelFolder *folder,
 	if (message_list->priv->destroyed)
 		return;
 
+	regen_cache_add_changes (message_list, folder, changes);
+
 	regen_data = message_list_ref_regen_data (message_list);
 
 	d (
@@ -5160,6 +5692,7 @@ message_list_set_folder (MessageList *message_list,
 	}
 
 	mail_regen_cancel (message_list);
+	regen_cache_reset (message_list, folder);
 
 	g_free (message_list->search);
 	message_list->search = NULL;
@@ -6070,7 +6603,7 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 {
 	MessageList *message_list;
 	RegenData *regen_data;
-	GPtrArray *uids, *searchuids = NULL;
+	GPtrArray *uids, *searchuids = NULL, *deltauids = NULL;
 	CamelMessageInfo *info;
 	CamelFolder *folder;
 	GNode *cursor;
@@ -6137,19 +6670,54 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 			camel_service_get_display_name (CAMEL_SERVICE (camel_folder_get_parent_store (folder))),
 			camel_folder_get_full_name (folder)));
 	} else {
-		uids = camel_folder_search_by_expression (
-			folder, expr->str, cancellable, &local_error);
+		CamelFolderChangeInfo *changes = NULL;
+		GPtrArray *cached_uids = NULL;
+		gboolean same_expr = FALSE;
+		gboolean cacheable;
 
-		dd (g_print ("%s: got %d uids in folder %p (%s : %s) for expression:---%s---\n", G_STRFUNC,
-			uids ? uids->len : -1, folder,
-			camel_service_get_display_name (CAMEL_SERVICE (camel_folder_get_parent_store (folder))),
-			camel_folder_get_full_name (folder), expr->str));
+		cacheable = ml_expr_is_cacheable (expr->str);
+
+		if (cacheable) {
+			cached_uids = regen_cache_lookup (
+				message_list, regen_data, expr->str,
+				&same_expr, &changes);
+		}
 
-		/* XXX This indicates we need to use a different
-		 *     "free UID" function for some dumb reason. */
-		searchuids = uids;
+		if (cached_uids != NULL) {
+			/* Apply only the changes since the previous search. */
+			deltauids = regen_cache_apply_changes (
+				folder, expr->str, same_expr, cached_uids,
+				changes, cancellable, &local_error);
+			uids = deltauids;
+
+			g_ptr_array_unref (cached_uids);
+			camel_folder_change_info_free (changes);
+
+			dd (g_print ("%s: got %d uids in folder %p (%s : %s) from %s cached result for expression:---%s---\n", G_STRFUNC,
+				uids ? uids->len : -1, folder,
+				camel_service_get_display_name (CAMEL_SERVICE (camel_folder_get_parent_store (folder))),
+				camel_folder_get_full_name (folder), same_expr ? "updated" : "narrowed", expr->str));
+		} else {
+			uids = camel_folder_search_by_expression (
+				folder, expr->str, cancellable, &local_error);
+
+			dd (g_print ("%s: got %d uids in folder %p (%s : %s) for expression:---%s---\n", G_STRFUNC,
+				uids ? uids->len : -1, folder,
+				camel_service_get_display_name (CAMEL_SERVICE (camel_folder_get_parent_store (folder))),
+				camel_folder_get_full_name (folder), expr->str));
+
+			/* XXX This indicates we need to use a different
+			 *     "free UID" function for some dumb reason. */
+			searchuids = uids;
+		}
 
 		if (uids != NULL) {
+			/* Remember the result before it's tweaked for the search cache. */
+			if (cacheable) {
+				regen_data->cache_expr = g_strdup (expr->str);
+				regen_data->cache_uids = ml_copy_uids (uids);
+			}
+
 			message_list_regen_tweak_search_results (
 				message_list,
 				uids, folder,
@@ -6223,7 +6791,9 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 	}
 
 exit:
-	if (searchuids != NULL)
+	if (deltauids != NULL)
+		g_ptr_array_unref (deltauids);
+	else if (searchuids != NULL)
 		camel_folder_search_free (folder, searchuids);
 	else if (uids != NULL)
 		camel_folder_free_uids (folder, uids);
@@ -6385,6 +6955,8 @@ message_list_regen_done_cb (GObject *source_object,
 
 	e_activity_set_state (activity, E_ACTIVITY_COMPLETED);
 
+	regen_cache_store (message_list, regen_data);
+
 	tree = E_TREE (message_list);
 	adapter = e_tree_get_table_adapter (tree);
 
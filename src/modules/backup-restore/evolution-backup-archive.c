@@ -0,0 +1,1367 @@
+/*
+ * evolution-backup-archive.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Reads and writes tar archives, compressed with gzip or xz, as used
+ * by the backups.  The gzip compression is done in-process, by several
+ * threads, each compressing one chunk of the tar stream into its own
+ * gzip member.  Concatenated members are a valid gzip file, which can
+ * be read by any gzip or tar.  The xz compression is done by the xz
+ * program, which is multi-threaded on its own. */
+
+#include "evolution-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <utime.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "evolution-backup-archive.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define BLOCK_SIZE 512
+#define RECORD_SIZE (20 * BLOCK_SIZE)
+#define CHUNK_SIZE (1024 * 1024)
+#define BUFFER_SIZE (64 * 1024)
+#define MAX_THREADS 8
+
+/* Long names and pax headers bigger than this are refused */
+#define MAX_META_SIZE (1024 * 1024)
+
+typedef struct _ArchiveChunk {
+	GBytes *input;
+	GBytes *output;
+	GError *error;
+	gboolean done;
+} ArchiveChunk;
+
+struct _BackupArchiveWriter {
+	GCancellable *cancellable;
+	GOutputStream *output; /* the file, or stdin of the xz process */
+	GSubprocess *subprocess;
+	GByteArray *chunk; /* not yet submitted part of the tar stream */
+	guint64 tar_len;
+	guint64 data_written;
+	BackupArchiveProgressFunc progress_func;
+	gpointer progress_data;
+
+	GThreadPool *pool; /* NULL, when not compressing in-process */
+	GQueue chunks; /* ArchiveChunk *, in the stream order */
+	guint max_pending;
+	GMutex lock;
+	GCond cond;
+};
+
+struct _BackupArchiveReader {
+	GCancellable *cancellable;
+	GInputStream *input; /* the file, or stdout of the xz process */
+	GSubprocess *subprocess;
+	GConverter *decompressor; /* NULL, when reading from xz */
+	gboolean member_finished;
+	guint64 file_size;
+	guint64 raw_read;
+
+	guint8 *in_buf;
+	gsize in_pos, in_len;
+	gboolean in_eof;
+
+	guint8 *out_buf;
+	gsize out_pos, out_len;
+
+	BackupArchiveEntry entry;
+	guint64 entry_left; /* bytes till the next header, including the padding */
+	guint64 data_left; /* bytes of the entry data not read yet */
+};
+
+static void
+archive_chunk_free (ArchiveChunk *chunk)
+{
+	if (chunk) {
+		g_bytes_unref (chunk->input);
+		if (chunk->output)
+			g_bytes_unref (chunk->output);
+		g_clear_error (&chunk->error);
+		g_slice_free (ArchiveChunk, chunk);
+	}
+}
+
+static GBytes *
+archive_gzip_bytes (GBytes *input,
+                    GError **error)
+{
+	GConverter *converter;
+	GByteArray *output;
+	const guint8 *data;
+	gsize data_len, data_pos = 0;
+	gboolean success = TRUE;
+
+	data = g_bytes_get_data (input, &data_len);
+
+	converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, 6));
+	output = g_byte_array_sized_new (data_len / 2 + BUFFER_SIZE);
+
+	while (success) {
+		GConverterResult res;
+		gsize bytes_read = 0, bytes_written = 0, out_len = output->len;
+
+		g_byte_array_set_size (output, out_len + BUFFER_SIZE);
+
+		res = g_converter_convert (
+			converter, data + data_pos, data_len - data_pos,
+			output->data + out_len, BUFFER_SIZE,
+			G_CONVERTER_INPUT_AT_END,
+			&bytes_read, &bytes_written, error);
+
+		g_byte_array_set_size (output, out_len + bytes_written);
+		data_pos += bytes_read;
+
+		if (res == G_CONVERTER_ERROR)
+			success = FALSE;
+		else if (res == G_CONVERTER_FINISHED)
+			break;
+	}
+
+	g_object_unref (converter);
+
+	if (!success) {
+		g_byte_array_free (output, TRUE);
+		return NULL;
+	}
+
+	return g_byte_array_free_to_bytes (output);
+}
+
+static void
+archive_compress_chunk_thread (gpointer data,
+                               gpointer user_data)
+{
+	ArchiveChunk *chunk = data;
+	BackupArchiveWriter *writer = user_data;
+	GBytes *output;
+	GError *local_error = NULL;
+
+	output = archive_gzip_bytes (chunk->input, &local_error);
+
+	g_mutex_lock (&writer->lock);
+	chunk->output = output;
+	chunk->error = local_error;
+	chunk->done = TRUE;
+	g_cond_broadcast (&writer->cond);
+	g_mutex_unlock (&writer->lock);
+}
+
+/* Writes the compressed chunks, in order, till at most @max_pending
+ * of them are left in the queue. */
+static gboolean
+archive_writer_write_chunks (BackupArchiveWriter *writer,
+                             guint max_pending,
+                             GError **error)
+{
+	gboolean success = TRUE;
+
+	g_mutex_lock (&writer->lock);
+
+	while (success && !g_queue_is_empty (&writer->chunks)) {
+		ArchiveChunk *chunk = g_queue_peek_head (&writer->chunks);
+
+		if (!chunk->done) {
+			if (g_queue_get_length (&writer->chunks) <= max_pending)
+				break;
+
+			g_cond_wait (&writer->cond, &writer->lock);
+			continue;
+		}
+
+		g_queue_pop_head (&writer->chunks);
+		g_mutex_unlock (&writer->lock);
+
+		if (chunk->error) {
+			g_propagate_error (error, chunk->error);
+			chunk->error = NULL;
+			success = FALSE;
+		} else {
+			success = g_output_stream_write_all (
+				writer->output,
+				g_bytes_get_data (chunk->output, NULL),
+				g_bytes_get_size (chunk->output),
+				NULL, writer->cancellable, error);
+		}
+
+		archive_chunk_free (chunk);
+
+		g_mutex_lock (&writer->lock);
+	}
+
+	g_mutex_unlock (&writer->lock);
+
+	return success;
+}
+
+static gboolean
+archive_writer_submit_chunk (BackupArchiveWriter *writer,
+                             GError **error)
+{
+	ArchiveChunk *chunk;
+	GBytes *bytes;
+
+	if (!writer->chunk->len)
+		return TRUE;
+
+	bytes = g_byte_array_free_to_bytes (writer->chunk);
+	writer->chunk = g_byte_array_sized_new (CHUNK_SIZE);
+
+	if (!writer->pool) {
+		gboolean success;
+
+		success = g_output_stream_write_all (
+			writer->output,
+			g_bytes_get_data (bytes, NULL),
+			g_bytes_get_size (bytes),
+			NULL, writer->cancellable, error);
+
+		g_bytes_unref (bytes);
+
+		return success;
+	}
+
+	chunk = g_slice_new0 (ArchiveChunk);
+	chunk->input = bytes;
+
+	g_mutex_lock (&writer->lock);
+	g_queue_push_tail (&writer->chunks, chunk);
+	g_mutex_unlock (&writer->lock);
+
+	g_thread_pool_push (writer->pool, chunk, NULL);
+
+	return archive_writer_write_chunks (writer, writer->max_pending, error);
+}
+
+static gboolean
+archive_writer_append (BackupArchiveWriter *writer,
+                       const gchar *data,
+                       gsize data_len,
+                       GError **error)
+{
+	while (data_len > 0) {
+		gsize len = MIN (data_len, CHUNK_SIZE - writer->chunk->len);
+
+		if (data) {
+			g_byte_array_append (writer->chunk, (const guint8 *) data, len);
+		} else {
+			g_byte_array_set_size (writer->chunk, writer->chunk->len + len);
+			memset (writer->chunk->data + writer->chunk->len - len, 0, len);
+		}
+
+		writer->tar_len += len;
+		data_len -= len;
+
+		if (data)
+			data += len;
+
+		if (writer->chunk->len >= CHUNK_SIZE &&
+		    !archive_writer_submit_chunk (writer, error))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Pads the tar stream with zeros to the full block */
+static gboolean
+archive_writer_pad (BackupArchiveWriter *writer,
+                    GError **error)
+{
+	static const gchar zeros[BLOCK_SIZE] = { 0 };
+	gsize rest = writer->tar_len % BLOCK_SIZE;
+
+	if (!rest)
+		return TRUE;
+
+	return archive_writer_append (writer, zeros, BLOCK_SIZE - rest, error);
+}
+
+static void
+archive_set_number (gchar *field,
+                    gsize field_len,
+                    guint64 value)
+{
+	if (value >> (3 * (field_len - 1))) {
+		gsize ii;
+
+		/* GNU extension for values which do not fit the octal digits */
+		for (ii = field_len - 1; ii > 0; ii--) {
+			field[ii] = value & 0xFF;
+			value >>= 8;
+		}
+
+		field[0] = (gchar) 0x80;
+	} else {
+		g_snprintf (field, field_len, "%0*" G_GINT64_MODIFIER "o", (gint) field_len - 1, value);
+	}
+}
+
+static guint64
+archive_get_number (const gchar *field,
+                    gsize field_len)
+{
+	guint64 value = 0;
+	gsize ii = 0;
+
+	if (((guchar) field[0]) & 0x80) {
+		value = ((guchar) field[0]) & 0x7F;
+
+		for (ii = 1; ii < field_len; ii++) {
+			value = (value << 8) | ((guchar) field[ii]);
+		}
+
+		return value;
+	}
+
+	while (ii < field_len && field[ii] == ' ')
+		ii++;
+
+	for (; ii < field_len && field[ii] >= '0' && field[ii] <= '7'; ii++) {
+		value = (value << 3) | (field[ii] - '0');
+	}
+
+	return value;
+}
+
+static guint
+archive_header_checksum (const gchar *header)
+{
+	guint sum = 0, ii;
+
+	for (ii = 0; ii < BLOCK_SIZE; ii++) {
+		if (ii >= 148 && ii < 156)
+			sum += ' ';
+		else
+			sum += (guchar) header[ii];
+	}
+
+	return sum;
+}
+
+static gboolean
+archive_writer_add_header (BackupArchiveWriter *writer,
+                           const gchar *path,
+                           gchar typeflag,
+                           guint64 size,
+                           guint mode,
+                           gint64 mtime,
+                           GError **error)
+{
+	gchar header[BLOCK_SIZE];
+	gsize path_len;
+
+	path_len = strlen (path);
+
+	/* GNU long name, stored as the data of a preceding entry */
+	if (path_len >= 100) {
+		if (!archive_writer_add_header (writer, "././@LongLink", 'L', path_len + 1, 0644, 0, error) ||
+		    !archive_writer_append (writer, path, path_len + 1, error) ||
+		    !archive_writer_pad (writer, error))
+			return FALSE;
+	}
+
+	memset (header, 0, BLOCK_SIZE);
+	memcpy (header, path, MIN (path_len, 99));
+	archive_set_number (header + 100, 8, mode & 07777);
+	archive_set_number (header + 108, 8, 0);
+	archive_set_number (header + 116, 8, 0);
+	archive_set_number (header + 124, 12, size);
+	archive_set_number (header + 136, 12, MAX (mtime, 0));
+	header[156] = typeflag;
+	memcpy (header + 257, "ustar  ", 8);
+
+	g_snprintf (header + 148, 7, "%06o", archive_header_checksum (header));
+	header[155] = ' ';
+
+	return archive_writer_append (writer, header, BLOCK_SIZE, error);
+}
+
+/**
+ * backup_archive_writer_new:
+ * @filename: where to write the archive
+ * @use_xz: whether to compress with xz, instead of gzip
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Creates a new tar archive @filename.  Add the content with
+ * backup_archive_writer_add_directory(), backup_archive_writer_add_file()
+ * and backup_archive_writer_add_data(), then finish it with
+ * backup_archive_writer_close().
+ *
+ * Returns: a new #BackupArchiveWriter, or %NULL on error
+ **/
+BackupArchiveWriter *
+backup_archive_writer_new (const gchar *filename,
+                           gboolean use_xz,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	BackupArchiveWriter *writer;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	writer = g_slice_new0 (BackupArchiveWriter);
+	writer->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	writer->chunk = g_byte_array_sized_new (CHUNK_SIZE);
+	g_queue_init (&writer->chunks);
+	g_mutex_init (&writer->lock);
+	g_cond_init (&writer->cond);
+
+	if (use_xz) {
+		GSubprocessLauncher *launcher;
+
+		launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDIN_PIPE);
+		g_subprocess_launcher_set_stdout_file_path (launcher, filename);
+
+		writer->subprocess = g_subprocess_launcher_spawn (launcher, error, "xz", "-z", "-c", "-T0", NULL);
+
+		g_object_unref (launcher);
+
+		if (writer->subprocess)
+			writer->output = g_object_ref (g_subprocess_get_stdin_pipe (writer->subprocess));
+	} else {
+		GFile *file;
+		guint n_threads;
+
+		file = g_file_new_for_path (filename);
+		writer->output = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE, cancellable, error));
+		g_object_unref (file);
+
+		n_threads = CLAMP (g_get_num_processors (), 1, MAX_THREADS);
+
+		writer->pool = g_thread_pool_new (archive_compress_chunk_thread, writer, n_threads, FALSE, NULL);
+		writer->max_pending = 2 * n_threads;
+	}
+
+	if (!writer->output) {
+		backup_archive_writer_free (writer);
+		return NULL;
+	}
+
+	return writer;
+}
+
+gboolean
+backup_archive_writer_add_directory (BackupArchiveWriter *writer,
+                                     const gchar *path,
+                                     guint mode,
+                                     gint64 mtime,
+                                     GError **error)
+{
+	gchar *dir_path;
+	gboolean success;
+
+	g_return_val_if_fail (writer != NULL, FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	dir_path = g_strconcat (path, "/", NULL);
+	success = archive_writer_add_header (writer, dir_path, '5', 0, mode, mtime, error);
+	g_free (dir_path);
+
+	return success;
+}
+
+/**
+ * backup_archive_writer_add_file:
+ * @writer: a #BackupArchiveWriter
+ * @path: path of the file in the archive
+ * @filename: the file to add
+ * @size: size of the file
+ * @mode: file mode
+ * @mtime: modification time of the file
+ * @error: return location for a #GError, or %NULL
+ *
+ * Adds content of the @filename into the archive as @path.  The @size is
+ * stored in the archive before the content is read, thus when the file
+ * changes meanwhile, its content is cut or padded with zeros to the @size.
+ *
+ * Returns: whether succeeded
+ **/
+gboolean
+backup_archive_writer_add_file (BackupArchiveWriter *writer,
+                                const gchar *path,
+                                const gchar *filename,
+                                guint64 size,
+                                guint mode,
+                                gint64 mtime,
+                                GError **error)
+{
+	gchar *buffer;
+	guint64 left = size;
+	gint fd;
+	gboolean success;
+
+	g_return_val_if_fail (writer != NULL, FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	fd = g_open (filename, O_RDONLY | O_BINARY, 0);
+	if (fd == -1) {
+		gint errn = errno;
+
+		g_set_error (
+			error, G_IO_ERROR, g_io_error_from_errno (errn),
+			_("Failed to open file “%s”: %s"), filename, g_strerror (errn));
+
+		return FALSE;
+	}
+
+	success = archive_writer_add_header (writer, path, '0', size, mode, mtime, error);
+
+	buffer = g_malloc (BUFFER_SIZE);
+
+	while (success && left > 0) {
+		gssize nread;
+
+		if (g_cancellable_set_error_if_cancelled (writer->cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		nread = read (fd, buffer, MIN (left, BUFFER_SIZE));
+
+		if (nread < 0 && errno == EINTR)
+			continue;
+
+		if (nread < 0) {
+			gint errn = errno;
+
+			g_set_error (
+				error, G_IO_ERROR, g_io_error_from_errno (errn),
+				_("Failed to read file “%s”: %s"), filename, g_strerror (errn));
+
+			success = FALSE;
+		} else if (nread == 0) {
+			g_warning ("%s: File '%s' shrunk while being backed up", G_STRFUNC, filename);
+
+			success = archive_writer_append (writer, NULL, left, error);
+			left = 0;
+		} else {
+			success = archive_writer_append (writer, buffer, nread, error);
+			left -= nread;
+			writer->data_written += nread;
+
+			if (writer->progress_func)
+				writer->progress_func (writer->data_written, writer->progress_data);
+		}
+	}
+
+	g_free (buffer);
+	close (fd);
+
+	return success && archive_writer_pad (writer, error);
+}
+
+gboolean
+backup_archive_writer_add_data (BackupArchiveWriter *writer,
+                                const gchar *path,
+                                const gchar *data,
+                                gsize data_len,
+                                gint64 mtime,
+                                GError **error)
+{
+	g_return_val_if_fail (writer != NULL, FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (data != NULL || !data_len, FALSE);
+
+	return archive_writer_add_header (writer, path, '0', data_len, 0644, mtime, error) &&
+		archive_writer_append (writer, data, data_len, error) &&
+		archive_writer_pad (writer, error);
+}
+
+/* Sets a function called with the count of bytes of the added
+ * files written so far, each time a part of a file is written. */
+void
+backup_archive_writer_set_progress_func (BackupArchiveWriter *writer,
+                                         BackupArchiveProgressFunc func,
+                                         gpointer user_data)
+{
+	g_return_if_fail (writer != NULL);
+
+	writer->progress_func = func;
+	writer->progress_data = user_data;
+}
+
+gboolean
+backup_archive_writer_close (BackupArchiveWriter *writer,
+                             GError **error)
+{
+	static const gchar zeros[2 * BLOCK_SIZE] = { 0 };
+
+	g_return_val_if_fail (writer != NULL, FALSE);
+
+	/* The end of the archive are two zero blocks, padded to the full record */
+	if (!archive_writer_append (writer, zeros, 2 * BLOCK_SIZE, error) ||
+	    ((writer->tar_len % RECORD_SIZE) != 0 &&
+	     !archive_writer_append (writer, NULL, RECORD_SIZE - (writer->tar_len % RECORD_SIZE), error)) ||
+	    !archive_writer_submit_chunk (writer, error) ||
+	    !archive_writer_write_chunks (writer, 0, error) ||
+	    !g_output_stream_close (writer->output, writer->cancellable, error))
+		return FALSE;
+
+	if (writer->subprocess)
+		return g_subprocess_wait_check (writer->subprocess, writer->cancellable, error);
+
+	return TRUE;
+}
+
+void
+backup_archive_writer_free (BackupArchiveWriter *writer)
+{
+	if (!writer)
+		return;
+
+	if (writer->pool)
+		g_thread_pool_free (writer->pool, TRUE, TRUE);
+
+	g_queue_foreach (&writer->chunks, (GFunc) archive_chunk_free, NULL);
+	g_queue_clear (&writer->chunks);
+
+	if (writer->subprocess && !g_subprocess_get_if_exited (writer->subprocess))
+		g_subprocess_force_exit (writer->subprocess);
+
+	g_clear_object (&writer->output);
+	g_clear_object (&writer->subprocess);
+	g_clear_object (&writer->cancellable);
+	g_byte_array_free (writer->chunk, TRUE);
+	g_mutex_clear (&writer->lock);
+	g_cond_clear (&writer->cond);
+
+	g_slice_free (BackupArchiveWriter, writer);
+}
+
+static gboolean
+archive_reader_read_input (BackupArchiveReader *reader,
+                           GError **error)
+{
+	gssize nread;
+
+	/* Keep what the decompressor did not consume yet */
+	if (reader->in_pos > 0) {
+		memmove (reader->in_buf, reader->in_buf + reader->in_pos, reader->in_len - reader->in_pos);
+		reader->in_len -= reader->in_pos;
+		reader->in_pos = 0;
+	}
+
+	nread = g_input_stream_read (
+		reader->input, reader->in_buf + reader->in_len,
+		BUFFER_SIZE - reader->in_len, reader->cancellable, error);
+
+	if (nread < 0)
+		return FALSE;
+
+	if (nread == 0)
+		reader->in_eof = TRUE;
+
+	reader->in_len += nread;
+	reader->raw_read += nread;
+
+	return TRUE;
+}
+
+/* Fills the output buffer with the next part of the tar stream;
+ * it's left empty at the end of the stream. */
+static gboolean
+archive_reader_fill (BackupArchiveReader *reader,
+                     GError **error)
+{
+	reader->out_pos = 0;
+	reader->out_len = 0;
+
+	if (!reader->decompressor) {
+		gssize nread;
+
+		nread = g_input_stream_read (reader->input, reader->out_buf, BUFFER_SIZE, reader->cancellable, error);
+		if (nread < 0)
+			return FALSE;
+
+		reader->out_len = nread;
+
+		return TRUE;
+	}
+
+	while (!reader->out_len) {
+		GConverterResult res;
+		gsize bytes_read = 0, bytes_written = 0;
+		GError *local_error = NULL;
+
+		if (reader->in_pos == reader->in_len && !reader->in_eof &&
+		    !archive_reader_read_input (reader, error))
+			return FALSE;
+
+		if (reader->in_pos == reader->in_len && reader->in_eof && reader->member_finished)
+			break;
+
+		res = g_converter_convert (
+			reader->decompressor,
+			reader->in_buf + reader->in_pos, reader->in_len - reader->in_pos,
+			reader->out_buf, BUFFER_SIZE,
+			reader->in_eof ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+			&bytes_read, &bytes_written, &local_error);
+
+		if (res == G_CONVERTER_ERROR) {
+			if (!reader->in_eof && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT)) {
+				g_clear_error (&local_error);
+
+				if (!archive_reader_read_input (reader, error))
+					return FALSE;
+
+				continue;
+			}
+
+			g_propagate_error (error, local_error);
+
+			return FALSE;
+		}
+
+		reader->in_pos += bytes_read;
+		reader->out_len = bytes_written;
+		reader->member_finished = res == G_CONVERTER_FINISHED;
+
+		/* Concatenated gzip members, each is decompressed on its own */
+		if (reader->member_finished)
+			g_converter_reset (reader->decompressor);
+	}
+
+	return TRUE;
+}
+
+/* Reads up to @len bytes of the tar stream into the @buffer,
+ * or skips them when the @buffer is %NULL.  Returns how many
+ * bytes had been read, which is less than @len only at the end
+ * of the stream, or -1 on error. */
+static gssize
+archive_reader_read (BackupArchiveReader *reader,
+                     gpointer buffer,
+                     gsize len,
+                     GError **error)
+{
+	gsize done = 0;
+
+	while (done < len) {
+		gsize nbytes;
+
+		if (reader->out_pos == reader->out_len) {
+			if (!archive_reader_fill (reader, error))
+				return -1;
+
+			if (!reader->out_len)
+				break;
+		}
+
+		nbytes = MIN (len - done, reader->out_len - reader->out_pos);
+
+		if (buffer)
+			memcpy (((guint8 *) buffer) + done, reader->out_buf + reader->out_pos, nbytes);
+
+		reader->out_pos += nbytes;
+		done += nbytes;
+	}
+
+	return done;
+}
+
+static gboolean
+archive_reader_skip (BackupArchiveReader *reader,
+                     guint64 len,
+                     GError **error)
+{
+	while (len > 0) {
+		gsize nbytes = MIN (len, G_MAXSSIZE);
+		gssize nread;
+
+		nread = archive_reader_read (reader, NULL, nbytes, error);
+		if (nread < 0)
+			return FALSE;
+
+		if ((gsize) nread < nbytes) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Unexpected end of the archive"));
+			return FALSE;
+		}
+
+		len -= nbytes;
+	}
+
+	return TRUE;
+}
+
+/**
+ * backup_archive_reader_new:
+ * @filename: an archive to read
+ * @use_xz: whether the @filename is compressed with xz, instead of gzip
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Opens the tar archive @filename for reading.  Walk its entries with
+ * backup_archive_reader_next().
+ *
+ * Returns: a new #BackupArchiveReader, or %NULL on error
+ **/
+BackupArchiveReader *
+backup_archive_reader_new (const gchar *filename,
+                           gboolean use_xz,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	BackupArchiveReader *reader;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	reader = g_slice_new0 (BackupArchiveReader);
+	reader->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	reader->member_finished = TRUE;
+	reader->out_buf = g_malloc (BUFFER_SIZE);
+
+	if (use_xz) {
+		reader->subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE, error, "xz", "-d", "-c", filename, NULL);
+
+		if (reader->subprocess)
+			reader->input = g_object_ref (g_subprocess_get_stdout_pipe (reader->subprocess));
+	} else {
+		GFile *file;
+		GFileInfo *info;
+
+		file = g_file_new_for_path (filename);
+		reader->input = G_INPUT_STREAM (g_file_read (file, cancellable, error));
+
+		if (reader->input) {
+			info = g_file_input_stream_query_info (G_FILE_INPUT_STREAM (reader->input),
+				G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+
+			if (info) {
+				reader->file_size = g_file_info_get_size (info);
+				g_object_unref (info);
+			}
+		}
+
+		g_object_unref (file);
+
+		reader->decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+		reader->in_buf = g_malloc (BUFFER_SIZE);
+	}
+
+	if (!reader->input) {
+		backup_archive_reader_free (reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+static void
+archive_reader_clear_entry (BackupArchiveReader *reader)
+{
+	g_free (reader->entry.path);
+	g_free (reader->entry.link_target);
+
+	memset (&reader->entry, 0, sizeof (BackupArchiveEntry));
+}
+
+static gchar *
+archive_reader_read_meta (BackupArchiveReader *reader,
+                          guint64 size,
+                          GError **error)
+{
+	gchar *data;
+	gssize nread;
+
+	if (size > MAX_META_SIZE) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Invalid archive header"));
+		return NULL;
+	}
+
+	data = g_malloc0 (size + 1);
+	nread = archive_reader_read (reader, data, size, error);
+
+	if (nread >= 0 && (guint64) nread < size)
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Unexpected end of the archive"));
+
+	if (nread < 0 || (guint64) nread != size ||
+	    !archive_reader_skip (reader, ((size + BLOCK_SIZE - 1) & ~((guint64) BLOCK_SIZE - 1)) - size, error)) {
+		g_free (data);
+		return NULL;
+	}
+
+	return data;
+}
+
+/* Reads "length key=value\n" records of a pax extended header */
+static void
+archive_parse_pax (const gchar *data,
+                   gchar **inout_path,
+                   gchar **inout_link_target,
+                   guint64 *inout_size)
+{
+	const gchar *ptr = data;
+
+	while (*ptr) {
+		const gchar *key, *eq;
+		gchar *end = NULL;
+		guint64 len;
+
+		len = g_ascii_strtoull (ptr, &end, 10);
+		if (!end || *end != ' ' || len <= (end - ptr) + 1 || strlen (ptr) < len)
+			break;
+
+		key = end + 1;
+		eq = memchr (key, '=', ptr + len - key);
+
+		if (eq && ptr[len - 1] == '\n') {
+			gchar *value = g_strndup (eq + 1, ptr + len - 1 - (eq + 1));
+
+			if (eq - key == 4 && strncmp (key, "path", 4) == 0) {
+				g_free (*inout_path);
+				*inout_path = value;
+				value = NULL;
+			} else if (eq - key == 8 && strncmp (key, "linkpath", 8) == 0) {
+				g_free (*inout_link_target);
+				*inout_link_target = value;
+				value = NULL;
+			} else if (eq - key == 4 && strncmp (key, "size", 4) == 0) {
+				*inout_size = g_ascii_strtoull (value, NULL, 10);
+			}
+
+			g_free (value);
+		}
+
+		ptr += len;
+	}
+}
+
+/* Strips leading "./" and trailing slashes; returns %FALSE for absolute
+ * paths and paths with "..", which could write out of the target. */
+static gboolean
+archive_normalize_path (gchar *path)
+{
+	gchar **parts;
+	gsize len;
+	gint ii;
+	gboolean safe = TRUE;
+
+	while (path[0] == '.' && path[1] == '/')
+		memmove (path, path + 2, strlen (path + 2) + 1);
+
+	len = strlen (path);
+	while (len > 0 && path[len - 1] == '/')
+		path[--len] = '\0';
+
+	if (!*path || g_path_is_absolute (path))
+		return FALSE;
+
+	parts = g_strsplit (path, "/", -1);
+
+	for (ii = 0; parts[ii] && safe; ii++) {
+		safe = g_strcmp0 (parts[ii], "..") != 0;
+	}
+
+	g_strfreev (parts);
+
+	return safe;
+}
+
+/**
+ * backup_archive_reader_next:
+ * @reader: a #BackupArchiveReader
+ * @error: return location for a #GError, or %NULL
+ *
+ * Moves to the next entry of the archive.  Its content can be read with
+ * backup_archive_reader_extract() or backup_archive_reader_read_data(),
+ * before calling this function again.  Entries with unsafe paths are
+ * returned with the %BACKUP_ARCHIVE_ENTRY_OTHER type.  The link_target of
+ * a %BACKUP_ARCHIVE_ENTRY_HARDLINK entry is the path of a previous entry.
+ *
+ * Returns: (nullable): the next entry, or %NULL at the end of the archive
+ *    or on error, when the @error is set.  The entry is owned by the @reader.
+ **/
+const BackupArchiveEntry *
+backup_archive_reader_next (BackupArchiveReader *reader,
+                            GError **error)
+{
+	gchar header[BLOCK_SIZE];
+	gchar *long_path = NULL, *long_link = NULL;
+	guint64 pax_size = 0;
+
+	g_return_val_if_fail (reader != NULL, NULL);
+
+	if (!archive_reader_skip (reader, reader->entry_left, error))
+		return NULL;
+
+	reader->entry_left = 0;
+	reader->data_left = 0;
+	archive_reader_clear_entry (reader);
+
+	while (TRUE) {
+		guint64 size;
+		gssize nread;
+		gchar typeflag;
+
+		if (g_cancellable_set_error_if_cancelled (reader->cancellable, error))
+			break;
+
+		nread = archive_reader_read (reader, header, BLOCK_SIZE, error);
+		if (nread < 0)
+			break;
+
+		if (nread == 0) {
+			/* End of the stream without the end blocks */
+			break;
+		}
+
+		if (nread < BLOCK_SIZE) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Unexpected end of the archive"));
+			break;
+		}
+
+		/* The end of the archive */
+		if (!header[0] && !memcmp (header, header + 1, BLOCK_SIZE - 1))
+			break;
+
+		if (archive_get_number (header + 148, 8) != archive_header_checksum (header)) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Invalid archive header"));
+			break;
+		}
+
+		size = archive_get_number (header + 124, 12);
+		typeflag = header[156];
+
+		if (typeflag == 'L' || typeflag == 'K' || typeflag == 'x') {
+			gchar *data;
+
+			data = archive_reader_read_meta (reader, size, error);
+			if (!data)
+				break;
+
+			if (typeflag == 'L') {
+				g_free (long_path);
+				long_path = data;
+			} else if (typeflag == 'K') {
+				g_free (long_link);
+				long_link = data;
+			} else {
+				archive_parse_pax (data, &long_path, &long_link, &pax_size);
+				g_free (data);
+			}
+
+			continue;
+		}
+
+		if (pax_size)
+			size = pax_size;
+
+		if (long_path) {
+			reader->entry.path = long_path;
+			long_path = NULL;
+		} else if (memcmp (header + 257, "ustar", 6) == 0 && header[345]) {
+			/* POSIX ustar splits long names into the prefix and the name */
+			reader->entry.path = g_strdup_printf ("%.155s/%.100s", header + 345, header);
+		} else {
+			reader->entry.path = g_strndup (header, 100);
+		}
+
+		if (long_link) {
+			reader->entry.link_target = long_link;
+			long_link = NULL;
+		} else {
+			reader->entry.link_target = g_strndup (header + 157, 100);
+		}
+
+		switch (typeflag) {
+		case '0':
+		case '\0':
+		case '7':
+			reader->entry.type = BACKUP_ARCHIVE_ENTRY_FILE;
+			break;
+		case '1':
+			/* The link_target is a path of a previous entry */
+			reader->entry.type = BACKUP_ARCHIVE_ENTRY_HARDLINK;
+			size = 0;
+			break;
+		case '2':
+			reader->entry.type = BACKUP_ARCHIVE_ENTRY_SYMLINK;
+			size = 0;
+			break;
+		case '5':
+			reader->entry.type = BACKUP_ARCHIVE_ENTRY_DIRECTORY;
+			size = 0;
+			break;
+		default:
+			reader->entry.type = BACKUP_ARCHIVE_ENTRY_OTHER;
+			break;
+		}
+
+		if (!archive_normalize_path (reader->entry.path) ||
+		    (reader->entry.type == BACKUP_ARCHIVE_ENTRY_HARDLINK &&
+		    !archive_normalize_path (reader->entry.link_target))) {
+			g_warning ("%s: Skipping unsafe path '%s' in the archive", G_STRFUNC, reader->entry.path);
+			reader->entry.type = BACKUP_ARCHIVE_ENTRY_OTHER;
+		}
+
+		reader->entry.size = size;
+		reader->entry.mtime = archive_get_number (header + 136, 12);
+		reader->entry.mode = archive_get_number (header + 100, 8) & 07777;
+		reader->data_left = size;
+		reader->entry_left = (size + BLOCK_SIZE - 1) & ~((guint64) BLOCK_SIZE - 1);
+
+		return &reader->entry;
+	}
+
+	g_free (long_path);
+	g_free (long_link);
+
+	return NULL;
+}
+
+/* Reads data of the current entry into the @buffer */
+static gssize
+archive_reader_read_data (BackupArchiveReader *reader,
+                          gpointer buffer,
+                          gsize len,
+                          GError **error)
+{
+	gssize nread;
+
+	len = MIN (len, reader->data_left);
+	if (!len)
+		return 0;
+
+	nread = archive_reader_read (reader, buffer, len, error);
+
+	if (nread >= 0 && (gsize) nread < len) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Unexpected end of the archive"));
+		nread = -1;
+	}
+
+	if (nread > 0) {
+		reader->data_left -= nread;
+		reader->entry_left -= nread;
+	}
+
+	return nread;
+}
+
+/**
+ * backup_archive_reader_extract:
+ * @reader: a #BackupArchiveReader
+ * @filename: where to write the content of the current entry
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the content of the current file entry into the @filename,
+ * and sets its modification time as stored in the archive.
+ *
+ * Returns: whether succeeded
+ **/
+gboolean
+backup_archive_reader_extract (BackupArchiveReader *reader,
+                               const gchar *filename,
+                               GError **error)
+{
+	struct utimbuf times;
+	gchar *buffer;
+	gint fd;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (reader != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, reader->entry.mode ? (reader->entry.mode & 0777) : 0600);
+	if (fd == -1) {
+		gint errn = errno;
+
+		g_set_error (
+			error, G_IO_ERROR, g_io_error_from_errno (errn),
+			_("Failed to create file “%s”: %s"), filename, g_strerror (errn));
+
+		return FALSE;
+	}
+
+	buffer = g_malloc (BUFFER_SIZE);
+
+	while (success && reader->data_left > 0) {
+		gssize nread, nwritten = 0;
+
+		nread = archive_reader_read_data (reader, buffer, BUFFER_SIZE, error);
+		if (nread < 0) {
+			success = FALSE;
+			break;
+		}
+
+		while (nwritten < nread) {
+			gssize nbytes;
+
+			nbytes = write (fd, buffer + nwritten, nread - nwritten);
+
+			if (nbytes < 0 && errno == EINTR)
+				continue;
+
+			if (nbytes < 0) {
+				gint errn = errno;
+
+				g_set_error (
+					error, G_IO_ERROR, g_io_error_from_errno (errn),
+					_("Failed to write file “%s”: %s"), filename, g_strerror (errn));
+
+				success = FALSE;
+				break;
+			}
+
+			nwritten += nbytes;
+		}
+	}
+
+	g_free (buffer);
+
+	if (close (fd) == -1 && success) {
+		gint errn = errno;
+
+		g_set_error (
+			error, G_IO_ERROR, g_io_error_from_errno (errn),
+			_("Failed to write file “%s”: %s"), filename, g_strerror (errn));
+
+		success = FALSE;
+	}
+
+	if (success) {
+		times.actime = reader->entry.mtime;
+		times.modtime = reader->entry.mtime;
+
+		g_utime (filename, &times);
+	}
+
+	return success;
+}
+
+/* Returns the content of the current entry, terminated with NUL */
+gchar *
+backup_archive_reader_read_data (BackupArchiveReader *reader,
+                                 gsize *out_len,
+                                 GError **error)
+{
+	gchar *data;
+	gssize nread;
+
+	g_return_val_if_fail (reader != NULL, NULL);
+
+	if (reader->data_left >= G_MAXSSIZE) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, g_strerror (ENOMEM));
+		return NULL;
+	}
+
+	data = g_try_malloc (reader->data_left + 1);
+	if (!data) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, g_strerror (ENOMEM));
+		return NULL;
+	}
+
+	nread = archive_reader_read_data (reader, data, reader->data_left, error);
+	if (nread < 0) {
+		g_free (data);
+		return NULL;
+	}
+
+	data[nread] = '\0';
+
+	if (out_len)
+		*out_len = nread;
+
+	return data;
+}
+
+/* Returns which part of the archive file had been read, or -1.0,
+ * when it's not known, like when reading from xz. */
+gdouble
+backup_archive_reader_get_fraction (BackupArchiveReader *reader)
+{
+	g_return_val_if_fail (reader != NULL, -1.0);
+
+	if (!reader->file_size)
+		return -1.0;
+
+	return MIN (1.0, ((gdouble) reader->raw_read) / reader->file_size);
+}
+
+void
+backup_archive_reader_free (BackupArchiveReader *reader)
+{
+	if (!reader)
+		return;
+
+	if (reader->subprocess && !g_subprocess_get_if_exited (reader->subprocess))
+		g_subprocess_force_exit (reader->subprocess);
+
+	archive_reader_clear_entry (reader);
+
+	g_clear_object (&reader->input);
+	g_clear_object (&reader->subprocess);
+	g_clear_object (&reader->decompressor);
+	g_clear_object (&reader->cancellable);
+	g_free (reader->in_buf);
+	g_free (reader->out_buf);
+
+	g_slice_free (BackupArchiveReader, reader);
+}
+
+/**
+ * backup_archive_read_member:
+ * @filename: an archive to read
+ * @use_xz: whether the @filename is compressed with xz, instead of gzip
+ * @path: path of the file in the archive
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Reads content of a single file @path from the archive @filename.
+ * It's not an error when the archive does not contain it.
+ *
+ * Returns: (nullable): content of the @path, or %NULL when not found or on error
+ **/
+gchar *
+backup_archive_read_member (const gchar *filename,
+                            gboolean use_xz,
+                            const gchar *path,
+                            GCancellable *cancellable,
+                            GError **error)
+{
+	BackupArchiveReader *reader;
+	const BackupArchiveEntry *entry;
+	gchar *data = NULL;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+	g_return_val_if_fail (path != NULL, NULL);
+
+	reader = backup_archive_reader_new (filename, use_xz, cancellable, error);
+	if (!reader)
+		return NULL;
+
+	while ((entry = backup_archive_reader_next (reader, error)) != NULL) {
+		if (entry->type == BACKUP_ARCHIVE_ENTRY_FILE && g_strcmp0 (entry->path, path) == 0) {
+			data = backup_archive_reader_read_data (reader, NULL, error);
+			break;
+		}
+	}
+
+	backup_archive_reader_free (reader);
+
+	return data;
+}
@@ -0,0 +1,106 @@
+/*
+ * evolution-backup-archive.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EVOLUTION_BACKUP_ARCHIVE_H
+#define EVOLUTION_BACKUP_ARCHIVE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BackupArchiveWriter BackupArchiveWriter;
+typedef struct _BackupArchiveReader BackupArchiveReader;
+
+typedef enum {
+	BACKUP_ARCHIVE_ENTRY_FILE,
+	BACKUP_ARCHIVE_ENTRY_DIRECTORY,
+	BACKUP_ARCHIVE_ENTRY_SYMLINK,
+	BACKUP_ARCHIVE_ENTRY_HARDLINK,
+	BACKUP_ARCHIVE_ENTRY_OTHER
+} BackupArchiveEntryType;
+
+typedef struct _BackupArchiveEntry {
+	BackupArchiveEntryType type;
+	gchar *path;
+	gchar *link_target;
+	guint64 size;
+	gint64 mtime;
+	guint mode;
+} BackupArchiveEntry;
+
+typedef void	(*BackupArchiveProgressFunc)	(guint64 data_written,
+						 gpointer user_data);
+
+BackupArchiveWriter *
+		backup_archive_writer_new	(const gchar *filename,
+						 gboolean use_xz,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	backup_archive_writer_add_directory
+						(BackupArchiveWriter *writer,
+						 const gchar *path,
+						 guint mode,
+						 gint64 mtime,
+						 GError **error);
+gboolean	backup_archive_writer_add_file	(BackupArchiveWriter *writer,
+						 const gchar *path,
+						 const gchar *filename,
+						 guint64 size,
+						 guint mode,
+						 gint64 mtime,
+						 GError **error);
+gboolean	backup_archive_writer_add_data	(BackupArchiveWriter *writer,
+						 const gchar *path,
+						 const gchar *data,
+						 gsize data_len,
+						 gint64 mtime,
+						 GError **error);
+void		backup_archive_writer_set_progress_func
+						(BackupArchiveWriter *writer,
+						 BackupArchiveProgressFunc func,
+						 gpointer user_data);
+gboolean	backup_archive_writer_close	(BackupArchiveWriter *writer,
+						 GError **error);
+void		backup_archive_writer_free	(BackupArchiveWriter *writer);
+
+BackupArchiveReader *
+		backup_archive_reader_new	(const gchar *filename,
+						 gboolean use_xz,
+						 GCancellable *cancellable,
+						 GError **error);
+const BackupArchiveEntry *
+		backup_archive_reader_next	(BackupArchiveReader *reader,
+						 GError **error);
+gboolean	backup_archive_reader_extract	(BackupArchiveReader *reader,
+						 const gchar *filename,
+						 GError **error);
+gchar *		backup_archive_reader_read_data	(BackupArchiveReader *reader,
+						 gsize *out_len,
+						 GError **error);
+gdouble		backup_archive_reader_get_fraction
+						(BackupArchiveReader *reader);
+void		backup_archive_reader_free	(BackupArchiveReader *reader);
+
+gchar *		backup_archive_read_member	(const gchar *filename,
+						 gboolean use_xz,
+						 const gchar *path,
+						 GCancellable *cancellable,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* EVOLUTION_BACKUP_ARCHIVE_H */
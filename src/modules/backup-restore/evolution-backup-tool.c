@@ -37,11 +37,15 @@
 #include "e-util/e-util-private.h"
 #include "e-util/e-util.h"
 
+#include "evolution-backup-archive.h"
+
 #define EVOUSERDATADIR_MAGIC "#EVO_USERDATADIR#"
 
 #define EVOLUTION "evolution"
 #define EVOLUTION_DIR "$DATADIR/"
 #define EVOLUTION_DIR_FILE EVOLUTION ".dir"
+#define MANIFEST_FILE EVOLUTION "-backup.manifest"
+#define BACKUP_STATE_FILE "backup-state.ini"
 #define DBUS_SOURCE_REGISTRY_SERVICE_FILE "$DBUSDATADIR/org.gnome.evolution.dataserver.Sources.service"
 
 #define ANCIENT_GCONF_DUMP_FILE "backup-restore-gconf.xml"
@@ -54,6 +58,13 @@
 
 #define KEY_FILE_GROUP "Evolution Backup"
 
+/* Content of the CACHEDIR.TAG file, see https://bford.info/cachedir/ */
+#define CACHEDIR_TAG_FILE "CACHEDIR.TAG"
+#define CACHEDIR_TAG_SIGNATURE "Signature: 8a477f597d28d172789f06886806bc55"
+
+/* Guards against a loop in the base archives of an incremental back up */
+#define MAX_INCREMENTAL_CHAIN 1000
+
 static gboolean backup_op = FALSE;
 static gchar *bk_file = NULL;
 static gboolean restore_op = FALSE;
@@ -62,11 +73,14 @@ static gboolean check_op = FALSE;
 static gchar *chk_file = NULL;
 static gboolean restart_arg = FALSE;
 static gboolean gui_arg = FALSE;
+static gboolean incremental_arg = FALSE;
+static gboolean exclude_caches_arg = FALSE;
 static gchar **opt_remaining = NULL;
 static gint result = 0;
 static GtkWidget *progress_dialog;
 static GtkWidget *pbar;
 static gchar *txt = NULL;
+static gint progress_permille = -1; /* -1 to pulse the progress bar */
 
 static GOptionEntry options[] = {
 	{ "backup", '\0', 0, G_OPTION_ARG_NONE, &backup_op,
@@ -79,6 +93,10 @@ static GOptionEntry options[] = {
 	  N_("Restart Evolution"), NULL },
 	{ "gui", '\0', 0, G_OPTION_ARG_NONE, &gui_arg,
 	  N_("With Graphical User Interface"), NULL },
+	{ "incremental", '\0', 0, G_OPTION_ARG_NONE, &incremental_arg,
+	  N_("Back up only files changed since the last back up"), NULL },
+	{ "exclude-caches", '\0', 0, G_OPTION_ARG_NONE, &exclude_caches_arg,
+	  N_("Do not back up data which can be downloaded again"), NULL },
 	{ G_OPTION_REMAINING, '\0', 0,
 	  G_OPTION_ARG_STRING_ARRAY, &opt_remaining },
 	{ NULL }
@@ -235,14 +253,10 @@ run_evolution_no_wait (void)
 	g_spawn_command_line_async (EVOLUTION, NULL);
 }
 
-static void
-write_dir_file (void)
+static GString *
+get_dir_file_content (const gchar *base_archive)
 {
-	GString *content, *filename;
-	GError *error = NULL;
-
-	filename = replace_variables ("$HOME/" EVOLUTION_DIR_FILE, TRUE);
-	g_return_if_fail (filename != NULL);
+	GString *content;
 
 	content = replace_variables (
 		"[" KEY_FILE_GROUP "]\n"
@@ -250,17 +264,13 @@ write_dir_file (void)
 		"UserDataDir=$STRIPDATADIR\n"
 		"UserConfigDir=$STRIPCONFIGDIR\n"
 		, TRUE);
-	g_return_if_fail (content != NULL);
-
-	g_file_set_contents (filename->str, content->str, content->len, &error);
+	g_return_val_if_fail (content != NULL, NULL);
 
-	if (error != NULL) {
-		g_warning ("Failed to write file '%s': %s\n", filename->str, error->message);
-		g_error_free (error);
-	}
+	/* An incremental back up contains only files changed since its base */
+	if (base_archive)
+		g_string_append_printf (content, "BaseArchive=%s\n", base_archive);
 
-	g_string_free (filename, TRUE);
-	g_string_free (content, TRUE);
+	return content;
 }
 
 static gboolean
@@ -278,13 +288,433 @@ get_filename_is_xz (const gchar *filename)
 	return g_ascii_strcasecmp (filename + len - 3, ".xz") == 0;
 }
 
+static gchar *
+get_absolute_filename (const gchar *filename)
+{
+	gchar *current_dir, *res;
+
+	if (g_path_is_absolute (filename))
+		return g_strdup (filename);
+
+	current_dir = g_get_current_dir ();
+	res = g_build_filename (current_dir, filename, NULL);
+	g_free (current_dir);
+
+	return res;
+}
+
+typedef struct _BackupFile {
+	gchar *path; /* in the archive */
+	gchar *filename; /* on the disk */
+	guint64 size;
+	gint64 mtime;
+	guint mode;
+	gboolean is_dir;
+	gboolean unchanged;
+} BackupFile;
+
+static BackupFile *
+backup_file_new (const gchar *path,
+                 const gchar *filename,
+                 const GStatBuf *st,
+                 gboolean is_dir)
+{
+	BackupFile *file;
+
+	file = g_slice_new0 (BackupFile);
+	file->path = g_strdup (path);
+	file->filename = g_strdup (filename);
+	file->size = is_dir ? 0 : st->st_size;
+	file->mtime = st->st_mtime;
+	file->mode = st->st_mode & 07777;
+	file->is_dir = is_dir;
+
+	return file;
+}
+
+static void
+backup_file_free (gpointer ptr)
+{
+	BackupFile *file = ptr;
+
+	if (file) {
+		g_free (file->path);
+		g_free (file->filename);
+		g_slice_free (BackupFile, file);
+	}
+}
+
+static gchar *
+backup_file_dup_stamp (const BackupFile *file)
+{
+	return g_strdup_printf ("%" G_GUINT64_FORMAT "\t%" G_GINT64_FORMAT, file->size, file->mtime);
+}
+
+/* Whether the directory is marked as a cache with a CACHEDIR.TAG file */
+static gboolean
+backup_dir_is_cache (const gchar *dirname)
+{
+	gchar *filename, *content = NULL;
+	gboolean is_cache;
+
+	filename = g_build_filename (dirname, CACHEDIR_TAG_FILE, NULL);
+	is_cache = g_file_get_contents (filename, &content, NULL, NULL) &&
+		g_str_has_prefix (content, CACHEDIR_TAG_SIGNATURE);
+	g_free (content);
+	g_free (filename);
+
+	return is_cache;
+}
+
+/* Local copies of messages of remote mail accounts can be downloaded
+ * from the server again, thus they are skipped with --exclude-caches. */
+static void
+backup_add_remote_mail_dirs (GHashTable *excluded_dirs)
+{
+	const gchar *local_backends[] = {
+		"local", "maildir", "mbox", "spool", "spooldir", "vfolder", "none", NULL
+	};
+	gchar *sources_dir;
+	const gchar *name;
+	GDir *dir;
+
+	sources_dir = g_build_filename (e_get_user_config_dir (), "sources", NULL);
+	dir = g_dir_open (sources_dir, 0, NULL);
+
+	while (dir && (name = g_dir_read_name (dir)) != NULL) {
+		GKeyFile *key_file;
+		gchar *filename, *backend_name;
+
+		if (!g_str_has_suffix (name, ".source"))
+			continue;
+
+		filename = g_build_filename (sources_dir, name, NULL);
+		key_file = g_key_file_new ();
+
+		if (g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL)) {
+			backend_name = g_key_file_get_string (key_file, "Mail Account", "BackendName", NULL);
+
+			if (backend_name && *backend_name && !g_strv_contains (local_backends, backend_name)) {
+				gchar *uid;
+
+				uid = g_strndup (name, strlen (name) - strlen (".source"));
+				g_hash_table_add (excluded_dirs, g_build_filename (e_get_user_data_dir (), "mail", uid, NULL));
+				g_free (uid);
+			}
+
+			g_free (backend_name);
+		}
+
+		g_key_file_free (key_file);
+		g_free (filename);
+	}
+
+	if (dir)
+		g_dir_close (dir);
+	g_free (sources_dir);
+}
+
+/* Symbolic links are followed, like 'tar -h' did */
+static void
+backup_collect_files (const gchar *dirname,
+                      const gchar *path,
+                      GHashTable *excluded_dirs,
+                      GHashTable *visited_dirs,
+                      GPtrArray *files)
+{
+	GStatBuf st;
+	const gchar *name;
+	GDir *dir;
+
+	if (g_stat (dirname, &st) != 0 || !S_ISDIR (st.st_mode))
+		return;
+
+	/* Do not loop on symbolic links pointing to a parent directory */
+	if (!g_hash_table_add (visited_dirs, g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+		(guint64) st.st_dev, (guint64) st.st_ino)))
+		return;
+
+	if (g_hash_table_contains (excluded_dirs, dirname) ||
+	    (exclude_caches_arg && backup_dir_is_cache (dirname))) {
+		g_message ("Skipping cache directory '%s'", dirname);
+		return;
+	}
+
+	g_ptr_array_add (files, backup_file_new (path, dirname, &st, TRUE));
+
+	dir = g_dir_open (dirname, 0, NULL);
+	if (!dir)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *filename, *file_path;
+
+		filename = g_build_filename (dirname, name, NULL);
+		file_path = g_strconcat (path, "/", name, NULL);
+
+		if (g_stat (filename, &st) == 0) {
+			if (S_ISDIR (st.st_mode))
+				backup_collect_files (filename, file_path, excluded_dirs, visited_dirs, files);
+			else if (S_ISREG (st.st_mode))
+				g_ptr_array_add (files, backup_file_new (file_path, filename, &st, FALSE));
+		}
+
+		g_free (file_path);
+		g_free (filename);
+	}
+
+	g_dir_close (dir);
+}
+
+/* The manifest lists all files of the back up, one per line, as
+ * "size<TAB>mtime<TAB>escaped-path"; the next incremental back up
+ * compares against it which files changed. */
+static GString *
+backup_build_manifest (GPtrArray *files)
+{
+	GString *manifest;
+	guint ii;
+
+	manifest = g_string_sized_new (files->len * 64);
+
+	for (ii = 0; ii < files->len; ii++) {
+		BackupFile *file = g_ptr_array_index (files, ii);
+		gchar *stamp, *escaped;
+
+		if (file->is_dir)
+			continue;
+
+		stamp = backup_file_dup_stamp (file);
+		escaped = g_strescape (file->path, NULL);
+
+		g_string_append_printf (manifest, "%s\t%s\n", stamp, escaped);
+
+		g_free (escaped);
+		g_free (stamp);
+	}
+
+	return manifest;
+}
+
+/* Returns a path ~> stamp of the manifest content */
+static GHashTable *
+parse_manifest (const gchar *content)
+{
+	GHashTable *manifest;
+	gchar **lines;
+	gint ii;
+
+	manifest = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	if (!content)
+		return manifest;
+
+	lines = g_strsplit (content, "\n", -1);
+
+	for (ii = 0; lines[ii]; ii++) {
+		gchar **parts;
+
+		parts = g_strsplit (lines[ii], "\t", 3);
+
+		if (g_strv_length (parts) == 3) {
+			g_hash_table_insert (manifest,
+				g_strcompress (parts[2]),
+				g_strconcat (parts[0], "\t", parts[1], NULL));
+		}
+
+		g_strfreev (parts);
+	}
+
+	g_strfreev (lines);
+
+	return manifest;
+}
+
+/* Returns the archive written by the last successful back up, if it still exists */
+static gchar *
+backup_dup_last_archive (void)
+{
+	GKeyFile *key_file;
+	gchar *filename, *last_archive;
+
+	filename = g_build_filename (e_get_user_cache_dir (), "backup", BACKUP_STATE_FILE, NULL);
+	key_file = g_key_file_new ();
+
+	if (g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL))
+		last_archive = g_key_file_get_string (key_file, KEY_FILE_GROUP, "LastArchive", NULL);
+	else
+		last_archive = NULL;
+
+	if (last_archive && !g_file_test (last_archive, G_FILE_TEST_IS_REGULAR))
+		g_clear_pointer (&last_archive, g_free);
+
+	g_key_file_free (key_file);
+	g_free (filename);
+
+	return last_archive;
+}
+
+static void
+backup_save_last_archive (const gchar *archive_filename)
+{
+	GKeyFile *key_file;
+	gchar *dirname, *filename;
+	GError *error = NULL;
+
+	dirname = g_build_filename (e_get_user_cache_dir (), "backup", NULL);
+	filename = g_build_filename (dirname, BACKUP_STATE_FILE, NULL);
+
+	g_mkdir_with_parents (dirname, 0700);
+
+	key_file = g_key_file_new ();
+	g_key_file_set_string (key_file, KEY_FILE_GROUP, "LastArchive", archive_filename);
+
+	if (!g_key_file_save_to_file (key_file, filename, &error)) {
+		g_warning ("Failed to write file '%s': %s", filename, error ? error->message : "Unknown error");
+		g_clear_error (&error);
+	}
+
+	g_key_file_free (key_file);
+	g_free (filename);
+	g_free (dirname);
+}
+
+static void
+backup_progress_cb (guint64 data_written,
+                    gpointer user_data)
+{
+	const guint64 *ptotal = user_data;
+
+	if (*ptotal > 0)
+		g_atomic_int_set (&progress_permille, (gint) (MIN (data_written, *ptotal) * 1000 / *ptotal));
+}
+
+static gboolean
+backup_write_archive (const gchar *filename,
+                      GCancellable *cancellable,
+                      GError **error)
+{
+	BackupArchiveWriter *writer;
+	GHashTable *excluded_dirs, *visited_dirs, *previous = NULL;
+	GPtrArray *files;
+	GString *dir_file, *manifest;
+	gchar *archive_filename, *base_archive = NULL;
+	guint64 total = 0;
+	gint64 now;
+	guint ii, n_unchanged = 0;
+	gboolean success;
+
+	archive_filename = get_absolute_filename (filename);
+	excluded_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	visited_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	files = g_ptr_array_new_with_free_func (backup_file_free);
+
+	if (exclude_caches_arg)
+		backup_add_remote_mail_dirs (excluded_dirs);
+
+	backup_collect_files (e_get_user_data_dir (), strip_home_dir (e_get_user_data_dir ()), excluded_dirs, visited_dirs, files);
+	backup_collect_files (e_get_user_config_dir (), strip_home_dir (e_get_user_config_dir ()), excluded_dirs, visited_dirs, files);
+
+	manifest = backup_build_manifest (files);
+
+	if (incremental_arg) {
+		base_archive = backup_dup_last_archive ();
+
+		/* Cannot be based on itself, when overwriting the last back up */
+		if (g_strcmp0 (base_archive, archive_filename) == 0)
+			g_clear_pointer (&base_archive, g_free);
+
+		if (base_archive) {
+			gchar *content;
+
+			content = backup_archive_read_member (base_archive, get_filename_is_xz (base_archive), MANIFEST_FILE, cancellable, NULL);
+			if (content)
+				previous = parse_manifest (content);
+			else
+				g_clear_pointer (&base_archive, g_free);
+
+			g_free (content);
+		}
+
+		if (!base_archive)
+			g_message ("No usable previous back up found, doing a full back up");
+	}
+
+	for (ii = 0; ii < files->len; ii++) {
+		BackupFile *file = g_ptr_array_index (files, ii);
+
+		if (file->is_dir)
+			continue;
+
+		if (previous) {
+			gchar *stamp = backup_file_dup_stamp (file);
+
+			file->unchanged = g_strcmp0 (g_hash_table_lookup (previous, file->path), stamp) == 0;
+
+			g_free (stamp);
+		}
+
+		if (file->unchanged)
+			n_unchanged++;
+		else
+			total += file->size;
+	}
+
+	if (base_archive)
+		g_message ("Incremental back up based on '%s', skipping %u unchanged files", base_archive, n_unchanged);
+
+	dir_file = get_dir_file_content (base_archive);
+	now = g_get_real_time () / G_USEC_PER_SEC;
+
+	g_atomic_int_set (&progress_permille, 0);
+
+	writer = backup_archive_writer_new (filename, get_filename_is_xz (filename), cancellable, error);
+	success = writer != NULL;
+
+	if (success)
+		backup_archive_writer_set_progress_func (writer, backup_progress_cb, &total);
+
+	/* Description and the manifest go first, thus they can be read
+	 * without decompressing the whole archive */
+	success = success && backup_archive_writer_add_data (writer, EVOLUTION_DIR_FILE, dir_file->str, dir_file->len, now, error);
+	success = success && backup_archive_writer_add_data (writer, MANIFEST_FILE, manifest->str, manifest->len, now, error);
+
+	for (ii = 0; success && ii < files->len; ii++) {
+		BackupFile *file = g_ptr_array_index (files, ii);
+
+		if (file->is_dir)
+			success = backup_archive_writer_add_directory (writer, file->path, file->mode, file->mtime, error);
+		else if (!file->unchanged)
+			success = backup_archive_writer_add_file (writer, file->path, file->filename, file->size, file->mode, file->mtime, error);
+	}
+
+	success = success && backup_archive_writer_close (writer, error);
+
+	backup_archive_writer_free (writer);
+
+	if (success)
+		backup_save_last_archive (archive_filename);
+
+	g_atomic_int_set (&progress_permille, -1);
+
+	g_string_free (dir_file, TRUE);
+	g_string_free (manifest, TRUE);
+	g_ptr_array_unref (files);
+	g_hash_table_destroy (visited_dirs);
+	g_hash_table_destroy (excluded_dirs);
+	if (previous)
+		g_hash_table_destroy (previous);
+	g_free (base_archive);
+	g_free (archive_filename);
+
+	return success;
+}
+
 static void
 backup (const gchar *filename,
         GCancellable *cancellable)
 {
-	gchar *command;
-	gchar *quotedfname;
-	gboolean use_xz;
+	GError *error = NULL;
 
 	g_return_if_fail (filename && *filename);
 
@@ -312,28 +742,19 @@ backup (const gchar *filename,
 		EVOLUTION_DIR DCONF_DUMP_FILE_EVO,
 		e_get_user_data_dir (), EVOUSERDATADIR_MAGIC);
 
-	write_dir_file ();
-
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
 
 	txt = _("Backing Evolution data (Mails, Contacts, Calendar, Tasks, Memos)");
 
-	quotedfname = g_shell_quote (filename);
-	use_xz = get_filename_is_xz (filename);
-
-	command = g_strdup_printf (
-		"cd $HOME && tar chf - $STRIPDATADIR "
-		"$STRIPCONFIGDIR " EVOLUTION_DIR_FILE " | "
-		"%s > %s", use_xz ? "xz -z" : "gzip", quotedfname);
-	run_cmd (command);
-
-	g_free (command);
-	g_free (quotedfname);
-
-	run_cmd ("rm $HOME/" EVOLUTION_DIR_FILE);
-
-	txt = _("Back up complete");
+	if (backup_write_archive (filename, cancellable, &error)) {
+		txt = _("Back up complete");
+	} else {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("Failed to write back up '%s': %s", filename, error ? error->message : "Unknown error");
+		g_clear_error (&error);
+		result = 1;
+	}
 
 	if (restart_arg) {
 
@@ -346,24 +767,41 @@ backup (const gchar *filename,
 
 }
 
+static gchar *
+dup_archive_dir (const gchar *value)
+{
+	gchar *dir;
+	gsize len;
+
+	dir = g_strdup (value);
+	len = strlen (dir);
+
+	/* remove trailing dir separator */
+	while (len > 0 && (dir[len - 1] == '/' || dir[len - 1] == '\\'))
+		dir[--len] = '\0';
+
+	return dir;
+}
+
 static void
-extract_backup_data (const gchar *filename,
+extract_backup_data (const gchar *content,
                      gchar **restored_version,
                      gchar **data_dir,
-                     gchar **config_dir)
+                     gchar **config_dir,
+                     gchar **base_archive)
 {
 	GKeyFile *key_file;
 	GError *error = NULL;
 
-	g_return_if_fail (filename != NULL);
+	g_return_if_fail (content != NULL);
 	g_return_if_fail (data_dir != NULL);
 	g_return_if_fail (config_dir != NULL);
 
 	key_file = g_key_file_new ();
-	g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, &error);
+	g_key_file_load_from_data (key_file, content, -1, G_KEY_FILE_NONE, &error);
 
 	if (error != NULL) {
-		g_warning ("Failed to read '%s': %s", filename, error->message);
+		g_warning ("Failed to read '%s': %s", EVOLUTION_DIR_FILE, error->message);
 		g_error_free (error);
 
 	/* This is the current format as of Evolution 3.6. */
@@ -372,20 +810,26 @@ extract_backup_data (const gchar *filename,
 
 		tmp = g_key_file_get_value (
 			key_file, KEY_FILE_GROUP, "Version", NULL);
-		if (tmp != NULL)
+		if (tmp != NULL && restored_version)
 			*restored_version = g_strstrip (g_strdup (tmp));
 		g_free (tmp);
 
 		tmp = g_key_file_get_value (
 			key_file, KEY_FILE_GROUP, "UserDataDir", NULL);
 		if (tmp != NULL)
-			*data_dir = g_shell_quote (tmp);
+			*data_dir = dup_archive_dir (tmp);
 		g_free (tmp);
 
 		tmp = g_key_file_get_value (
 			key_file, KEY_FILE_GROUP, "UserConfigDir", NULL);
 		if (tmp != NULL)
-			*config_dir = g_shell_quote (tmp);
+			*config_dir = dup_archive_dir (tmp);
+		g_free (tmp);
+
+		tmp = g_key_file_get_value (
+			key_file, KEY_FILE_GROUP, "BaseArchive", NULL);
+		if (tmp != NULL && *tmp && base_archive)
+			*base_archive = g_strdup (tmp);
 		g_free (tmp);
 
 	/* This is the legacy format with no version information. */
@@ -394,34 +838,311 @@ extract_backup_data (const gchar *filename,
 
 		tmp = g_key_file_get_value (key_file, "dirs", "data", NULL);
 		if (tmp)
-			*data_dir = g_shell_quote (tmp);
+			*data_dir = dup_archive_dir (tmp);
 		g_free (tmp);
 
 		tmp = g_key_file_get_value (key_file, "dirs", "config", NULL);
 		if (tmp)
-			*config_dir = g_shell_quote (tmp);
+			*config_dir = dup_archive_dir (tmp);
 		g_free (tmp);
 	}
 
 	g_key_file_free (key_file);
 }
 
-static gint
-get_dir_level (const gchar *dir)
+typedef struct _RestoreArchive {
+	gchar *filename;
+	gchar *data_dir; /* in the archive */
+	gchar *config_dir; /* in the archive */
+} RestoreArchive;
+
+static void
+restore_archive_free (gpointer ptr)
 {
-	gint res = 0, i;
+	RestoreArchive *archive = ptr;
+
+	if (archive) {
+		g_free (archive->filename);
+		g_free (archive->data_dir);
+		g_free (archive->config_dir);
+		g_slice_free (RestoreArchive, archive);
+	}
+}
 
-	g_return_val_if_fail (dir != NULL, -1);
+/* Reads the @filename and all the base archives it depends on into
+ * the @chain, ordered from the full back up to the @filename. */
+static gboolean
+restore_read_chain (const gchar *filename,
+                    GPtrArray *chain,
+                    gchar **restored_version,
+                    GCancellable *cancellable,
+                    GError **error)
+{
+	gchar *current;
+	gboolean success = TRUE;
+
+	current = g_strdup (filename);
+
+	while (current && success) {
+		RestoreArchive *archive;
+		gchar *content, *base_archive = NULL;
+		guint ii;
+
+		for (ii = 0; ii < chain->len; ii++) {
+			archive = g_ptr_array_index (chain, ii);
+
+			if (g_strcmp0 (archive->filename, current) == 0)
+				break;
+		}
+
+		if (ii < chain->len || chain->len >= MAX_INCREMENTAL_CHAIN) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				_("Back up file “%s” is its own base"), current);
+			success = FALSE;
+			break;
+		}
+
+		if (!g_file_test (current, G_FILE_TEST_IS_REGULAR)) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+				_("Base back up file “%s” does not exist"), current);
+			success = FALSE;
+			break;
+		}
+
+		content = backup_archive_read_member (current, get_filename_is_xz (current), EVOLUTION_DIR_FILE, cancellable, error);
+		if (!content) {
+			if (error && !*error) {
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					_("Back up file “%s” does not contain “%s”"), current, EVOLUTION_DIR_FILE);
+			}
+			success = FALSE;
+			break;
+		}
 
-	for (i = 0; dir[i]; i++) {
-		if (dir[i] == '/' || dir[i] == '\\')
-			res++;
+		archive = g_slice_new0 (RestoreArchive);
+		archive->filename = current;
+
+		extract_backup_data (content,
+			chain->len ? NULL : restored_version,
+			&archive->data_dir,
+			&archive->config_dir,
+			&base_archive);
+
+		g_free (content);
+
+		g_ptr_array_insert (chain, 0, archive);
+
+		if (!archive->data_dir || !archive->config_dir) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				_("Back up file “%s” does not contain data directories"), current);
+			g_free (base_archive);
+			current = NULL;
+			success = FALSE;
+			break;
+		}
+
+		current = base_archive;
 	}
 
-	if (i > 0)
-		res++;
+	g_free (current);
 
-	return res;
+	return success;
+}
+
+/* Checks whether the archive @path is inside the archive @dir, and if so,
+ * sets the @out_rest to the part of the @path relative to the @dir. */
+static gboolean
+restore_path_in_dir (const gchar *path,
+                     const gchar *dir,
+                     const gchar **out_rest)
+{
+	gsize len = strlen (dir);
+
+	if (strncmp (path, dir, len) != 0 || (path[len] && path[len] != '/'))
+		return FALSE;
+
+	*out_rest = path + len + (path[len] ? 1 : 0);
+
+	return TRUE;
+}
+
+/* Returns where to restore the archive @path, or %NULL when
+ * it is not in the data or the config directory of the @archive. */
+static gchar *
+restore_get_destination (RestoreArchive *archive,
+                         const gchar *path)
+{
+	const gchar *target_dir, *rest = NULL;
+
+	if (restore_path_in_dir (path, archive->data_dir, &rest))
+		target_dir = e_get_user_data_dir ();
+	else if (restore_path_in_dir (path, archive->config_dir, &rest))
+		target_dir = e_get_user_config_dir ();
+	else
+		return NULL;
+
+	return *rest ? g_build_filename (target_dir, rest, NULL) : g_strdup (target_dir);
+}
+
+static gboolean
+restore_extract_archive (RestoreArchive *archive,
+                         guint index,
+                         guint n_archives,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+	BackupArchiveReader *reader;
+	const BackupArchiveEntry *entry;
+	GError *local_error = NULL;
+	gboolean success = TRUE;
+
+	reader = backup_archive_reader_new (archive->filename, get_filename_is_xz (archive->filename), cancellable, error);
+	if (!reader)
+		return FALSE;
+
+	while (success && (entry = backup_archive_reader_next (reader, &local_error)) != NULL) {
+		gchar *destination;
+		gdouble fraction;
+
+		destination = restore_get_destination (archive, entry->path);
+		if (!destination)
+			continue;
+
+		if (entry->type == BACKUP_ARCHIVE_ENTRY_DIRECTORY) {
+			g_mkdir_with_parents (destination, 0700);
+		} else if (entry->type == BACKUP_ARCHIVE_ENTRY_FILE) {
+			gchar *dirname;
+
+			dirname = g_path_get_dirname (destination);
+			g_mkdir_with_parents (dirname, 0700);
+			g_free (dirname);
+
+			success = backup_archive_reader_extract (reader, destination, &local_error);
+		} else if (entry->type == BACKUP_ARCHIVE_ENTRY_HARDLINK) {
+			gchar *source, *dirname;
+
+			/* The linked file had been extracted already, thus copy it */
+			source = restore_get_destination (archive, entry->link_target);
+
+			if (source && g_file_test (source, G_FILE_TEST_IS_REGULAR)) {
+				GFile *source_file, *destination_file;
+
+				dirname = g_path_get_dirname (destination);
+				g_mkdir_with_parents (dirname, 0700);
+				g_free (dirname);
+
+				source_file = g_file_new_for_path (source);
+				destination_file = g_file_new_for_path (destination);
+
+				success = g_file_copy (source_file, destination_file,
+					G_FILE_COPY_OVERWRITE, cancellable, NULL, NULL, &local_error);
+
+				g_object_unref (destination_file);
+				g_object_unref (source_file);
+			} else {
+				g_set_error (&local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+					_("Back up file “%s” contains a link “%s” to a missing file “%s”"),
+					archive->filename, entry->path, entry->link_target);
+				success = FALSE;
+			}
+
+			g_free (source);
+		} else {
+			/* Back ups follow symbolic links, thus they contain none */
+			g_message ("Skipping '%s' of an unsupported type", entry->path);
+		}
+
+		g_free (destination);
+
+		fraction = backup_archive_reader_get_fraction (reader);
+		if (fraction >= 0)
+			g_atomic_int_set (&progress_permille, (gint) (1000 * (index + fraction) / n_archives));
+	}
+
+	backup_archive_reader_free (reader);
+
+	if (local_error) {
+		g_propagate_error (error, local_error);
+		success = FALSE;
+	}
+
+	return success;
+}
+
+/* Removes files not listed in the manifest of the last incremental
+ * back up, which means they had been deleted before that back up. */
+static void
+restore_prune_files (const gchar *dirname,
+                     const gchar *path,
+                     GHashTable *manifest)
+{
+	const gchar *name;
+	GDir *dir;
+
+	dir = g_dir_open (dirname, 0, NULL);
+	if (!dir)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *filename, *file_path;
+
+		filename = g_build_filename (dirname, name, NULL);
+		file_path = g_strconcat (path, "/", name, NULL);
+
+		if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+			restore_prune_files (filename, file_path, manifest);
+		else if (!g_hash_table_contains (manifest, file_path))
+			g_unlink (filename);
+
+		g_free (file_path);
+		g_free (filename);
+	}
+
+	g_dir_close (dir);
+}
+
+static gboolean
+restore_archives (GPtrArray *chain,
+                  GCancellable *cancellable,
+                  GError **error)
+{
+	RestoreArchive *last;
+	gchar *content;
+	guint ii;
+
+	g_mkdir_with_parents (e_get_user_data_dir (), 0700);
+	g_mkdir_with_parents (e_get_user_config_dir (), 0700);
+
+	g_atomic_int_set (&progress_permille, 0);
+
+	for (ii = 0; ii < chain->len; ii++) {
+		if (!restore_extract_archive (g_ptr_array_index (chain, ii), ii, chain->len, cancellable, error)) {
+			g_atomic_int_set (&progress_permille, -1);
+			return FALSE;
+		}
+	}
+
+	g_atomic_int_set (&progress_permille, -1);
+
+	if (chain->len < 2)
+		return TRUE;
+
+	last = g_ptr_array_index (chain, chain->len - 1);
+	content = backup_archive_read_member (last->filename, get_filename_is_xz (last->filename), MANIFEST_FILE, cancellable, NULL);
+
+	if (content) {
+		GHashTable *manifest;
+
+		manifest = parse_manifest (content);
+
+		restore_prune_files (e_get_user_data_dir (), last->data_dir, manifest);
+		restore_prune_files (e_get_user_config_dir (), last->config_dir, manifest);
+
+		g_hash_table_destroy (manifest);
+		g_free (content);
+	}
+
+	return TRUE;
 }
 
 static gchar *
@@ -474,22 +1195,15 @@ unset_eds_migrated_flag (void)
 	g_object_unref (settings);
 }
 
+/* The @chain is %NULL for the legacy format, which contains ~/.evolution */
 static void
-restore (const gchar *filename,
-         GCancellable *cancellable)
+restore_files (const gchar *filename,
+               GPtrArray *chain,
+               const gchar *restored_version,
+               GCancellable *cancellable)
 {
 	gchar *command;
-	gchar *quotedfname;
-	gboolean is_new_format = FALSE;
-
-	g_return_if_fail (filename && *filename);
-
-	if (!check (filename, &is_new_format)) {
-		g_message ("Cannot restore from an incorrect archive '%s'.", filename);
-		goto end;
-	}
-
-	quotedfname = g_shell_quote (filename);
+	gboolean is_new_format = chain != NULL;
 
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
@@ -511,63 +1225,14 @@ restore (const gchar *filename,
 	txt = _("Extracting files from back up");
 
 	if (is_new_format) {
-		GString *dir_fn;
-		gchar *data_dir = NULL;
-		gchar *config_dir = NULL;
-		gchar *restored_version = NULL;
-		const gchar *tar_opts;
+		GError *error = NULL;
 
-		if (get_filename_is_xz (filename))
-			tar_opts = "-xJf";
-		else
-			tar_opts = "-xzf";
-
-		command = g_strdup_printf (
-			"cd $TMP && tar %s %s " EVOLUTION_DIR_FILE,
-			tar_opts, quotedfname);
-		run_cmd (command);
-		g_free (command);
-
-		dir_fn = replace_variables ("$TMP" G_DIR_SEPARATOR_S EVOLUTION_DIR_FILE, TRUE);
-		if (!dir_fn) {
-			g_warning ("Failed to create evolution's dir filename");
-			goto end;
-		}
-
-		/* data_dir and config_dir are quoted inside extract_backup_data */
-		extract_backup_data (
-			dir_fn->str,
-			&restored_version,
-			&data_dir,
-			&config_dir);
-
-		g_unlink (dir_fn->str);
-		g_string_free (dir_fn, TRUE);
-
-		if (!data_dir || !config_dir) {
-			g_warning (
-				"Failed to get old data_dir (%p)/"
-				"config_dir (%p)", data_dir, config_dir);
-			g_free (data_dir);
-			g_free (config_dir);
-			goto end;
+		if (!restore_archives (chain, cancellable, &error)) {
+			if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+				g_warning ("Failed to restore from '%s': %s", filename, error ? error->message : "Unknown error");
+			g_clear_error (&error);
 		}
 
-		g_mkdir_with_parents (e_get_user_data_dir (), 0700);
-		g_mkdir_with_parents (e_get_user_config_dir (), 0700);
-
-		command = g_strdup_printf (
-			"cd $DATADIR && tar --strip-components %d %s %s %s",
-			 get_dir_level (data_dir), tar_opts, quotedfname, data_dir);
-		run_cmd (command);
-		g_free (command);
-
-		command = g_strdup_printf (
-			"cd $CONFIGDIR && tar --strip-components %d %s %s %s",
-			get_dir_level (config_dir), tar_opts, quotedfname, config_dir);
-		run_cmd (command);
-		g_free (command);
-
 		/* If the back file had version information, set the last
 		 * used version in GSettings before restarting Evolution. */
 		if (restored_version != NULL && *restored_version != '\0') {
@@ -578,12 +1243,9 @@ restore (const gchar *filename,
 				settings, "version", restored_version);
 			g_object_unref (settings);
 		}
-
-		g_free (data_dir);
-		g_free (config_dir);
-		g_free (restored_version);
 	} else {
 		const gchar *decr_opts;
+		gchar *quotedfname;
 
 		if (get_filename_is_xz (filename))
 			decr_opts = "xz -cd";
@@ -592,14 +1254,14 @@ restore (const gchar *filename,
 
 		run_cmd ("mv $HOME/.evolution $HOME/.evolution_old");
 
+		quotedfname = g_shell_quote (filename);
 		command = g_strdup_printf (
 			"cd $HOME && %s %s | tar xf -", decr_opts, quotedfname);
 		run_cmd (command);
 		g_free (command);
+		g_free (quotedfname);
 	}
 
-	g_free (quotedfname);
-
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
 
@@ -696,8 +1358,40 @@ restore (const gchar *filename,
 	/* This runs migration routines on the newly-restored data. */
 	run_cmd (command);
 	g_free (command);
+}
+
+static void
+restore (const gchar *filename,
+         GCancellable *cancellable)
+{
+	GPtrArray *chain = NULL;
+	gchar *restored_version = NULL;
+	gboolean is_new_format = FALSE;
+
+	g_return_if_fail (filename && *filename);
+
+	if (!check (filename, &is_new_format)) {
+		g_message ("Cannot restore from an incorrect archive '%s'.", filename);
+	} else if (is_new_format) {
+		GError *error = NULL;
+
+		chain = g_ptr_array_new_with_free_func (restore_archive_free);
+
+		/* Resolve all base archives of an incremental back up
+		 * before touching the current data. */
+		if (restore_read_chain (filename, chain, &restored_version, cancellable, &error)) {
+			restore_files (filename, chain, restored_version, cancellable);
+		} else {
+			g_message ("Cannot restore from '%s': %s", filename, error ? error->message : "Unknown error");
+			g_clear_error (&error);
+		}
+
+		g_ptr_array_unref (chain);
+		g_free (restored_version);
+	} else {
+		restore_files (filename, NULL, NULL, cancellable);
+	}
 
-end:
 	if (restart_arg) {
 		if (g_cancellable_is_cancelled (cancellable))
 			return;
@@ -716,79 +1410,45 @@ static gboolean
 check (const gchar *filename,
        gboolean *is_new_format)
 {
-	gchar *command;
-	gchar *quotedfname;
-	const gchar *tar_opts;
-	gboolean is_new = TRUE;
+	BackupArchiveReader *reader;
+	const BackupArchiveEntry *entry;
+	gboolean has_dir_file = FALSE;
+	gboolean has_evolution_dir = FALSE;
+	gboolean has_gconf_dump = FALSE;
+	GError *error = NULL;
 
 	g_return_val_if_fail (filename && *filename, FALSE);
 
-	if (get_filename_is_xz (filename))
-		tar_opts = "-tJf";
-	else
-		tar_opts = "-tzf";
-
-	quotedfname = g_shell_quote (filename);
-
 	if (is_new_format)
 		*is_new_format = FALSE;
 
-	command = g_strdup_printf ("tar %s %s 1>/dev/null", tar_opts, quotedfname);
-	result = system (command);
-	g_free (command);
-
-	g_message ("First result %d", result);
-	if (result) {
-		g_free (quotedfname);
-		return FALSE;
-	}
-
-	command = g_strdup_printf (
-		"tar %s %s | grep -e \"%s$\"",
-		tar_opts, quotedfname, EVOLUTION_DIR_FILE);
-	result = system (command);
-	g_free (command);
+	reader = backup_archive_reader_new (filename, get_filename_is_xz (filename), NULL, &error);
 
-	if (result) {
-		command = g_strdup_printf (
-			"tar %s %s | grep -e \"^\\.evolution/$\"",
-			tar_opts, quotedfname);
-		result = system (command);
-		g_free (command);
-		is_new = FALSE;
+	/* Read the whole archive, to verify it's not broken */
+	while (reader && (entry = backup_archive_reader_next (reader, &error)) != NULL) {
+		if (g_strcmp0 (entry->path, EVOLUTION_DIR_FILE) == 0)
+			has_dir_file = TRUE;
+		else if (entry->type == BACKUP_ARCHIVE_ENTRY_DIRECTORY && g_strcmp0 (entry->path, ".evolution") == 0)
+			has_evolution_dir = TRUE;
+		else if (g_strcmp0 (entry->path, ".evolution/" ANCIENT_GCONF_DUMP_FILE) == 0)
+			has_gconf_dump = TRUE;
 	}
 
-	g_message ("Second result %d", result);
-	if (result) {
-		g_free (quotedfname);
-		return FALSE;
-	}
+	backup_archive_reader_free (reader);
 
-	if (is_new) {
+	if (error) {
+		g_message ("Failed to read '%s': %s", filename, error->message);
+		g_clear_error (&error);
+		result = 1;
+	} else if (has_dir_file) {
 		if (is_new_format)
 			*is_new_format = TRUE;
-		g_free (quotedfname);
-		return TRUE;
-	}
-
-	command = g_strdup_printf (
-		"tar %s %s | grep -e \"^\\.evolution/%s$\"",
-		tar_opts, quotedfname, ANCIENT_GCONF_DUMP_FILE);
-	result = system (command);
-	g_free (command);
-
-	if (result != 0) {
-		/* maybe it's an ancient backup */
-		command = g_strdup_printf (
-			"tar %s %s | grep -e \"^\\.evolution/%s$\"",
-			tar_opts, quotedfname, ANCIENT_GCONF_DUMP_FILE);
-		result = system (command);
-		g_free (command);
+		result = 0;
+	} else {
+		result = has_evolution_dir && has_gconf_dump ? 0 : 1;
 	}
 
-	g_free (quotedfname);
-
-	g_message ("Third result %d", result);
+	g_message ("Check result %d", result);
 
 	return result == 0;
 }
@@ -797,8 +1457,12 @@ static gboolean
 pbar_update (gpointer user_data)
 {
 	GCancellable *cancellable = G_CANCELLABLE (user_data);
+	gint permille = g_atomic_int_get (&progress_permille);
 
-	gtk_progress_bar_pulse ((GtkProgressBar *) pbar);
+	if (permille >= 0)
+		gtk_progress_bar_set_fraction ((GtkProgressBar *) pbar, permille / 1000.0);
+	else
+		gtk_progress_bar_pulse ((GtkProgressBar *) pbar);
 	gtk_progress_bar_set_text ((GtkProgressBar *) pbar, txt);
 
 	/* Return TRUE to reschedule the timeout. */
@@ -842,7 +1506,8 @@ dlg_response (GtkWidget *dlg,
 	if (response != GTK_RESPONSE_NONE)
 		gtk_widget_destroy (dlg);
 
-	/* We will kill just the tar operation. Rest of
+	/* We will kill just the tar operation of a legacy restore; the
+	 * archive is read and written by this process otherwise. Rest of
 	 * them will be just a second of microseconds.*/
 	run_cmd ("pkill tar");
 
@@ -30,6 +30,14 @@ struct _EPhotoCacheContactLoaderPrivate {
 
 	/* ESource -> EPhotoSource */
 	GHashTable *photo_sources;
+
+	/* Watches the opened books for added and changed contacts,
+	 * whose cached photos are not valid anymore. */
+	EClientCache *client_cache;
+	gulong client_created_handler_id;
+
+	/* ESource -> EBookClientView */
+	GHashTable *book_views;
 };
 
 G_DEFINE_DYNAMIC_TYPE (
@@ -47,6 +55,121 @@ photo_cache_contact_loader_get_photo_cache (EPhotoCacheContactLoader *loader)
 	return E_PHOTO_CACHE (extensible);
 }
 
+static void
+photo_cache_contact_loader_objects_changed_cb (EBookClientView *book_view,
+                                               const GSList *contacts,
+                                               EPhotoCacheContactLoader *loader)
+{
+	EPhotoCache *photo_cache;
+	const GSList *link;
+
+	photo_cache = photo_cache_contact_loader_get_photo_cache (loader);
+
+	for (link = contacts; link != NULL; link = g_slist_next (link)) {
+		EContact *contact = E_CONTACT (link->data);
+		GList *emails, *elink;
+
+		emails = e_contact_get (contact, E_CONTACT_EMAIL);
+
+		for (elink = emails; elink != NULL; elink = g_list_next (elink)) {
+			const gchar *email_address = elink->data;
+
+			if (email_address != NULL && *email_address != '\0')
+				e_photo_cache_remove_photo (photo_cache, email_address);
+		}
+
+		g_list_free_full (emails, g_free);
+	}
+}
+
+static void
+photo_cache_contact_loader_stop_book_view (gpointer data)
+{
+	EBookClientView *book_view = data;
+
+	g_signal_handlers_disconnect_matched (
+		book_view, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+		photo_cache_contact_loader_objects_changed_cb, NULL);
+
+	e_book_client_view_stop (book_view, NULL);
+	g_object_unref (book_view);
+}
+
+static void
+photo_cache_contact_loader_got_view_cb (GObject *source_object,
+                                        GAsyncResult *result,
+                                        gpointer user_data)
+{
+	EPhotoCacheContactLoader *loader = user_data;
+	EBookClientView *book_view = NULL;
+	ESource *source;
+	GError *local_error = NULL;
+
+	source = e_client_get_source (E_CLIENT (source_object));
+
+	if (!e_book_client_get_view_finish (E_BOOK_CLIENT (source_object), result, &book_view, &local_error)) {
+		if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: Failed to get book view: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+
+		g_clear_error (&local_error);
+		g_object_unref (loader);
+		return;
+	}
+
+	/* The source could be removed meanwhile or the view already exist. */
+	if (!g_hash_table_contains (loader->priv->photo_sources, source) ||
+	    g_hash_table_contains (loader->priv->book_views, source)) {
+		g_object_unref (book_view);
+		g_object_unref (loader);
+		return;
+	}
+
+	g_signal_connect (
+		book_view, "objects-added",
+		G_CALLBACK (photo_cache_contact_loader_objects_changed_cb), loader);
+
+	g_signal_connect (
+		book_view, "objects-modified",
+		G_CALLBACK (photo_cache_contact_loader_objects_changed_cb), loader);
+
+	/* Only the changes are interesting, not the current content. */
+	e_book_client_view_set_flags (book_view, E_BOOK_CLIENT_VIEW_FLAGS_NONE, NULL);
+	e_book_client_view_start (book_view, NULL);
+
+	g_hash_table_insert (loader->priv->book_views, g_object_ref (source), book_view);
+
+	g_object_unref (loader);
+}
+
+static void
+photo_cache_contact_loader_watch_client (EPhotoCacheContactLoader *loader,
+                                         EClient *client)
+{
+	ESource *source;
+
+	if (!E_IS_BOOK_CLIENT (client))
+		return;
+
+	source = e_client_get_source (client);
+
+	if (!g_hash_table_contains (loader->priv->photo_sources, source) ||
+	    g_hash_table_contains (loader->priv->book_views, source))
+		return;
+
+	e_book_client_get_view (
+		E_BOOK_CLIENT (client), "(exists \"email\")", NULL,
+		photo_cache_contact_loader_got_view_cb,
+		g_object_ref (loader));
+}
+
+static void
+photo_cache_contact_loader_client_created_cb (EClientCache *client_cache,
+                                              EClient *client,
+                                              EPhotoCacheContactLoader *loader)
+{
+	photo_cache_contact_loader_watch_client (loader, client);
+}
+
 static void
 photo_cache_contact_loader_add_source (EPhotoCacheContactLoader *loader,
                                        ESource *source)
@@ -54,6 +177,7 @@ photo_cache_contact_loader_add_source (EPhotoCacheContactLoader *loader,
 	EPhotoCache *photo_cache;
 	EPhotoSource *photo_source;
 	EClientCache *client_cache;
+	EClient *client;
 
 	photo_cache = photo_cache_contact_loader_get_photo_cache (loader);
 	client_cache = e_photo_cache_ref_client_cache (photo_cache);
@@ -66,6 +190,14 @@ photo_cache_contact_loader_add_source (EPhotoCacheContactLoader *loader,
 	e_photo_cache_add_photo_source (photo_cache, photo_source);
 	g_object_unref (photo_source);
 
+	/* Books not opened yet are watched once they are opened. */
+	client = e_client_cache_ref_cached_client (
+		client_cache, source, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+	if (client != NULL) {
+		photo_cache_contact_loader_watch_client (loader, client);
+		g_object_unref (client);
+	}
+
 	g_object_unref (client_cache);
 }
 
@@ -85,6 +217,8 @@ photo_cache_contact_loader_remove_source (EPhotoCacheContactLoader *loader,
 		e_photo_cache_remove_photo_source (photo_cache, photo_source);
 		g_hash_table_remove (hash_table, source);
 	}
+
+	g_hash_table_remove (loader->priv->book_views, source);
 }
 
 static void
@@ -132,7 +266,17 @@ photo_cache_contact_loader_dispose (GObject *object)
 
 	g_clear_object (&priv->registry);
 
+	if (priv->client_created_handler_id > 0) {
+		g_signal_handler_disconnect (
+			priv->client_cache,
+			priv->client_created_handler_id);
+		priv->client_created_handler_id = 0;
+	}
+
+	g_clear_object (&priv->client_cache);
+
 	g_hash_table_remove_all (priv->photo_sources);
+	g_hash_table_remove_all (priv->book_views);
 
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_photo_cache_contact_loader_parent_class)->
@@ -147,6 +291,7 @@ photo_cache_contact_loader_finalize (GObject *object)
 	priv = E_PHOTO_CACHE_CONTACT_LOADER_GET_PRIVATE (object);
 
 	g_hash_table_destroy (priv->photo_sources);
+	g_hash_table_destroy (priv->book_views);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_photo_cache_contact_loader_parent_class)->
@@ -173,6 +318,14 @@ photo_cache_contact_loader_constructed (GObject *object)
 	client_cache = e_photo_cache_ref_client_cache (photo_cache);
 	registry = e_client_cache_ref_registry (client_cache);
 
+	loader->priv->client_cache = g_object_ref (client_cache);
+
+	handler_id = g_signal_connect (
+		client_cache, "client-created",
+		G_CALLBACK (photo_cache_contact_loader_client_created_cb),
+		loader);
+	loader->priv->client_created_handler_id = handler_id;
+
 	extension_name = E_SOURCE_EXTENSION_ADDRESS_BOOK;
 	list = e_source_registry_list_sources (registry, extension_name);
 
@@ -228,6 +381,7 @@ static void
 e_photo_cache_contact_loader_init (EPhotoCacheContactLoader *loader)
 {
 	GHashTable *photo_sources;
+	GHashTable *book_views;
 
 	photo_sources = g_hash_table_new_full (
 		(GHashFunc) e_source_hash,
@@ -235,8 +389,15 @@ e_photo_cache_contact_loader_init (EPhotoCacheContactLoader *loader)
 		(GDestroyNotify) g_object_unref,
 		(GDestroyNotify) g_object_unref);
 
+	book_views = g_hash_table_new_full (
+		(GHashFunc) e_source_hash,
+		(GEqualFunc) e_source_equal,
+		(GDestroyNotify) g_object_unref,
+		(GDestroyNotify) photo_cache_contact_loader_stop_book_view);
+
 	loader->priv = E_PHOTO_CACHE_CONTACT_LOADER_GET_PRIVATE (loader);
 	loader->priv->photo_sources = photo_sources;
+	loader->priv->book_views = book_views;
 }
 
 void
@@ -181,7 +181,7 @@ mail_shell_view_setup_search_results_folder (CamelFolder *folder,
 	msg->stores_list = stores;
 
 	id = msg->base.seq;
-	mail_msg_slow_ordered_push (msg);
+	mail_msg_ordered_push (msg, camel_folder_get_parent_store (folder));
 
 	return id;
 }
@@ -295,7 +295,7 @@ mail_shell_view_setup_search_results_folder_and_subfolders (CamelFolder *vfolder
 	msg->root_folder = g_object_ref (root_folder);
 
 	id = msg->base.seq;
-	mail_msg_slow_ordered_push (msg);
+	mail_msg_ordered_push (msg, camel_folder_get_parent_store (vfolder));
 
 	return id;
 }
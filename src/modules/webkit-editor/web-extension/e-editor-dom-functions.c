@@ -625,305 +625,579 @@ e_editor_dom_exec_command (EEditorPage *editor_page,
 		e_editor_page_get_document (editor_page), cmd_str, FALSE, has_value ? value : "" );
 }
 
-/* FIXME WK2: this doesn't work, the cursor is moved, but the spellcheck is not updated */
-#if 0
+/* Spell checking of the existing content.  WebKit checks the words only
+ * around a moved caret and only once the selection settles, in a timer,
+ * which is why moving the caret through the whole document in one go
+ * did not mark anything.  The words are checked by moving the caret by
+ * one word per main loop iteration: paragraphs in the viewport and the
+ * edited paragraph first, then the rest of the document in background.
+ * Any action of the user interrupts the checking and restores the
+ * selection; it resumes after a short delay. */
+
+#define SPELL_CHECK_CONTEXT_KEY "-x-evo-spell-check-context"
+#define SPELL_CHECK_RESUME_DELAY_MS 500
+#define SPELL_CHECK_MAX_VIEWPORT_BLOCKS 200
+
+typedef struct _SpellCheckContext {
+	EEditorPage *editor_page; /* not referenced */
+
+	GQueue pending; /* WebKitDOMElement *, checked before the rest */
+	GHashTable *checked; /* WebKitDOMElement * */
+	WebKitDOMElement *catch_up_block; /* last block of the background check */
+	gboolean catch_up_done;
+
+	WebKitDOMElement *block; /* being checked */
+	WebKitDOMRange *end_range; /* end of the block */
+	WebKitDOMRange *word_range; /* caret position after the last step */
+	WebKitDOMRange *user_range; /* selection to restore */
+	gboolean selection_changed_blocked;
+	gboolean paused; /* while the mouse button is pressed */
+
+	guint source_id;
+} SpellCheckContext;
+
 static void
-perform_spell_check (WebKitDOMDOMSelection *dom_selection,
-                     WebKitDOMRange *start_range,
-                     WebKitDOMRange *end_range)
-{
-	WebKitDOMRange *actual = start_range;
-
-	/* Go through all words to spellcheck them. To avoid this we have to wait for
-	 * http://www.w3.org/html/wg/drafts/html/master/editing.html#dom-forcespellcheck */
-	/* We are moving forward word by word until we hit the text on the end. */
-	while (actual && webkit_dom_range_compare_boundary_points (actual, WEBKIT_DOM_RANGE_START_TO_START, end_range, NULL) < 0) {
-		if (actual != start_range)
-			g_object_unref (actual);
-		webkit_dom_dom_selection_modify (
-			dom_selection, "move", "forward", "word");
-		actual = webkit_dom_dom_selection_get_range_at (
-			dom_selection, 0, NULL);
+spell_check_context_free (gpointer ptr)
+{
+	SpellCheckContext *context = ptr;
+
+	if (!context)
+		return;
+
+	if (context->source_id)
+		g_source_remove (context->source_id);
+
+	g_queue_foreach (&context->pending, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&context->pending);
+	g_hash_table_destroy (context->checked);
+	g_clear_object (&context->catch_up_block);
+	g_clear_object (&context->block);
+	g_clear_object (&context->end_range);
+	g_clear_object (&context->word_range);
+	g_clear_object (&context->user_range);
+
+	g_slice_free (SpellCheckContext, context);
+}
+
+static SpellCheckContext *
+spell_check_get_context (EEditorPage *editor_page)
+{
+	SpellCheckContext *context;
+
+	context = g_object_get_data (G_OBJECT (editor_page), SPELL_CHECK_CONTEXT_KEY);
+	if (!context) {
+		context = g_slice_new0 (SpellCheckContext);
+		context->editor_page = editor_page;
+		context->checked = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+		g_queue_init (&context->pending);
+
+		g_object_set_data_full (G_OBJECT (editor_page), SPELL_CHECK_CONTEXT_KEY, context, spell_check_context_free);
 	}
-	g_clear_object (&actual);
+
+	return context;
 }
-#endif
 
-void
-e_editor_dom_force_spell_check_for_current_paragraph (EEditorPage *editor_page)
+static WebKitDOMDOMSelection *
+spell_check_ref_dom_selection (EEditorPage *editor_page)
 {
-/* FIXME WK2: this doesn't work, the cursor is moved, but the spellcheck is not updated */
-#if 0
 	WebKitDOMDocument *document;
-	WebKitDOMDOMSelection *dom_selection = NULL;
-	WebKitDOMDOMWindow *dom_window = NULL;
-	WebKitDOMElement *selection_start_marker, *selection_end_marker;
-	WebKitDOMElement *parent;
-	WebKitDOMHTMLElement *body;
-	WebKitDOMRange *end_range = NULL, *actual = NULL;
-	WebKitDOMText *text;
-
-	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
+	WebKitDOMDOMWindow *dom_window;
+	WebKitDOMDOMSelection *dom_selection;
 
 	document = e_editor_page_get_document (editor_page);
+	if (!document)
+		return NULL;
 
-	if (!e_editor_page_get_inline_spelling_enabled (editor_page))
-		return;
+	dom_window = webkit_dom_document_get_default_view (document);
+	dom_selection = webkit_dom_dom_window_get_selection (dom_window);
+	g_clear_object (&dom_window);
 
-	document = e_editor_page_get_document (editor_page);
-	body = webkit_dom_document_get_body (document);
+	return dom_selection;
+}
 
-	if (!body)
-		return;
+/* Stops checking of the current block and restores the user's selection;
+ * the block is checked again later, when @requeue is %TRUE. */
+static void
+spell_check_finish_block (SpellCheckContext *context,
+                          gboolean requeue)
+{
+	WebKitDOMDOMSelection *dom_selection;
 
-	if (!webkit_dom_node_get_first_child (WEBKIT_DOM_NODE (body)))
+	if (!context->block)
 		return;
 
-	e_editor_dom_selection_save (editor_page);
+	dom_selection = spell_check_ref_dom_selection (context->editor_page);
+	if (dom_selection) {
+		webkit_dom_dom_selection_remove_all_ranges (dom_selection);
+		if (context->user_range)
+			webkit_dom_dom_selection_add_range (dom_selection, context->user_range);
+		g_clear_object (&dom_selection);
+	}
 
-	selection_start_marker = webkit_dom_document_get_element_by_id (
-		document, "-x-evo-selection-start-marker");
-	selection_end_marker = webkit_dom_document_get_element_by_id (
-		document, "-x-evo-selection-end-marker");
+	if (requeue) {
+		g_hash_table_remove (context->checked, context->block);
+		g_queue_push_head (&context->pending, context->block);
+		context->block = NULL;
+	} else {
+		g_clear_object (&context->block);
+	}
 
-	if (!selection_start_marker || !selection_end_marker)
-		return;
+	g_clear_object (&context->end_range);
+	g_clear_object (&context->word_range);
+	g_clear_object (&context->user_range);
+}
 
-	/* Block callbacks of selection-changed signal as we don't want to
-	 * recount all the block format things in EEditorSelection and here as well
-	 * when we are moving with caret */
-	e_editor_page_block_selection_changed (editor_page);
+static void
+spell_check_stop (SpellCheckContext *context,
+                  gboolean requeue)
+{
+	spell_check_finish_block (context, requeue);
 
-	parent = get_parent_block_element (WEBKIT_DOM_NODE (selection_end_marker));
-	if (!parent)
-		parent = WEBKIT_DOM_ELEMENT (body);
+	if (context->source_id) {
+		g_source_remove (context->source_id);
+		context->source_id = 0;
+	}
 
-	/* Append some text on the end of the element */
-	text = webkit_dom_document_create_text_node (document, "-x-evo-end");
-	webkit_dom_node_append_child (
-		WEBKIT_DOM_NODE (parent),
-		WEBKIT_DOM_NODE (text),
-		NULL);
+	/* The selection-changed is blocked for the whole run, thus the caret
+	 * moves and restores are not reported for each checked paragraph. */
+	if (context->selection_changed_blocked) {
+		context->selection_changed_blocked = FALSE;
+		e_editor_page_unblock_selection_changed (context->editor_page);
+	}
+}
 
-	parent = get_parent_block_element (WEBKIT_DOM_NODE (selection_start_marker));
-	if (!parent)
-		parent = WEBKIT_DOM_ELEMENT (body);
+/* Returns the next node in the document order, within the @root */
+static WebKitDOMNode *
+spell_check_next_node (WebKitDOMNode *node,
+                       WebKitDOMNode *root,
+                       gboolean skip_children)
+{
+	WebKitDOMNode *next;
 
-	/* Create range that's pointing on the end of this text */
-	end_range = webkit_dom_document_create_range (document);
-	webkit_dom_range_select_node_contents (
-		end_range, WEBKIT_DOM_NODE (text), NULL);
-	webkit_dom_range_collapse (end_range, FALSE, NULL);
+	if (!skip_children && (next = webkit_dom_node_get_first_child (node)) != NULL)
+		return next;
 
-	/* Move on the beginning of the paragraph */
-	dom_window = webkit_dom_document_get_default_view (document);
-	dom_selection = webkit_dom_dom_window_get_selection (dom_window);
+	while (node && node != root) {
+		next = webkit_dom_node_get_next_sibling (node);
+		if (next)
+			return next;
 
-	actual = webkit_dom_document_create_range (document);
-	webkit_dom_range_select_node_contents (
-		actual, WEBKIT_DOM_NODE (parent), NULL);
-	webkit_dom_range_collapse (actual, TRUE, NULL);
-	webkit_dom_dom_selection_remove_all_ranges (dom_selection);
-	webkit_dom_dom_selection_add_range (dom_selection, actual);
-	g_clear_object (&actual);
+		node = webkit_dom_node_get_parent_node (node);
+	}
 
-	actual = webkit_dom_dom_selection_get_range_at (dom_selection, 0, NULL);
-	perform_spell_check (dom_selection, actual, end_range);
+	return NULL;
+}
 
-	g_clear_object (&dom_selection);
-	g_clear_object (&dom_window);
-	g_clear_object (&end_range);
-	g_clear_object (&actual);
+/* Returns the first block element with some text after the @after_block,
+ * or the first one in the document, when it's %NULL. */
+static WebKitDOMElement *
+spell_check_next_block (WebKitDOMHTMLElement *body,
+                        WebKitDOMElement *after_block)
+{
+	WebKitDOMNode *root = WEBKIT_DOM_NODE (body), *node;
 
-	/* Remove the text that we inserted on the end of the paragraph */
-	remove_node (WEBKIT_DOM_NODE (text));
+	if (after_block)
+		node = spell_check_next_node (WEBKIT_DOM_NODE (after_block), root, TRUE);
+	else
+		node = webkit_dom_node_get_first_child (root);
 
-	e_editor_dom_selection_restore (editor_page);
-	/* Unblock the callbacks */
-	e_editor_page_unblock_selection_changed (editor_page);
-#endif
+	while (node) {
+		if (WEBKIT_DOM_IS_TEXT (node)) {
+			WebKitDOMElement *block;
+			gchar *data;
+			gboolean has_text;
+
+			data = webkit_dom_character_data_get_data (WEBKIT_DOM_CHARACTER_DATA (node));
+			has_text = data && *g_strstrip (data);
+			g_free (data);
+
+			block = has_text ? get_parent_block_element (node) : NULL;
+			if (block && block != after_block)
+				return block;
+		}
+
+		node = spell_check_next_node (node, root, FALSE);
+	}
+
+	return NULL;
+}
+
+static WebKitDOMElement *
+spell_check_block_from_point (WebKitDOMDocument *document,
+                              glong xx,
+                              glong yy)
+{
+	WebKitDOMRange *range;
+	WebKitDOMNode *node;
+	WebKitDOMElement *block = NULL;
+
+	range = webkit_dom_document_caret_range_from_point (document, xx, yy);
+	if (!range)
+		return NULL;
+
+	node = webkit_dom_range_get_start_container (range, NULL);
+	if (node && !WEBKIT_DOM_IS_HTML_BODY_ELEMENT (node) && !WEBKIT_DOM_IS_HTML_HTML_ELEMENT (node))
+		block = get_parent_block_element (node);
+
+	g_clear_object (&range);
+
+	return block;
 }
 
 static void
-refresh_spell_check (EEditorPage *editor_page,
-                     gboolean enable_spell_check)
+spell_check_queue_block (SpellCheckContext *context,
+                         WebKitDOMElement *block)
+{
+	GList *link;
+
+	if (!block || block == context->block)
+		return;
+
+	link = g_queue_find (&context->pending, block);
+	if (link) {
+		g_queue_unlink (&context->pending, link);
+		g_queue_push_head_link (&context->pending, link);
+	} else {
+		g_queue_push_head (&context->pending, g_object_ref (block));
+	}
+}
+
+/* Puts paragraphs in the viewport at the head of the queue, top first */
+static void
+spell_check_queue_viewport (SpellCheckContext *context,
+                            WebKitDOMDocument *document,
+                            WebKitDOMHTMLElement *body)
 {
-/* FIXME WK2: this doesn't work, the cursor is moved, but the spellcheck is not updated */
-#if 0
+	WebKitDOMDOMWindow *dom_window;
+	WebKitDOMElement *block, *last;
+	GSList *blocks = NULL, *link;
+	glong viewport_height;
+	gint n_blocks = 0;
+
+	dom_window = webkit_dom_document_get_default_view (document);
+	viewport_height = webkit_dom_dom_window_get_inner_height (dom_window);
+	g_clear_object (&dom_window);
+
+	/* We have to add 10 px offset as otherwise just the HTML element will be returned */
+	block = spell_check_block_from_point (document, 10, 10);
+	last = spell_check_block_from_point (document, 10, viewport_height - 10);
+
+	if (!block)
+		block = spell_check_next_block (body, NULL);
+
+	while (block && n_blocks < SPELL_CHECK_MAX_VIEWPORT_BLOCKS) {
+		blocks = g_slist_prepend (blocks, block);
+		n_blocks++;
+
+		/* Without the last block the content ends above the bottom of the viewport */
+		if (last && (block == last || webkit_dom_node_contains (WEBKIT_DOM_NODE (block), WEBKIT_DOM_NODE (last))))
+			break;
+
+		block = spell_check_next_block (body, block);
+	}
+
+	for (link = blocks; link; link = g_slist_next (link)) {
+		spell_check_queue_block (context, link->data);
+	}
+
+	g_slist_free (blocks);
+}
+
+/* Returns the next block to check, with a reference, or %NULL when all done */
+static WebKitDOMElement *
+spell_check_take_block (SpellCheckContext *context,
+                        WebKitDOMHTMLElement *body)
+{
+	WebKitDOMElement *block = NULL;
+
+	while (!block && !g_queue_is_empty (&context->pending)) {
+		block = g_queue_pop_head (&context->pending);
+
+		/* Could be removed from the document meanwhile */
+		if (!webkit_dom_node_contains (WEBKIT_DOM_NODE (body), WEBKIT_DOM_NODE (block)))
+			g_clear_object (&block);
+	}
+
+	if (context->catch_up_block &&
+	    !webkit_dom_node_contains (WEBKIT_DOM_NODE (body), WEBKIT_DOM_NODE (context->catch_up_block)))
+		g_clear_object (&context->catch_up_block);
+
+	while (!block && !context->catch_up_done) {
+		WebKitDOMElement *next;
+
+		next = spell_check_next_block (body, context->catch_up_block);
+
+		g_clear_object (&context->catch_up_block);
+
+		if (next) {
+			context->catch_up_block = g_object_ref (next);
+
+			if (!g_hash_table_contains (context->checked, next))
+				block = g_object_ref (next);
+		} else {
+			context->catch_up_done = TRUE;
+		}
+	}
+
+	return block;
+}
+
+static gboolean
+spell_check_step_cb (gpointer user_data)
+{
+	SpellCheckContext *context = user_data;
+	EEditorPage *editor_page = context->editor_page;
 	WebKitDOMDocument *document;
-	WebKitDOMDOMSelection *dom_selection = NULL;
-	WebKitDOMDOMWindow *dom_window = NULL;
-	WebKitDOMElement *selection_start_marker, *selection_end_marker;
 	WebKitDOMHTMLElement *body;
-	WebKitDOMRange *end_range = NULL, *actual = NULL;
-	WebKitDOMText *text;
-
-	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
+	WebKitDOMDOMSelection *dom_selection;
+	WebKitDOMRange *range;
 
 	document = e_editor_page_get_document (editor_page);
-	body = webkit_dom_document_get_body (document);
+	body = document ? webkit_dom_document_get_body (document) : NULL;
 
-	if (!webkit_dom_node_get_first_child (WEBKIT_DOM_NODE (body)))
-		return;
+	if (!body || !e_editor_page_get_inline_spelling_enabled (editor_page)) {
+		context->source_id = 0;
+		spell_check_stop (context, FALSE);
+		return FALSE;
+	}
 
-	/* Enable/Disable spellcheck in composer */
-	webkit_dom_element_set_attribute (
-		WEBKIT_DOM_ELEMENT (body),
-		"spellcheck",
-		enable_spell_check ? "true" : "false",
-		NULL);
+	dom_selection = spell_check_ref_dom_selection (editor_page);
 
-	e_editor_dom_selection_save (editor_page);
+	if (!context->block) {
+		WebKitDOMElement *block;
 
-	selection_start_marker = webkit_dom_document_get_element_by_id (
-		document, "-x-evo-selection-start-marker");
-	selection_end_marker = webkit_dom_document_get_element_by_id (
-		document, "-x-evo-selection-end-marker");
+		block = spell_check_take_block (context, body);
+		if (!block) {
+			g_clear_object (&dom_selection);
+			context->source_id = 0;
+			spell_check_stop (context, FALSE);
+			return FALSE;
+		}
 
-	/* Sometimes the web view is not focused, so we have to save the selection
-	 * manually into the body */
-	if (!selection_start_marker || !selection_end_marker) {
-		WebKitDOMNode *child;
+		if (!context->selection_changed_blocked) {
+			context->selection_changed_blocked = TRUE;
+			e_editor_page_block_selection_changed (editor_page);
+		}
 
-		child = webkit_dom_node_get_first_child (WEBKIT_DOM_NODE (body));
-		if (!WEBKIT_DOM_IS_ELEMENT (child))
-			return;
+		g_hash_table_add (context->checked, g_object_ref (block));
 
-		dom_add_selection_markers_into_element_start (
-			document,
-			WEBKIT_DOM_ELEMENT (child),
-			&selection_start_marker,
-			&selection_end_marker);
-	}
+		context->block = block;
+		context->user_range = webkit_dom_dom_selection_get_range_at (dom_selection, 0, NULL);
 
-	/* Block callbacks of selection-changed signal as we don't want to
-	 * recount all the block format things in EEditorSelection and here as well
-	 * when we are moving with caret */
-	e_editor_page_block_selection_changed (editor_page);
+		context->end_range = webkit_dom_document_create_range (document);
+		webkit_dom_range_select_node_contents (
+			context->end_range, WEBKIT_DOM_NODE (block), NULL);
+		webkit_dom_range_collapse (context->end_range, FALSE, NULL);
 
-	/* Append some text on the end of the body */
-	text = webkit_dom_document_create_text_node (document, "-x-evo-end");
-	webkit_dom_node_append_child (
-		WEBKIT_DOM_NODE (body), WEBKIT_DOM_NODE (text), NULL);
+		/* Move on the beginning of the paragraph */
+		range = webkit_dom_document_create_range (document);
+		webkit_dom_range_select_node_contents (
+			range, WEBKIT_DOM_NODE (block), NULL);
+		webkit_dom_range_collapse (range, TRUE, NULL);
+		webkit_dom_dom_selection_remove_all_ranges (dom_selection);
+		webkit_dom_dom_selection_add_range (dom_selection, range);
 
-	/* Create range that's pointing on the end of this text */
-	end_range = webkit_dom_document_create_range (document);
-	webkit_dom_range_select_node_contents (
-		end_range, WEBKIT_DOM_NODE (text), NULL);
-	webkit_dom_range_collapse (end_range, FALSE, NULL);
+		context->word_range = range;
 
-	dom_window = webkit_dom_document_get_default_view (document);
-	dom_selection = webkit_dom_dom_window_get_selection (dom_window);
+		g_clear_object (&dom_selection);
 
-	/* Move on the beginning of the document */
-	webkit_dom_dom_selection_modify (
-		dom_selection, "move", "backward", "documentboundary");
+		return TRUE;
+	}
+
+	/* WebKit checks the word the caret left, once it's back in the main loop */
+	webkit_dom_dom_selection_modify (dom_selection, "move", "forward", "word");
+	range = webkit_dom_dom_selection_get_range_at (dom_selection, 0, NULL);
 
-	actual = webkit_dom_dom_selection_get_range_at (dom_selection, 0, NULL);
-	perform_spell_check (dom_selection, actual, end_range);
+	if (!range ||
+	    webkit_dom_range_compare_boundary_points (range, WEBKIT_DOM_RANGE_START_TO_START, context->end_range, NULL) >= 0 ||
+	    webkit_dom_range_compare_boundary_points (range, WEBKIT_DOM_RANGE_START_TO_START, context->word_range, NULL) <= 0) {
+		/* The last word is checked with the selection restore */
+		g_clear_object (&range);
+		spell_check_finish_block (context, FALSE);
+	} else {
+		g_clear_object (&context->word_range);
+		context->word_range = range;
+	}
 
 	g_clear_object (&dom_selection);
-	g_clear_object (&dom_window);
-	g_clear_object (&end_range);
-	g_clear_object (&actual);
 
-	/* Remove the text that we inserted on the end of the body */
-	remove_node (WEBKIT_DOM_NODE (text));
+	return TRUE;
+}
 
-	e_editor_dom_selection_restore (editor_page);
-	/* Unblock the callbacks */
-	e_editor_page_unblock_selection_changed (editor_page);
-#endif
+static gboolean
+spell_check_resume_cb (gpointer user_data)
+{
+	SpellCheckContext *context = user_data;
+
+	context->source_id = g_idle_add_full (
+		G_PRIORITY_LOW, spell_check_step_cb, context, NULL);
+
+	return FALSE;
+}
+
+/* Starts checking after a delay, unless it's already running */
+static void
+spell_check_schedule (SpellCheckContext *context)
+{
+	if (context->block || context->paused)
+		return;
+
+	if (context->source_id)
+		g_source_remove (context->source_id);
+
+	context->source_id = g_timeout_add_full (
+		G_PRIORITY_LOW, SPELL_CHECK_RESUME_DELAY_MS,
+		spell_check_resume_cb, context, NULL);
 }
 
 void
-e_editor_dom_turn_spell_check_off (EEditorPage *editor_page)
+e_editor_dom_spell_check_interrupt (EEditorPage *editor_page)
 {
+	SpellCheckContext *context;
+
 	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
 
-	refresh_spell_check (editor_page, FALSE);
+	context = g_object_get_data (G_OBJECT (editor_page), SPELL_CHECK_CONTEXT_KEY);
+	if (!context || !context->source_id)
+		return;
+
+	spell_check_stop (context, TRUE);
+	spell_check_schedule (context);
+}
+
+/* Does not check while the user selects with the mouse, the caret moves
+ * of the check would change the selection under the mouse pointer. */
+static void
+spell_check_set_paused (EEditorPage *editor_page,
+                        gboolean paused)
+{
+	SpellCheckContext *context;
+
+	if (paused)
+		context = spell_check_get_context (editor_page);
+	else
+		context = g_object_get_data (G_OBJECT (editor_page), SPELL_CHECK_CONTEXT_KEY);
+
+	if (!context || context->paused == paused)
+		return;
+
+	if (paused) {
+		spell_check_stop (context, TRUE);
+		context->paused = TRUE;
+	} else {
+		context->paused = FALSE;
+		spell_check_schedule (context);
+	}
 }
 
 void
-e_editor_dom_force_spell_check_in_viewport (EEditorPage *editor_page)
+e_editor_dom_force_spell_check_for_current_paragraph (EEditorPage *editor_page)
 {
-/* FIXME WK2: this doesn't work, the cursor is moved, but the spellcheck is not updated */
-#if 0
-	WebKitDOMDocument *document;
-	WebKitDOMDOMSelection *dom_selection = NULL;
-	WebKitDOMDOMWindow *dom_window = NULL;
-	WebKitDOMElement *last_element;
-	WebKitDOMHTMLElement *body;
-	WebKitDOMRange *end_range = NULL, *actual = NULL;
-	WebKitDOMText *text;
-	glong viewport_height;
+	SpellCheckContext *context;
+	WebKitDOMDOMSelection *dom_selection;
+	WebKitDOMRange *range;
 
 	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
 
 	if (!e_editor_page_get_inline_spelling_enabled (editor_page))
 		return;
 
+	dom_selection = spell_check_ref_dom_selection (editor_page);
+	if (!dom_selection)
+		return;
+
+	range = webkit_dom_dom_selection_get_range_at (dom_selection, 0, NULL);
+	if (range) {
+		WebKitDOMNode *node;
+		WebKitDOMElement *block = NULL;
+
+		node = webkit_dom_range_get_end_container (range, NULL);
+		if (node && !WEBKIT_DOM_IS_HTML_BODY_ELEMENT (node))
+			block = get_parent_block_element (node);
+
+		if (block) {
+			context = spell_check_get_context (editor_page);
+			spell_check_queue_block (context, block);
+			spell_check_schedule (context);
+		}
+	}
+
+	g_clear_object (&range);
+	g_clear_object (&dom_selection);
+}
+
+static void
+refresh_spell_check (EEditorPage *editor_page,
+                     gboolean enable_spell_check)
+{
+	SpellCheckContext *context;
+	WebKitDOMDocument *document;
+	WebKitDOMHTMLElement *body;
+
+	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
+
 	document = e_editor_page_get_document (editor_page);
 	body = webkit_dom_document_get_body (document);
 
-	if (!webkit_dom_node_get_first_child (WEBKIT_DOM_NODE (body)))
+	if (!body)
 		return;
 
-	e_editor_dom_selection_save (editor_page);
+	/* Enable/Disable spellcheck in composer */
+	webkit_dom_element_set_attribute (
+		WEBKIT_DOM_ELEMENT (body),
+		"spellcheck",
+		enable_spell_check ? "true" : "false",
+		NULL);
 
-	/* Block callbacks of selection-changed signal as we don't want to
-	 * recount all the block format things in EEditorSelection and here as well
-	 * when we are moving with caret */
-	e_editor_page_block_selection_changed (editor_page);
+	/* Start over, the languages could change */
+	context = spell_check_get_context (editor_page);
+	spell_check_stop (context, FALSE);
 
-	/* We have to add 10 px offset as otherwise just the HTML element will be returned */
-	actual = webkit_dom_document_caret_range_from_point (document, 10, 10);
-	if (!actual)
-		goto out;
+	g_queue_foreach (&context->pending, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&context->pending);
+	g_hash_table_remove_all (context->checked);
+	g_clear_object (&context->catch_up_block);
+	context->catch_up_done = FALSE;
 
-	/* Append some text on the end of the body */
-	text = webkit_dom_document_create_text_node (document, "-x-evo-end");
+	if (enable_spell_check && webkit_dom_node_get_first_child (WEBKIT_DOM_NODE (body))) {
+		spell_check_queue_viewport (context, document, body);
+		spell_check_schedule (context);
+	}
+}
 
-	dom_window = webkit_dom_document_get_default_view (document);
-	dom_selection = webkit_dom_dom_window_get_selection (dom_window);
+void
+e_editor_dom_turn_spell_check_off (EEditorPage *editor_page)
+{
+	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
 
-	/* We have to add 10 px offset as otherwise just the HTML element will be returned */
-	viewport_height = webkit_dom_dom_window_get_inner_height (dom_window);
-	last_element = webkit_dom_document_element_from_point (document, 10, viewport_height - 10);
-	if (last_element && !WEBKIT_DOM_IS_HTML_HTML_ELEMENT (last_element) &&
-	    !WEBKIT_DOM_IS_HTML_BODY_ELEMENT (last_element)) {
-		WebKitDOMElement *parent;
+	refresh_spell_check (editor_page, FALSE);
+}
 
-		parent = get_parent_block_element (WEBKIT_DOM_NODE (last_element));
-		webkit_dom_node_append_child (
-			WEBKIT_DOM_NODE (parent ? parent : last_element), WEBKIT_DOM_NODE (text), NULL);
-	} else
-		webkit_dom_node_append_child (
-			WEBKIT_DOM_NODE (body), WEBKIT_DOM_NODE (text), NULL);
+void
+e_editor_dom_force_spell_check_in_viewport (EEditorPage *editor_page)
+{
+	SpellCheckContext *context;
+	WebKitDOMDocument *document;
+	WebKitDOMHTMLElement *body;
 
-	/* Create range that's pointing on the end of viewport */
-	end_range = webkit_dom_document_create_range (document);
-	webkit_dom_range_select_node_contents (
-		end_range, WEBKIT_DOM_NODE (text), NULL);
-	webkit_dom_range_collapse (end_range, FALSE, NULL);
+	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
 
-	webkit_dom_dom_selection_remove_all_ranges (dom_selection);
-	webkit_dom_dom_selection_add_range (dom_selection, actual);
-	perform_spell_check (dom_selection, actual, end_range);
+	if (!e_editor_page_get_inline_spelling_enabled (editor_page))
+		return;
 
-	g_clear_object (&dom_selection);
-	g_clear_object (&dom_window);
-	g_clear_object (&end_range);
-	g_clear_object (&actual);
+	document = e_editor_page_get_document (editor_page);
+	body = webkit_dom_document_get_body (document);
 
-	/* Remove the text that we inserted on the end of the body */
-	remove_node (WEBKIT_DOM_NODE (text));
+	if (!body || !webkit_dom_node_get_first_child (WEBKIT_DOM_NODE (body)))
+		return;
 
- out:
-	e_editor_dom_selection_restore (editor_page);
-	/* Unblock the callbacks */
-	e_editor_page_unblock_selection_changed (editor_page);
-#endif
+	context = spell_check_get_context (editor_page);
+
+	/* The content could change, check the not visible part again too */
+	context->catch_up_done = FALSE;
+
+	spell_check_queue_viewport (context, document, body);
+	spell_check_schedule (context);
 }
 
 void
@@ -2933,6 +3207,9 @@ body_keydown_event_cb (WebKitDOMElement *element,
 
 	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
 
+	/* The key applies to the user's selection */
+	e_editor_dom_spell_check_interrupt (editor_page);
+
 	document = webkit_dom_node_get_owner_document (WEBKIT_DOM_NODE (element));
 
 	key_code = webkit_dom_ui_event_get_key_code (event);
@@ -6001,12 +6278,79 @@ body_dragend_event_cb (WebKitDOMElement *element,
 	e_editor_dom_register_input_event_listener_on_body (editor_page);
 }
 
+static void
+body_mousedown_event_cb (WebKitDOMElement *element,
+                         WebKitDOMEvent *event,
+                         EEditorPage *editor_page)
+{
+	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
+
+	spell_check_set_paused (editor_page, TRUE);
+}
+
+static void
+body_mouseup_event_cb (WebKitDOMElement *element,
+                       WebKitDOMEvent *event,
+                       EEditorPage *editor_page)
+{
+	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
+
+	spell_check_set_paused (editor_page, FALSE);
+}
+
+/* Editing commands run by the UI process do not go through the keydown */
+static void
+body_spell_check_interrupt_event_cb (WebKitDOMElement *element,
+                                     WebKitDOMEvent *event,
+                                     EEditorPage *editor_page)
+{
+	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
+
+	e_editor_dom_spell_check_interrupt (editor_page);
+}
+
 static void
 register_html_events_handlers (EEditorPage *editor_page,
                                WebKitDOMHTMLElement *body)
 {
+	const gchar *interrupt_events[] = { "selectstart", "input", "compositionstart", "focus" };
+	guint ii;
+
 	g_return_if_fail (E_IS_EDITOR_PAGE (editor_page));
 
+	webkit_dom_event_target_add_event_listener (
+		WEBKIT_DOM_EVENT_TARGET (body),
+		"mousedown",
+		G_CALLBACK (body_mousedown_event_cb),
+		FALSE,
+		editor_page);
+
+	/* On the document and in the capture phase, thus the release is seen
+	 * also outside of the body and when an element stops its propagation. */
+	webkit_dom_event_target_add_event_listener (
+		WEBKIT_DOM_EVENT_TARGET (e_editor_page_get_document (editor_page)),
+		"mouseup",
+		G_CALLBACK (body_mouseup_event_cb),
+		TRUE,
+		editor_page);
+
+	/* The mouseup can be missed, when released outside of the view */
+	webkit_dom_event_target_add_event_listener (
+		WEBKIT_DOM_EVENT_TARGET (body),
+		"blur",
+		G_CALLBACK (body_mouseup_event_cb),
+		FALSE,
+		editor_page);
+
+	for (ii = 0; ii < G_N_ELEMENTS (interrupt_events); ii++) {
+		webkit_dom_event_target_add_event_listener (
+			WEBKIT_DOM_EVENT_TARGET (body),
+			interrupt_events[ii],
+			G_CALLBACK (body_spell_check_interrupt_event_cb),
+			FALSE,
+			editor_page);
+	}
+
 	webkit_dom_event_target_add_event_listener (
 		WEBKIT_DOM_EVENT_TARGET (body),
 		"keydown",
@@ -84,6 +84,8 @@ void		e_editor_dom_force_spell_check_in_viewport
 void		e_editor_dom_force_spell_check	(EEditorPage *editor_page);
 void		e_editor_dom_turn_spell_check_off
 						(EEditorPage *editor_page);
+void		e_editor_dom_spell_check_interrupt
+						(EEditorPage *editor_page);
 void		e_editor_dom_embed_style_sheet	(EEditorPage *editor_page,
 						 const gchar *style_sheet_content);
 void		e_editor_dom_remove_embedded_style_sheet
@@ -663,6 +663,10 @@ get_editor_page_or_return_dbus_error (GDBusMethodInvocation *invocation,
 		g_dbus_method_invocation_return_error (
 			invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
 			"Invalid page ID: %" G_GUINT64_FORMAT, page_id);
+	} else {
+		/* The method works with the user's selection, not with
+		 * the one moved by the spell checker. */
+		e_editor_dom_spell_check_interrupt (editor_page);
 	}
 
 	return editor_page;